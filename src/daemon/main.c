@@ -1021,9 +1021,11 @@ int main(int argc, char *argv[]) {
     c->deferred_volume_extra_delay_usec = conf->deferred_volume_extra_delay_usec;
     c->exit_idle_time = conf->exit_idle_time;
     c->scache_idle_time = conf->scache_idle_time;
+    c->resampler_idle_time = conf->resampler_idle_time;
     c->resample_method = conf->resample_method;
     c->realtime_priority = conf->realtime_priority;
     c->realtime_scheduling = !!conf->realtime_scheduling;
+    c->render_threads = conf->render_threads;
     c->disable_remixing = !!conf->disable_remixing;
     c->disable_lfe_remixing = !!conf->disable_lfe_remixing;
     c->deferred_volume = !!conf->deferred_volume;
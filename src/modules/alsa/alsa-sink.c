@@ -1697,15 +1697,24 @@ static void thread_func(void *userdata) {
             pa_usec_t sleep_usec = 0;
             pa_bool_t on_timeout = pa_rtpoll_timer_elapsed(u->rtpoll);
 
-            if (PA_UNLIKELY(u->sink->thread_info.rewind_requested))
-                if (process_rewind(u) < 0)
-                        goto fail;
+            if (PA_UNLIKELY(u->sink->thread_info.rewind_requested)) {
+                pa_cycle_profile_begin(&u->sink->thread_info.cycle_profile);
+                ret = process_rewind(u);
+                pa_cycle_profile_end(&u->sink->thread_info.cycle_profile, PA_CYCLE_STAGE_REWIND);
+
+                if (ret < 0)
+                    goto fail;
+            }
+
+            pa_cycle_profile_begin(&u->sink->thread_info.cycle_profile);
 
             if (u->use_mmap)
                 work_done = mmap_write(u, &sleep_usec, revents & POLLOUT, on_timeout);
             else
                 work_done = unix_write(u, &sleep_usec, revents & POLLOUT, on_timeout);
 
+            pa_cycle_profile_end(&u->sink->thread_info.cycle_profile, PA_CYCLE_STAGE_IO);
+
             if (work_done < 0)
                 goto fail;
 
@@ -1791,6 +1800,9 @@ static void thread_func(void *userdata) {
         if (ret == 0)
             goto finish;
 
+        if (PA_SINK_IS_OPENED(u->sink->thread_info.state))
+            pa_cycle_profile_next(&u->sink->thread_info.cycle_profile);
+
         /* Tell ALSA about this and process its response */
         if (PA_SINK_IS_OPENED(u->sink->thread_info.state)) {
             struct pollfd *pollfd;
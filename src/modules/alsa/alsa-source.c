@@ -1472,11 +1472,15 @@ static void thread_func(void *userdata) {
                 u->first = FALSE;
             }
 
+            pa_cycle_profile_begin(&u->source->thread_info.cycle_profile);
+
             if (u->use_mmap)
                 work_done = mmap_read(u, &sleep_usec, revents & POLLIN, on_timeout);
             else
                 work_done = unix_read(u, &sleep_usec, revents & POLLIN, on_timeout);
 
+            pa_cycle_profile_end(&u->source->thread_info.cycle_profile, PA_CYCLE_STAGE_IO);
+
             if (work_done < 0)
                 goto fail;
 
@@ -1530,6 +1534,9 @@ static void thread_func(void *userdata) {
         if (ret == 0)
             goto finish;
 
+        if (PA_SOURCE_IS_OPENED(u->source->thread_info.state))
+            pa_cycle_profile_next(&u->source->thread_info.cycle_profile);
+
         /* Tell ALSA about this and process its response */
         if (PA_SOURCE_IS_OPENED(u->source->thread_info.state)) {
             struct pollfd *pollfd;
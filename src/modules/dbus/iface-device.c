@@ -67,6 +67,7 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
 
 static void handle_suspend(DBusConnection *conn, DBusMessage *msg, void *userdata);
 static void handle_get_port_by_name(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_get_cycle_profile(DBusConnection *conn, DBusMessage *msg, void *userdata);
 
 static void handle_sink_get_monitor_source(DBusConnection *conn, DBusMessage *msg, void *userdata);
 
@@ -178,11 +179,13 @@ static pa_dbus_property_handler source_property_handlers[SOURCE_PROPERTY_HANDLER
 enum method_handler_index {
     METHOD_HANDLER_SUSPEND,
     METHOD_HANDLER_GET_PORT_BY_NAME,
+    METHOD_HANDLER_GET_CYCLE_PROFILE,
     METHOD_HANDLER_MAX
 };
 
 static pa_dbus_arg_info suspend_args[] = { { "suspend", "b", "in" } };
 static pa_dbus_arg_info get_port_by_name_args[] = { { "name", "s", "in" }, { "port", "o", "out" } };
+static pa_dbus_arg_info get_cycle_profile_args[] = { { "profile", "a{sv}", "out" } };
 
 static pa_dbus_method_handler method_handlers[METHOD_HANDLER_MAX] = {
     [METHOD_HANDLER_SUSPEND] = {
@@ -194,7 +197,12 @@ static pa_dbus_method_handler method_handlers[METHOD_HANDLER_MAX] = {
         .method_name = "GetPortByName",
         .arguments = get_port_by_name_args,
         .n_arguments = sizeof(get_port_by_name_args) / sizeof(pa_dbus_arg_info),
-        .receive_cb = handle_get_port_by_name }
+        .receive_cb = handle_get_port_by_name },
+    [METHOD_HANDLER_GET_CYCLE_PROFILE] = {
+        .method_name = "GetCycleProfile",
+        .arguments = get_cycle_profile_args,
+        .n_arguments = sizeof(get_cycle_profile_args) / sizeof(pa_dbus_arg_info),
+        .receive_cb = handle_get_cycle_profile }
 };
 
 enum signal_index {
@@ -968,6 +976,52 @@ static void handle_get_port_by_name(DBusConnection *conn, DBusMessage *msg, void
     pa_dbus_send_basic_value_reply(conn, msg, DBUS_TYPE_OBJECT_PATH, &port_path);
 }
 
+static void append_histogram(DBusMessageIter *dict_iter, const char *key, const pa_histogram *h) {
+    dbus_uint64_t values[4];
+
+    values[0] = h->count;
+    values[1] = pa_histogram_percentile(h, 50);
+    values[2] = pa_histogram_percentile(h, 99);
+    values[3] = h->max;
+
+    pa_dbus_append_basic_array_variant_dict_entry(dict_iter, key, DBUS_TYPE_UINT64, values, PA_ELEMENTSOF(values));
+}
+
+/* Each entry is [count, median, 99th percentile, max]; in usec for the
+ * stages, in permille of the cycle for "duty" */
+static void handle_get_cycle_profile(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_device *d = userdata;
+    pa_cycle_profile profile;
+    DBusMessage *reply = NULL;
+    DBusMessageIter msg_iter;
+    DBusMessageIter dict_iter;
+    unsigned i;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(d);
+
+    if (d->type == PA_DEVICE_TYPE_SINK)
+        pa_sink_get_cycle_profile(d->sink, &profile);
+    else
+        pa_source_get_cycle_profile(d->source, &profile);
+
+    pa_assert_se((reply = dbus_message_new_method_return(msg)));
+
+    dbus_message_iter_init_append(reply, &msg_iter);
+    pa_assert_se(dbus_message_iter_open_container(&msg_iter, DBUS_TYPE_ARRAY, "{sv}", &dict_iter));
+
+    for (i = 0; i < PA_CYCLE_STAGE_MAX; i++)
+        append_histogram(&dict_iter, pa_cycle_stage_to_string(i), &profile.stage[i]);
+
+    append_histogram(&dict_iter, "duty", &profile.duty);
+
+    pa_assert_se(dbus_message_iter_close_container(&msg_iter, &dict_iter));
+
+    pa_assert_se(dbus_connection_send(conn, reply, NULL));
+    dbus_message_unref(reply);
+}
+
 static void handle_sink_get_monitor_source(DBusConnection *conn, DBusMessage *msg, void *userdata) {
     pa_dbusiface_device *d = userdata;
     const char *monitor_source = NULL;
@@ -0,0 +1,410 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#ifdef HAVE_FFTW
+#include <fftw3.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "hrir-convolver.h"
+
+/* Impulse responses at least this long are folded in the frequency
+ * domain when the method is left to us */
+#define FFT_MIN_HRIR_SAMPLES 64
+
+/* Upper bound for the partition size of the FFT engine, in frames. The
+ * cost of a partial block does not depend on how much of it is
+ * filled, so this also bounds the work done for tiny requests. */
+#define FFT_MAX_BLOCK_SIZE 128
+
+struct pa_hrir_convolver {
+    pa_hrir_convolver_method_t method;
+
+    unsigned hrir_samples;
+    unsigned hrir_channels;
+    unsigned channels;
+
+    unsigned *mapping_left;
+    unsigned *mapping_right;
+
+    /* Direct time domain folding */
+    float *hrir_data;
+    float *input_buffer;
+    int input_buffer_offset;
+
+#ifdef HAVE_FFTW
+    /* Uniformly partitioned overlap-save convolution. The impulse
+     * response is split into n_partitions blocks of block_size
+     * frames, each transformed with a 2 * block_size point FFT. */
+    unsigned block_size;
+    unsigned fft_size;
+    unsigned bins_stride;
+    unsigned n_partitions;
+
+    /* Filter spectra: [hrir_channels][n_partitions][bins_stride] */
+    fftwf_complex *filter;
+
+    /* Frequency domain delay line: [channels][n_partitions][bins_stride],
+     * a ring in which slot (fdl_pos + p) % n_partitions holds the
+     * input spectrum of p blocks ago */
+    fftwf_complex *fdl;
+    unsigned fdl_pos;
+
+    /* Per input channel: the previous block followed by the current,
+     * partially filled one: [channels][fft_size] */
+    float *window;
+    unsigned fill;
+
+    /* Contribution of all older partitions to the current block, per ear */
+    float *tail[2];
+
+    fftwf_complex *accu;
+    float *work;
+
+    fftwf_plan forward_plan, inverse_plan;
+#endif
+};
+
+static void direct_run(pa_hrir_convolver *c, const float *src, float *dst, unsigned n) {
+    unsigned j, k, l;
+    float sum_right, sum_left;
+    float current_sample;
+
+    for (l = 0; l < n; l++) {
+        memcpy(c->input_buffer + c->input_buffer_offset * c->channels, src + l * c->channels, c->channels * sizeof(float));
+
+        sum_right = 0;
+        sum_left = 0;
+
+        /* fold the input buffer with the impulse response */
+        for (j = 0; j < c->hrir_samples; j++) {
+            for (k = 0; k < c->channels; k++) {
+                current_sample = c->input_buffer[((c->input_buffer_offset + j) % c->hrir_samples) * c->channels + k];
+
+                sum_left += current_sample * c->hrir_data[j * c->hrir_channels + c->mapping_left[k]];
+                sum_right += current_sample * c->hrir_data[j * c->hrir_channels + c->mapping_right[k]];
+            }
+        }
+
+        dst[2 * l] = PA_CLAMP_UNLIKELY(sum_left, -1.0f, 1.0f);
+        dst[2 * l + 1] = PA_CLAMP_UNLIKELY(sum_right, -1.0f, 1.0f);
+
+        c->input_buffer_offset--;
+        if (c->input_buffer_offset < 0)
+            c->input_buffer_offset += c->hrir_samples;
+    }
+}
+
+#ifdef HAVE_FFTW
+
+static inline fftwf_complex *filter_spectrum(pa_hrir_convolver *c, unsigned hrir_channel, unsigned partition) {
+    return c->filter + (hrir_channel * c->n_partitions + partition) * c->bins_stride;
+}
+
+static inline fftwf_complex *fdl_spectrum(pa_hrir_convolver *c, unsigned channel, unsigned age) {
+    return c->fdl + (channel * c->n_partitions + (c->fdl_pos + age) % c->n_partitions) * c->bins_stride;
+}
+
+/* accu += x * h, for the non-redundant half of the spectrum */
+static void complex_mac(fftwf_complex * restrict accu, const fftwf_complex * restrict x, const fftwf_complex * restrict h, unsigned n_bins) {
+    unsigned b;
+
+    for (b = 0; b < n_bins; b++) {
+        accu[b][0] += x[b][0] * h[b][0] - x[b][1] * h[b][1];
+        accu[b][1] += x[b][0] * h[b][1] + x[b][1] * h[b][0];
+    }
+}
+
+/* Folds every input channel's spectrum of the given ages with the
+ * matching filter partitions and leaves the time domain result in
+ * c->work */
+static void fft_fold(pa_hrir_convolver *c, const unsigned *mapping, unsigned first, unsigned last) {
+    unsigned k, p, n_bins = c->block_size + 1;
+
+    memset(c->accu, 0, n_bins * sizeof(fftwf_complex));
+
+    for (k = 0; k < c->channels; k++)
+        for (p = first; p < last; p++)
+            complex_mac(c->accu, fdl_spectrum(c, k, p), filter_spectrum(c, mapping[k], p), n_bins);
+
+    fftwf_execute_dft_c2r(c->inverse_plan, c->accu, c->work);
+}
+
+/* Called whenever a block has been completed: shift the delay line and
+ * precompute what the older partitions add to the next block */
+static void fft_next_block(pa_hrir_convolver *c) {
+    unsigned k;
+
+    c->fdl_pos = (c->fdl_pos + c->n_partitions - 1) % c->n_partitions;
+
+    for (k = 0; k < c->channels; k++) {
+        float *w = c->window + k * c->fft_size;
+
+        memcpy(w, w + c->block_size, c->block_size * sizeof(float));
+        memset(w + c->block_size, 0, c->block_size * sizeof(float));
+    }
+
+    c->fill = 0;
+
+    if (c->n_partitions <= 1)
+        return;
+
+    fft_fold(c, c->mapping_left, 1, c->n_partitions);
+    memcpy(c->tail[0], c->work + c->block_size, c->block_size * sizeof(float));
+
+    fft_fold(c, c->mapping_right, 1, c->n_partitions);
+    memcpy(c->tail[1], c->work + c->block_size, c->block_size * sizeof(float));
+}
+
+static void fft_run(pa_hrir_convolver *c, const float *src, float *dst, unsigned n) {
+
+    while (n > 0) {
+        unsigned k, l, chunk;
+        float *out;
+
+        chunk = PA_MIN(n, c->block_size - c->fill);
+
+        /* Append to the current block and transform what we have so
+         * far. The missing samples are zero, and since the filter is
+         * causal the outputs up to the fill level are already exact. */
+        for (k = 0; k < c->channels; k++) {
+            float *w = c->window + k * c->fft_size + c->block_size + c->fill;
+
+            for (l = 0; l < chunk; l++)
+                w[l] = src[l * c->channels + k];
+
+            fftwf_execute_dft_r2c(c->forward_plan, c->window + k * c->fft_size, fdl_spectrum(c, k, 0));
+        }
+
+        fft_fold(c, c->mapping_left, 0, 1);
+        out = c->work + c->block_size + c->fill;
+        for (l = 0; l < chunk; l++) {
+            float sum = c->tail[0][c->fill + l] + out[l];
+            dst[2 * l] = PA_CLAMP_UNLIKELY(sum, -1.0f, 1.0f);
+        }
+
+        fft_fold(c, c->mapping_right, 0, 1);
+        for (l = 0; l < chunk; l++) {
+            float sum = c->tail[1][c->fill + l] + out[l];
+            dst[2 * l + 1] = PA_CLAMP_UNLIKELY(sum, -1.0f, 1.0f);
+        }
+
+        c->fill += chunk;
+        if (c->fill >= c->block_size)
+            fft_next_block(c);
+
+        src += chunk * c->channels;
+        dst += chunk * 2;
+        n -= chunk;
+    }
+}
+
+static void fft_reset(pa_hrir_convolver *c) {
+    memset(c->fdl, 0, c->channels * c->n_partitions * c->bins_stride * sizeof(fftwf_complex));
+    memset(c->window, 0, c->channels * c->fft_size * sizeof(float));
+    memset(c->tail[0], 0, c->block_size * sizeof(float));
+    memset(c->tail[1], 0, c->block_size * sizeof(float));
+    c->fdl_pos = 0;
+    c->fill = 0;
+}
+
+static void *alloc(size_t x, size_t s) {
+    size_t f;
+    void *t;
+
+    pa_assert_se(f = x * s);
+    pa_assert_se(t = fftwf_malloc(f));
+
+    return t;
+}
+
+static void fft_init(pa_hrir_convolver *c, const float *hrir_data) {
+    unsigned i, j, p;
+    float scale;
+
+    c->block_size = 2;
+    while (c->block_size < FFT_MAX_BLOCK_SIZE && c->block_size < c->hrir_samples)
+        c->block_size *= 2;
+
+    c->fft_size = 2 * c->block_size;
+    /* Keep every spectrum equally aligned so that the new-array execute
+     * functions can reuse the plans made for the first one */
+    c->bins_stride = c->block_size + 2;
+    c->n_partitions = (c->hrir_samples + c->block_size - 1) / c->block_size;
+
+    c->filter = alloc(c->hrir_channels * c->n_partitions * c->bins_stride, sizeof(fftwf_complex));
+    c->fdl = alloc(c->channels * c->n_partitions * c->bins_stride, sizeof(fftwf_complex));
+    c->window = alloc(c->channels * c->fft_size, sizeof(float));
+    c->tail[0] = alloc(c->block_size, sizeof(float));
+    c->tail[1] = alloc(c->block_size, sizeof(float));
+    c->accu = alloc(c->bins_stride, sizeof(fftwf_complex));
+    c->work = alloc(c->fft_size, sizeof(float));
+
+    c->forward_plan = fftwf_plan_dft_r2c_1d(c->fft_size, c->work, c->accu, FFTW_ESTIMATE);
+    c->inverse_plan = fftwf_plan_dft_c2r_1d(c->fft_size, c->accu, c->work, FFTW_ESTIMATE);
+
+    /* FFTW does not normalize, fold that into the filter */
+    scale = 1.0f / (float) c->fft_size;
+
+    for (j = 0; j < c->hrir_channels; j++)
+        for (p = 0; p < c->n_partitions; p++) {
+            memset(c->work, 0, c->fft_size * sizeof(float));
+
+            for (i = 0; i < c->block_size && p * c->block_size + i < c->hrir_samples; i++)
+                c->work[i] = hrir_data[(p * c->block_size + i) * c->hrir_channels + j] * scale;
+
+            fftwf_execute_dft_r2c(c->forward_plan, c->work, filter_spectrum(c, j, p));
+        }
+
+    fft_reset(c);
+
+    pa_log_debug("Using partitioned FFT convolution: %u partitions of %u frames.", c->n_partitions, c->block_size);
+}
+
+static void fft_done(pa_hrir_convolver *c) {
+    if (c->inverse_plan)
+        fftwf_destroy_plan(c->inverse_plan);
+    if (c->forward_plan)
+        fftwf_destroy_plan(c->forward_plan);
+
+    fftwf_free(c->work);
+    fftwf_free(c->accu);
+    fftwf_free(c->tail[1]);
+    fftwf_free(c->tail[0]);
+    fftwf_free(c->window);
+    fftwf_free(c->fdl);
+    fftwf_free(c->filter);
+}
+
+#endif
+
+pa_hrir_convolver* pa_hrir_convolver_new(
+        pa_hrir_convolver_method_t method,
+        const float *hrir_data,
+        unsigned hrir_samples,
+        unsigned hrir_channels,
+        unsigned channels,
+        const unsigned *mapping_left,
+        const unsigned *mapping_right) {
+
+    pa_hrir_convolver *c;
+
+    pa_assert(hrir_data);
+    pa_assert(hrir_samples > 0);
+    pa_assert(hrir_channels > 0);
+    pa_assert(channels > 0);
+    pa_assert(mapping_left);
+    pa_assert(mapping_right);
+
+    if (method == PA_HRIR_CONVOLVER_AUTO) {
+#ifdef HAVE_FFTW
+        method = hrir_samples >= FFT_MIN_HRIR_SAMPLES ? PA_HRIR_CONVOLVER_FFT : PA_HRIR_CONVOLVER_DIRECT;
+#else
+        method = PA_HRIR_CONVOLVER_DIRECT;
+#endif
+    }
+
+#ifndef HAVE_FFTW
+    if (method == PA_HRIR_CONVOLVER_FFT) {
+        pa_log("FFT convolution is not available, compiled without FFTW support.");
+        return NULL;
+    }
+#endif
+
+    c = pa_xnew0(pa_hrir_convolver, 1);
+    c->method = method;
+    c->hrir_samples = hrir_samples;
+    c->hrir_channels = hrir_channels;
+    c->channels = channels;
+    c->mapping_left = pa_xnewdup(unsigned, mapping_left, channels);
+    c->mapping_right = pa_xnewdup(unsigned, mapping_right, channels);
+
+#ifdef HAVE_FFTW
+    if (method == PA_HRIR_CONVOLVER_FFT) {
+        fft_init(c, hrir_data);
+        return c;
+    }
+#endif
+
+    c->hrir_data = pa_xnewdup(float, hrir_data, hrir_samples * hrir_channels);
+    c->input_buffer = pa_xnew0(float, hrir_samples * channels);
+    c->input_buffer_offset = 0;
+
+    return c;
+}
+
+void pa_hrir_convolver_free(pa_hrir_convolver *c) {
+    pa_assert(c);
+
+#ifdef HAVE_FFTW
+    if (c->method == PA_HRIR_CONVOLVER_FFT)
+        fft_done(c);
+#endif
+
+    pa_xfree(c->hrir_data);
+    pa_xfree(c->input_buffer);
+    pa_xfree(c->mapping_left);
+    pa_xfree(c->mapping_right);
+    pa_xfree(c);
+}
+
+pa_hrir_convolver_method_t pa_hrir_convolver_get_method(pa_hrir_convolver *c) {
+    pa_assert(c);
+
+    return c->method;
+}
+
+void pa_hrir_convolver_reset(pa_hrir_convolver *c) {
+    pa_assert(c);
+
+#ifdef HAVE_FFTW
+    if (c->method == PA_HRIR_CONVOLVER_FFT) {
+        fft_reset(c);
+        return;
+    }
+#endif
+
+    memset(c->input_buffer, 0, c->hrir_samples * c->channels * sizeof(float));
+    c->input_buffer_offset = 0;
+}
+
+void pa_hrir_convolver_run(pa_hrir_convolver *c, const float *src, float *dst, unsigned n) {
+    pa_assert(c);
+    pa_assert(src);
+    pa_assert(dst);
+
+#ifdef HAVE_FFTW
+    if (c->method == PA_HRIR_CONVOLVER_FFT) {
+        fft_run(c, src, dst, n);
+        return;
+    }
+#endif
+
+    direct_run(c, src, dst, n);
+}
@@ -0,0 +1,64 @@
+#ifndef foohrirconvolverhfoo
+#define foohrirconvolverhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulsecore/macro.h>
+
+/* Folds an interleaved multi-channel float stream with a set of head
+ * related impulse responses and produces an interleaved stereo
+ * stream. Input channel k is convolved with HRIR channel
+ * mapping_left[k] for the left ear and mapping_right[k] for the right
+ * ear. */
+
+typedef struct pa_hrir_convolver pa_hrir_convolver;
+
+typedef enum pa_hrir_convolver_method {
+    PA_HRIR_CONVOLVER_AUTO,
+    PA_HRIR_CONVOLVER_DIRECT,
+    PA_HRIR_CONVOLVER_FFT,
+} pa_hrir_convolver_method_t;
+
+/* hrir_data is interleaved with hrir_channels channels and is copied,
+ * as are the two mapping tables. With PA_HRIR_CONVOLVER_AUTO the
+ * partitioned FFT engine is picked for long impulse responses if
+ * FFTW support has been compiled in. Returns NULL if the requested
+ * method is not available. */
+pa_hrir_convolver* pa_hrir_convolver_new(
+        pa_hrir_convolver_method_t method,
+        const float *hrir_data,
+        unsigned hrir_samples,
+        unsigned hrir_channels,
+        unsigned channels,
+        const unsigned *mapping_left,
+        const unsigned *mapping_right);
+
+void pa_hrir_convolver_free(pa_hrir_convolver *c);
+
+pa_hrir_convolver_method_t pa_hrir_convolver_get_method(pa_hrir_convolver *c);
+
+/* Forget all history, e.g. after a rewind */
+void pa_hrir_convolver_reset(pa_hrir_convolver *c);
+
+/* Processes n frames. src has 'channels' interleaved channels, dst
+ * receives two interleaved channels clamped to [-1, 1] */
+void pa_hrir_convolver_run(pa_hrir_convolver *c, const float *src, float *dst, unsigned n);
+
+#endif
@@ -45,6 +45,7 @@
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/time-smoother.h>
+#include <pulsecore/rate-controller.h>
 #include <pulsecore/strlist.h>
 
 #include "module-combine-sink-symdef.h"
@@ -70,6 +71,10 @@ PA_MODULE_USAGE(
 
 #define DEFAULT_ADJUST_TIME_USEC (10*PA_USEC_PER_SEC)
 
+/* Can follow the fractional rate adjustment of the drift compensation
+ * without being rebuilt, see pa_resample_method_adaptive() */
+#define DEFAULT_RESAMPLE_METHOD (PA_RESAMPLER_SINC_BASE + 2)
+
 #define BLOCK_USEC (PA_USEC_PER_MSEC * 200)
 
 static const char* const valid_modargs[] = {
@@ -102,6 +107,9 @@ struct output {
     /* For communication of the stream latencies to the main thread */
     pa_usec_t total_latency;
 
+    /* Drift compensation, managed in main context */
+    pa_rate_controller *rate_controller;
+
     /* For communication of the stream parameters to the sink thread */
     pa_atomic_t max_request;
     pa_atomic_t requested_latency;
@@ -216,11 +224,24 @@ static void adjust_rates(struct userdata *u) {
 
     PA_IDXSET_FOREACH(o, u->outputs, idx) {
         uint32_t new_rate = base_rate;
-        uint32_t current_rate = o->sink_input->sample_spec.rate;
+        uint32_t current_rate;
+        double factor;
 
         if (!o->sink_input || !PA_SINK_IS_OPENED(pa_sink_get_state(o->sink)))
             continue;
 
+        /* If the resampler can follow a fractional ratio it gets one from
+         * the controller, which converges to the drift and doesn't need
+         * the resampler to be rebuilt */
+        factor = pa_rate_controller_update(o->rate_controller, (int64_t) o->total_latency - (int64_t) target_latency);
+
+        if (pa_sink_input_set_rate_adjust(o->sink_input, factor) >= 0) {
+            pa_log_info("[%s] rate adjust is %0.6f; latency is %0.2f msec.", o->sink_input->sink->name, factor, (double) o->total_latency / PA_USEC_PER_MSEC);
+            continue;
+        }
+
+        current_rate = o->sink_input->sample_spec.rate;
+
         if (o->total_latency != target_latency)
             new_rate += (uint32_t) (((double) o->total_latency - (double) target_latency) / (double) u->adjust_time * (double) new_rate);
 
@@ -880,6 +901,9 @@ static int output_create_sink_input(struct output *o) {
 
     pa_sink_input_set_requested_latency(o->sink_input, BLOCK_USEC);
 
+    /* The new stream starts out at its nominal rate */
+    pa_rate_controller_reset(o->rate_controller);
+
     return 0;
 }
 
@@ -906,6 +930,7 @@ static struct output *output_new(struct userdata *u, pa_sink *sink) {
             0,
             0,
             &u->sink->silence);
+    o->rate_controller = pa_rate_controller_new(u->adjust_time > 0 ? u->adjust_time : DEFAULT_ADJUST_TIME_USEC, PA_RATE_CONTROLLER_MAX_DEVIATION);
 
     pa_assert_se(pa_idxset_put(u->outputs, o, NULL) == 0);
     update_description(u);
@@ -941,6 +966,9 @@ static void output_free(struct output *o) {
     if (o->memblockq)
         pa_memblockq_free(o->memblockq);
 
+    if (o->rate_controller)
+        pa_rate_controller_free(o->rate_controller);
+
     pa_xfree(o);
 }
 
@@ -1130,7 +1158,7 @@ int pa__init(pa_module*m) {
     struct userdata *u;
     pa_modargs *ma = NULL;
     const char *slaves, *rm;
-    int resample_method = PA_RESAMPLER_TRIVIAL;
+    int resample_method = DEFAULT_RESAMPLE_METHOD;
     pa_sample_spec ss;
     pa_channel_map map;
     struct output *o;
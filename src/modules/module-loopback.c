@@ -34,6 +34,7 @@
 #include <pulsecore/namereg.h>
 #include <pulsecore/log.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/rate-controller.h>
 
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
@@ -57,7 +58,8 @@ PA_MODULE_USAGE(
         "source_output_properties=<proplist> "
         "source_dont_move=<boolean> "
         "sink_dont_move=<boolean> "
-        "remix=<remix channels?> ");
+        "remix=<remix channels?> "
+        "resample_method=<method> ");
 
 #define DEFAULT_LATENCY_MSEC 200
 
@@ -65,6 +67,10 @@ PA_MODULE_USAGE(
 
 #define DEFAULT_ADJUST_TIME_USEC (10*PA_USEC_PER_SEC)
 
+/* Can follow the fractional rate adjustment of the drift compensation
+ * without being rebuilt, see pa_resample_method_adaptive() */
+#define DEFAULT_RESAMPLE_METHOD (PA_RESAMPLER_SINC_BASE + 2)
+
 struct userdata {
     pa_core *core;
     pa_module *module;
@@ -79,6 +85,7 @@ struct userdata {
 
     pa_time_event *time_event;
     pa_usec_t adjust_time;
+    pa_rate_controller *rate_controller;
 
     int64_t recv_counter;
     int64_t send_counter;
@@ -117,6 +124,7 @@ static const char* const valid_modargs[] = {
     "source_dont_move",
     "sink_dont_move",
     "remix",
+    "resample_method",
     NULL,
 };
 
@@ -169,6 +177,7 @@ static void adjust_rates(struct userdata *u) {
     size_t buffer, fs;
     uint32_t old_rate, base_rate, new_rate;
     pa_usec_t buffer_latency;
+    double factor;
 
     pa_assert(u);
     pa_assert_ctl_context();
@@ -197,6 +206,19 @@ static void adjust_rates(struct userdata *u) {
                 u->latency_snapshot.max_request*2,
                 u->latency_snapshot.min_memblockq_length);
 
+    /* If the resampler can follow a fractional ratio it gets one from
+     * the controller, which converges to the drift and doesn't need the
+     * resampler to be rebuilt */
+    factor = pa_rate_controller_update(u->rate_controller,
+                                       (int64_t) pa_bytes_to_usec(u->latency_snapshot.min_memblockq_length, &u->sink_input->sample_spec) -
+                                       (int64_t) pa_bytes_to_usec(u->latency_snapshot.max_request*2, &u->sink_input->sample_spec));
+
+    if (pa_sink_input_set_rate_adjust(u->sink_input, factor) >= 0) {
+        pa_log_debug("[%s] Updated rate adjust to %0.6f.", u->sink_input->sink->name, factor);
+        pa_core_rttime_restart(u->core, u->time_event, pa_rtclock_now() + u->adjust_time);
+        return;
+    }
+
     fs = pa_frame_size(&u->sink_input->sample_spec);
     old_rate = u->sink_input->sample_spec.rate;
     base_rate = u->source_output->sample_spec.rate;
@@ -663,6 +685,7 @@ int pa__init(pa_module *m) {
     uint32_t adjust_time_sec;
     const char *n;
     pa_bool_t remix = TRUE;
+    pa_resample_method_t resample_method = DEFAULT_RESAMPLE_METHOD;
 
     pa_assert(m);
 
@@ -688,6 +711,13 @@ int pa__init(pa_module *m) {
         goto fail;
     }
 
+    if ((n = pa_modargs_get_value(ma, "resample_method", NULL))) {
+        if ((resample_method = pa_parse_resample_method(n)) < 0) {
+            pa_log("Invalid resample method '%s'", n);
+            goto fail;
+        }
+    }
+
     if (sink) {
         ss = sink->sample_spec;
         map = sink->channel_map;
@@ -749,6 +779,9 @@ int pa__init(pa_module *m) {
     else
         u->adjust_time = DEFAULT_ADJUST_TIME_USEC;
 
+    if (u->adjust_time > 0)
+        u->rate_controller = pa_rate_controller_new(u->adjust_time, PA_RATE_CONTROLLER_MAX_DEVIATION);
+
     pa_sink_input_new_data_init(&sink_input_data);
     sink_input_data.driver = __FILE__;
     sink_input_data.module = m;
@@ -768,6 +801,7 @@ int pa__init(pa_module *m) {
     pa_sink_input_new_data_set_sample_spec(&sink_input_data, &ss);
     pa_sink_input_new_data_set_channel_map(&sink_input_data, &map);
     sink_input_data.flags = PA_SINK_INPUT_VARIABLE_RATE;
+    sink_input_data.resample_method = resample_method;
 
     if (!remix)
         sink_input_data.flags |= PA_SINK_INPUT_NO_REMIX;
@@ -933,5 +967,8 @@ void pa__done(pa_module*m) {
     if (u->asyncmsgq)
         pa_asyncmsgq_unref(u->asyncmsgq);
 
+    if (u->rate_controller)
+        pa_rate_controller_free(u->rate_controller);
+
     pa_xfree(u);
 }
@@ -235,6 +235,9 @@ static void thread_func(void *userdata) {
 
         if (ret == 0)
             goto finish;
+
+        if (PA_SINK_IS_OPENED(u->sink->thread_info.state))
+            pa_cycle_profile_next(&u->sink->thread_info.cycle_profile);
     }
 
 fail:
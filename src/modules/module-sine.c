@@ -160,6 +160,7 @@ int pa__init(pa_module*m) {
     pa_proplist_sets(data.proplist, PA_PROP_MEDIA_ROLE, "abstract");
     pa_proplist_setf(data.proplist, "sine.hz", "%u", frequency);
     pa_sink_input_new_data_set_sample_spec(&data, &ss);
+    data.flags = PA_SINK_INPUT_PARALLEL_PEEK;
 
     pa_sink_input_new(&u->sink_input, m->core, &data);
     pa_sink_input_new_data_done(&data);
@@ -879,6 +879,11 @@ static void request_latency(struct userdata *u) {
 
     pa_tagstruct_put_timeval(t, pa_gettimeofday(&now));
 
+#ifdef TUNNEL_SINK
+    if (u->version >= 28)
+        pa_tagstruct_puts64(t, 0); /* no shm ring */
+#endif
+
     pa_pstream_send_tagstruct(u->pstream, t);
     pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, stream_get_latency_callback, u, NULL);
 
@@ -1526,6 +1531,16 @@ static void create_stream_callback(pa_pdispatch *pd, uint32_t command,  uint32_t
         pa_format_info_free(format);
     }
 
+#ifdef TUNNEL_SINK
+    if (u->version >= 28) {
+        uint32_t ring_status_id;
+
+        /* We didn't offer a shm ring, so there is nothing to do with this */
+        if (pa_tagstruct_getu32(t, &ring_status_id) < 0)
+            goto parse_error;
+    }
+#endif
+
     if (!pa_tagstruct_eof(t))
         goto parse_error;
 
@@ -1731,6 +1746,9 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
         /* We're not using the extended API, so n_formats = 0 and that's that */
         pa_tagstruct_putu8(reply, 0);
     }
+
+    if (u->version >= 28)
+        pa_tagstruct_putu32(reply, PA_INVALID_INDEX); /* no shm ring */
 #else
     if (u->version >= 22) {
         /* We're not using the extended API, so n_formats = 0 and that's that */
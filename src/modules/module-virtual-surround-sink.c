@@ -43,6 +43,7 @@
 
 #include <math.h>
 
+#include "hrir-convolver.h"
 #include "module-virtual-surround-sink-symdef.h"
 
 PA_MODULE_AUTHOR("Niels Ole Salscheider");
@@ -77,18 +78,10 @@ struct userdata {
 
     pa_bool_t auto_desc;
     unsigned channels;
-    unsigned hrir_channels;
 
     unsigned fs, sink_fs;
 
-    unsigned *mapping_left;
-    unsigned *mapping_right;
-
-    unsigned hrir_samples;
-    float *hrir_data;
-
-    float *input_buffer;
-    int input_buffer_offset;
+    pa_hrir_convolver *convolver;
 };
 
 static const char* const valid_modargs[] = {
@@ -220,10 +213,6 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     unsigned n;
     pa_memchunk tchunk;
 
-    unsigned j, k, l;
-    float sum_right, sum_left;
-    float current_sample;
-
     pa_sink_input_assert_ref(i);
     pa_assert(chunk);
     pa_assert_se(u = i->userdata);
@@ -255,29 +244,8 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     src = pa_memblock_acquire_chunk(&tchunk);
     dst = pa_memblock_acquire(chunk->memblock);
 
-    for (l = 0; l < n; l++) {
-        memcpy(((char*) u->input_buffer) + u->input_buffer_offset * u->sink_fs, ((char *) src) + l * u->sink_fs, u->sink_fs);
-
-        sum_right = 0;
-        sum_left = 0;
-
-        /* fold the input buffer with the impulse response */
-        for (j = 0; j < u->hrir_samples; j++) {
-            for (k = 0; k < u->channels; k++) {
-                current_sample = u->input_buffer[((u->input_buffer_offset + j) % u->hrir_samples) * u->channels + k];
-
-                sum_left += current_sample * u->hrir_data[j * u->hrir_channels + u->mapping_left[k]];
-                sum_right += current_sample * u->hrir_data[j * u->hrir_channels + u->mapping_right[k]];
-            }
-        }
-
-        dst[2 * l] = PA_CLAMP_UNLIKELY(sum_left, -1.0f, 1.0f);
-        dst[2 * l + 1] = PA_CLAMP_UNLIKELY(sum_right, -1.0f, 1.0f);
-
-        u->input_buffer_offset--;
-        if (u->input_buffer_offset < 0)
-            u->input_buffer_offset += u->hrir_samples;
-    }
+    /* fold the input with the impulse response */
+    pa_hrir_convolver_run(u->convolver, src, dst, n);
 
     pa_memblock_release(tchunk.memblock);
     pa_memblock_release(chunk->memblock);
@@ -306,8 +274,7 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
             pa_memblockq_seek(u->memblockq, - (int64_t) amount, PA_SEEK_RELATIVE, TRUE);
 
             /* Reset the input buffer */
-            memset(u->input_buffer, 0, u->hrir_samples * u->sink_fs);
-            u->input_buffer_offset = 0;
+            pa_hrir_convolver_reset(u->convolver);
         }
     }
 
@@ -544,7 +511,9 @@ int pa__init(pa_module*m) {
     const char *hrir_file;
     unsigned i, j, found_channel_left, found_channel_right;
     float hrir_sum, hrir_max;
-    float *hrir_data;
+    float *hrir_data = NULL;
+    unsigned hrir_samples, hrir_channels;
+    unsigned *mapping_left = NULL, *mapping_right = NULL;
 
     pa_sample_spec hrir_ss;
     pa_channel_map hrir_map;
@@ -722,13 +691,11 @@ int pa__init(pa_module*m) {
     pa_resampler_run(resampler, &hrir_temp_chunk, &hrir_temp_chunk);
     pa_resampler_free(resampler);
 
-    u->hrir_samples =  hrir_temp_chunk.length / pa_frame_size(&hrir_ss);
-    u->hrir_channels = hrir_ss.channels;
+    hrir_samples = hrir_temp_chunk.length / pa_frame_size(&hrir_ss);
+    hrir_channels = hrir_ss.channels;
 
     /* copy hrir data */
-    hrir_data = (float *) pa_memblock_acquire(hrir_temp_chunk.memblock);
-    u->hrir_data = (float *) pa_xmalloc(hrir_temp_chunk.length);
-    memcpy(u->hrir_data, hrir_data, hrir_temp_chunk.length);
+    hrir_data = (float *) pa_xmemdup(pa_memblock_acquire_chunk(&hrir_temp_chunk), hrir_temp_chunk.length);
     pa_memblock_release(hrir_temp_chunk.memblock);
     pa_memblock_unref(hrir_temp_chunk.memblock);
     hrir_temp_chunk.memblock = NULL;
@@ -740,36 +707,36 @@ int pa__init(pa_module*m) {
 
     /* normalize hrir to avoid clipping */
     hrir_max = 0;
-    for (i = 0; i < u->hrir_samples; i++) {
+    for (i = 0; i < hrir_samples; i++) {
         hrir_sum = 0;
-        for (j = 0; j < u->hrir_channels; j++)
-            hrir_sum += fabs(u->hrir_data[i * u->hrir_channels + j]);
+        for (j = 0; j < hrir_channels; j++)
+            hrir_sum += fabs(hrir_data[i * hrir_channels + j]);
 
         if (hrir_sum > hrir_max)
             hrir_max = hrir_sum;
     }
     if (hrir_max > 1) {
-        for (i = 0; i < u->hrir_samples; i++) {
-            for (j = 0; j < u->hrir_channels; j++)
-                u->hrir_data[i * u->hrir_channels + j] /= hrir_max * 1.2;
+        for (i = 0; i < hrir_samples; i++) {
+            for (j = 0; j < hrir_channels; j++)
+                hrir_data[i * hrir_channels + j] /= hrir_max * 1.2;
         }
     }
 
     /* create mapping between hrir and input */
-    u->mapping_left = (unsigned *) pa_xnew0(unsigned, u->channels);
-    u->mapping_right = (unsigned *) pa_xnew0(unsigned, u->channels);
+    mapping_left = pa_xnew0(unsigned, u->channels);
+    mapping_right = pa_xnew0(unsigned, u->channels);
     for (i = 0; i < map.channels; i++) {
         found_channel_left = 0;
         found_channel_right = 0;
 
         for (j = 0; j < hrir_map.channels; j++) {
             if (hrir_map.map[j] == map.map[i]) {
-                u->mapping_left[i] = j;
+                mapping_left[i] = j;
                 found_channel_left = 1;
             }
 
             if (hrir_map.map[j] == mirror_channel(map.map[i])) {
-                u->mapping_right[i] = j;
+                mapping_right[i] = j;
                 found_channel_right = 1;
             }
         }
@@ -784,8 +751,14 @@ int pa__init(pa_module*m) {
         }
     }
 
-    u->input_buffer = pa_xmalloc0(u->hrir_samples * u->sink_fs);
-    u->input_buffer_offset = 0;
+    /* Long impulse responses are folded in the frequency domain */
+    u->convolver = pa_hrir_convolver_new(PA_HRIR_CONVOLVER_AUTO, hrir_data, hrir_samples, hrir_channels,
+                                         u->channels, mapping_left, mapping_right);
+    pa_assert(u->convolver);
+
+    pa_xfree(hrir_data);
+    pa_xfree(mapping_left);
+    pa_xfree(mapping_right);
 
     pa_sink_put(u->sink);
     pa_sink_input_put(u->sink_input);
@@ -797,6 +770,10 @@ fail:
     if (hrir_temp_chunk.memblock)
         pa_memblock_unref(hrir_temp_chunk.memblock);
 
+    pa_xfree(hrir_data);
+    pa_xfree(mapping_left);
+    pa_xfree(mapping_right);
+
     if (ma)
         pa_modargs_free(ma);
 
@@ -840,16 +817,8 @@ void pa__done(pa_module*m) {
     if (u->memblockq)
         pa_memblockq_free(u->memblockq);
 
-    if (u->hrir_data)
-        pa_xfree(u->hrir_data);
-
-    if (u->input_buffer)
-        pa_xfree(u->input_buffer);
-
-    if (u->mapping_left)
-        pa_xfree(u->mapping_left);
-    if (u->mapping_right)
-        pa_xfree(u->mapping_right);
+    if (u->convolver)
+        pa_hrir_convolver_free(u->convolver);
 
     pa_xfree(u);
 }
@@ -172,7 +172,14 @@ pa_context *pa_context_new_with_proplist(pa_mainloop_api *mainloop, const char *
 #endif
     pa_client_conf_env(c->conf);
 
-    if (!(c->mempool = pa_mempool_new(!c->conf->disable_shm, c->conf->shm_size))) {
+#ifdef HAVE_CREDS
+    /* The server can only get hold of a memfd pool through the
+     * connection socket, so that only it has access to our audio */
+    if (!c->conf->disable_shm && !c->conf->disable_memfd)
+        c->mempool = pa_mempool_new_memfd(c->conf->shm_size);
+#endif
+
+    if (!c->mempool && !(c->mempool = pa_mempool_new(!c->conf->disable_shm, c->conf->shm_size))) {
 
         if (!c->conf->disable_shm)
             c->mempool = pa_mempool_new(FALSE, c->conf->shm_size);
@@ -425,7 +432,7 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
     switch(c->state) {
         case PA_CONTEXT_AUTHORIZING: {
             pa_tagstruct *reply;
-            pa_bool_t shm_on_remote = FALSE;
+            pa_bool_t shm_on_remote = FALSE, memfd_on_remote = FALSE;
 
             if (pa_tagstruct_getu32(t, &c->version) < 0 ||
                 !pa_tagstruct_eof(t)) {
@@ -444,9 +451,16 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
                not. */
             if (c->version >= 13) {
                 shm_on_remote = !!(c->version & 0x80000000U);
-                c->version &= 0x7FFFFFFFU;
+                memfd_on_remote = !!(c->version & 0x40000000U);
+                c->version &= 0x3FFFFFFFU;
             }
 
+            /* Starting with protocol version 29 the second bit
+               reflects if the server sends us a memfd pool of our
+               own, and wants ours. */
+            if (c->version < 29)
+                memfd_on_remote = FALSE;
+
             pa_log_debug("Protocol version: remote %u, local %u", c->version, PA_PROTOCOL_VERSION);
 
             /* Enable shared memory support if possible */
@@ -467,9 +481,16 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
 #endif
             }
 
-            pa_log_debug("Negotiated SHM: %s", pa_yes_no(c->do_shm));
+            pa_log_debug("Negotiated SHM: %s, memfd: %s", pa_yes_no(c->do_shm), pa_yes_no(c->do_shm && memfd_on_remote));
             pa_pstream_enable_shm(c->pstream, c->do_shm);
 
+#ifdef HAVE_CREDS
+            /* Without this, the data we send from a memfd pool goes
+             * through the socket */
+            if (c->do_shm && memfd_on_remote && pa_mempool_is_memfd(c->mempool))
+                pa_pstream_register_memfd_mempool(c->pstream, c->mempool);
+#endif
+
             reply = pa_tagstruct_command(c, PA_COMMAND_SET_CLIENT_NAME, &tag);
 
             if (c->version >= 13) {
@@ -536,8 +557,11 @@ static void setup_context(pa_context *c, pa_iochannel *io) {
     pa_log_debug("SHM possible: %s", pa_yes_no(c->do_shm));
 
     /* Starting with protocol version 13 we use the MSB of the version
-     * tag for informing the other side if we could do SHM or not */
-    pa_tagstruct_putu32(t, PA_PROTOCOL_VERSION | (c->do_shm ? 0x80000000U : 0));
+     * tag for informing the other side if we could do SHM or not, and
+     * starting with version 29 the second bit if we use memfd */
+    pa_tagstruct_putu32(t, PA_PROTOCOL_VERSION |
+                        (c->do_shm ? 0x80000000U : 0) |
+                        (c->do_shm && pa_mempool_is_memfd(c->mempool) ? 0x40000000U : 0));
     pa_tagstruct_put_arbitrary(t, c->conf->cookie, sizeof(c->conf->cookie));
 
 #ifdef HAVE_CREDS
@@ -27,6 +27,7 @@
 #include <pulse/context.h>
 #include <pulse/stream.h>
 #include <pulse/operation.h>
+#include <pulse/introspect.h>
 #include <pulse/subscribe.h>
 #include <pulse/ext-device-manager.h>
 #include <pulse/ext-device-restore.h>
@@ -43,6 +44,7 @@
 #include <pulsecore/hashmap.h>
 #include <pulsecore/refcnt.h>
 #include <pulsecore/time-smoother.h>
+#include <pulsecore/shmring.h>
 #ifdef HAVE_DBUS
 #include <pulsecore/dbus-util.h>
 #endif
@@ -74,6 +76,10 @@ struct pa_context {
     uint32_t ctag;
     uint32_t csyncid;
     int error;
+
+    /* The filtered info list query whose callbacks are running */
+    pa_operation *list_operation;
+
     pa_context_state_t state;
 
     pa_context_notify_cb_t state_callback;
@@ -170,6 +176,10 @@ struct pa_stream {
     pa_memblock *write_memblock;
     void *write_data;
     int64_t latest_underrun_at_index;
+    pa_shmring *ring;
+    /* The sum of offset and length of everything written into the
+     * ring, kept after falling back to the socket */
+    int64_t ring_written;
 
     /* recording */
     pa_memchunk peek_memchunk;
@@ -236,6 +246,9 @@ struct pa_operation {
     pa_operation_cb_t callback;
 
     void *private; /* some operations might need this */
+
+    /* Where the reply of a filtered info list query ended */
+    pa_info_list_cursor list_cursor;
 };
 
 void pa_command_request(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
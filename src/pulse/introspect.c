@@ -35,6 +35,91 @@
 #include "internal.h"
 #include "introspect.h"
 
+/*** Paged and filtered lists ***/
+
+/* Marks the operations of the _filtered() list queries, whose replies
+ * start with a header */
+#define FILTERED_LIST PA_UINT_TO_PTR(1)
+
+static int read_list_header(pa_operation *o, pa_tagstruct *t) {
+    pa_assert(o);
+    pa_assert(t);
+
+    if (o->private != FILTERED_LIST)
+        return 0;
+
+    if (pa_tagstruct_getu32(t, &o->list_cursor.next_index) < 0 ||
+        pa_tagstruct_getu64(t, &o->list_cursor.generation) < 0)
+        return -1;
+
+    /* Older servers don't tell about removals, so assume that
+     * something was removed whenever anything changed */
+    o->list_cursor.removed_generation = o->list_cursor.generation;
+
+    if (o->context->version >= 34 &&
+        pa_tagstruct_getu64(t, &o->list_cursor.removed_generation) < 0)
+        return -1;
+
+    /* Until the operation is done */
+    o->context->list_operation = o;
+    return 0;
+}
+
+static pa_operation* send_filtered_list_command(pa_context *c, uint32_t command, const pa_info_list_filter *filter, pa_pdispatch_cb_t internal_cb, pa_operation_cb_t cb, void *userdata) {
+    pa_tagstruct *t;
+    pa_operation *o;
+    uint32_t tag, n_keys = PA_INVALID_INDEX;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+    pa_assert(cb);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, filter, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 30, PA_ERR_NOTSUPPORTED);
+
+    if (filter->keys) {
+        for (n_keys = 0; filter->keys[n_keys]; n_keys++)
+            PA_CHECK_VALIDITY_RETURN_NULL(c, pa_proplist_key_valid(filter->keys[n_keys]), PA_ERR_INVALID);
+
+        PA_CHECK_VALIDITY_RETURN_NULL(c, n_keys <= 64, PA_ERR_INVALID);
+    }
+
+    o = pa_operation_new(c, NULL, cb, userdata);
+    o->private = FILTERED_LIST;
+
+    t = pa_tagstruct_command(c, command, &tag);
+    pa_tagstruct_putu32(t, filter->start_index);
+    pa_tagstruct_putu32(t, filter->max_entries);
+    pa_tagstruct_putu64(t, filter->changed_since);
+    pa_tagstruct_putu32(t, n_keys);
+
+    if (filter->keys) {
+        const char * const *k;
+
+        for (k = filter->keys; *k; k++)
+            pa_tagstruct_puts(t, *k);
+    }
+
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, internal_cb, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
+}
+
+int pa_context_get_info_list_cursor(pa_context *c, pa_info_list_cursor *cursor) {
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+    pa_assert(cursor);
+
+    PA_CHECK_VALIDITY(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY(c, c->list_operation, PA_ERR_BADSTATE);
+
+    *cursor = c->list_operation->list_cursor;
+    return 0;
+}
+
 /*** Statistics ***/
 
 static void context_stat_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -60,6 +145,14 @@ static void context_stat_callback(pa_pdispatch *pd, uint32_t command, uint32_t t
                pa_tagstruct_getu32(t, &i.memblock_allocated) < 0 ||
                pa_tagstruct_getu32(t, &i.memblock_allocated_size) < 0 ||
                pa_tagstruct_getu32(t, &i.scache_size) < 0 ||
+               (o->context->version >= 32 &&
+                (pa_tagstruct_getu32(t, &i.resampler_cache_size) < 0 ||
+                 pa_tagstruct_getu32(t, &i.resampler_cache_saved) < 0)) ||
+               (o->context->version >= 33 &&
+                (pa_tagstruct_getu64(t, &i.subscription_events_delivered) < 0 ||
+                 pa_tagstruct_getu64(t, &i.subscription_events_suppressed) < 0 ||
+                 pa_tagstruct_getu64(t, &i.client_subscription_events_delivered) < 0 ||
+                 pa_tagstruct_getu64(t, &i.client_subscription_events_suppressed) < 0)) ||
                !pa_tagstruct_eof(t)) {
         pa_context_fail(o->context, PA_ERR_PROTOCOL);
         goto finish;
@@ -79,6 +172,73 @@ pa_operation* pa_context_stat(pa_context *c, pa_stat_info_cb_t cb, void *userdat
     return pa_context_send_simple_command(c, PA_COMMAND_STAT, context_stat_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+static int read_latency_stats(pa_tagstruct *t, uint32_t *n, pa_latency_stat_info **stats) {
+    uint32_t i;
+
+    if (pa_tagstruct_getu32(t, n) < 0)
+        return -1;
+
+    *stats = pa_xnew0(pa_latency_stat_info, *n);
+
+    for (i = 0; i < *n; i++)
+        if (pa_tagstruct_gets(t, &(*stats)[i].name) < 0 ||
+            !(*stats)[i].name ||
+            pa_tagstruct_getu64(t, &(*stats)[i].count) < 0 ||
+            pa_tagstruct_get_usec(t, &(*stats)[i].p50) < 0 ||
+            pa_tagstruct_get_usec(t, &(*stats)[i].p99) < 0 ||
+            pa_tagstruct_get_usec(t, &(*stats)[i].max) < 0)
+            return -1;
+
+    return 0;
+}
+
+static void context_get_latency_stats_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    pa_latency_stats_info i, *p = &i;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    pa_zero(i);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, FALSE) < 0)
+            goto finish;
+
+        p = NULL;
+    } else if (read_latency_stats(t, &i.n_commands, &i.commands) < 0 ||
+               read_latency_stats(t, &i.n_threads, &i.threads) < 0 ||
+               !pa_tagstruct_eof(t)) {
+        pa_context_fail(o->context, PA_ERR_PROTOCOL);
+        goto finish;
+    }
+
+    if (o->callback) {
+        pa_latency_stats_info_cb_t cb = (pa_latency_stats_info_cb_t) o->callback;
+        cb(o->context, p, o->userdata);
+    }
+
+finish:
+    pa_xfree(i.commands);
+    pa_xfree(i.threads);
+
+    pa_operation_done(o);
+    pa_operation_unref(o);
+}
+
+pa_operation* pa_context_get_latency_stats(pa_context *c, pa_latency_stats_info_cb_t cb, void *userdata) {
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 31, PA_ERR_NOTSUPPORTED);
+
+    return pa_context_send_simple_command(c, PA_COMMAND_GET_LATENCY_STATS, context_get_latency_stats_callback, (pa_operation_cb_t) cb, userdata);
+}
+
 /*** Server Info ***/
 
 static void context_get_server_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -157,6 +317,11 @@ static void context_get_sink_info_callback(pa_pdispatch *pd, uint32_t command, u
         eol = -1;
     } else {
 
+        if (read_list_header(o, t) < 0) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
         while (!pa_tagstruct_eof(t)) {
             pa_bool_t mute;
             uint32_t flags;
@@ -308,6 +473,10 @@ pa_operation* pa_context_get_sink_info_list(pa_context *c, pa_sink_info_cb_t cb,
     return pa_context_send_simple_command(c, PA_COMMAND_GET_SINK_INFO_LIST, context_get_sink_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+pa_operation* pa_context_get_sink_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_sink_info_cb_t cb, void *userdata) {
+    return send_filtered_list_command(c, PA_COMMAND_GET_SINK_INFO_LIST, filter, context_get_sink_info_callback, (pa_operation_cb_t) cb, userdata);
+}
+
 pa_operation* pa_context_get_sink_info_by_index(pa_context *c, uint32_t idx, pa_sink_info_cb_t cb, void *userdata) {
     pa_tagstruct *t;
     pa_operation *o;
@@ -430,6 +599,11 @@ static void context_get_source_info_callback(pa_pdispatch *pd, uint32_t command,
         eol = -1;
     } else {
 
+        if (read_list_header(o, t) < 0) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
         while (!pa_tagstruct_eof(t)) {
             pa_bool_t mute;
             uint32_t flags;
@@ -581,6 +755,10 @@ pa_operation* pa_context_get_source_info_list(pa_context *c, pa_source_info_cb_t
     return pa_context_send_simple_command(c, PA_COMMAND_GET_SOURCE_INFO_LIST, context_get_source_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+pa_operation* pa_context_get_source_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_source_info_cb_t cb, void *userdata) {
+    return send_filtered_list_command(c, PA_COMMAND_GET_SOURCE_INFO_LIST, filter, context_get_source_info_callback, (pa_operation_cb_t) cb, userdata);
+}
+
 pa_operation* pa_context_get_source_info_by_index(pa_context *c, uint32_t idx, pa_source_info_cb_t cb, void *userdata) {
     pa_tagstruct *t;
     pa_operation *o;
@@ -698,6 +876,11 @@ static void context_get_client_info_callback(pa_pdispatch *pd, uint32_t command,
         eol = -1;
     } else {
 
+        if (read_list_header(o, t) < 0) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
         while (!pa_tagstruct_eof(t)) {
             pa_client_info i;
 
@@ -761,6 +944,10 @@ pa_operation* pa_context_get_client_info_list(pa_context *c, pa_client_info_cb_t
     return pa_context_send_simple_command(c, PA_COMMAND_GET_CLIENT_INFO_LIST, context_get_client_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+pa_operation* pa_context_get_client_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_client_info_cb_t cb, void *userdata) {
+    return send_filtered_list_command(c, PA_COMMAND_GET_CLIENT_INFO_LIST, filter, context_get_client_info_callback, (pa_operation_cb_t) cb, userdata);
+}
+
 /*** Card info ***/
 
 static void card_info_free(pa_card_info* i) {
@@ -876,6 +1063,11 @@ static void context_get_card_info_callback(pa_pdispatch *pd, uint32_t command, u
         eol = -1;
     } else {
 
+        if (read_list_header(o, t) < 0) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
         while (!pa_tagstruct_eof(t)) {
             uint32_t j;
             const char*ap;
@@ -1016,6 +1208,10 @@ pa_operation* pa_context_get_card_info_list(pa_context *c, pa_card_info_cb_t cb,
     return pa_context_send_simple_command(c, PA_COMMAND_GET_CARD_INFO_LIST, context_get_card_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+pa_operation* pa_context_get_card_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_card_info_cb_t cb, void *userdata) {
+    return send_filtered_list_command(c, PA_COMMAND_GET_CARD_INFO_LIST, filter, context_get_card_info_callback, (pa_operation_cb_t) cb, userdata);
+}
+
 pa_operation* pa_context_set_card_profile_by_index(pa_context *c, uint32_t idx, const char*profile, pa_context_success_cb_t cb, void *userdata) {
     pa_operation *o;
     pa_tagstruct *t;
@@ -1086,6 +1282,11 @@ static void context_get_module_info_callback(pa_pdispatch *pd, uint32_t command,
         eol = -1;
     } else {
 
+        if (read_list_header(o, t) < 0) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
         while (!pa_tagstruct_eof(t)) {
             pa_module_info i;
             pa_bool_t auto_unload = FALSE;
@@ -1151,6 +1352,10 @@ pa_operation* pa_context_get_module_info_list(pa_context *c, pa_module_info_cb_t
     return pa_context_send_simple_command(c, PA_COMMAND_GET_MODULE_INFO_LIST, context_get_module_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+pa_operation* pa_context_get_module_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_module_info_cb_t cb, void *userdata) {
+    return send_filtered_list_command(c, PA_COMMAND_GET_MODULE_INFO_LIST, filter, context_get_module_info_callback, (pa_operation_cb_t) cb, userdata);
+}
+
 /*** Sink input info ***/
 
 static void context_get_sink_input_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -1171,6 +1376,11 @@ static void context_get_sink_input_info_callback(pa_pdispatch *pd, uint32_t comm
         eol = -1;
     } else {
 
+        if (read_list_header(o, t) < 0) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
         while (!pa_tagstruct_eof(t)) {
             pa_sink_input_info i;
             pa_bool_t mute = FALSE, corked = FALSE, has_volume = FALSE, volume_writable = TRUE;
@@ -1256,6 +1466,10 @@ pa_operation* pa_context_get_sink_input_info_list(pa_context *c, void (*cb)(pa_c
     return pa_context_send_simple_command(c, PA_COMMAND_GET_SINK_INPUT_INFO_LIST, context_get_sink_input_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+pa_operation* pa_context_get_sink_input_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_sink_input_info_cb_t cb, void *userdata) {
+    return send_filtered_list_command(c, PA_COMMAND_GET_SINK_INPUT_INFO_LIST, filter, context_get_sink_input_info_callback, (pa_operation_cb_t) cb, userdata);
+}
+
 /*** Source output info ***/
 
 static void context_get_source_output_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -1276,6 +1490,11 @@ static void context_get_source_output_info_callback(pa_pdispatch *pd, uint32_t c
         eol = -1;
     } else {
 
+        if (read_list_header(o, t) < 0) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
         while (!pa_tagstruct_eof(t)) {
             pa_source_output_info i;
             pa_bool_t mute = FALSE, corked = FALSE, has_volume = FALSE, volume_writable = TRUE;
@@ -1361,6 +1580,10 @@ pa_operation* pa_context_get_source_output_info_list(pa_context *c,  pa_source_o
     return pa_context_send_simple_command(c, PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST, context_get_source_output_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+pa_operation* pa_context_get_source_output_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_source_output_info_cb_t cb, void *userdata) {
+    return send_filtered_list_command(c, PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST, filter, context_get_source_output_info_callback, (pa_operation_cb_t) cb, userdata);
+}
+
 /*** Volume manipulation ***/
 
 pa_operation* pa_context_set_sink_volume_by_index(pa_context *c, uint32_t idx, const pa_cvolume *volume, pa_context_success_cb_t cb, void *userdata) {
@@ -1682,6 +1905,11 @@ static void context_get_sample_info_callback(pa_pdispatch *pd, uint32_t command,
         eol = -1;
     } else {
 
+        if (read_list_header(o, t) < 0) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
         while (!pa_tagstruct_eof(t)) {
             pa_sample_info i;
             pa_bool_t lazy = FALSE;
@@ -1777,6 +2005,10 @@ pa_operation* pa_context_get_sample_info_list(pa_context *c, pa_sample_info_cb_t
     return pa_context_send_simple_command(c, PA_COMMAND_GET_SAMPLE_INFO_LIST, context_get_sample_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+pa_operation* pa_context_get_sample_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_sample_info_cb_t cb, void *userdata) {
+    return send_filtered_list_command(c, PA_COMMAND_GET_SAMPLE_INFO_LIST, filter, context_get_sample_info_callback, (pa_operation_cb_t) cb, userdata);
+}
+
 static pa_operation* command_kill(pa_context *c, uint32_t command, uint32_t idx, pa_context_success_cb_t cb, void *userdata) {
     pa_operation *o;
     pa_tagstruct *t;
@@ -136,6 +136,17 @@
  * either pa_context_get_client_info() or pa_context_get_client_info_list().
  * The information structure is called pa_client_info.
  *
+ * \subsection filtered_subsec Paged and Filtered Lists
+ *
+ * Applications that regularly poll the lists of a busy server can use
+ * the _filtered() variants of the list functions, e.g.
+ * pa_context_get_sink_input_info_list_filtered(). A pa_info_list_filter
+ * limits the reply to a range of indexes, to the objects that changed
+ * since an earlier reply, and to some keys of the property lists. From
+ * the callbacks of such a query, pa_context_get_info_list_cursor()
+ * tells where the next page starts, which generation to ask for changes
+ * since, and whether objects were removed in the meantime.
+ *
  * \section ctrl_sec Control
  *
  * Some parts of the server are only possible to read, but most can also be
@@ -193,6 +204,36 @@
 
 PA_C_DECL_BEGIN
 
+/** @{ \name Paged and Filtered Lists */
+
+/** Restricts what pa_context_get_sink_info_list_filtered() and
+ * friends return. Please note that this structure can be extended as
+ * part of evolutionary API updates at any time in any new
+ * release. \since 4.0 */
+typedef struct pa_info_list_filter {
+    uint32_t start_index;                /**< Only list objects with this index or a higher one */
+    uint32_t max_entries;                /**< List at most this many objects, 0 for no limit */
+    uint64_t changed_since;              /**< If not 0, only list objects that were created or changed after this generation */
+    const char * const *keys;            /**< If not NULL, a NULL terminated array of the only property list keys to fetch, at most 64 */
+} pa_info_list_filter;
+
+/** Where the reply of a _filtered() list query ended. Please note
+ * that this structure can be extended as part of evolutionary API
+ * updates at any time in any new release. \since 4.0 */
+typedef struct pa_info_list_cursor {
+    uint32_t next_index;                 /**< The start_index of the next page, PA_INVALID_INDEX if there is none */
+    uint64_t generation;                 /**< The server's generation at the time of the reply, to pass as changed_since later */
+    uint64_t removed_generation;         /**< The generation at which the last object of this kind was removed. Removed objects are never listed, so if this is larger than the changed_since of the query, list the objects without changed_since or use pa_context_subscribe() to find out which ones are gone */
+} pa_info_list_cursor;
+
+/** Return where the reply of the _filtered() list query whose callback
+ * is running ended. Each query has its own cursor, so several of them
+ * may be in flight at once. Returns a negative error code if not
+ * called from the callback of a _filtered() list query. \since 4.0 */
+int pa_context_get_info_list_cursor(pa_context *c, pa_info_list_cursor *cursor);
+
+/** @} */
+
 /** @{ \name Sinks */
 
 /** Stores information about a specific port of a sink.  Please
@@ -247,6 +288,10 @@ pa_operation* pa_context_get_sink_info_by_index(pa_context *c, uint32_t idx, pa_
 /** Get the complete sink list */
 pa_operation* pa_context_get_sink_info_list(pa_context *c, pa_sink_info_cb_t cb, void *userdata);
 
+/** Like pa_context_get_sink_info_list(), but only list what matches
+ * the filter. \since 4.0 */
+pa_operation* pa_context_get_sink_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_sink_info_cb_t cb, void *userdata);
+
 /** Set the volume of a sink device specified by its index */
 pa_operation* pa_context_set_sink_volume_by_index(pa_context *c, uint32_t idx, const pa_cvolume *volume, pa_context_success_cb_t cb, void *userdata);
 
@@ -327,6 +372,10 @@ pa_operation* pa_context_get_source_info_by_index(pa_context *c, uint32_t idx, p
 /** Get the complete source list */
 pa_operation* pa_context_get_source_info_list(pa_context *c, pa_source_info_cb_t cb, void *userdata);
 
+/** Like pa_context_get_source_info_list(), but only list what matches
+ * the filter. \since 4.0 */
+pa_operation* pa_context_get_source_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_source_info_cb_t cb, void *userdata);
+
 /** Set the volume of a source device specified by its index */
 pa_operation* pa_context_set_source_volume_by_index(pa_context *c, uint32_t idx, const pa_cvolume *volume, pa_context_success_cb_t cb, void *userdata);
 
@@ -403,6 +452,10 @@ pa_operation* pa_context_get_module_info(pa_context *c, uint32_t idx, pa_module_
 /** Get the complete list of currently loaded modules */
 pa_operation* pa_context_get_module_info_list(pa_context *c, pa_module_info_cb_t cb, void *userdata);
 
+/** Like pa_context_get_module_info_list(), but only list what matches
+ * the filter. \since 4.0 */
+pa_operation* pa_context_get_module_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_module_info_cb_t cb, void *userdata);
+
 /** Callback prototype for pa_context_load_module() */
 typedef void (*pa_context_index_cb_t)(pa_context *c, uint32_t idx, void *userdata);
 
@@ -436,6 +489,10 @@ pa_operation* pa_context_get_client_info(pa_context *c, uint32_t idx, pa_client_
 /** Get the complete client list */
 pa_operation* pa_context_get_client_info_list(pa_context *c, pa_client_info_cb_t cb, void *userdata);
 
+/** Like pa_context_get_client_info_list(), but only list what matches
+ * the filter. \since 4.0 */
+pa_operation* pa_context_get_client_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_client_info_cb_t cb, void *userdata);
+
 /** Kill a client. */
 pa_operation* pa_context_kill_client(pa_context *c, uint32_t idx, pa_context_success_cb_t cb, void *userdata);
 
@@ -497,6 +554,10 @@ pa_operation* pa_context_get_card_info_by_name(pa_context *c, const char *name,
 /** Get the complete card list \since 0.9.15 */
 pa_operation* pa_context_get_card_info_list(pa_context *c, pa_card_info_cb_t cb, void *userdata);
 
+/** Like pa_context_get_card_info_list(), but only list what matches
+ * the filter. \since 4.0 */
+pa_operation* pa_context_get_card_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_card_info_cb_t cb, void *userdata);
+
 /** Change the profile of a card. \since 0.9.15 */
 pa_operation* pa_context_set_card_profile_by_index(pa_context *c, uint32_t idx, const char*profile, pa_context_success_cb_t cb, void *userdata);
 
@@ -543,6 +604,10 @@ pa_operation* pa_context_get_sink_input_info(pa_context *c, uint32_t idx, pa_sin
 /** Get the complete sink input list */
 pa_operation* pa_context_get_sink_input_info_list(pa_context *c, pa_sink_input_info_cb_t cb, void *userdata);
 
+/** Like pa_context_get_sink_input_info_list(), but only list what matches
+ * the filter. \since 4.0 */
+pa_operation* pa_context_get_sink_input_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_sink_input_info_cb_t cb, void *userdata);
+
 /** Move the specified sink input to a different sink. \since 0.9.5 */
 pa_operation* pa_context_move_sink_input_by_name(pa_context *c, uint32_t idx, const char *sink_name, pa_context_success_cb_t cb, void* userdata);
 
@@ -595,6 +660,10 @@ pa_operation* pa_context_get_source_output_info(pa_context *c, uint32_t idx, pa_
 /** Get the complete list of source outputs */
 pa_operation* pa_context_get_source_output_info_list(pa_context *c, pa_source_output_info_cb_t cb, void *userdata);
 
+/** Like pa_context_get_source_output_info_list(), but only list what matches
+ * the filter. \since 4.0 */
+pa_operation* pa_context_get_source_output_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_source_output_info_cb_t cb, void *userdata);
+
 /** Move the specified source output to a different source. \since 0.9.5 */
 pa_operation* pa_context_move_source_output_by_name(pa_context *c, uint32_t idx, const char *source_name, pa_context_success_cb_t cb, void* userdata);
 
@@ -623,6 +692,12 @@ typedef struct pa_stat_info {
     uint32_t memblock_allocated;       /**< Allocated memory blocks during the whole lifetime of the daemon. */
     uint32_t memblock_allocated_size;  /**< Total size of all memory blocks allocated during the whole lifetime of the daemon. */
     uint32_t scache_size;              /**< Total size of all sample cache entries. */
+    uint32_t resampler_cache_size;     /**< Total size of the resampler filter tables shared between streams. \since 4.0 */
+    uint32_t resampler_cache_saved;    /**< Memory saved by sharing the resampler filter tables between streams. \since 4.0 */
+    uint64_t subscription_events_delivered;        /**< Subscription events sent to all clients. \since 4.0 */
+    uint64_t subscription_events_suppressed;       /**< Subscription events saved by merging them, for all clients. \since 4.0 */
+    uint64_t client_subscription_events_delivered; /**< Subscription events sent to this client. \since 4.0 */
+    uint64_t client_subscription_events_suppressed;/**< Subscription events saved by merging them, for this client. \since 4.0 */
 } pa_stat_info;
 
 /** Callback prototype for pa_context_stat() */
@@ -631,6 +706,32 @@ typedef void (*pa_stat_info_cb_t) (pa_context *c, const pa_stat_info *i, void *u
 /** Get daemon memory block statistics */
 pa_operation* pa_context_stat(pa_context *c, pa_stat_info_cb_t cb, void *userdata);
 
+/** Latency distribution of one kind of server operation. Percentiles
+ * are rounded up and accurate to within 25%. \since 4.0 */
+typedef struct pa_latency_stat_info {
+    const char *name;                  /**< Name of the command or IO thread */
+    uint64_t count;                    /**< Number of samples */
+    pa_usec_t p50;                     /**< Median */
+    pa_usec_t p99;                     /**< 99th percentile */
+    pa_usec_t max;                     /**< Largest sample */
+} pa_latency_stat_info;
+
+/** Server side latency statistics. Please note that this structure
+ * can be extended as part of evolutionary API updates at any time in
+ * any new release. \since 4.0 */
+typedef struct pa_latency_stats_info {
+    uint32_t n_commands;               /**< Number of entries in commands */
+    pa_latency_stat_info *commands;    /**< Time the server took to handle each protocol command, over all clients */
+    uint32_t n_threads;                /**< Number of entries in threads */
+    pa_latency_stat_info *threads;     /**< Round trip times of synchronous messages from the main thread to each IO thread */
+} pa_latency_stats_info;
+
+/** Callback prototype for pa_context_get_latency_stats() \since 4.0 */
+typedef void (*pa_latency_stats_info_cb_t) (pa_context *c, const pa_latency_stats_info *i, void *userdata);
+
+/** Get daemon command handling and IO thread latency statistics \since 4.0 */
+pa_operation* pa_context_get_latency_stats(pa_context *c, pa_latency_stats_info_cb_t cb, void *userdata);
+
 /** @} */
 
 /** @{ \name Cached Samples */
@@ -663,6 +764,10 @@ pa_operation* pa_context_get_sample_info_by_index(pa_context *c, uint32_t idx, p
 /** Get the complete list of samples stored in the daemon. */
 pa_operation* pa_context_get_sample_info_list(pa_context *c, pa_sample_info_cb_t cb, void *userdata);
 
+/** Like pa_context_get_sample_info_list(), but only list what matches
+ * the filter. \since 4.0 */
+pa_operation* pa_context_get_sample_info_list_filtered(pa_context *c, const pa_info_list_filter *filter, pa_sample_info_cb_t cb, void *userdata);
+
 /** @} */
 
 /** \cond fulldocs */
@@ -34,6 +34,11 @@
 #include <pulsecore/pipe.h>
 #endif
 
+#ifdef HAVE_EPOLL_CREATE1
+#define USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
 #include <pulse/xmalloc.h>
@@ -74,6 +79,10 @@ struct pa_time_event {
     pa_bool_t use_rtclock:1;
     pa_usec_t time;
 
+    /* Position in the timer heap while enabled, and when it was armed */
+    unsigned heap_idx;
+    uint64_t serial;
+
     pa_time_event_cb_t callback;
     void *userdata;
     pa_time_event_destroy_cb_t destroy_callback;
@@ -106,8 +115,22 @@ struct pa_mainloop {
     struct pollfd *pollfds;
     unsigned max_pollfds, n_pollfds;
 
+#ifdef USE_EPOLL
+    /* When epoll_fd is valid the io events are registered with it as
+     * they come and go and pollfds is not used at all */
+    int epoll_fd;
+    pa_bool_t epoll_polled:1;
+    struct epoll_event *epoll_events;
+    unsigned max_epoll_events;
+#endif
+
+    /* Binary min-heap of the enabled time events, n_enabled_time_events
+     * long */
+    pa_time_event **time_heap;
+    unsigned max_time_heap;
+    uint64_t time_event_serial;
+
     pa_usec_t prepared_timeout;
-    pa_time_event *cached_next_time_event;
 
     pa_mainloop_api api;
 
@@ -147,6 +170,55 @@ static pa_io_event_flags_t map_flags_from_libc(short flags) {
         (flags & POLLHUP ? PA_IO_EVENT_HANGUP : 0);
 }
 
+#ifdef USE_EPOLL
+static void epoll_stop(pa_mainloop *m, const char *reason) {
+    pa_assert(m);
+    pa_assert(m->epoll_fd >= 0);
+
+    pa_log_info("%s, falling back to poll().", reason);
+
+    pa_close(m->epoll_fd);
+    m->epoll_fd = -1;
+
+    /* The pollfds have not been kept up to date */
+    m->rebuild_pollfds = TRUE;
+}
+
+static void epoll_update(pa_io_event *e, int op) {
+    pa_mainloop *m;
+    pa_io_event *i;
+    struct epoll_event ev;
+
+    pa_assert(e);
+
+    m = e->mainloop;
+
+    if (m->epoll_fd < 0)
+        return;
+
+    if (op == EPOLL_CTL_DEL) {
+        /* If the fd has been closed before the event was freed and its
+         * number reused we cannot tell which registration DEL would
+         * remove, so don't guess. */
+        PA_LLIST_FOREACH(i, m->io_events)
+            if (i != e && !i->dead && i->fd == e->fd) {
+                epoll_stop(m, "Two io events for the same fd");
+                return;
+            }
+    }
+
+    pa_zero(ev);
+    /* On Linux the EPOLL* bits have the same values as the POLL* ones */
+    ev.events = (uint32_t) (unsigned short) map_flags_to_libc(e->events);
+    ev.data.ptr = e;
+
+    if (epoll_ctl(m->epoll_fd, op, e->fd, &ev) < 0) {
+        pa_log_debug("epoll_ctl(%i): %s", e->fd, pa_cstrerror(errno));
+        epoll_stop(m, "Cannot use epoll for all io events");
+    }
+}
+#endif
+
 /* IO events */
 static pa_io_event* mainloop_io_new(
         pa_mainloop_api *a,
@@ -197,6 +269,11 @@ static pa_io_event* mainloop_io_new(
     m->rebuild_pollfds = TRUE;
     m->n_io_events ++;
 
+#ifdef USE_EPOLL
+    if (!e->dead)
+        epoll_update(e, EPOLL_CTL_ADD);
+#endif
+
     pa_mainloop_wakeup(m);
 
     return e;
@@ -216,6 +293,10 @@ static void mainloop_io_enable(pa_io_event *e, pa_io_event_flags_t events) {
     else
         e->mainloop->rebuild_pollfds = TRUE;
 
+#ifdef USE_EPOLL
+    epoll_update(e, EPOLL_CTL_MOD);
+#endif
+
     pa_mainloop_wakeup(e->mainloop);
 }
 
@@ -223,6 +304,10 @@ static void mainloop_io_free(pa_io_event *e) {
     pa_assert(e);
     pa_assert(!e->dead);
 
+#ifdef USE_EPOLL
+    epoll_update(e, EPOLL_CTL_DEL);
+#endif
+
     e->dead = TRUE;
     e->mainloop->io_events_please_scan ++;
 
@@ -307,6 +392,75 @@ static void mainloop_defer_set_destroy(pa_defer_event *e, pa_defer_event_destroy
 }
 
 /* Time events */
+static void time_heap_set(pa_mainloop *m, unsigned idx, pa_time_event *e) {
+    m->time_heap[idx] = e;
+    e->heap_idx = idx;
+}
+
+static void time_heap_up(pa_mainloop *m, unsigned idx) {
+    pa_time_event *e = m->time_heap[idx];
+
+    while (idx > 0) {
+        unsigned parent = (idx - 1) / 2;
+
+        if (m->time_heap[parent]->time <= e->time)
+            break;
+
+        time_heap_set(m, idx, m->time_heap[parent]);
+        idx = parent;
+    }
+
+    time_heap_set(m, idx, e);
+}
+
+static void time_heap_down(pa_mainloop *m, unsigned idx) {
+    pa_time_event *e = m->time_heap[idx];
+    unsigned n = m->n_enabled_time_events;
+
+    for (;;) {
+        unsigned child = 2 * idx + 1;
+
+        if (child >= n)
+            break;
+
+        if (child + 1 < n && m->time_heap[child + 1]->time < m->time_heap[child]->time)
+            child++;
+
+        if (e->time <= m->time_heap[child]->time)
+            break;
+
+        time_heap_set(m, idx, m->time_heap[child]);
+        idx = child;
+    }
+
+    time_heap_set(m, idx, e);
+}
+
+static void time_heap_insert(pa_mainloop *m, pa_time_event *e) {
+    if (m->n_enabled_time_events >= m->max_time_heap) {
+        m->max_time_heap = PA_MAX(16U, m->max_time_heap * 2);
+        m->time_heap = pa_xrealloc(m->time_heap, m->max_time_heap * sizeof(pa_time_event*));
+    }
+
+    time_heap_set(m, m->n_enabled_time_events++, e);
+    time_heap_up(m, e->heap_idx);
+}
+
+static void time_heap_remove(pa_mainloop *m, pa_time_event *e) {
+    unsigned idx = e->heap_idx;
+
+    pa_assert(m->n_enabled_time_events > 0);
+    pa_assert(m->time_heap[idx] == e);
+
+    if (idx == --m->n_enabled_time_events)
+        return;
+
+    /* Move the last entry into the gap, it can go either way */
+    time_heap_set(m, idx, m->time_heap[m->n_enabled_time_events]);
+    time_heap_up(m, idx);
+    time_heap_down(m, idx);
+}
+
 static pa_usec_t make_rt(const struct timeval *tv, pa_bool_t *use_rtclock) {
     struct timeval ttv;
 
@@ -352,15 +506,9 @@ static pa_time_event* mainloop_time_new(
     if ((e->enabled = (t != PA_USEC_INVALID))) {
         e->time = t;
         e->use_rtclock = use_rtclock;
+        e->serial = ++m->time_event_serial;
 
-        m->n_enabled_time_events++;
-
-        if (m->cached_next_time_event) {
-            pa_assert(m->cached_next_time_event->enabled);
-
-            if (t < m->cached_next_time_event->time)
-                m->cached_next_time_event = e;
-        }
+        time_heap_insert(m, e);
     }
 
     e->callback = callback;
@@ -385,25 +533,24 @@ static void mainloop_time_restart(pa_time_event *e, const struct timeval *tv) {
     t = make_rt(tv, &use_rtclock);
 
     valid = (t != PA_USEC_INVALID);
-    if (e->enabled && !valid) {
-        pa_assert(e->mainloop->n_enabled_time_events > 0);
-        e->mainloop->n_enabled_time_events--;
-    } else if (!e->enabled && valid)
-        e->mainloop->n_enabled_time_events++;
 
-    if ((e->enabled = valid)) {
+    if (valid) {
         e->time = t;
         e->use_rtclock = use_rtclock;
+        e->serial = ++e->mainloop->time_event_serial;
+
+        if (e->enabled) {
+            time_heap_up(e->mainloop, e->heap_idx);
+            time_heap_down(e->mainloop, e->heap_idx);
+        } else
+            time_heap_insert(e->mainloop, e);
+
         pa_mainloop_wakeup(e->mainloop);
-    }
 
-    if (e->mainloop->cached_next_time_event && e->enabled) {
-        pa_assert(e->mainloop->cached_next_time_event->enabled);
+    } else if (e->enabled)
+        time_heap_remove(e->mainloop, e);
 
-        if (t < e->mainloop->cached_next_time_event->time)
-            e->mainloop->cached_next_time_event = e;
-    } else if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
+    e->enabled = valid;
 }
 
 static void mainloop_time_free(pa_time_event *e) {
@@ -414,14 +561,10 @@ static void mainloop_time_free(pa_time_event *e) {
     e->mainloop->time_events_please_scan ++;
 
     if (e->enabled) {
-        pa_assert(e->mainloop->n_enabled_time_events > 0);
-        e->mainloop->n_enabled_time_events--;
+        time_heap_remove(e->mainloop, e);
         e->enabled = FALSE;
     }
 
-    if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
-
     /* no wakeup needed here. Think about it! */
 }
 
@@ -484,6 +627,25 @@ pa_mainloop *pa_mainloop_new(void) {
 
     m->rebuild_pollfds = TRUE;
 
+#ifdef USE_EPOLL
+    m->epoll_fd = -1;
+
+    if (!getenv("PULSE_NO_EPOLL")) {
+        if ((m->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+            pa_log_debug("epoll_create1(): %s", pa_cstrerror(errno));
+        else {
+            struct epoll_event ev;
+
+            /* data.ptr == NULL marks the wakeup pipe */
+            pa_zero(ev);
+            ev.events = EPOLLIN;
+
+            if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, m->wakeup_pipe[0], &ev) < 0)
+                epoll_stop(m, "Cannot watch the wakeup pipe with epoll");
+        }
+    }
+#endif
+
     m->api = vtable;
     m->api.userdata = m;
 
@@ -539,8 +701,7 @@ static void cleanup_time_events(pa_mainloop *m, pa_bool_t force) {
             }
 
             if (!e->dead && e->enabled) {
-                pa_assert(m->n_enabled_time_events > 0);
-                m->n_enabled_time_events--;
+                time_heap_remove(m, e);
                 e->enabled = FALSE;
             }
 
@@ -595,6 +756,14 @@ void pa_mainloop_free(pa_mainloop *m) {
     cleanup_time_events(m, TRUE);
 
     pa_xfree(m->pollfds);
+    pa_xfree(m->time_heap);
+
+#ifdef USE_EPOLL
+    if (m->epoll_fd >= 0)
+        pa_close(m->epoll_fd);
+
+    pa_xfree(m->epoll_events);
+#endif
 
     pa_close_pipe(m->wakeup_pipe);
 
@@ -683,52 +852,54 @@ static unsigned dispatch_pollfds(pa_mainloop *m) {
     return r;
 }
 
-static unsigned dispatch_defer(pa_mainloop *m) {
-    pa_defer_event *e;
-    unsigned r = 0;
+#ifdef USE_EPOLL
+static unsigned dispatch_epoll(pa_mainloop *m) {
+    unsigned r = 0, k;
 
-    if (m->n_enabled_defer_events <= 0)
-        return 0;
+    pa_assert(m->poll_func_ret > 0);
 
-    PA_LLIST_FOREACH(e, m->defer_events) {
+    for (k = 0; k < (unsigned) m->poll_func_ret; k++) {
+        pa_io_event *e;
 
         if (m->quit)
             break;
 
-        if (e->dead || !e->enabled)
+        /* Events freed by an earlier callback stay around until the
+         * next prepare, so the pointer is still good */
+        if (!(e = m->epoll_events[k].data.ptr) || e->dead)
             continue;
 
         pa_assert(e->callback);
-        e->callback(&m->api, e, e->userdata);
+
+        e->callback(&m->api, e, e->fd, map_flags_from_libc((short) m->epoll_events[k].events), e->userdata);
         r++;
     }
 
     return r;
 }
+#endif
 
-static pa_time_event* find_next_time_event(pa_mainloop *m) {
-    pa_time_event *t, *n = NULL;
-    pa_assert(m);
+static unsigned dispatch_defer(pa_mainloop *m) {
+    pa_defer_event *e;
+    unsigned r = 0;
+
+    if (m->n_enabled_defer_events <= 0)
+        return 0;
 
-    if (m->cached_next_time_event)
-        return m->cached_next_time_event;
+    PA_LLIST_FOREACH(e, m->defer_events) {
 
-    PA_LLIST_FOREACH(t, m->time_events) {
+        if (m->quit)
+            break;
 
-        if (t->dead || !t->enabled)
+        if (e->dead || !e->enabled)
             continue;
 
-        if (!n || t->time < n->time) {
-            n = t;
-
-            /* Shortcut for time == 0 */
-            if (n->time == 0)
-                break;
-        }
+        pa_assert(e->callback);
+        e->callback(&m->api, e, e->userdata);
+        r++;
     }
 
-    m->cached_next_time_event = n;
-    return n;
+    return r;
 }
 
 static pa_usec_t calc_next_timeout(pa_mainloop *m) {
@@ -738,7 +909,7 @@ static pa_usec_t calc_next_timeout(pa_mainloop *m) {
     if (m->n_enabled_time_events <= 0)
         return PA_USEC_INVALID;
 
-    pa_assert_se(t = find_next_time_event(m));
+    t = m->time_heap[0];
 
     if (t->time <= 0)
         return 0;
@@ -754,6 +925,7 @@ static pa_usec_t calc_next_timeout(pa_mainloop *m) {
 static unsigned dispatch_timeout(pa_mainloop *m) {
     pa_time_event *e;
     pa_usec_t now;
+    uint64_t serial;
     unsigned r = 0;
     pa_assert(m);
 
@@ -761,26 +933,27 @@ static unsigned dispatch_timeout(pa_mainloop *m) {
         return 0;
 
     now = pa_rtclock_now();
+    serial = m->time_event_serial;
 
-    PA_LLIST_FOREACH(e, m->time_events) {
+    while (m->n_enabled_time_events > 0 && !m->quit) {
+        struct timeval tv;
 
-        if (m->quit)
-            break;
+        e = m->time_heap[0];
 
-        if (e->dead || !e->enabled)
-            continue;
+        /* Events (re)armed by a callback of this round wait for the
+         * next iteration, like they always did */
+        if (e->time > now || e->serial > serial)
+            break;
 
-        if (e->time <= now) {
-            struct timeval tv;
-            pa_assert(e->callback);
+        pa_assert(!e->dead);
+        pa_assert(e->callback);
 
-            /* Disable time event */
-            mainloop_time_restart(e, NULL);
+        /* Disable time event */
+        mainloop_time_restart(e, NULL);
 
-            e->callback(&m->api, e, pa_timeval_rtstore(&tv, e->time, e->use_rtclock), e->userdata);
+        e->callback(&m->api, e, pa_timeval_rtstore(&tv, e->time, e->use_rtclock), e->userdata);
 
-            r++;
-        }
+        r++;
     }
 
     return r;
@@ -823,6 +996,18 @@ int pa_mainloop_prepare(pa_mainloop *m, int timeout) {
 
     if (m->n_enabled_defer_events <= 0) {
 
+#ifdef USE_EPOLL
+        /* A custom poll function needs the pollfd array */
+        if (m->epoll_fd >= 0 && m->poll_func)
+            epoll_stop(m, "Custom poll function set");
+
+        if (m->epoll_fd >= 0) {
+            if (m->max_epoll_events < m->n_io_events + 1) {
+                m->max_epoll_events = (m->n_io_events + 1) * 2;
+                m->epoll_events = pa_xrealloc(m->epoll_events, m->max_epoll_events * sizeof(struct epoll_event));
+            }
+        } else
+#endif
         if (m->rebuild_pollfds)
             rebuild_pollfds(m);
 
@@ -864,16 +1049,31 @@ int pa_mainloop_poll(pa_mainloop *m) {
 
     m->state = STATE_POLLING;
 
+#ifdef USE_EPOLL
+    m->epoll_polled = FALSE;
+#endif
+
     if (m->n_enabled_defer_events )
         m->poll_func_ret = 0;
     else {
-        pa_assert(!m->rebuild_pollfds);
+#ifdef USE_EPOLL
+        if (m->epoll_fd < 0)
+#endif
+            pa_assert(!m->rebuild_pollfds);
 
         if (m->poll_func)
             m->poll_func_ret = m->poll_func(
                     m->pollfds, m->n_pollfds,
                     usec_to_timeout(m->prepared_timeout),
                     m->poll_func_userdata);
+#ifdef USE_EPOLL
+        else if (m->epoll_fd >= 0) {
+            m->poll_func_ret = epoll_wait(
+                    m->epoll_fd, m->epoll_events, (int) m->max_epoll_events,
+                    usec_to_timeout(m->prepared_timeout));
+            m->epoll_polled = TRUE;
+        }
+#endif
         else {
 #ifdef HAVE_PPOLL
             struct timespec ts;
@@ -923,8 +1123,14 @@ int pa_mainloop_dispatch(pa_mainloop *m) {
         if (m->quit)
             goto quit;
 
-        if (m->poll_func_ret > 0)
-            dispatched += dispatch_pollfds(m);
+        if (m->poll_func_ret > 0) {
+#ifdef USE_EPOLL
+            if (m->epoll_polled)
+                dispatched += dispatch_epoll(m);
+            else
+#endif
+                dispatched += dispatch_pollfds(m);
+        }
     }
 
     if (m->quit)
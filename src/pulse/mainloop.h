@@ -38,6 +38,12 @@ struct pollfd;
  * It supports the functions defined in the main loop abstraction and very
  * little else.
  *
+ * On Linux epoll is used instead, unless a custom poll function is set
+ * with pa_mainloop_set_poll_func() or the environment variable
+ * $PULSE_NO_EPOLL is set. IO events should be freed before their file
+ * descriptor is closed; if that is not the case the main loop falls back
+ * to poll(). \since 4.0
+ *
  * The main loop is created using pa_mainloop_new() and destroyed using
  * pa_mainloop_free(). To get access to the main loop abstraction,
  * pa_mainloop_get_api() is used.
@@ -82,6 +82,9 @@ static void operation_unlink(pa_operation *o) {
     if (o->context) {
         pa_assert(PA_REFCNT_VALUE(o) >= 2);
 
+        if (o->context->list_operation == o)
+            o->context->list_operation = NULL;
+
         PA_LLIST_REMOVE(pa_operation, o->context->operations, o);
         pa_operation_unref(o);
 
@@ -180,6 +180,12 @@ PA_C_DECL_BEGIN
 /** For clients/streams: an id for the login session the application runs in. On Unix the value of $XDG_SESSION_ID. e.g. "5" */
 #define PA_PROP_APPLICATION_PROCESS_SESSION_ID "application.process.session_id"
 
+/** For clients: the most subscription events per second the client
+ * wants, an integer formatted as string, "0" for no limit. Events
+ * beyond that are held back and merged per object. Overrides the
+ * server's default when the client subscribes. e.g. "50" \since 4.0 */
+#define PA_PROP_APPLICATION_SUBSCRIPTION_RATE_LIMIT "application.subscription_rate_limit"
+
 /** For devices: device string in the underlying audio layer's format. e.g. "surround51:0" */
 #define PA_PROP_DEVICE_STRING                  "device.string"
 
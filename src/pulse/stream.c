@@ -51,6 +51,10 @@
 #define SMOOTHER_HISTORY_TIME (5000*PA_USEC_PER_MSEC)
 #define SMOOTHER_MIN_HISTORY (4)
 
+/* Bounds for the shared memory ring of playback streams */
+#define RING_SIZE_MIN (64*1024)
+#define RING_SIZE_MAX (1024*1024)
+
 pa_stream *pa_stream_new(pa_context *c, const char *name, const pa_sample_spec *ss, const pa_channel_map *map) {
     return pa_stream_new_with_proplist(c, name, ss, map, NULL);
 }
@@ -171,6 +175,8 @@ static pa_stream *pa_stream_new_with_proplist_internal(
 
     s->write_memblock = NULL;
     s->write_data = NULL;
+    s->ring = NULL;
+    s->ring_written = 0;
 
     pa_memchunk_reset(&s->peek_memchunk);
     s->peek_data = NULL;
@@ -263,6 +269,11 @@ static void stream_unlink(pa_stream *s) {
         s->channel_valid = FALSE;
     }
 
+    if (s->ring) {
+        pa_shmring_free(s->ring);
+        s->ring = NULL;
+    }
+
     PA_LLIST_REMOVE(pa_stream, s->context->streams, s);
     pa_stream_unref(s);
 
@@ -1132,6 +1143,21 @@ void pa_create_stream_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag,
         }
     }
 
+    if (s->context->version >= 28 && s->direction == PA_STREAM_PLAYBACK) {
+        uint32_t ring_status_id;
+
+        if (pa_tagstruct_getu32(t, &ring_status_id) < 0) {
+            pa_context_fail(s->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
+        /* If the server didn't take our ring, we use the socket */
+        if (s->ring && (ring_status_id == PA_INVALID_INDEX || pa_shmring_attach_consumer(s->ring, ring_status_id) < 0)) {
+            pa_shmring_free(s->ring);
+            s->ring = NULL;
+        }
+    }
+
     if (!pa_tagstruct_eof(t)) {
         pa_context_fail(s->context, PA_ERR_PROTOCOL);
         goto finish;
@@ -1161,6 +1187,27 @@ finish:
     pa_stream_unref(s);
 }
 
+/* Creates the shared memory ring we write playback data into, which is
+ * big enough for two target buffer lengths */
+static pa_shmring* stream_ring_new(pa_stream *s) {
+    size_t length, size;
+
+    pa_assert(s);
+
+    if (!pa_pstream_get_shm(s->context->pstream) || s->n_formats > 0 || getenv("PULSE_NO_SHM_RING"))
+        return NULL;
+
+    if (s->buffer_attr.tlength == (uint32_t) -1)
+        length = pa_usec_to_bytes(2 * PA_USEC_PER_SEC, &s->sample_spec);
+    else
+        length = s->buffer_attr.tlength;
+
+    for (size = RING_SIZE_MIN; size < 2 * length && size < RING_SIZE_MAX; size <<= 1)
+        ;
+
+    return pa_shmring_new_producer(size);
+}
+
 static int create_stream(
         pa_stream_direction_t direction,
         pa_stream *s,
@@ -1364,6 +1411,13 @@ static int create_stream(
         pa_tagstruct_put_boolean(t, flags & (PA_STREAM_PASSTHROUGH));
     }
 
+    if (s->context->version >= 28 && s->direction == PA_STREAM_PLAYBACK) {
+        pa_assert(!s->ring);
+
+        s->ring = stream_ring_new(s);
+        pa_tagstruct_putu32(t, s->ring ? pa_shmring_get_shm_id(s->ring) : PA_INVALID_INDEX);
+    }
+
     pa_pstream_send_tagstruct(s->context->pstream, t);
     pa_pdispatch_register_reply(s->context->pdispatch, tag, DEFAULT_TIMEOUT, pa_create_stream_callback, s, NULL);
 
@@ -1456,6 +1510,50 @@ int pa_stream_cancel_write(
     return 0;
 }
 
+/* Stops using the ring for this stream. Whatever is in it is still
+ * read by the server before anything we send through the socket. */
+static void stream_ring_fall_back(pa_stream *s) {
+    pa_assert(s->ring);
+
+    pa_log_debug("Playback ring full, sending data through the socket from now on.");
+
+    pa_shmring_free(s->ring);
+    s->ring = NULL;
+}
+
+static int stream_ring_write(pa_stream *s, const void *data, size_t length, int64_t offset, pa_seek_mode_t seek) {
+    pa_tagstruct *t;
+    uint32_t tag;
+
+    pa_assert(s->ring);
+
+    if (pa_shmring_write(s->ring, data, length, offset, seek) < 0) {
+        stream_ring_fall_back(s);
+        return -1;
+    }
+
+    s->ring_written += offset + (int64_t) length;
+
+    /* The server ran dry and waits for us */
+    if (pa_shmring_doorbell_pending(s->ring)) {
+        t = pa_tagstruct_command(s->context, PA_COMMAND_PLAYBACK_RING_DOORBELL, &tag);
+        pa_tagstruct_putu32(t, s->channel);
+        pa_pstream_send_tagstruct(s->context->pstream, t);
+    }
+
+    return 0;
+}
+
+/* Keeps the server from reading what we write after this before it got
+ * the request we are about to send */
+static void stream_ring_fence(pa_stream *s) {
+    if (!s->ring)
+        return;
+
+    if (pa_shmring_write_fence(s->ring) < 0)
+        stream_ring_fall_back(s);
+}
+
 int pa_stream_write(
         pa_stream *s,
         const void *data,
@@ -1480,7 +1578,19 @@ int pa_stream_write(
                       PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context, !free_cb || !s->write_memblock, PA_ERR_INVALID);
 
-    if (s->write_memblock) {
+    if (s->ring && length > 0 && stream_ring_write(s, data, length, offset, seek) >= 0) {
+
+        /* The data is in shared memory now, we don't need it anymore */
+
+        if (s->write_memblock) {
+            pa_memblock_release(s->write_memblock);
+            pa_memblock_unref(s->write_memblock);
+            s->write_memblock = NULL;
+            s->write_data = NULL;
+        } else if (free_cb)
+            free_cb((void*) data);
+
+    } else if (s->write_memblock) {
         pa_memchunk chunk;
 
         /* pa_stream_write_begin() was called before */
@@ -1672,6 +1782,8 @@ pa_operation * pa_stream_drain(pa_stream *s, pa_stream_success_cb_t cb, void *us
 
     o = pa_operation_new(s->context, s, (pa_operation_cb_t) cb, userdata);
 
+    stream_ring_fence(s);
+
     t = pa_tagstruct_command(s->context, PA_COMMAND_DRAIN_PLAYBACK_STREAM, &tag);
     pa_tagstruct_putu32(t, s->channel);
     pa_pstream_send_tagstruct(s->context->pstream, t);
@@ -1962,6 +2074,12 @@ pa_operation* pa_stream_update_timing_info(pa_stream *s, pa_stream_success_cb_t
     pa_tagstruct_putu32(t, s->channel);
     pa_tagstruct_put_timeval(t, pa_gettimeofday(&now));
 
+    /* What we write into the ring from now on is accounted for by the
+     * correction below, the server tells us the write index as it was
+     * when it had read this much from the ring */
+    if (s->context->version >= 28 && s->direction == PA_STREAM_PLAYBACK)
+        pa_tagstruct_puts64(t, s->ring_written);
+
     pa_pstream_send_tagstruct(s->context->pstream, t);
     pa_pdispatch_register_reply(s->context->pdispatch, tag, DEFAULT_TIMEOUT, stream_get_timing_info_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -2269,6 +2387,8 @@ static pa_operation* stream_send_simple_command(pa_stream *s, uint32_t command,
 
     o = pa_operation_new(s->context, s, (pa_operation_cb_t) cb, userdata);
 
+    stream_ring_fence(s);
+
     t = pa_tagstruct_command(s->context, command, &tag);
     pa_tagstruct_putu32(t, s->channel);
     pa_pstream_send_tagstruct(s->context->pstream, t);
@@ -27,16 +27,21 @@
 #include <errno.h>
 
 #include <pulse/xmalloc.h>
+#include <pulse/rtclock.h>
 
 #include <pulsecore/macro.h>
 #include <pulsecore/log.h>
 #include <pulsecore/semaphore.h>
-#include <pulsecore/macro.h>
 #include <pulsecore/mutex.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/fdsem.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/core-util.h>
 
 #include "asyncmsgq.h"
 
+#define ASYNCMSGQ_SIZE 256
+
 PA_STATIC_FLIST_DECLARE(asyncmsgq, 0, pa_xfree);
 PA_STATIC_FLIST_DECLARE(semaphores, 0, (void(*)(void*)) pa_semaphore_free);
 
@@ -48,44 +53,201 @@ struct asyncmsgq_item {
     int64_t offset;
     pa_memchunk memchunk;
     pa_semaphore *semaphore;
+    pa_atomic_t *pending;
     int ret;
+
+    PA_LLIST_FIELDS(struct asyncmsgq_item);
+};
+
+/* A cell of the ring. seq equals the index a writer may fill the cell
+ * for, and that index + 1 once the item is ready for the reader. This
+ * is the bounded queue described by Dmitry Vyukov, with only a single
+ * reader. */
+struct cell {
+    pa_atomic_t seq;
+    pa_atomic_ptr_t item;
 };
 
 struct pa_asyncmsgq {
     PA_REFCNT_DECLARE;
-    pa_asyncq *asyncq;
-    pa_mutex *mutex; /* only for the writer side */
+
+    unsigned size;
+    struct cell *cells;
+    pa_atomic_t write_idx; /* claimed by the writers with cmpxchg */
+    unsigned read_idx; /* only touched by the reader */
+
+    /* Messages that didn't fit into the ring. As long as this list is
+     * not empty all writers append here, so that no writer's messages
+     * can overtake its own earlier ones. The mutex is only taken on
+     * overrun. */
+    pa_mutex *mutex;
+    PA_LLIST_HEAD(struct asyncmsgq_item, overflow);
+    struct asyncmsgq_item *last_overflow;
+    pa_atomic_t n_overflow;
+
+    pa_fdsem *read_fdsem, *write_fdsem;
 
     struct asyncmsgq_item *current;
+
+    /* Round trip times of pa_asyncmsgq_send(), protected by the
+     * mutex since there may be several senders */
+    pa_histogram send_stats;
 };
 
 pa_asyncmsgq *pa_asyncmsgq_new(unsigned size) {
     pa_asyncmsgq *a;
+    unsigned j;
+
+    if (!size)
+        size = ASYNCMSGQ_SIZE;
+
+    pa_assert(pa_is_power_of_two(size));
 
     a = pa_xnew(pa_asyncmsgq, 1);
 
     PA_REFCNT_INIT(a);
-    pa_assert_se(a->asyncq = pa_asyncq_new(size));
+    a->size = size;
+    a->cells = pa_xnew(struct cell, size);
+    for (j = 0; j < size; j++) {
+        pa_atomic_store(&a->cells[j].seq, (int) j);
+        pa_atomic_ptr_store(&a->cells[j].item, NULL);
+    }
+    pa_atomic_store(&a->write_idx, 0);
+    a->read_idx = 0;
+
     pa_assert_se(a->mutex = pa_mutex_new(FALSE, TRUE));
+    PA_LLIST_HEAD_INIT(struct asyncmsgq_item, a->overflow);
+    a->last_overflow = NULL;
+    pa_atomic_store(&a->n_overflow, 0);
+
+    pa_assert_se(a->read_fdsem = pa_fdsem_new());
+    pa_assert_se(a->write_fdsem = pa_fdsem_new());
+
     a->current = NULL;
+    pa_zero(a->send_stats);
 
     return a;
 }
 
+/* Called from any writer thread */
+static int ring_push(pa_asyncmsgq *a, struct asyncmsgq_item *i) {
+    struct cell *c;
+    unsigned idx;
+
+    for (;;) {
+        int d;
+
+        idx = (unsigned) pa_atomic_load(&a->write_idx);
+        c = &a->cells[idx & (a->size - 1)];
+        d = (int) ((unsigned) pa_atomic_load(&c->seq) - idx);
+
+        if (d == 0) {
+            if (pa_atomic_cmpxchg(&a->write_idx, (int) idx, (int) (idx + 1)))
+                break;
+        } else if (d < 0)
+            /* The reader hasn't consumed this cell yet, we're full */
+            return -1;
+
+        /* Otherwise another writer claimed idx before us, retry */
+    }
+
+    pa_assert_se(pa_atomic_ptr_cmpxchg(&c->item, NULL, i));
+    pa_atomic_store(&c->seq, (int) (idx + 1));
+
+    return 0;
+}
+
+/* Called from any writer thread */
+static void push(pa_asyncmsgq *a, struct asyncmsgq_item *i) {
+
+    if (pa_atomic_load(&a->n_overflow) > 0 || ring_push(a, i) < 0) {
+
+        if (pa_log_ratelimit(PA_LOG_WARN))
+            pa_log_warn("q overrun, queuing in overflow list");
+
+        pa_mutex_lock(a->mutex);
+        PA_LLIST_PREPEND(struct asyncmsgq_item, a->overflow, i);
+        if (!a->last_overflow)
+            a->last_overflow = i;
+        pa_atomic_inc(&a->n_overflow);
+        pa_mutex_unlock(a->mutex);
+    }
+
+    /* If the reader has been woken up already and hasn't caught up
+     * yet this is just a load, so messages posted in a burst cost a
+     * single wakeup. */
+    pa_fdsem_post(a->read_fdsem);
+}
+
+/* Called from the reader thread */
+static pa_bool_t ring_ready(pa_asyncmsgq *a) {
+    return (unsigned) pa_atomic_load(&a->cells[a->read_idx & (a->size - 1)].seq) == a->read_idx + 1;
+}
+
+/* Called from the reader thread */
+static pa_bool_t overflow_ready(pa_asyncmsgq *a) {
+
+    /* A writer might have claimed the next cell without having filled
+     * it yet. Its message must not be overtaken by the ones queued in
+     * the overflow list after it, and the writer wakes us up when it
+     * is done. */
+    if ((unsigned) pa_atomic_load(&a->write_idx) != a->read_idx)
+        return FALSE;
+
+    return pa_atomic_load(&a->n_overflow) > 0;
+}
+
+/* Called from the reader thread */
+static struct asyncmsgq_item *pop(pa_asyncmsgq *a) {
+    struct asyncmsgq_item *i;
+
+    if (ring_ready(a)) {
+        struct cell *c = &a->cells[a->read_idx & (a->size - 1)];
+
+        i = pa_atomic_ptr_load(&c->item);
+        pa_assert(i);
+
+        /* Guaranteed to succeed since we are the only reader */
+        pa_assert_se(pa_atomic_ptr_cmpxchg(&c->item, i, NULL));
+
+        pa_atomic_store(&c->seq, (int) (a->read_idx + a->size));
+        a->read_idx++;
+
+        return i;
+    }
+
+    if (!overflow_ready(a))
+        return NULL;
+
+    pa_mutex_lock(a->mutex);
+    if ((i = a->last_overflow)) {
+        a->last_overflow = i->prev;
+        PA_LLIST_REMOVE(struct asyncmsgq_item, a->overflow, i);
+        pa_atomic_dec(&a->n_overflow);
+    }
+    pa_mutex_unlock(a->mutex);
+
+    return i;
+}
+
 static void asyncmsgq_free(pa_asyncmsgq *a) {
     struct asyncmsgq_item *i;
     pa_assert(a);
 
-    while ((i = pa_asyncq_pop(a->asyncq, FALSE))) {
+    while ((i = pop(a))) {
 
         pa_assert(!i->semaphore);
 
-        if (i->object)
-            pa_msgobject_unref(i->object);
+        if (i->pending)
+            pa_atomic_store(i->pending, 0);
 
+        /* The object might keep the pool of the block alive */
         if (i->memchunk.memblock)
             pa_memblock_unref(i->memchunk.memblock);
 
+        if (i->object)
+            pa_msgobject_unref(i->object);
+
         if (i->free_cb)
             i->free_cb(i->userdata);
 
@@ -93,8 +255,10 @@ static void asyncmsgq_free(pa_asyncmsgq *a) {
             pa_xfree(i);
     }
 
-    pa_asyncq_free(a->asyncq, NULL);
+    pa_fdsem_free(a->read_fdsem);
+    pa_fdsem_free(a->write_fdsem);
     pa_mutex_free(a->mutex);
+    pa_xfree(a->cells);
     pa_xfree(a);
 }
 
@@ -112,9 +276,8 @@ void pa_asyncmsgq_unref(pa_asyncmsgq* q) {
         asyncmsgq_free(q);
 }
 
-void pa_asyncmsgq_post(pa_asyncmsgq *a, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *chunk, pa_free_cb_t free_cb) {
+static struct asyncmsgq_item *new_item(pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *chunk, pa_free_cb_t free_cb) {
     struct asyncmsgq_item *i;
-    pa_assert(PA_REFCNT_VALUE(a) > 0);
 
     if (!(i = pa_flist_pop(PA_STATIC_FLIST_GET(asyncmsgq))))
         i = pa_xnew(struct asyncmsgq_item, 1);
@@ -131,15 +294,37 @@ void pa_asyncmsgq_post(pa_asyncmsgq *a, pa_msgobject *object, int code, const vo
     } else
         pa_memchunk_reset(&i->memchunk);
     i->semaphore = NULL;
+    i->pending = NULL;
 
-    /* This mutex makes the queue multiple-writer safe. This lock is only used on the writing side */
-    pa_mutex_lock(a->mutex);
-    pa_asyncq_post(a->asyncq, i);
-    pa_mutex_unlock(a->mutex);
+    return i;
+}
+
+void pa_asyncmsgq_post(pa_asyncmsgq *a, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *chunk, pa_free_cb_t free_cb) {
+    pa_assert(PA_REFCNT_VALUE(a) > 0);
+
+    push(a, new_item(object, code, userdata, offset, chunk, free_cb));
+}
+
+void pa_asyncmsgq_post_coalesced(pa_asyncmsgq *a, pa_atomic_t *pending, pa_msgobject *object, int code, int64_t offset) {
+    struct asyncmsgq_item *i;
+
+    pa_assert(PA_REFCNT_VALUE(a) > 0);
+    pa_assert(pending);
+
+    /* The receiver clears the flag before dispatching, so whatever
+     * changed before this point will be seen by the queued message */
+    if (!pa_atomic_cmpxchg(pending, 0, 1))
+        return;
+
+    i = new_item(object, code, NULL, offset, NULL, NULL);
+    i->pending = pending;
+
+    push(a, i);
 }
 
 int pa_asyncmsgq_send(pa_asyncmsgq *a, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *chunk) {
     struct asyncmsgq_item i;
+    pa_usec_t start;
     pa_assert(PA_REFCNT_VALUE(a) > 0);
 
     i.code = code;
@@ -153,19 +338,23 @@ int pa_asyncmsgq_send(pa_asyncmsgq *a, pa_msgobject *object, int code, const voi
         i.memchunk = *chunk;
     } else
         pa_memchunk_reset(&i.memchunk);
+    i.pending = NULL;
 
     if (!(i.semaphore = pa_flist_pop(PA_STATIC_FLIST_GET(semaphores))))
         i.semaphore = pa_semaphore_new(0);
 
     pa_assert_se(i.semaphore);
 
-    /* This mutex makes the queue multiple-writer safe. This lock is only used on the writing side */
-    pa_mutex_lock(a->mutex);
-    pa_assert_se(pa_asyncq_push(a->asyncq, &i, TRUE) == 0);
-    pa_mutex_unlock(a->mutex);
+    start = pa_rtclock_now();
+
+    push(a, &i);
 
     pa_semaphore_wait(i.semaphore);
 
+    pa_mutex_lock(a->mutex);
+    pa_histogram_add(&a->send_stats, pa_rtclock_now() - start);
+    pa_mutex_unlock(a->mutex);
+
     if (pa_flist_push(PA_STATIC_FLIST_GET(semaphores), i.semaphore) < 0)
         pa_semaphore_free(i.semaphore);
 
@@ -176,11 +365,21 @@ int pa_asyncmsgq_get(pa_asyncmsgq *a, pa_msgobject **object, int *code, void **u
     pa_assert(PA_REFCNT_VALUE(a) > 0);
     pa_assert(!a->current);
 
-    if (!(a->current = pa_asyncq_pop(a->asyncq, wait_op))) {
-/*         pa_log("failure"); */
-        return -1;
+    if (!(a->current = pop(a))) {
+
+        if (!wait_op) {
+/*             pa_log("failure"); */
+            return -1;
+        }
+
+        do {
+            pa_fdsem_wait(a->read_fdsem);
+        } while (!(a->current = pop(a)));
     }
 
+    if (a->current->pending)
+        pa_atomic_store(a->current->pending, 0);
+
 /*     pa_log("success"); */
 
     if (code)
@@ -220,12 +419,12 @@ void pa_asyncmsgq_done(pa_asyncmsgq *a, int ret) {
         if (a->current->free_cb)
             a->current->free_cb(a->current->userdata);
 
-        if (a->current->object)
-            pa_msgobject_unref(a->current->object);
-
         if (a->current->memchunk.memblock)
             pa_memblock_unref(a->current->memchunk.memblock);
 
+        if (a->current->object)
+            pa_msgobject_unref(a->current->object);
+
         if (pa_flist_push(PA_STATIC_FLIST_GET(asyncmsgq), a->current) < 0)
             pa_xfree(a->current);
     }
@@ -283,37 +482,44 @@ int pa_asyncmsgq_process_one(pa_asyncmsgq *a) {
 int pa_asyncmsgq_read_fd(pa_asyncmsgq *a) {
     pa_assert(PA_REFCNT_VALUE(a) > 0);
 
-    return pa_asyncq_read_fd(a->asyncq);
+    return pa_fdsem_get(a->read_fdsem);
 }
 
 int pa_asyncmsgq_read_before_poll(pa_asyncmsgq *a) {
     pa_assert(PA_REFCNT_VALUE(a) > 0);
 
-    return pa_asyncq_read_before_poll(a->asyncq);
+    for (;;) {
+        if (ring_ready(a) || overflow_ready(a))
+            return -1;
+
+        if (pa_fdsem_before_poll(a->read_fdsem) >= 0)
+            return 0;
+    }
 }
 
 void pa_asyncmsgq_read_after_poll(pa_asyncmsgq *a) {
     pa_assert(PA_REFCNT_VALUE(a) > 0);
 
-    pa_asyncq_read_after_poll(a->asyncq);
+    pa_fdsem_after_poll(a->read_fdsem);
 }
 
+/* Writers never have to wait for the reader since messages that
+ * don't fit into the ring are kept in the overflow list, which the
+ * reader drains itself. The write fd hence never becomes ready, it
+ * is only kept so that the writer side can still be hooked into a
+ * poll loop the same way the reader side is. */
 int pa_asyncmsgq_write_fd(pa_asyncmsgq *a) {
     pa_assert(PA_REFCNT_VALUE(a) > 0);
 
-    return pa_asyncq_write_fd(a->asyncq);
+    return pa_fdsem_get(a->write_fdsem);
 }
 
 void pa_asyncmsgq_write_before_poll(pa_asyncmsgq *a) {
     pa_assert(PA_REFCNT_VALUE(a) > 0);
-
-    pa_asyncq_write_before_poll(a->asyncq);
 }
 
 void pa_asyncmsgq_write_after_poll(pa_asyncmsgq *a) {
     pa_assert(PA_REFCNT_VALUE(a) > 0);
-
-    pa_asyncq_write_after_poll(a->asyncq);
 }
 
 int pa_asyncmsgq_dispatch(pa_msgobject *object, int code, void *userdata, int64_t offset, pa_memchunk *memchunk) {
@@ -355,3 +561,12 @@ pa_bool_t pa_asyncmsgq_dispatching(pa_asyncmsgq *a) {
 
     return !!a->current;
 }
+
+void pa_asyncmsgq_get_send_stats(pa_asyncmsgq *a, pa_histogram *stats) {
+    pa_assert(PA_REFCNT_VALUE(a) > 0);
+    pa_assert(stats);
+
+    pa_mutex_lock(a->mutex);
+    *stats = a->send_stats;
+    pa_mutex_unlock(a->mutex);
+}
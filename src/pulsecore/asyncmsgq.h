@@ -25,16 +25,19 @@
 #include <sys/types.h>
 
 #include <pulsecore/asyncq.h>
+#include <pulsecore/atomic.h>
+#include <pulsecore/histogram.h>
 #include <pulsecore/memchunk.h>
 #include <pulsecore/msgobject.h>
 
-/* A simple asynchronous message queue, based on pa_asyncq. In
- * contrast to pa_asyncq this one is multiple-writer safe, though
- * still not multiple-reader safe. This queue is intended to be used
- * for controlling real-time threads from normal-priority
- * threads. Multiple-writer-safety is accomplished by using a mutex on
- * the writer side. This queue is thus not useful for communication
- * between several real-time threads.
+/* A simple asynchronous message queue. In contrast to pa_asyncq this
+ * one is multiple-writer safe, though still not multiple-reader
+ * safe. This queue is intended to be used for controlling real-time
+ * threads from normal-priority threads and vice versa. Writers claim
+ * slots in a fixed-size ring with a compare-and-swap and don't block
+ * each other, only when the ring overruns messages are appended to a
+ * mutex-protected overflow list. Posting thus never blocks and is
+ * cheap enough to be used from several real-time threads.
  *
  * The queue takes messages consisting of:
  *    "Object" for which this messages is intended (may be NULL)
@@ -58,6 +61,13 @@ pa_asyncmsgq* pa_asyncmsgq_ref(pa_asyncmsgq *q);
 void pa_asyncmsgq_unref(pa_asyncmsgq* q);
 
 void pa_asyncmsgq_post(pa_asyncmsgq *q, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *memchunk, pa_free_cb_t userdata_free_cb);
+/* For messages that merely ask the receiver to look at some shared
+ * state again, so that a single delivery covers any number of
+ * posts. If the message last posted with the same pending flag hasn't
+ * been taken off the queue yet this does nothing. *pending must be
+ * zero initially and stay valid until the message is dispatched,
+ * which is easiest to achieve by embedding it in object. */
+void pa_asyncmsgq_post_coalesced(pa_asyncmsgq *q, pa_atomic_t *pending, pa_msgobject *object, int code, int64_t offset);
 int pa_asyncmsgq_send(pa_asyncmsgq *q, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *memchunk);
 
 int pa_asyncmsgq_get(pa_asyncmsgq *q, pa_msgobject **object, int *code, void **userdata, int64_t *offset, pa_memchunk *memchunk, pa_bool_t wait);
@@ -80,4 +90,7 @@ void pa_asyncmsgq_write_after_poll(pa_asyncmsgq *a);
 
 pa_bool_t pa_asyncmsgq_dispatching(pa_asyncmsgq *a);
 
+/* Copies the round trip times of pa_asyncmsgq_send() seen so far */
+void pa_asyncmsgq_get_send_stats(pa_asyncmsgq *a, pa_histogram *stats);
+
 #endif
@@ -381,6 +381,15 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_b
                      (unsigned) pa_atomic_load(&mstat->n_exported),
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_atomic_load(&mstat->exported_size)));
 
+    pa_strbuf_printf(buf, "Subscription events delivered: %llu, saved by merging: %llu.\n",
+                     (unsigned long long) c->n_subscription_events_delivered,
+                     (unsigned long long) c->n_subscription_events_suppressed);
+
+    pa_strbuf_printf(buf, "Stream resamplers without state: %u, %s freed while idle, released %u times.\n",
+                     (unsigned) pa_atomic_load(&c->n_idle_resamplers),
+                     pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_atomic_load(&c->idle_resampler_size)),
+                     (unsigned) pa_atomic_load(&c->n_idle_resampler_releases));
+
     pa_strbuf_printf(buf, "Total sample cache size: %s.\n",
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_scache_total_size(c)));
 
@@ -404,6 +413,22 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_b
                          (unsigned) pa_atomic_load(&mstat->n_allocated_by_type[k]),
                          (unsigned) pa_atomic_load(&mstat->n_accumulated_by_type[k]));
 
+    for (k = 0; k < PA_MEMPOOL_SLOT_CLASSES_MAX; k++) {
+        size_t slot_size;
+        unsigned n_slots;
+
+        if (pa_mempool_get_slot_class(c->mempool, k, &slot_size, &n_slots) < 0)
+            break;
+
+        pa_strbuf_printf(buf,
+                         "Memory pool slots of size %s: %u/%u allocated/%u accumulated, exhausted %u times.\n",
+                         pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) slot_size),
+                         (unsigned) pa_atomic_load(&mstat->n_slots_allocated_by_class[k]),
+                         n_slots,
+                         (unsigned) pa_atomic_load(&mstat->n_slots_accumulated_by_class[k]),
+                         (unsigned) pa_atomic_load(&mstat->n_class_full_by_class[k]));
+    }
+
     return 0;
 }
 
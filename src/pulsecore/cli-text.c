@@ -329,6 +329,13 @@ char *pa_sink_list_to_string(pa_core *c) {
                     "\tfixed latency: %0.2f ms\n",
                     (double) pa_sink_get_fixed_latency(sink) / PA_USEC_PER_MSEC);
 
+        {
+            pa_cycle_profile profile;
+
+            pa_sink_get_cycle_profile(sink, &profile);
+            pa_cycle_profile_to_strbuf(&profile, s);
+        }
+
         if (sink->card)
             pa_strbuf_printf(s, "\tcard: %u <%s>\n", sink->card->index, sink->card->name);
         if (sink->module)
@@ -442,6 +449,13 @@ char *pa_source_list_to_string(pa_core *c) {
                     "\tfixed latency: %0.2f ms\n",
                     (double) pa_source_get_fixed_latency(source) / PA_USEC_PER_MSEC);
 
+        {
+            pa_cycle_profile profile;
+
+            pa_source_get_cycle_profile(source, &profile);
+            pa_cycle_profile_to_strbuf(&profile, s);
+        }
+
         if (source->monitor_of)
             pa_strbuf_printf(s, "\tmonitor_of: %u\n", source->monitor_of->index);
         if (source->card)
@@ -611,7 +625,7 @@ char *pa_sink_input_list_to_string(pa_core *c) {
             s,
             "    index: %u\n"
             "\tdriver: <%s>\n"
-            "\tflags: %s%s%s%s%s%s%s%s%s%s%s%s\n"
+            "\tflags: %s%s%s%s%s%s%s%s%s%s%s%s%s\n"
             "\tstate: %s\n"
             "\tsink: %u <%s>\n"
             "\tvolume: %s\n"
@@ -635,6 +649,7 @@ char *pa_sink_input_list_to_string(pa_core *c) {
             i->flags & PA_SINK_INPUT_NO_CREATE_ON_SUSPEND ? "NO_CREATE_SUSPEND " : "",
             i->flags & PA_SINK_INPUT_KILL_ON_SUSPEND ? "KILL_ON_SUSPEND " : "",
             i->flags & PA_SINK_INPUT_PASSTHROUGH ? "PASSTHROUGH " : "",
+            i->flags & PA_SINK_INPUT_PARALLEL_PEEK ? "PARALLEL_PEEK " : "",
             state_table[pa_sink_input_get_state(i)],
             i->sink->index, i->sink->name,
             volume_str,
@@ -25,8 +25,12 @@
 
 #include <stdio.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 #include <pulse/xmalloc.h>
 
+#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 
@@ -39,6 +43,27 @@
  * function is postponed to the next main loop iteration, i.e. is not
  * called from within the stack frame the entity was created in. */
 
+/* Held back events of rate limited subscriptions are flushed at most
+ * this often */
+#define FLUSH_INTERVAL_USEC (20*PA_USEC_PER_MSEC)
+
+struct pa_subscription_event {
+    pa_subscription_event_type_t type;
+    uint32_t index;
+
+    PA_LLIST_FIELDS(pa_subscription_event);
+};
+
+/* A FIFO of events with at most one event per object: a CHANGE is
+ * merged into whatever is still queued for the same object, and a
+ * NEW or REMOVE replaces it. by_object finds that event without
+ * walking the queue. */
+struct pa_subscription_queue {
+    PA_LLIST_HEAD(pa_subscription_event, events);
+    pa_subscription_event *last;
+    pa_hashmap *by_object;
+};
+
 struct pa_subscription {
     pa_core *core;
     pa_bool_t dead;
@@ -47,19 +72,120 @@ struct pa_subscription {
     void *userdata;
     pa_subscription_mask_t mask;
 
+    /* Rate limiting: each event costs PA_USEC_PER_SEC/rate of credit,
+     * which accrues in real time up to one second's worth. What
+     * doesn't fit is held back in the queue and flushed from the time
+     * event. */
+    unsigned rate;
+    pa_usec_t credit, refilled_at;
+    pa_subscription_queue *queue;
+    pa_time_event *flush_event;
+
+    uint64_t n_delivered, n_suppressed;
+
     PA_LLIST_FIELDS(pa_subscription);
 };
 
-struct pa_subscription_event {
-    pa_core *core;
+static void sched_event(pa_core *c);
 
-    pa_subscription_event_type_t type;
-    uint32_t index;
+static unsigned event_hash_func(const void *p) {
+    const pa_subscription_event *e = p;
 
-    PA_LLIST_FIELDS(pa_subscription_event);
-};
+    return e->index * (PA_SUBSCRIPTION_EVENT_FACILITY_MASK+1) + (e->type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK);
+}
 
-static void sched_event(pa_core *c);
+static int event_compare_func(const void *a, const void *b) {
+    const pa_subscription_event *x = a, *y = b;
+
+    if (x->index != y->index)
+        return x->index < y->index ? -1 : 1;
+
+    return (int) (x->type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK) - (int) (y->type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK);
+}
+
+static pa_subscription_queue *queue_new(void) {
+    pa_subscription_queue *q;
+
+    q = pa_xnew(pa_subscription_queue, 1);
+    PA_LLIST_HEAD_INIT(pa_subscription_event, q->events);
+    q->last = NULL;
+    q->by_object = pa_hashmap_new(event_hash_func, event_compare_func);
+
+    return q;
+}
+
+static void queue_remove(pa_subscription_queue *q, pa_subscription_event *e) {
+    pa_assert(q);
+    pa_assert(e);
+
+    if (!e->next)
+        q->last = e->prev;
+
+    PA_LLIST_REMOVE(pa_subscription_event, q->events, e);
+    pa_assert_se(pa_hashmap_remove(q->by_object, e) == e);
+    pa_xfree(e);
+}
+
+static void queue_free(pa_subscription_queue *q) {
+    pa_assert(q);
+
+    while (q->events)
+        queue_remove(q, q->events);
+
+    pa_hashmap_free(q->by_object, NULL, NULL);
+    pa_xfree(q);
+}
+
+/* Returns how many events were saved by merging */
+static unsigned queue_push(pa_subscription_queue *q, pa_subscription_event_type_t t, uint32_t idx) {
+    pa_subscription_event *e, key;
+    unsigned saved = 0;
+
+    pa_assert(q);
+
+    key.type = t;
+    key.index = idx;
+
+    if ((e = pa_hashmap_get(q->by_object, &key))) {
+
+        /* This object has changed, or is gone for the second time. The
+         * "new", "change" or "remove" event that is still in the queue
+         * says it all already. */
+        if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_CHANGE ||
+            (t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == (e->type & PA_SUBSCRIPTION_EVENT_TYPE_MASK))
+            return 1;
+
+        /* This object is being removed (or, oddly, created anew), hence
+         * there is no point in keeping the old event regarding this
+         * entry in the queue. */
+        queue_remove(q, e);
+        saved = 1;
+    }
+
+    e = pa_xnew(pa_subscription_event, 1);
+    e->type = t;
+    e->index = idx;
+
+    PA_LLIST_INSERT_AFTER(pa_subscription_event, q->events, q->last, e);
+    q->last = e;
+    pa_assert_se(pa_hashmap_put(q->by_object, e, e) == 0);
+
+    return saved;
+}
+
+static pa_bool_t queue_pop(pa_subscription_queue *q, pa_subscription_event_type_t *t, uint32_t *idx) {
+    pa_assert(t);
+    pa_assert(idx);
+
+    if (!q || !q->events)
+        return FALSE;
+
+    *t = q->events->type;
+    *idx = q->events->index;
+    queue_remove(q, q->events);
+
+    return TRUE;
+}
 
 /* Allocate a new subscription object for the given subscription mask. Use the specified callback function and user data */
 pa_subscription* pa_subscription_new(pa_core *c, pa_subscription_mask_t m, pa_subscription_cb_t callback, void *userdata) {
@@ -69,7 +195,7 @@ pa_subscription* pa_subscription_new(pa_core *c, pa_subscription_mask_t m, pa_su
     pa_assert(m);
     pa_assert(callback);
 
-    s = pa_xnew(pa_subscription, 1);
+    s = pa_xnew0(pa_subscription, 1);
     s->core = c;
     s->dead = FALSE;
     s->callback = callback;
@@ -93,39 +219,48 @@ static void free_subscription(pa_subscription *s) {
     pa_assert(s);
     pa_assert(s->core);
 
+    if (s->flush_event)
+        s->core->mainloop->time_free(s->flush_event);
+
+    if (s->queue)
+        queue_free(s->queue);
+
     PA_LLIST_REMOVE(pa_subscription, s->core->subscriptions, s);
     pa_xfree(s);
 }
 
-static void free_event(pa_subscription_event *s) {
-    pa_assert(s);
-    pa_assert(s->core);
-
-    if (!s->next)
-        s->core->subscription_event_last = s->prev;
-
-    PA_LLIST_REMOVE(pa_subscription_event, s->core->subscription_event_queue, s);
-    pa_xfree(s);
+static void free_generation(void *p, void *userdata) {
+    pa_xfree(p);
 }
 
 /* Free all subscription objects */
 void pa_subscription_free_all(pa_core *c) {
+    unsigned i;
+
     pa_assert(c);
 
     while (c->subscriptions)
         free_subscription(c->subscriptions);
 
-    while (c->subscription_event_queue)
-        free_event(c->subscription_event_queue);
+    if (c->subscription_queue) {
+        queue_free(c->subscription_queue);
+        c->subscription_queue = NULL;
+    }
 
     if (c->subscription_defer_event) {
         c->mainloop->defer_free(c->subscription_defer_event);
         c->subscription_defer_event = NULL;
     }
+
+    for (i = 0; i < PA_ELEMENTSOF(c->generations); i++)
+        if (c->generations[i]) {
+            pa_hashmap_free(c->generations[i], free_generation, NULL);
+            c->generations[i] = NULL;
+        }
 }
 
 #ifdef DEBUG
-static void dump_event(const char * prefix, pa_subscription_event*e) {
+static void dump_event(const char * prefix, pa_subscription_event_type_t t, uint32_t idx) {
     const char * const fac_table[] = {
         [PA_SUBSCRIPTION_EVENT_SINK] = "SINK",
         [PA_SUBSCRIPTION_EVENT_SOURCE] = "SOURCE",
@@ -146,16 +281,118 @@ static void dump_event(const char * prefix, pa_subscription_event*e) {
 
     pa_log_debug("%s event (%s|%s|%u)",
            prefix,
-           fac_table[e->type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK],
-           type_table[e->type & PA_SUBSCRIPTION_EVENT_TYPE_MASK],
-           e->index);
+           fac_table[t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK],
+           type_table[t & PA_SUBSCRIPTION_EVENT_TYPE_MASK],
+           idx);
 }
 #endif
 
+static pa_bool_t take_credit(pa_subscription *s) {
+    pa_usec_t now, cost;
+
+    pa_assert(s->rate > 0);
+
+    now = pa_rtclock_now();
+    cost = PA_USEC_PER_SEC / s->rate;
+
+    s->credit = PA_MIN(s->credit + (now - s->refilled_at), PA_USEC_PER_SEC);
+    s->refilled_at = now;
+
+    if (s->credit < cost)
+        return FALSE;
+
+    s->credit -= cost;
+    return TRUE;
+}
+
+static pa_usec_t next_flush(pa_subscription *s) {
+    pa_usec_t cost;
+
+    cost = PA_USEC_PER_SEC / s->rate;
+
+    return s->refilled_at + PA_MAX(cost > s->credit ? cost - s->credit : 0, FLUSH_INTERVAL_USEC);
+}
+
+static void emit(pa_subscription *s, pa_subscription_event_type_t t, uint32_t idx) {
+    s->n_delivered++;
+    s->core->n_subscription_events_delivered++;
+
+    s->callback(s->core, t, idx, s->userdata);
+}
+
+static void flush_cb(pa_mainloop_api *m, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    pa_subscription *s = userdata;
+    pa_subscription_event_type_t t;
+    uint32_t idx;
+
+    pa_assert(s);
+    pa_assert(s->flush_event == e);
+
+    while (!s->dead && s->queue->events && (s->rate == 0 || take_credit(s))) {
+        pa_assert_se(queue_pop(s->queue, &t, &idx));
+        emit(s, t, idx);
+    }
+
+    pa_core_rttime_restart(s->core, e, !s->dead && s->queue->events ? next_flush(s) : PA_USEC_INVALID);
+}
+
+/* Hand an event to a subscriber, or hold it back if the subscriber is
+ * over its rate limit */
+static void deliver(pa_subscription *s, pa_subscription_event_type_t t, uint32_t idx) {
+    unsigned saved;
+
+    pa_assert(s);
+
+    /* Once something is held back, everything is, to keep the order */
+    if (s->rate == 0 || (!(s->queue && s->queue->events) && take_credit(s))) {
+        emit(s, t, idx);
+        return;
+    }
+
+    if (!s->queue)
+        s->queue = queue_new();
+
+    if (!s->queue->events) {
+        if (s->flush_event)
+            pa_core_rttime_restart(s->core, s->flush_event, next_flush(s));
+        else
+            s->flush_event = pa_core_rttime_new(s->core, next_flush(s), flush_cb, s);
+    }
+
+    saved = queue_push(s->queue, t, idx);
+    s->n_suppressed += saved;
+    s->core->n_subscription_events_suppressed += saved;
+}
+
+void pa_subscription_set_rate_limit(pa_subscription *s, unsigned rate) {
+    pa_assert(s);
+    pa_assert(!s->dead);
+
+    s->rate = rate;
+    s->credit = PA_USEC_PER_SEC;
+    s->refilled_at = pa_rtclock_now();
+
+    /* Let go of what was held back under the old limit right away */
+    if (s->queue && s->queue->events)
+        pa_core_rttime_restart(s->core, s->flush_event, 0);
+}
+
+void pa_subscription_get_stats(pa_subscription *s, uint64_t *delivered, uint64_t *suppressed) {
+    pa_assert(s);
+
+    if (delivered)
+        *delivered = s->n_delivered;
+
+    if (suppressed)
+        *suppressed = s->n_suppressed;
+}
+
 /* Deferred callback for dispatching subscription events */
 static void defer_cb(pa_mainloop_api *m, pa_defer_event *de, void *userdata) {
     pa_core *c = userdata;
     pa_subscription *s;
+    pa_subscription_event_type_t t;
+    uint32_t idx;
 
     pa_assert(c->mainloop == m);
     pa_assert(c);
@@ -165,19 +402,17 @@ static void defer_cb(pa_mainloop_api *m, pa_defer_event *de, void *userdata) {
 
     /* Dispatch queued events */
 
-    while (c->subscription_event_queue) {
-        pa_subscription_event *e = c->subscription_event_queue;
+    while (queue_pop(c->subscription_queue, &t, &idx)) {
 
         for (s = c->subscriptions; s; s = s->next) {
 
-            if (!s->dead && pa_subscription_match_flags(s->mask, e->type))
-                s->callback(c, e->type, e->index, s->userdata);
+            if (!s->dead && pa_subscription_match_flags(s->mask, t))
+                deliver(s, t, idx);
         }
 
 #ifdef DEBUG
-        dump_event("Dispatched", e);
+        dump_event("Dispatched", t, idx);
 #endif
-        free_event(e);
     }
 
     /* Remove dead subscriptions */
@@ -203,60 +438,67 @@ static void sched_event(pa_core *c) {
     c->mainloop->defer_enable(c->subscription_defer_event, 1);
 }
 
-/* Append a new subscription event to the subscription event queue and schedule a main loop event */
-void pa_subscription_post(pa_core *c, pa_subscription_event_type_t t, uint32_t idx) {
-    pa_subscription_event *e;
-    pa_assert(c);
+static void update_generation(pa_core *c, pa_subscription_event_type_t t, uint32_t idx) {
+    pa_hashmap **h;
+    uint64_t *g;
 
-    /* No need for queuing subscriptions of no one is listening */
-    if (!c->subscriptions)
+    h = &c->generations[t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK];
+    c->generation++;
+
+    if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
+        c->removed_generations[t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK] = c->generation;
+
+        if (*h)
+            pa_xfree(pa_hashmap_remove(*h, PA_UINT32_TO_PTR(idx)));
         return;
+    }
 
-    if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) != PA_SUBSCRIPTION_EVENT_NEW) {
-        pa_subscription_event *i, *n;
+    if (!*h)
+        *h = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
 
-        /* Check for duplicates */
-        for (i = c->subscription_event_last; i; i = n) {
-            n = i->prev;
+    if (!(g = pa_hashmap_get(*h, PA_UINT32_TO_PTR(idx)))) {
+        g = pa_xnew(uint64_t, 1);
+        pa_hashmap_put(*h, PA_UINT32_TO_PTR(idx), g);
+    }
 
-            /* not the same object type */
-            if (((t ^ i->type) & PA_SUBSCRIPTION_EVENT_FACILITY_MASK))
-                continue;
+    *g = c->generation;
+}
 
-            /* not the same object */
-            if (i->index != idx)
-                continue;
+uint64_t pa_subscription_get_generation(pa_core *c, pa_subscription_event_type_t facility, uint32_t idx) {
+    pa_hashmap *h;
+    uint64_t *g;
 
-            if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
-                /* This object is being removed, hence there is no
-                 * point in keeping the old events regarding this
-                 * entry in the queue. */
+    pa_assert(c);
 
-                free_event(i);
-                pa_log_debug("Dropped redundant event due to remove event.");
-                continue;
-            }
+    if (!(h = c->generations[facility & PA_SUBSCRIPTION_EVENT_FACILITY_MASK]))
+        return 0;
 
-            if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_CHANGE) {
-                /* This object has changed. If a "new" or "change" event for
-                 * this object is still in the queue we can exit. */
+    if (!(g = pa_hashmap_get(h, PA_UINT32_TO_PTR(idx))))
+        return 0;
 
-                pa_log_debug("Dropped redundant event due to change event.");
-                return;
-            }
-        }
-    }
+    return *g;
+}
 
-    e = pa_xnew(pa_subscription_event, 1);
-    e->core = c;
-    e->type = t;
-    e->index = idx;
+/* Append a new subscription event to the subscription event queue and schedule a main loop event */
+void pa_subscription_post(pa_core *c, pa_subscription_event_type_t t, uint32_t idx) {
+    pa_assert(c);
+
+    /* Keep track of what changed when even if no one is listening, so
+     * that clients polling the info lists can skip what they have
+     * already seen */
+    update_generation(c, t, idx);
+
+    /* No need for queuing subscriptions of no one is listening */
+    if (!c->subscriptions)
+        return;
+
+    if (!c->subscription_queue)
+        c->subscription_queue = queue_new();
 
-    PA_LLIST_INSERT_AFTER(pa_subscription_event, c->subscription_event_queue, c->subscription_event_last, e);
-    c->subscription_event_last = e;
+    c->n_subscription_events_suppressed += queue_push(c->subscription_queue, t, idx);
 
 #ifdef DEBUG
-    dump_event("Queued", e);
+    dump_event("Queued", t, idx);
 #endif
 
     sched_event(c);
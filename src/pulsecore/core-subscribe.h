@@ -24,6 +24,7 @@
 
 typedef struct pa_subscription pa_subscription;
 typedef struct pa_subscription_event pa_subscription_event;
+typedef struct pa_subscription_queue pa_subscription_queue;
 
 #include <pulsecore/core.h>
 #include <pulsecore/native-common.h>
@@ -34,6 +35,19 @@ pa_subscription* pa_subscription_new(pa_core *c, pa_subscription_mask_t m,  pa_s
 void pa_subscription_free(pa_subscription*s);
 void pa_subscription_free_all(pa_core *c);
 
+/* Deliver at most rate events per second to this subscription, 0 for
+ * no limit. Events beyond that are held back and merged per object
+ * until the subscription may receive them. */
+void pa_subscription_set_rate_limit(pa_subscription *s, unsigned rate);
+
+/* How many events were delivered to this subscription, and how many
+ * were saved by merging them */
+void pa_subscription_get_stats(pa_subscription *s, uint64_t *delivered, uint64_t *suppressed);
+
 void pa_subscription_post(pa_core *c, pa_subscription_event_type_t t, uint32_t idx);
 
+/* The core generation at the last event posted for the object, 0 if
+ * there never was one */
+uint64_t pa_subscription_get_generation(pa_core *c, pa_subscription_event_type_t facility, uint32_t idx);
+
 #endif
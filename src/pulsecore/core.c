@@ -121,8 +121,11 @@ pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
 
     c->subscription_defer_event = NULL;
     PA_LLIST_HEAD_INIT(pa_subscription, c->subscriptions);
-    PA_LLIST_HEAD_INIT(pa_subscription_event, c->subscription_event_queue);
-    c->subscription_event_last = NULL;
+    c->subscription_queue = NULL;
+    c->n_subscription_events_delivered = c->n_subscription_events_suppressed = 0;
+    c->generation = 0;
+    pa_zero(c->generations);
+    pa_zero(c->removed_generations);
 
     c->mempool = pool;
     pa_silence_cache_init(&c->silence_cache);
@@ -132,12 +135,18 @@ pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
     c->exit_idle_time = -1;
     c->scache_idle_time = 20;
 
+    c->resampler_idle_time = 10;
+    pa_atomic_store(&c->n_idle_resamplers, 0);
+    pa_atomic_store(&c->idle_resampler_size, 0);
+    pa_atomic_store(&c->n_idle_resampler_releases, 0);
+
     c->flat_volumes = TRUE;
     c->disallow_module_loading = FALSE;
     c->disallow_exit = FALSE;
     c->running_as_daemon = FALSE;
     c->realtime_scheduling = FALSE;
     c->realtime_priority = 5;
+    c->render_threads = 0;
     c->disable_remixing = FALSE;
     c->disable_lfe_remixing = FALSE;
     c->deferred_volume = TRUE;
@@ -153,8 +153,19 @@ struct pa_core {
 
     pa_defer_event *subscription_defer_event;
     PA_LLIST_HEAD(pa_subscription, subscriptions);
-    PA_LLIST_HEAD(pa_subscription_event, subscription_event_queue);
-    pa_subscription_event *subscription_event_last;
+    pa_subscription_queue *subscription_queue;
+
+    /* Subscription events handed to subscribers, and how many were
+     * saved by merging events for the same object */
+    uint64_t n_subscription_events_delivered, n_subscription_events_suppressed;
+
+    /* Bumped for every subscription event. Per facility, the
+     * generation of the last event of each object, so that clients
+     * can ask for what changed since they last looked, and the
+     * generation at which the last object was removed. */
+    uint64_t generation;
+    pa_hashmap *generations[PA_SUBSCRIPTION_EVENT_FACILITY_MASK+1];
+    uint64_t removed_generations[PA_SUBSCRIPTION_EVENT_FACILITY_MASK+1];
 
     pa_mempool *mempool;
     pa_silence_cache silence_cache;
@@ -164,6 +175,16 @@ struct pa_core {
 
     int exit_idle_time, scache_idle_time;
 
+    /* Seconds of silence after which a sink input frees the state of
+     * its resampler, negative to keep it */
+    int resampler_idle_time;
+
+    /* Sink input resamplers that currently have no buffers, because
+     * they haven't been used yet or were idle, how much memory that
+     * freed, and how often idle resamplers were released. Updated
+     * from the IO threads. */
+    pa_atomic_t n_idle_resamplers, idle_resampler_size, n_idle_resampler_releases;
+
     pa_bool_t flat_volumes:1;
     pa_bool_t disallow_module_loading:1;
     pa_bool_t disallow_exit:1;
@@ -176,6 +197,10 @@ struct pa_core {
     pa_resample_method_t resample_method;
     int realtime_priority;
 
+    /* Workers per sink to peek sink inputs in parallel, 0 to render
+     * on the IO thread only */
+    unsigned render_threads;
+
     pa_server_type_t server_type;
     pa_cpu_info cpu_info;
 
@@ -79,6 +79,19 @@ static char *get_cpuinfo(void) {
 }
 #endif /* defined (__arm__) && defined (__linux__) */
 
+#if (defined (__arm__) && defined (__linux__)) || defined (__aarch64__)
+static void init_neon_funcs(pa_cpu_arm_flag_t flags) {
+#ifdef HAVE_NEON_INTRINSICS
+    if (flags & PA_CPU_ARM_NEON) {
+        pa_convert_func_init_neon(flags);
+        pa_remap_func_init_neon(flags);
+        pa_mix_func_init_neon(flags);
+        pa_sinc_func_init_neon(flags);
+    }
+#endif
+}
+#endif /* (defined (__arm__) && defined (__linux__)) || defined (__aarch64__) */
+
 pa_bool_t pa_cpu_init_arm(pa_cpu_arm_flag_t *flags) {
 #if defined (__arm__)
 #if defined (__linux__)
@@ -135,12 +148,25 @@ pa_bool_t pa_cpu_init_arm(pa_cpu_arm_flag_t *flags) {
     if (*flags & PA_CPU_ARM_V6)
         pa_volume_func_init_arm(*flags);
 
+    init_neon_funcs(*flags);
+
     return TRUE;
 
 #else /* defined (__linux__) */
     pa_log("Reading ARM CPU features not yet supported on this OS");
 #endif /* defined (__linux__) */
 
+#elif defined (__aarch64__)
+    /* NEON is part of the base instruction set here, the other flags
+     * only matter for the 32 bit code */
+    *flags = PA_CPU_ARM_NEON;
+
+    pa_log_info("CPU flags: NEON");
+
+    init_neon_funcs(*flags);
+
+    return TRUE;
+
 #else /* defined (__arm__) */
     return FALSE;
 #endif /* defined (__arm__) */
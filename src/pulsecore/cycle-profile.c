@@ -0,0 +1,129 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/rtclock.h>
+
+#include <pulsecore/macro.h>
+
+#include "cycle-profile.h"
+
+static const char* const stage_names[PA_CYCLE_STAGE_MAX] = {
+    [PA_CYCLE_STAGE_RENDER] = "render",
+    [PA_CYCLE_STAGE_REWIND] = "rewind",
+    [PA_CYCLE_STAGE_IO] = "io"
+};
+
+void pa_cycle_profile_init(pa_cycle_profile *p) {
+    pa_assert(p);
+
+    pa_zero(*p);
+}
+
+void pa_cycle_profile_begin(pa_cycle_profile *p) {
+    pa_assert(p);
+    pa_assert(p->depth < PA_CYCLE_PROFILE_DEPTH);
+
+    p->stack[p->depth].start = pa_rtclock_now();
+    p->stack[p->depth].nested = 0;
+    p->depth++;
+}
+
+void pa_cycle_profile_end(pa_cycle_profile *p, pa_cycle_stage_t stage) {
+    pa_usec_t d;
+
+    pa_assert(p);
+    pa_assert(stage < PA_CYCLE_STAGE_MAX);
+    pa_assert(p->depth > 0);
+
+    p->depth--;
+    d = pa_rtclock_now() - p->stack[p->depth].start;
+
+    p->spent[stage] += d - PA_MIN(d, p->stack[p->depth].nested);
+
+    if (p->depth > 0)
+        p->stack[p->depth - 1].nested += d;
+}
+
+void pa_cycle_profile_next(pa_cycle_profile *p) {
+    pa_usec_t now, busy = 0;
+    unsigned i;
+
+    pa_assert(p);
+    pa_assert(p->depth == 0);
+
+    now = pa_rtclock_now();
+
+    /* The first cycle starts here */
+    if (p->cycle_start > 0) {
+        for (i = 0; i < PA_CYCLE_STAGE_MAX; i++) {
+            pa_histogram_add(&p->stage[i], p->spent[i]);
+            busy += p->spent[i];
+        }
+
+        if (now > p->cycle_start)
+            pa_histogram_add(&p->duty, PA_MIN(busy * 1000 / (now - p->cycle_start), (pa_usec_t) 1000));
+    }
+
+    p->cycle_start = now;
+    memset(p->spent, 0, sizeof(p->spent));
+}
+
+void pa_cycle_profile_copy(pa_cycle_profile *dst, const pa_cycle_profile *src) {
+    pa_assert(dst);
+    pa_assert(src);
+
+    pa_cycle_profile_init(dst);
+    memcpy(dst->stage, src->stage, sizeof(dst->stage));
+    dst->duty = src->duty;
+}
+
+const char *pa_cycle_stage_to_string(pa_cycle_stage_t stage) {
+    pa_assert(stage < PA_CYCLE_STAGE_MAX);
+
+    return stage_names[stage];
+}
+
+void pa_cycle_profile_to_strbuf(const pa_cycle_profile *p, pa_strbuf *buf) {
+    unsigned i;
+
+    pa_assert(p);
+    pa_assert(buf);
+
+    if (p->duty.count <= 0)
+        return;
+
+    pa_strbuf_printf(buf, "\tcycles: %llu, busy median %0.1f%%, 99%% %0.1f%%, max %0.1f%%\n",
+                     (unsigned long long) p->duty.count,
+                     (double) pa_histogram_percentile(&p->duty, 50) / 10,
+                     (double) pa_histogram_percentile(&p->duty, 99) / 10,
+                     (double) p->duty.max / 10);
+
+    for (i = 0; i < PA_CYCLE_STAGE_MAX; i++)
+        pa_strbuf_printf(buf, "\tcycle %s: median %llu usec, 99%% %llu usec, max %llu usec\n",
+                         stage_names[i],
+                         (unsigned long long) pa_histogram_percentile(&p->stage[i], 50),
+                         (unsigned long long) pa_histogram_percentile(&p->stage[i], 99),
+                         (unsigned long long) p->stage[i].max);
+}
@@ -0,0 +1,81 @@
+#ifndef foopulsecycleprofilehfoo
+#define foopulsecycleprofilehfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+
+#include <pulsecore/histogram.h>
+#include <pulsecore/strbuf.h>
+
+/* Where the IO thread of a sink or source spends its time. Each
+ * iteration of the IO loop is one cycle; the time spent in each stage
+ * during a cycle goes into the histogram of that stage, and the share
+ * of the cycle spent in any stage into the duty histogram. Stages may
+ * nest, e.g. rendering happens from within the device write, in which
+ * case the outer stage is only charged for what the inner one didn't
+ * use. Only to be touched from the IO thread. */
+
+typedef enum pa_cycle_stage {
+    PA_CYCLE_STAGE_RENDER,  /* pa_sink_render*(), pa_source_post*() */
+    PA_CYCLE_STAGE_REWIND,  /* pa_sink_process_rewind(), pa_source_process_rewind() */
+    PA_CYCLE_STAGE_IO,      /* Reading from or writing to the device */
+    PA_CYCLE_STAGE_MAX
+} pa_cycle_stage_t;
+
+#define PA_CYCLE_PROFILE_DEPTH 4
+
+typedef struct pa_cycle_profile {
+    pa_histogram stage[PA_CYCLE_STAGE_MAX];
+
+    /* In permille of the cycle length */
+    pa_histogram duty;
+
+    /* The current cycle */
+    pa_usec_t cycle_start;
+    pa_usec_t spent[PA_CYCLE_STAGE_MAX];
+
+    unsigned depth;
+    struct {
+        pa_usec_t start;
+        pa_usec_t nested;
+    } stack[PA_CYCLE_PROFILE_DEPTH];
+} pa_cycle_profile;
+
+void pa_cycle_profile_init(pa_cycle_profile *p);
+
+/* Brackets the given stage */
+void pa_cycle_profile_begin(pa_cycle_profile *p);
+void pa_cycle_profile_end(pa_cycle_profile *p, pa_cycle_stage_t stage);
+
+/* Closes the current cycle and opens the next one. To be called once
+ * per IO loop iteration, right after waking up. */
+void pa_cycle_profile_next(pa_cycle_profile *p);
+
+/* Copies the histograms, without the state of the current cycle */
+void pa_cycle_profile_copy(pa_cycle_profile *dst, const pa_cycle_profile *src);
+
+const char *pa_cycle_stage_to_string(pa_cycle_stage_t stage);
+
+/* Appends one tab indented line per stage plus one for the duty
+ * cycle. Appends nothing if no cycle has been completed yet. */
+void pa_cycle_profile_to_strbuf(const pa_cycle_profile *p, pa_strbuf *buf);
+
+#endif
@@ -182,6 +182,13 @@ static void flush(pa_fdsem *f) {
 void pa_fdsem_post(pa_fdsem *f) {
     pa_assert(f);
 
+    /* Still signalled from an earlier post, which the other side
+     * hasn't consumed yet. Checking that with a plain load first
+     * keeps writers posting in a burst from fighting over the cache
+     * line. */
+    if (pa_atomic_load(&f->data->signalled))
+        return;
+
     if (pa_atomic_cmpxchg(&f->data->signalled, 0, 1)) {
 
         if (pa_atomic_load(&f->data->waiting)) {
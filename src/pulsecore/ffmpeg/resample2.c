@@ -68,6 +68,7 @@ typedef struct AVResampleContext{
     int phase_shift;
     int phase_mask;
     int linear;
+    int shared_filter_bank;
 }AVResampleContext;
 
 /**
@@ -175,20 +176,39 @@ void av_build_filter(FELEM *filter, double factor, int tap_count, int phase_coun
 #endif
 }
 
-AVResampleContext *av_resample_init(int out_rate, int in_rate, int filter_size, int phase_shift, int linear, double cutoff){
-    AVResampleContext *c= av_mallocz(sizeof(AVResampleContext));
+static int filter_length(int out_rate, int in_rate, int filter_size, double cutoff){
+    double factor= FFMIN(out_rate * cutoff / in_rate, 1.0);
+
+    return FFMAX((int)ceil(filter_size/factor), 1);
+}
+
+/* PulseAudio: the filter bank only depends on the parameters, so it
+ * can be built once and shared by several contexts */
+int av_resample_filter_bank_size(int out_rate, int in_rate, int filter_size, int phase_shift, double cutoff){
+    return filter_length(out_rate, in_rate, filter_size, cutoff)*((1<<phase_shift)+1)*sizeof(FELEM);
+}
+
+void av_resample_build_filter_bank(FELEM *filter_bank, int out_rate, int in_rate, int filter_size, int phase_shift, double cutoff){
     double factor= FFMIN(out_rate * cutoff / in_rate, 1.0);
     int phase_count= 1<<phase_shift;
+    int length= filter_length(out_rate, in_rate, filter_size, cutoff);
+
+    av_build_filter(filter_bank, factor, length, phase_count, 1<<FILTER_SHIFT, WINDOW_TYPE);
+    memcpy(&filter_bank[length*phase_count+1], filter_bank, (length-1)*sizeof(FELEM));
+    filter_bank[length*phase_count]= filter_bank[length - 1];
+}
+
+AVResampleContext *av_resample_init_shared(int out_rate, int in_rate, int filter_size, int phase_shift, int linear, double cutoff, FELEM *filter_bank){
+    AVResampleContext *c= av_mallocz(sizeof(AVResampleContext));
+    int phase_count= 1<<phase_shift;
 
     c->phase_shift= phase_shift;
     c->phase_mask= phase_count-1;
     c->linear= linear;
 
-    c->filter_length= FFMAX((int)ceil(filter_size/factor), 1);
-    c->filter_bank= av_mallocz(c->filter_length*(phase_count+1)*sizeof(FELEM));
-    av_build_filter(c->filter_bank, factor, c->filter_length, phase_count, 1<<FILTER_SHIFT, WINDOW_TYPE);
-    memcpy(&c->filter_bank[c->filter_length*phase_count+1], c->filter_bank, (c->filter_length-1)*sizeof(FELEM));
-    c->filter_bank[c->filter_length*phase_count]= c->filter_bank[c->filter_length - 1];
+    c->filter_length= filter_length(out_rate, in_rate, filter_size, cutoff);
+    c->filter_bank= filter_bank;
+    c->shared_filter_bank= 1;
 
     c->src_incr= out_rate;
     c->ideal_dst_incr= c->dst_incr= in_rate * phase_count;
@@ -197,8 +217,30 @@ AVResampleContext *av_resample_init(int out_rate, int in_rate, int filter_size,
     return c;
 }
 
+void av_resample_reset(AVResampleContext *c){
+    int phase_count= 1<<c->phase_shift;
+
+    c->dst_incr= c->ideal_dst_incr;
+    c->compensation_distance= 0;
+    c->frac= 0;
+    c->index= -phase_count*((c->filter_length-1)/2);
+}
+
+AVResampleContext *av_resample_init(int out_rate, int in_rate, int filter_size, int phase_shift, int linear, double cutoff){
+    FELEM *filter_bank= av_mallocz(av_resample_filter_bank_size(out_rate, in_rate, filter_size, phase_shift, cutoff));
+    AVResampleContext *c;
+
+    av_resample_build_filter_bank(filter_bank, out_rate, in_rate, filter_size, phase_shift, cutoff);
+
+    c= av_resample_init_shared(out_rate, in_rate, filter_size, phase_shift, linear, cutoff, filter_bank);
+    c->shared_filter_bank= 0;
+
+    return c;
+}
+
 void av_resample_close(AVResampleContext *c){
-    av_freep(&c->filter_bank);
+    if(!c->shared_filter_bank)
+        av_freep(&c->filter_bank);
     av_freep(&c);
 }
 
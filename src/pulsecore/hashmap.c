@@ -32,11 +32,20 @@
 
 #include "hashmap.h"
 
-#define NBUCKETS 127
+/* The bucket array starts small and is doubled whenever there are more
+ * entries than buckets, and halved again when less than an eighth of
+ * the buckets are used. */
+#define MIN_BUCKETS_SHIFT 5
+
+/* Multiplicative hashing: keeps the top bits of the product, so that
+ * aligned pointers and other hashes with poor low bits spread evenly
+ * over a power of two sized table. */
+#define BUCKET(h, hash) ((unsigned) (((uint32_t) (hash) * 0x9E3779B1U) >> (32 - (h)->buckets_shift)))
 
 struct hashmap_entry {
     const void *key;
     void *value;
+    unsigned hash;
 
     struct hashmap_entry *bucket_next, *bucket_previous;
     struct hashmap_entry *iterate_next, *iterate_previous;
@@ -46,18 +55,22 @@ struct pa_hashmap {
     pa_hash_func_t hash_func;
     pa_compare_func_t compare_func;
 
+    struct hashmap_entry **buckets;
+    unsigned buckets_shift;
+
     struct hashmap_entry *iterate_list_head, *iterate_list_tail;
     unsigned n_entries;
 };
 
-#define BY_HASH(h) ((struct hashmap_entry**) ((uint8_t*) (h) + PA_ALIGN(sizeof(pa_hashmap))))
-
 PA_STATIC_FLIST_DECLARE(entries, 0, pa_xfree);
 
 pa_hashmap *pa_hashmap_new(pa_hash_func_t hash_func, pa_compare_func_t compare_func) {
     pa_hashmap *h;
 
-    h = pa_xmalloc0(PA_ALIGN(sizeof(pa_hashmap)) + NBUCKETS*sizeof(struct hashmap_entry*));
+    h = pa_xnew0(pa_hashmap, 1);
+
+    h->buckets_shift = MIN_BUCKETS_SHIFT;
+    h->buckets = pa_xnew0(struct hashmap_entry*, 1U << h->buckets_shift);
 
     h->hash_func = hash_func ? hash_func : pa_idxset_trivial_hash_func;
     h->compare_func = compare_func ? compare_func : pa_idxset_trivial_compare_func;
@@ -68,6 +81,42 @@ pa_hashmap *pa_hashmap_new(pa_hash_func_t hash_func, pa_compare_func_t compare_f
     return h;
 }
 
+static void bucket_insert(pa_hashmap *h, struct hashmap_entry *e) {
+    struct hashmap_entry **b;
+
+    b = h->buckets + BUCKET(h, e->hash);
+
+    e->bucket_next = *b;
+    e->bucket_previous = NULL;
+    if (*b)
+        (*b)->bucket_previous = e;
+    *b = e;
+}
+
+static void resize(pa_hashmap *h, unsigned buckets_shift) {
+    struct hashmap_entry *e;
+
+    pa_assert(h);
+    pa_assert(buckets_shift >= MIN_BUCKETS_SHIFT);
+    pa_assert(buckets_shift < 32);
+
+    pa_xfree(h->buckets);
+
+    h->buckets_shift = buckets_shift;
+    h->buckets = pa_xnew0(struct hashmap_entry*, 1U << h->buckets_shift);
+
+    /* The iteration list is not touched, so the order stays the same */
+    for (e = h->iterate_list_head; e; e = e->iterate_next)
+        bucket_insert(h, e);
+}
+
+static void maybe_shrink(pa_hashmap *h) {
+    pa_assert(h);
+
+    if (h->buckets_shift > MIN_BUCKETS_SHIFT && h->n_entries < (1U << h->buckets_shift) / 8)
+        resize(h, h->buckets_shift - 1);
+}
+
 static void remove_entry(pa_hashmap *h, struct hashmap_entry *e) {
     pa_assert(h);
     pa_assert(e);
@@ -89,10 +138,8 @@ static void remove_entry(pa_hashmap *h, struct hashmap_entry *e) {
 
     if (e->bucket_previous)
         e->bucket_previous->bucket_next = e->bucket_next;
-    else {
-        unsigned hash = h->hash_func(e->key) % NBUCKETS;
-        BY_HASH(h)[hash] = e->bucket_next;
-    }
+    else
+        h->buckets[BUCKET(h, e->hash)] = e->bucket_next;
 
     if (pa_flist_push(PA_STATIC_FLIST_GET(entries), e) < 0)
         pa_xfree(e);
@@ -113,16 +160,16 @@ void pa_hashmap_free(pa_hashmap*h, pa_free2_cb_t free_cb, void *userdata) {
             free_cb(data, userdata);
     }
 
+    pa_xfree(h->buckets);
     pa_xfree(h);
 }
 
 static struct hashmap_entry *hash_scan(pa_hashmap *h, unsigned hash, const void *key) {
     struct hashmap_entry *e;
     pa_assert(h);
-    pa_assert(hash < NBUCKETS);
 
-    for (e = BY_HASH(h)[hash]; e; e = e->bucket_next)
-        if (h->compare_func(e->key, key) == 0)
+    for (e = h->buckets[BUCKET(h, hash)]; e; e = e->bucket_next)
+        if (e->hash == hash && h->compare_func(e->key, key) == 0)
             return e;
 
     return NULL;
@@ -134,7 +181,7 @@ int pa_hashmap_put(pa_hashmap *h, const void *key, void *value) {
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
+    hash = h->hash_func(key);
 
     if (hash_scan(h, hash, key))
         return -1;
@@ -144,13 +191,10 @@ int pa_hashmap_put(pa_hashmap *h, const void *key, void *value) {
 
     e->key = key;
     e->value = value;
+    e->hash = hash;
 
     /* Insert into hash table */
-    e->bucket_next = BY_HASH(h)[hash];
-    e->bucket_previous = NULL;
-    if (BY_HASH(h)[hash])
-        BY_HASH(h)[hash]->bucket_previous = e;
-    BY_HASH(h)[hash] = e;
+    bucket_insert(h, e);
 
     /* Insert into iteration list */
     e->iterate_previous = h->iterate_list_tail;
@@ -167,6 +211,9 @@ int pa_hashmap_put(pa_hashmap *h, const void *key, void *value) {
     h->n_entries++;
     pa_assert(h->n_entries >= 1);
 
+    if (h->n_entries > (1U << h->buckets_shift) && h->buckets_shift < 31)
+        resize(h, h->buckets_shift + 1);
+
     return 0;
 }
 
@@ -176,7 +223,7 @@ void* pa_hashmap_get(pa_hashmap *h, const void *key) {
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
+    hash = h->hash_func(key);
 
     if (!(e = hash_scan(h, hash, key)))
         return NULL;
@@ -191,13 +238,14 @@ void* pa_hashmap_remove(pa_hashmap *h, const void *key) {
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
+    hash = h->hash_func(key);
 
     if (!(e = hash_scan(h, hash, key)))
         return NULL;
 
     data = e->value;
     remove_entry(h, e);
+    maybe_shrink(h);
 
     return data;
 }
@@ -296,6 +344,7 @@ void* pa_hashmap_steal_first(pa_hashmap *h) {
 
     data = h->iterate_list_head->value;
     remove_entry(h, h->iterate_list_head);
+    maybe_shrink(h);
 
     return data;
 }
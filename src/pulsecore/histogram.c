@@ -0,0 +1,83 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+
+#include "histogram.h"
+
+/* Durations below 4 usec get a bucket each, above that the two bits
+ * following the most significant one select one of four buckets per
+ * power of two */
+static unsigned bucket_of(pa_usec_t usec) {
+    unsigned e;
+
+    if (usec < 4)
+        return (unsigned) usec;
+
+    usec = PA_MIN(usec, (pa_usec_t) 0xFFFFFFFFU);
+    e = pa_ulog2((unsigned) usec);
+
+    return (e - 1) * 4 + (unsigned) ((usec >> (e - 2)) & 3);
+}
+
+static pa_usec_t bucket_start(unsigned b) {
+    if (b < 4)
+        return b;
+
+    return (pa_usec_t) (4 + b % 4) << (b / 4 - 1);
+}
+
+void pa_histogram_add(pa_histogram *h, pa_usec_t usec) {
+    unsigned b;
+
+    pa_assert(h);
+
+    b = bucket_of(usec);
+    pa_assert(b < PA_HISTOGRAM_BUCKETS);
+
+    h->buckets[b]++;
+    h->count++;
+
+    if (usec > h->max)
+        h->max = usec;
+}
+
+pa_usec_t pa_histogram_percentile(const pa_histogram *h, unsigned percent) {
+    uint64_t n = 0, want;
+    unsigned b;
+
+    pa_assert(h);
+    pa_assert(percent <= 100);
+
+    if (h->count == 0)
+        return 0;
+
+    want = (h->count * percent + 99) / 100;
+
+    for (b = 0; b < PA_HISTOGRAM_BUCKETS - 1; b++)
+        if ((n += h->buckets[b]) >= want && n > 0)
+            break;
+
+    return PA_MIN(bucket_start(b + 1) - 1, h->max);
+}
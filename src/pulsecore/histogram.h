@@ -0,0 +1,46 @@
+#ifndef foopulsehistogramhfoo
+#define foopulsehistogramhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/sample.h>
+
+/* A histogram of durations, cheap enough to be updated for every
+ * request. Each power of two is split into four buckets, so
+ * percentiles are accurate to 25%. Durations of more than about an
+ * hour all end up in the last bucket. Not thread-safe. */
+
+#define PA_HISTOGRAM_BUCKETS 128
+
+typedef struct pa_histogram {
+    uint64_t count;
+    pa_usec_t max;
+    uint32_t buckets[PA_HISTOGRAM_BUCKETS];
+} pa_histogram;
+
+void pa_histogram_add(pa_histogram *h, pa_usec_t usec);
+
+/* An upper bound for the given percentile of what was added, 0 if
+ * nothing was */
+pa_usec_t pa_histogram_percentile(const pa_histogram *h, unsigned percent);
+
+#endif
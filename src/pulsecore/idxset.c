@@ -34,11 +34,19 @@
 
 #include "idxset.h"
 
-#define NBUCKETS 127
+/* Both tables start small and grow with the number of entries, see
+ * hashmap.c */
+#define MIN_BUCKETS_SHIFT 5
+
+/* Indexes are handed out sequentially, so their low bits are used
+ * directly. Data hashes are spread by multiplicative hashing. */
+#define DATA_BUCKET(s, hash) ((unsigned) (((uint32_t) (hash) * 0x9E3779B1U) >> (32 - (s)->buckets_shift)))
+#define INDEX_BUCKET(s, idx) ((unsigned) ((idx) & ((1U << (s)->buckets_shift) - 1)))
 
 struct idxset_entry {
     uint32_t idx;
     void *data;
+    unsigned hash;
 
     struct idxset_entry *data_next, *data_previous;
     struct idxset_entry *index_next, *index_previous;
@@ -51,12 +59,16 @@ struct pa_idxset {
 
     uint32_t current_index;
 
+    /* Twice the bucket count, the index table follows the data table */
+    struct idxset_entry **buckets;
+    unsigned buckets_shift;
+
     struct idxset_entry *iterate_list_head, *iterate_list_tail;
     unsigned n_entries;
 };
 
-#define BY_DATA(i) ((struct idxset_entry**) ((uint8_t*) (i) + PA_ALIGN(sizeof(pa_idxset))))
-#define BY_INDEX(i) (BY_DATA(i) + NBUCKETS)
+#define BY_DATA(i) ((i)->buckets)
+#define BY_INDEX(i) ((i)->buckets + (1U << (i)->buckets_shift))
 
 PA_STATIC_FLIST_DECLARE(entries, 0, pa_xfree);
 
@@ -85,7 +97,10 @@ int pa_idxset_trivial_compare_func(const void *a, const void *b) {
 pa_idxset* pa_idxset_new(pa_hash_func_t hash_func, pa_compare_func_t compare_func) {
     pa_idxset *s;
 
-    s = pa_xmalloc0(PA_ALIGN(sizeof(pa_idxset)) + NBUCKETS*2*sizeof(struct idxset_entry*));
+    s = pa_xnew0(pa_idxset, 1);
+
+    s->buckets_shift = MIN_BUCKETS_SHIFT;
+    s->buckets = pa_xnew0(struct idxset_entry*, 2U << s->buckets_shift);
 
     s->hash_func = hash_func ? hash_func : pa_idxset_trivial_hash_func;
     s->compare_func = compare_func ? compare_func : pa_idxset_trivial_compare_func;
@@ -97,6 +112,52 @@ pa_idxset* pa_idxset_new(pa_hash_func_t hash_func, pa_compare_func_t compare_fun
     return s;
 }
 
+static void bucket_insert(pa_idxset *s, struct idxset_entry *e) {
+    struct idxset_entry **b;
+
+    /* Insert into data hash table */
+    b = BY_DATA(s) + DATA_BUCKET(s, e->hash);
+
+    e->data_next = *b;
+    e->data_previous = NULL;
+    if (*b)
+        (*b)->data_previous = e;
+    *b = e;
+
+    /* Insert into index hash table */
+    b = BY_INDEX(s) + INDEX_BUCKET(s, e->idx);
+
+    e->index_next = *b;
+    e->index_previous = NULL;
+    if (*b)
+        (*b)->index_previous = e;
+    *b = e;
+}
+
+static void resize(pa_idxset *s, unsigned buckets_shift) {
+    struct idxset_entry *e;
+
+    pa_assert(s);
+    pa_assert(buckets_shift >= MIN_BUCKETS_SHIFT);
+    pa_assert(buckets_shift < 31);
+
+    pa_xfree(s->buckets);
+
+    s->buckets_shift = buckets_shift;
+    s->buckets = pa_xnew0(struct idxset_entry*, 2U << s->buckets_shift);
+
+    /* The iteration list is not touched, so the order stays the same */
+    for (e = s->iterate_list_head; e; e = e->iterate_next)
+        bucket_insert(s, e);
+}
+
+static void maybe_shrink(pa_idxset *s) {
+    pa_assert(s);
+
+    if (s->buckets_shift > MIN_BUCKETS_SHIFT && s->n_entries < (1U << s->buckets_shift) / 8)
+        resize(s, s->buckets_shift - 1);
+}
+
 static void remove_entry(pa_idxset *s, struct idxset_entry *e) {
     pa_assert(s);
     pa_assert(e);
@@ -118,10 +179,8 @@ static void remove_entry(pa_idxset *s, struct idxset_entry *e) {
 
     if (e->data_previous)
         e->data_previous->data_next = e->data_next;
-    else {
-        unsigned hash = s->hash_func(e->data) % NBUCKETS;
-        BY_DATA(s)[hash] = e->data_next;
-    }
+    else
+        BY_DATA(s)[DATA_BUCKET(s, e->hash)] = e->data_next;
 
     /* Remove from index hash table */
     if (e->index_next)
@@ -130,7 +189,7 @@ static void remove_entry(pa_idxset *s, struct idxset_entry *e) {
     if (e->index_previous)
         e->index_previous->index_next = e->index_next;
     else
-        BY_INDEX(s)[e->idx % NBUCKETS] = e->index_next;
+        BY_INDEX(s)[INDEX_BUCKET(s, e->idx)] = e->index_next;
 
     if (pa_flist_push(PA_STATIC_FLIST_GET(entries), e) < 0)
         pa_xfree(e);
@@ -151,28 +210,27 @@ void pa_idxset_free(pa_idxset *s, pa_free2_cb_t free_cb, void *userdata) {
             free_cb(data, userdata);
     }
 
+    pa_xfree(s->buckets);
     pa_xfree(s);
 }
 
 static struct idxset_entry* data_scan(pa_idxset *s, unsigned hash, const void *p) {
     struct idxset_entry *e;
     pa_assert(s);
-    pa_assert(hash < NBUCKETS);
     pa_assert(p);
 
-    for (e = BY_DATA(s)[hash]; e; e = e->data_next)
-        if (s->compare_func(e->data, p) == 0)
+    for (e = BY_DATA(s)[DATA_BUCKET(s, hash)]; e; e = e->data_next)
+        if (e->hash == hash && s->compare_func(e->data, p) == 0)
             return e;
 
     return NULL;
 }
 
-static struct idxset_entry* index_scan(pa_idxset *s, unsigned hash, uint32_t idx) {
+static struct idxset_entry* index_scan(pa_idxset *s, uint32_t idx) {
     struct idxset_entry *e;
     pa_assert(s);
-    pa_assert(hash < NBUCKETS);
 
-    for (e = BY_INDEX(s)[hash]; e; e = e->index_next)
+    for (e = BY_INDEX(s)[INDEX_BUCKET(s, idx)]; e; e = e->index_next)
         if (e->idx == idx)
             return e;
 
@@ -185,7 +243,7 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
 
     pa_assert(s);
 
-    hash = s->hash_func(p) % NBUCKETS;
+    hash = s->hash_func(p);
 
     if ((e = data_scan(s, hash, p))) {
         if (idx)
@@ -199,22 +257,9 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
 
     e->data = p;
     e->idx = s->current_index++;
+    e->hash = hash;
 
-    /* Insert into data hash table */
-    e->data_next = BY_DATA(s)[hash];
-    e->data_previous = NULL;
-    if (BY_DATA(s)[hash])
-        BY_DATA(s)[hash]->data_previous = e;
-    BY_DATA(s)[hash] = e;
-
-    hash = e->idx % NBUCKETS;
-
-    /* Insert into index hash table */
-    e->index_next = BY_INDEX(s)[hash];
-    e->index_previous = NULL;
-    if (BY_INDEX(s)[hash])
-        BY_INDEX(s)[hash]->index_previous = e;
-    BY_INDEX(s)[hash] = e;
+    bucket_insert(s, e);
 
     /* Insert into iteration list */
     e->iterate_previous = s->iterate_list_tail;
@@ -231,6 +276,9 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
     s->n_entries++;
     pa_assert(s->n_entries >= 1);
 
+    if (s->n_entries > (1U << s->buckets_shift) && s->buckets_shift < 30)
+        resize(s, s->buckets_shift + 1);
+
     if (idx)
         *idx = e->idx;
 
@@ -238,14 +286,11 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
 }
 
 void* pa_idxset_get_by_index(pa_idxset*s, uint32_t idx) {
-    unsigned hash;
     struct idxset_entry *e;
 
     pa_assert(s);
 
-    hash = idx % NBUCKETS;
-
-    if (!(e = index_scan(s, hash, idx)))
+    if (!(e = index_scan(s, idx)))
         return NULL;
 
     return e->data;
@@ -257,7 +302,7 @@ void* pa_idxset_get_by_data(pa_idxset*s, const void *p, uint32_t *idx) {
 
     pa_assert(s);
 
-    hash = s->hash_func(p) % NBUCKETS;
+    hash = s->hash_func(p);
 
     if (!(e = data_scan(s, hash, p)))
         return NULL;
@@ -270,18 +315,16 @@ void* pa_idxset_get_by_data(pa_idxset*s, const void *p, uint32_t *idx) {
 
 void* pa_idxset_remove_by_index(pa_idxset*s, uint32_t idx) {
     struct idxset_entry *e;
-    unsigned hash;
     void *data;
 
     pa_assert(s);
 
-    hash = idx % NBUCKETS;
-
-    if (!(e = index_scan(s, hash, idx)))
+    if (!(e = index_scan(s, idx)))
         return NULL;
 
     data = e->data;
     remove_entry(s, e);
+    maybe_shrink(s);
 
     return data;
 }
@@ -293,7 +336,7 @@ void* pa_idxset_remove_by_data(pa_idxset*s, const void *data, uint32_t *idx) {
 
     pa_assert(s);
 
-    hash = s->hash_func(data) % NBUCKETS;
+    hash = s->hash_func(data);
 
     if (!(e = data_scan(s, hash, data)))
         return NULL;
@@ -304,20 +347,18 @@ void* pa_idxset_remove_by_data(pa_idxset*s, const void *data, uint32_t *idx) {
         *idx = e->idx;
 
     remove_entry(s, e);
+    maybe_shrink(s);
 
     return r;
 }
 
 void* pa_idxset_rrobin(pa_idxset *s, uint32_t *idx) {
-    unsigned hash;
     struct idxset_entry *e;
 
     pa_assert(s);
     pa_assert(idx);
 
-    hash = *idx % NBUCKETS;
-
-    e = index_scan(s, hash, *idx);
+    e = index_scan(s, *idx);
 
     if (e && e->iterate_next)
         e = e->iterate_next;
@@ -378,6 +419,7 @@ void* pa_idxset_steal_first(pa_idxset *s, uint32_t *idx) {
         *idx = s->iterate_list_head->idx;
 
     remove_entry(s, s->iterate_list_head);
+    maybe_shrink(s);
 
     return data;
 }
@@ -399,7 +441,6 @@ void* pa_idxset_first(pa_idxset *s, uint32_t *idx) {
 
 void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
     struct idxset_entry *e;
-    unsigned hash;
 
     pa_assert(s);
     pa_assert(idx);
@@ -407,9 +448,7 @@ void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
     if (*idx == PA_IDXSET_INVALID)
         return NULL;
 
-    hash = *idx % NBUCKETS;
-
-    if ((e = index_scan(s, hash, *idx))) {
+    if ((e = index_scan(s, *idx))) {
 
         e = e->iterate_next;
 
@@ -428,9 +467,7 @@ void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
 
         for ((*idx)++; *idx < s->current_index; (*idx)++) {
 
-            hash = *idx % NBUCKETS;
-
-            if ((e = index_scan(s, hash, *idx))) {
+            if ((e = index_scan(s, *idx))) {
                 *idx = e->idx;
                 return e->data;
             }
@@ -231,6 +231,49 @@ ssize_t pa_iochannel_write(pa_iochannel*io, const void*data, size_t l) {
     return r;
 }
 
+ssize_t pa_iochannel_writev(pa_iochannel*io, const struct iovec *iov, unsigned n) {
+    ssize_t r;
+
+    pa_assert(io);
+    pa_assert(iov);
+    pa_assert(n > 0);
+    pa_assert(io->ofd >= 0);
+
+#ifdef HAVE_SYS_UIO_H
+    for (;;) {
+
+        if (io->ofd_type == 0) {
+            struct msghdr mh;
+
+            pa_zero(mh);
+            mh.msg_iov = (struct iovec*) iov;
+            mh.msg_iovlen = n;
+
+            if ((r = sendmsg(io->ofd, &mh, MSG_NOSIGNAL)) < 0 && errno == ENOTSOCK) {
+                io->ofd_type = 1;
+                continue;
+            }
+
+        } else
+            r = writev(io->ofd, iov, (int) n);
+
+        if (r < 0 && errno == EINTR)
+            continue;
+
+        break;
+    }
+#else
+    r = pa_write(io->ofd, iov[0].iov_base, iov[0].iov_len, &io->ofd_type);
+#endif
+
+    if (r >= 0) {
+        io->writable = io->hungup = FALSE;
+        enable_events(io);
+    }
+
+    return r;
+}
+
 ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l) {
     ssize_t r;
 
@@ -289,9 +332,21 @@ int pa_iochannel_creds_enable(pa_iochannel *io) {
 }
 
 ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l, const pa_creds *ucred) {
+    struct iovec iov;
+
+    pa_assert(data);
+    pa_assert(l);
+
+    pa_zero(iov);
+    iov.iov_base = (void*) data;
+    iov.iov_len = l;
+
+    return pa_iochannel_writev_with_creds(io, &iov, 1, ucred);
+}
+
+ssize_t pa_iochannel_writev_with_creds(pa_iochannel*io, const struct iovec *iov, unsigned n, const pa_creds *ucred) {
     ssize_t r;
     struct msghdr mh;
-    struct iovec iov;
     union {
         struct cmsghdr hdr;
         uint8_t data[CMSG_SPACE(sizeof(struct ucred))];
@@ -299,14 +354,10 @@ ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l
     struct ucred *u;
 
     pa_assert(io);
-    pa_assert(data);
-    pa_assert(l);
+    pa_assert(iov);
+    pa_assert(n > 0);
     pa_assert(io->ofd >= 0);
 
-    pa_zero(iov);
-    iov.iov_base = (void*) data;
-    iov.iov_len = l;
-
     pa_zero(cmsg);
     cmsg.hdr.cmsg_len = CMSG_LEN(sizeof(struct ucred));
     cmsg.hdr.cmsg_level = SOL_SOCKET;
@@ -324,8 +375,8 @@ ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l
     }
 
     pa_zero(mh);
-    mh.msg_iov = &iov;
-    mh.msg_iovlen = 1;
+    mh.msg_iov = (struct iovec*) iov;
+    mh.msg_iovlen = n;
     mh.msg_control = &cmsg;
     mh.msg_controllen = sizeof(cmsg);
 
@@ -337,13 +388,47 @@ ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l
     return r;
 }
 
-ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_creds *creds, pa_bool_t *creds_valid) {
+ssize_t pa_iochannel_writev_with_fd(pa_iochannel*io, const struct iovec *iov, unsigned n, int fd) {
+    ssize_t r;
+    struct msghdr mh;
+    union {
+        struct cmsghdr hdr;
+        uint8_t data[CMSG_SPACE(sizeof(int))];
+    } cmsg;
+
+    pa_assert(io);
+    pa_assert(iov);
+    pa_assert(n > 0);
+    pa_assert(io->ofd >= 0);
+    pa_assert(fd >= 0);
+
+    pa_zero(cmsg);
+    cmsg.hdr.cmsg_len = CMSG_LEN(sizeof(int));
+    cmsg.hdr.cmsg_level = SOL_SOCKET;
+    cmsg.hdr.cmsg_type = SCM_RIGHTS;
+    memcpy(CMSG_DATA(&cmsg.hdr), &fd, sizeof(int));
+
+    pa_zero(mh);
+    mh.msg_iov = (struct iovec*) iov;
+    mh.msg_iovlen = n;
+    mh.msg_control = &cmsg;
+    mh.msg_controllen = sizeof(cmsg);
+
+    if ((r = sendmsg(io->ofd, &mh, MSG_NOSIGNAL)) >= 0) {
+        io->writable = io->hungup = FALSE;
+        enable_events(io);
+    }
+
+    return r;
+}
+
+ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_creds *creds, pa_bool_t *creds_valid, int *fd) {
     ssize_t r;
     struct msghdr mh;
     struct iovec iov;
     union {
         struct cmsghdr hdr;
-        uint8_t data[CMSG_SPACE(sizeof(struct ucred))];
+        uint8_t data[CMSG_SPACE(sizeof(struct ucred)) + CMSG_SPACE(sizeof(int))];
     } cmsg;
 
     pa_assert(io);
@@ -352,6 +437,7 @@ ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_cr
     pa_assert(io->ifd >= 0);
     pa_assert(creds);
     pa_assert(creds_valid);
+    pa_assert(fd);
 
     pa_zero(iov);
     iov.iov_base = data;
@@ -364,10 +450,11 @@ ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_cr
     mh.msg_control = &cmsg;
     mh.msg_controllen = sizeof(cmsg);
 
-    if ((r = recvmsg(io->ifd, &mh, 0)) >= 0) {
+    if ((r = recvmsg(io->ifd, &mh, MSG_CMSG_CLOEXEC)) >= 0) {
         struct cmsghdr *cmh;
 
         *creds_valid = FALSE;
+        *fd = -1;
 
         for (cmh = CMSG_FIRSTHDR(&mh); cmh; cmh = CMSG_NXTHDR(&mh, cmh)) {
 
@@ -379,7 +466,25 @@ ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_cr
                 creds->gid = u.gid;
                 creds->uid = u.uid;
                 *creds_valid = TRUE;
-                break;
+
+            } else if (cmh->cmsg_level == SOL_SOCKET && cmh->cmsg_type == SCM_RIGHTS) {
+                int *fds = (int*) CMSG_DATA(cmh);
+                unsigned i, n;
+
+                /* We take the first one, and don't leak any others the
+                 * other side might have sent */
+                n = (unsigned) ((cmh->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+
+                for (i = 0; i < n; i++) {
+                    int f;
+
+                    memcpy(&f, fds + i, sizeof(int));
+
+                    if (*fd < 0)
+                        *fd = f;
+                    else
+                        pa_close(f);
+                }
             }
         }
 
@@ -29,6 +29,15 @@
 
 #include <sys/types.h>
 
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#else
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+#endif
+
 #include <pulse/mainloop-api.h>
 #include <pulsecore/creds.h>
 #include <pulsecore/macro.h>
@@ -51,12 +60,22 @@ void pa_iochannel_free(pa_iochannel*io);
 ssize_t pa_iochannel_write(pa_iochannel*io, const void*data, size_t l);
 ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l);
 
+/* Write several buffers with a single system call. Like
+ * pa_iochannel_write() this may write less than requested. */
+ssize_t pa_iochannel_writev(pa_iochannel*io, const struct iovec *iov, unsigned n);
+
 #ifdef HAVE_CREDS
 pa_bool_t pa_iochannel_creds_supported(pa_iochannel *io);
 int pa_iochannel_creds_enable(pa_iochannel *io);
 
 ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l, const pa_creds *ucred);
-ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_creds *ucred, pa_bool_t *creds_valid);
+ssize_t pa_iochannel_writev_with_creds(pa_iochannel*io, const struct iovec *iov, unsigned n, const pa_creds *ucred);
+
+/* Passes a file descriptor along with the data. On the receiving end
+ * pa_iochannel_read_with_creds() returns it in *fd, or -1 if the data
+ * read came without one. */
+ssize_t pa_iochannel_writev_with_fd(pa_iochannel*io, const struct iovec *iov, unsigned n, int fd);
+ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_creds *ucred, pa_bool_t *creds_valid, int *fd);
 #endif
 
 pa_bool_t pa_iochannel_is_readable(pa_iochannel*io);
@@ -25,6 +25,7 @@
 #endif
 
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -49,15 +50,35 @@
 #include <pulsecore/flist.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/memtrap.h>
+#include <pulsecore/thread.h>
 
 #include "memblock.h"
 
-/* We can allocate 64*1024*1024 bytes at maximum. That's 64MB. Please
- * note that the footprint is usually much smaller, since the data is
- * stored in SHM and our OS does not commit the memory before we use
- * it for the first time. */
-#define PA_MEMPOOL_SLOTS_MAX 1024
-#define PA_MEMPOOL_SLOT_SIZE (64*1024)
+/* We can allocate 64*1024*1024 bytes at maximum by default. That's
+ * 64MB. Please note that the footprint is usually much smaller, since
+ * the data is stored in SHM and our OS does not commit the memory
+ * before we use it for the first time. */
+#define PA_MEMPOOL_SIZE_DEFAULT (64*1024*1024)
+
+/* The pool is split into regions of equally sized slots, one region
+ * for each of these classes. share is the size of a region in
+ * sixteenths of the configured pool size. Blocks go into the smallest
+ * class they fit in, and into the next larger one if that is
+ * exhausted. The default class gets as many slots as the pool had
+ * before it was split, the others come on top, which makes the pool
+ * 22/16 of the configured size. */
+static const struct {
+    size_t slot_size;
+    unsigned share;
+} slot_class_table[PA_MEMPOOL_SLOT_CLASSES_MAX] = {
+    {   4*1024,  1 },
+    {  16*1024,  2 },
+    {  64*1024, 16 },
+    { 256*1024,  3 },
+};
+
+/* The class pa_mempool_block_size_max() refers to */
+#define PA_MEMPOOL_SLOT_CLASS_DEFAULT 2
 
 #define PA_MEMEXPORT_SLOTS_MAX 128
 
@@ -97,6 +118,10 @@ struct pa_memimport_segment {
     pa_shm memory;
     pa_memtrap *trap;
     unsigned n_blocks;
+
+    /* memfd segments can't be attached again by ID, so they stay
+     * until the import goes away */
+    pa_bool_t permanent;
 };
 
 /* A collection of multiple segments */
@@ -139,21 +164,47 @@ struct pa_memexport {
     PA_LLIST_FIELDS(pa_memexport);
 };
 
+struct mempool_slot_class {
+    size_t slot_size;
+    unsigned n_slots;
+
+    /* Where the slots of this class start in the pool memory */
+    size_t offset;
+
+    pa_atomic_t n_init;
+
+    /* A list of free slots that may be reused */
+    pa_flist *free_slots;
+};
+
+#define STAT_SHARDS 16
+#define CACHE_LINE_SIZE 64
+
+union stat_shard {
+    pa_mempool_stat stat;
+    uint8_t padding[(sizeof(pa_mempool_stat) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE];
+};
+
 struct pa_mempool {
+    PA_REFCNT_DECLARE;
+
     pa_semaphore *semaphore;
     pa_mutex *mutex;
 
     pa_shm memory;
-    size_t block_size;
-    unsigned n_blocks;
 
-    pa_atomic_t n_init;
+    /* Ordered by slot size */
+    struct mempool_slot_class classes[PA_MEMPOOL_SLOT_CLASSES_MAX];
+    unsigned n_classes, default_class;
 
     PA_LLIST_HEAD(pa_memimport, imports);
     PA_LLIST_HEAD(pa_memexport, exports);
 
-    /* A list of free slots that may be reused */
-    pa_flist *free_slots;
+    /* Every thread updates the counters of its own shard, so that
+     * the threads don't keep stealing the same cache lines from each
+     * other. The sums are only taken in pa_mempool_get_stat(). */
+    void *stat_shards_allocated;
+    union stat_shard *stat_shards;
 
     pa_mempool_stat stat;
 };
@@ -162,46 +213,88 @@ static void segment_detach(pa_memimport_segment *seg);
 
 PA_STATIC_FLIST_DECLARE(unused_memblocks, 0, pa_xfree);
 
+/* The shard of the calling thread, plus one */
+PA_STATIC_TLS_DECLARE_NO_FREE(stat_shard);
+
+static pa_atomic_t n_stat_shard_threads = PA_ATOMIC_INIT(0);
+
+/* No lock necessary. Threads are handed out shards round robin, so
+ * the counters need to stay atomic for when there are more threads
+ * than shards, but mostly they aren't contended. */
+static pa_mempool_stat *stat_shard(pa_mempool *p) {
+    unsigned i;
+
+    if (PA_UNLIKELY(!(i = PA_PTR_TO_UINT(PA_STATIC_TLS_GET(stat_shard))))) {
+        i = (unsigned) pa_atomic_inc(&n_stat_shard_threads) % STAT_SHARDS + 1;
+        PA_STATIC_TLS_SET(stat_shard, PA_UINT_TO_PTR(i));
+    }
+
+    return &p->stat_shards[i - 1].stat;
+}
+
+/* Only for the sanity checks, which compare the total */
+#define STAT_SUM(p, counter) stat_sum((p), offsetof(pa_mempool_stat, counter))
+
+static int stat_sum(pa_mempool *p, size_t offset) {
+    unsigned i;
+    int v = 0;
+
+    for (i = 0; i < STAT_SHARDS; i++)
+        v += pa_atomic_load((pa_atomic_t*) ((uint8_t*) &p->stat_shards[i].stat + offset));
+
+    return v;
+}
+
 /* No lock necessary */
 static void stat_add(pa_memblock*b) {
+    pa_mempool_stat *stat;
+
     pa_assert(b);
     pa_assert(b->pool);
 
-    pa_atomic_inc(&b->pool->stat.n_allocated);
-    pa_atomic_add(&b->pool->stat.allocated_size, (int) b->length);
+    stat = stat_shard(b->pool);
 
-    pa_atomic_inc(&b->pool->stat.n_accumulated);
-    pa_atomic_add(&b->pool->stat.accumulated_size, (int) b->length);
+    pa_atomic_inc(&stat->n_allocated);
+    pa_atomic_add(&stat->allocated_size, (int) b->length);
+
+    pa_atomic_inc(&stat->n_accumulated);
+    pa_atomic_add(&stat->accumulated_size, (int) b->length);
 
     if (b->type == PA_MEMBLOCK_IMPORTED) {
-        pa_atomic_inc(&b->pool->stat.n_imported);
-        pa_atomic_add(&b->pool->stat.imported_size, (int) b->length);
+        pa_atomic_inc(&stat->n_imported);
+        pa_atomic_add(&stat->imported_size, (int) b->length);
     }
 
-    pa_atomic_inc(&b->pool->stat.n_allocated_by_type[b->type]);
-    pa_atomic_inc(&b->pool->stat.n_accumulated_by_type[b->type]);
+    pa_atomic_inc(&stat->n_allocated_by_type[b->type]);
+    pa_atomic_inc(&stat->n_accumulated_by_type[b->type]);
 }
 
-/* No lock necessary */
+/* No lock necessary. The block may well have been accounted for in
+ * the shard of another thread, so the shards can go negative, only
+ * their sums can't. */
 static void stat_remove(pa_memblock *b) {
+    pa_mempool_stat *stat;
+
     pa_assert(b);
     pa_assert(b->pool);
 
-    pa_assert(pa_atomic_load(&b->pool->stat.n_allocated) > 0);
-    pa_assert(pa_atomic_load(&b->pool->stat.allocated_size) >= (int) b->length);
+    pa_assert_fp(STAT_SUM(b->pool, n_allocated) > 0);
+    pa_assert_fp(STAT_SUM(b->pool, allocated_size) >= (int) b->length);
 
-    pa_atomic_dec(&b->pool->stat.n_allocated);
-    pa_atomic_sub(&b->pool->stat.allocated_size, (int) b->length);
+    stat = stat_shard(b->pool);
+
+    pa_atomic_dec(&stat->n_allocated);
+    pa_atomic_sub(&stat->allocated_size, (int) b->length);
 
     if (b->type == PA_MEMBLOCK_IMPORTED) {
-        pa_assert(pa_atomic_load(&b->pool->stat.n_imported) > 0);
-        pa_assert(pa_atomic_load(&b->pool->stat.imported_size) >= (int) b->length);
+        pa_assert_fp(STAT_SUM(b->pool, n_imported) > 0);
+        pa_assert_fp(STAT_SUM(b->pool, imported_size) >= (int) b->length);
 
-        pa_atomic_dec(&b->pool->stat.n_imported);
-        pa_atomic_sub(&b->pool->stat.imported_size, (int) b->length);
+        pa_atomic_dec(&stat->n_imported);
+        pa_atomic_sub(&stat->imported_size, (int) b->length);
     }
 
-    pa_atomic_dec(&b->pool->stat.n_allocated_by_type[b->type]);
+    pa_atomic_dec(&stat->n_allocated_by_type[b->type]);
 }
 
 static pa_memblock *memblock_new_appended(pa_mempool *p, size_t length);
@@ -246,31 +339,77 @@ static pa_memblock *memblock_new_appended(pa_mempool *p, size_t length) {
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_allocate_slot(pa_mempool *p) {
+static struct mempool_slot* mempool_allocate_slot_from_class(pa_mempool *p, unsigned c) {
+    struct mempool_slot_class *k;
     struct mempool_slot *slot;
+
     pa_assert(p);
+    pa_assert(c < p->n_classes);
+
+    k = p->classes + c;
 
-    if (!(slot = pa_flist_pop(p->free_slots))) {
+    if (!(slot = pa_flist_pop(k->free_slots))) {
         int idx;
 
         /* The free list was empty, we have to allocate a new entry */
 
-        if ((unsigned) (idx = pa_atomic_inc(&p->n_init)) >= p->n_blocks)
-            pa_atomic_dec(&p->n_init);
+        if ((unsigned) (idx = pa_atomic_inc(&k->n_init)) >= k->n_slots)
+            pa_atomic_dec(&k->n_init);
         else
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) idx));
+            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + k->offset + (k->slot_size * (size_t) idx));
 
-        if (!slot) {
-            if (pa_log_ratelimit(PA_LOG_DEBUG))
-                pa_log_debug("Pool full");
-            pa_atomic_inc(&p->stat.n_pool_full);
+        if (!slot)
             return NULL;
-        }
     }
 
+    pa_atomic_inc(&stat_shard(p)->n_slots_allocated_by_class[c]);
+    pa_atomic_inc(&stat_shard(p)->n_slots_accumulated_by_class[c]);
+
+    return slot;
+}
+
+/* Returns the smallest class with slots of at least size bytes */
+static unsigned mempool_find_class(pa_mempool *p, size_t size) {
+    unsigned c;
+
+    pa_assert(p);
+
+    for (c = 0; c < p->n_classes; c++)
+        if (p->classes[c].slot_size >= size)
+            break;
+
+    return c;
+}
+
+/* No lock necessary. Takes a slot of class *c, or of the next larger
+ * class that still has one. */
+static struct mempool_slot* mempool_allocate_slot(pa_mempool *p, unsigned *c) {
+    struct mempool_slot *slot = NULL;
+    unsigned i;
+
+    pa_assert(p);
+    pa_assert(c);
+    pa_assert(*c < p->n_classes);
+
+    for (i = *c; i < p->n_classes; i++) {
+        if ((slot = mempool_allocate_slot_from_class(p, i)))
+            break;
+
+        pa_atomic_inc(&stat_shard(p)->n_class_full_by_class[i]);
+    }
+
+    if (!slot) {
+        if (pa_log_ratelimit(PA_LOG_DEBUG))
+            pa_log_debug("Pool full");
+        pa_atomic_inc(&stat_shard(p)->n_pool_full);
+        return NULL;
+    }
+
+    *c = i;
+
 /* #ifdef HAVE_VALGRIND_MEMCHECK_H */
 /*     if (PA_UNLIKELY(pa_in_valgrind())) { */
-/*         VALGRIND_MALLOCLIKE_BLOCK(slot, p->block_size, 0, 0); */
+/*         VALGRIND_MALLOCLIKE_BLOCK(slot, p->classes[i].slot_size, 0, 0); */
 /*     } */
 /* #endif */
 
@@ -283,29 +422,45 @@ static inline void* mempool_slot_data(struct mempool_slot *slot) {
 }
 
 /* No lock necessary */
-static unsigned mempool_slot_idx(pa_mempool *p, void *ptr) {
+static unsigned mempool_slot_class_by_ptr(pa_mempool *p, void *ptr) {
+    size_t offset;
+    unsigned c;
+
     pa_assert(p);
 
     pa_assert((uint8_t*) ptr >= (uint8_t*) p->memory.ptr);
     pa_assert((uint8_t*) ptr < (uint8_t*) p->memory.ptr + p->memory.size);
 
-    return (unsigned) ((size_t) ((uint8_t*) ptr - (uint8_t*) p->memory.ptr) / p->block_size);
+    offset = (size_t) ((uint8_t*) ptr - (uint8_t*) p->memory.ptr);
+
+    for (c = p->n_classes - 1; c > 0; c--)
+        if (offset >= p->classes[c].offset)
+            break;
+
+    return c;
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr) {
-    unsigned idx;
+static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, unsigned c, void *ptr) {
+    struct mempool_slot_class *k;
+    size_t idx;
 
-    if ((idx = mempool_slot_idx(p, ptr)) == (unsigned) -1)
-        return NULL;
+    pa_assert(p);
+    pa_assert(c < p->n_classes);
 
-    return (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (idx * p->block_size));
+    k = p->classes + c;
+    idx = ((size_t) ((uint8_t*) ptr - (uint8_t*) p->memory.ptr) - k->offset) / k->slot_size;
+
+    pa_assert(idx < k->n_slots);
+
+    return (struct mempool_slot*) ((uint8_t*) p->memory.ptr + k->offset + idx * k->slot_size);
 }
 
 /* No lock necessary */
 pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
     pa_memblock *b = NULL;
     struct mempool_slot *slot;
+    unsigned c;
     static int mempool_disable = 0;
 
     pa_assert(p);
@@ -323,30 +478,30 @@ pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
     if (length == (size_t) -1)
         length = pa_mempool_block_size_max(p);
 
-    if (p->block_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
+    if ((c = mempool_find_class(p, length)) >= p->n_classes) {
+        pa_log_debug("Memory block too large for pool: %lu > %lu", (unsigned long) length, (unsigned long) p->classes[p->n_classes-1].slot_size);
+        pa_atomic_inc(&stat_shard(p)->n_too_large_for_pool);
+        return NULL;
+    }
 
-        if (!(slot = mempool_allocate_slot(p)))
-            return NULL;
+    if (!(slot = mempool_allocate_slot(p, &c)))
+        return NULL;
+
+    /* Keep the pa_memblock structure in the slot too if there's room,
+     * rather than going for a class twice as large */
+    if (p->classes[c].slot_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
 
         b = mempool_slot_data(slot);
         b->type = PA_MEMBLOCK_POOL;
         pa_atomic_ptr_store(&b->data, (uint8_t*) b + PA_ALIGN(sizeof(pa_memblock)));
 
-    } else if (p->block_size >= length) {
-
-        if (!(slot = mempool_allocate_slot(p)))
-            return NULL;
+    } else {
 
         if (!(b = pa_flist_pop(PA_STATIC_FLIST_GET(unused_memblocks))))
             b = pa_xnew(pa_memblock, 1);
 
         b->type = PA_MEMBLOCK_POOL_EXTERNAL;
         pa_atomic_ptr_store(&b->data, mempool_slot_data(slot));
-
-    } else {
-        pa_log_debug("Memory block too large for pool: %lu > %lu", (unsigned long) length, (unsigned long) p->block_size);
-        pa_atomic_inc(&p->stat.n_too_large_for_pool);
-        return NULL;
     }
 
     PA_REFCNT_INIT(b);
@@ -544,7 +699,7 @@ static void memblock_free(pa_memblock *b) {
             pa_assert_se(pa_hashmap_remove(import->blocks, PA_UINT32_TO_PTR(b->per_type.imported.id)));
 
             pa_assert(segment->n_blocks >= 1);
-            if (-- segment->n_blocks <= 0)
+            if (-- segment->n_blocks <= 0 && !segment->permanent)
                 segment_detach(segment);
 
             pa_mutex_unlock(import->mutex);
@@ -561,23 +716,27 @@ static void memblock_free(pa_memblock *b) {
         case PA_MEMBLOCK_POOL: {
             struct mempool_slot *slot;
             pa_bool_t call_free;
+            unsigned c;
 
-            pa_assert_se(slot = mempool_slot_by_ptr(b->pool, pa_atomic_ptr_load(&b->data)));
+            c = mempool_slot_class_by_ptr(b->pool, pa_atomic_ptr_load(&b->data));
+            pa_assert_se(slot = mempool_slot_by_ptr(b->pool, c, pa_atomic_ptr_load(&b->data)));
 
             call_free = b->type == PA_MEMBLOCK_POOL_EXTERNAL;
 
 /* #ifdef HAVE_VALGRIND_MEMCHECK_H */
 /*             if (PA_UNLIKELY(pa_in_valgrind())) { */
-/*                 VALGRIND_FREELIKE_BLOCK(slot, b->pool->block_size); */
+/*                 VALGRIND_FREELIKE_BLOCK(slot, b->pool->classes[c].slot_size); */
 /*             } */
 /* #endif */
 
             /* The free list dimensions should easily allow all slots
              * to fit in, hence try harder if pushing this slot into
              * the free list fails */
-            while (pa_flist_push(b->pool->free_slots, slot) < 0)
+            while (pa_flist_push(b->pool->classes[c].free_slots, slot) < 0)
                 ;
 
+            pa_atomic_dec(&stat_shard(b->pool)->n_slots_allocated_by_class[c]);
+
             if (call_free)
                 if (pa_flist_push(PA_STATIC_FLIST_GET(unused_memblocks), b) < 0)
                     pa_xfree(b);
@@ -624,12 +783,15 @@ static void memblock_wait(pa_memblock *b) {
 static void memblock_make_local(pa_memblock *b) {
     pa_assert(b);
 
-    pa_atomic_dec(&b->pool->stat.n_allocated_by_type[b->type]);
+    pa_atomic_dec(&stat_shard(b->pool)->n_allocated_by_type[b->type]);
 
-    if (b->length <= b->pool->block_size) {
+    if (b->length <= b->pool->classes[b->pool->n_classes-1].slot_size) {
         struct mempool_slot *slot;
+        unsigned c;
+
+        c = mempool_find_class(b->pool, b->length);
 
-        if ((slot = mempool_allocate_slot(b->pool))) {
+        if ((slot = mempool_allocate_slot(b->pool, &c))) {
             void *new_data;
             /* We can move it into a local pool, perfect! */
 
@@ -652,8 +814,8 @@ static void memblock_make_local(pa_memblock *b) {
     b->read_only = FALSE;
 
 finish:
-    pa_atomic_inc(&b->pool->stat.n_allocated_by_type[b->type]);
-    pa_atomic_inc(&b->pool->stat.n_accumulated_by_type[b->type]);
+    pa_atomic_inc(&stat_shard(b->pool)->n_allocated_by_type[b->type]);
+    pa_atomic_inc(&stat_shard(b->pool)->n_accumulated_by_type[b->type]);
     memblock_wait(b);
 }
 
@@ -691,10 +853,10 @@ static void memblock_replace_import(pa_memblock *b) {
     pa_assert(b);
     pa_assert(b->type == PA_MEMBLOCK_IMPORTED);
 
-    pa_assert(pa_atomic_load(&b->pool->stat.n_imported) > 0);
-    pa_assert(pa_atomic_load(&b->pool->stat.imported_size) >= (int) b->length);
-    pa_atomic_dec(&b->pool->stat.n_imported);
-    pa_atomic_sub(&b->pool->stat.imported_size, (int) b->length);
+    pa_assert_fp(STAT_SUM(b->pool, n_imported) > 0);
+    pa_assert_fp(STAT_SUM(b->pool, imported_size) >= (int) b->length);
+    pa_atomic_dec(&stat_shard(b->pool)->n_imported);
+    pa_atomic_sub(&stat_shard(b->pool)->imported_size, (int) b->length);
 
     pa_assert_se(segment = b->per_type.imported.segment);
     pa_assert_se(import = segment->import);
@@ -706,59 +868,132 @@ static void memblock_replace_import(pa_memblock *b) {
     memblock_make_local(b);
 
     pa_assert(segment->n_blocks >= 1);
-    if (-- segment->n_blocks <= 0)
+    if (-- segment->n_blocks <= 0 && !segment->permanent)
         segment_detach(segment);
 
     pa_mutex_unlock(import->mutex);
 }
 
-pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size) {
+static pa_mempool* mempool_new(pa_bool_t shared, pa_bool_t memfd, size_t size) {
     pa_mempool *p;
     char t1[PA_BYTES_SNPRINT_MAX], t2[PA_BYTES_SNPRINT_MAX];
+    size_t total = 0, size_max;
+    unsigned i, share = 0;
 
-    p = pa_xnew(pa_mempool, 1);
-
-    p->block_size = PA_PAGE_ALIGN(PA_MEMPOOL_SLOT_SIZE);
-    if (p->block_size < PA_PAGE_SIZE)
-        p->block_size = PA_PAGE_SIZE;
+    p = pa_xnew0(pa_mempool, 1);
+    PA_REFCNT_INIT(p);
 
     if (size <= 0)
-        p->n_blocks = PA_MEMPOOL_SLOTS_MAX;
-    else {
-        p->n_blocks = (unsigned) (size / p->block_size);
+        size = PA_MEMPOOL_SIZE_DEFAULT;
 
-        if (p->n_blocks < 2)
-            p->n_blocks = 2;
+    /* The classes together take more than the configured size, which
+     * still has to fit into a single SHM segment */
+    for (i = 0; i < PA_MEMPOOL_SLOT_CLASSES_MAX; i++)
+        share += slot_class_table[i].share;
+
+    size_max = PA_SHM_SIZE_MAX / share * 16;
+    share = 0;
+
+    if (size > size_max) {
+        pa_log_warn("Memory pool size of %lu bytes is too large, using %lu bytes.", (unsigned long) size, (unsigned long) size_max);
+        size = size_max;
     }
 
-    if (pa_shm_create_rw(&p->memory, p->n_blocks * p->block_size, shared, 0700) < 0) {
+    for (i = 0; i < PA_MEMPOOL_SLOT_CLASSES_MAX; i++) {
+        struct mempool_slot_class *k;
+        size_t slot_size;
+
+        slot_size = PA_PAGE_ALIGN(slot_class_table[i].slot_size);
+        if (slot_size < PA_PAGE_SIZE)
+            slot_size = PA_PAGE_SIZE;
+
+        share += slot_class_table[i].share;
+
+        if (i == PA_MEMPOOL_SLOT_CLASS_DEFAULT)
+            p->default_class = p->n_classes;
+
+        /* With large pages several classes may end up the same size,
+         * merge them then */
+        if (i + 1 < PA_MEMPOOL_SLOT_CLASSES_MAX &&
+            PA_PAGE_ALIGN(slot_class_table[i+1].slot_size) <= slot_size)
+            continue;
+
+        k = p->classes + p->n_classes++;
+        k->slot_size = slot_size;
+        k->offset = total;
+        k->n_slots = (unsigned) (size / 16 * share / slot_size);
+
+        if (k->n_slots < 2)
+            k->n_slots = 2;
+
+        total += k->n_slots * k->slot_size;
+        share = 0;
+    }
+
+    pa_assert(total <= PA_SHM_SIZE_MAX);
+
+    if ((memfd ? pa_shm_create_memfd(&p->memory, total) : pa_shm_create_rw(&p->memory, total, shared, 0700)) < 0) {
         pa_xfree(p);
         return NULL;
     }
 
-    pa_log_debug("Using %s memory pool with %u slots of size %s each, total size is %s, maximum usable slot size is %lu",
-                 p->memory.shared ? "shared" : "private",
-                 p->n_blocks,
-                 pa_bytes_snprint(t1, sizeof(t1), (unsigned) p->block_size),
-                 pa_bytes_snprint(t2, sizeof(t2), (unsigned) (p->n_blocks * p->block_size)),
+    pa_log_debug("Using %s memory pool with %u slot classes, total size is %s, maximum usable slot size is %lu",
+                 p->memory.memfd ? "memfd" : p->memory.shared ? "shared" : "private",
+                 p->n_classes,
+                 pa_bytes_snprint(t1, sizeof(t1), (unsigned) total),
                  (unsigned long) pa_mempool_block_size_max(p));
 
-    memset(&p->stat, 0, sizeof(p->stat));
-    pa_atomic_store(&p->n_init, 0);
+    for (i = 0; i < p->n_classes; i++) {
+        pa_log_debug("Slot class %u: %u slots of size %s each",
+                     i, p->classes[i].n_slots,
+                     pa_bytes_snprint(t2, sizeof(t2), (unsigned) p->classes[i].slot_size));
+
+        pa_atomic_store(&p->classes[i].n_init, 0);
+        p->classes[i].free_slots = pa_flist_new(p->classes[i].n_slots);
+    }
 
     PA_LLIST_HEAD_INIT(pa_memimport, p->imports);
     PA_LLIST_HEAD_INIT(pa_memexport, p->exports);
 
+    p->stat_shards_allocated = pa_xmalloc0(STAT_SHARDS * sizeof(union stat_shard) + CACHE_LINE_SIZE);
+    p->stat_shards = (union stat_shard*) PA_ROUND_UP((uintptr_t) p->stat_shards_allocated, CACHE_LINE_SIZE);
+
     p->mutex = pa_mutex_new(TRUE, TRUE);
     p->semaphore = pa_semaphore_new(0);
 
-    p->free_slots = pa_flist_new(p->n_blocks);
+    return p;
+}
+
+pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size) {
+    return mempool_new(shared, FALSE, size);
+}
+
+/* A shared pool that other processes can only access if they are
+ * explicitly handed its file descriptor */
+pa_mempool* pa_mempool_new_memfd(size_t size) {
+    if (!pa_shm_memfd_supported())
+        return NULL;
+
+    return mempool_new(TRUE, TRUE, size);
+}
+
+pa_mempool* pa_mempool_ref(pa_mempool *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
 
+    PA_REFCNT_INC(p);
     return p;
 }
 
+/* Drops a reference, the pool is only destroyed with the last one */
 void pa_mempool_free(pa_mempool *p) {
+    unsigned i;
+
     pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (PA_REFCNT_DEC(p) > 0)
+        return;
 
     pa_mutex_lock(p->mutex);
 
@@ -770,44 +1005,49 @@ void pa_mempool_free(pa_mempool *p) {
 
     pa_mutex_unlock(p->mutex);
 
-    pa_flist_free(p->free_slots, NULL);
+    pa_mempool_get_stat(p);
 
     if (pa_atomic_load(&p->stat.n_allocated) > 0) {
 
         /* Ouch, somebody is retaining a memory block reference! */
 
 #ifdef DEBUG_REF
-        unsigned i;
-        pa_flist *list;
+        unsigned c;
 
         /* Let's try to find at least one of those leaked memory blocks */
 
-        list = pa_flist_new(p->n_blocks);
+        for (c = 0; c < p->n_classes; c++) {
+            struct mempool_slot_class *k = p->classes + c;
+            unsigned i;
+            pa_flist *list;
 
-        for (i = 0; i < (unsigned) pa_atomic_load(&p->n_init); i++) {
-            struct mempool_slot *slot;
-            pa_memblock *b, *k;
+            list = pa_flist_new(k->n_slots);
 
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) i));
-            b = mempool_slot_data(slot);
+            for (i = 0; i < (unsigned) pa_atomic_load(&k->n_init); i++) {
+                struct mempool_slot *slot;
+                pa_memblock *b, *x;
 
-            while ((k = pa_flist_pop(p->free_slots))) {
-                while (pa_flist_push(list, k) < 0)
-                    ;
+                slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + k->offset + (k->slot_size * (size_t) i));
+                b = mempool_slot_data(slot);
 
-                if (b == k)
-                    break;
-            }
+                while ((x = pa_flist_pop(k->free_slots))) {
+                    while (pa_flist_push(list, x) < 0)
+                        ;
 
-            if (!k)
-                pa_log("REF: Leaked memory block %p", b);
+                    if (b == x)
+                        break;
+                }
 
-            while ((k = pa_flist_pop(list)))
-                while (pa_flist_push(p->free_slots, k) < 0)
-                    ;
-        }
+                if (!x)
+                    pa_log("REF: Leaked memory block %p", b);
 
-        pa_flist_free(list, NULL);
+                while ((x = pa_flist_pop(list)))
+                    while (pa_flist_push(k->free_slots, x) < 0)
+                        ;
+            }
+
+            pa_flist_free(list, NULL);
+        }
 
 #endif
 
@@ -816,18 +1056,39 @@ void pa_mempool_free(pa_mempool *p) {
 /*         PA_DEBUG_TRAP; */
     }
 
+    for (i = 0; i < p->n_classes; i++)
+        pa_flist_free(p->classes[i].free_slots, NULL);
+
     pa_shm_free(&p->memory);
 
     pa_mutex_free(p->mutex);
     pa_semaphore_free(p->semaphore);
 
+    pa_xfree(p->stat_shards_allocated);
     pa_xfree(p);
 }
 
 /* No lock necessary */
 const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p) {
+    pa_atomic_t *sum, *shard;
+    unsigned i, j;
+
     pa_assert(p);
 
+    /* pa_mempool_stat is nothing but counters */
+    sum = (pa_atomic_t*) &p->stat;
+
+    for (j = 0; j < sizeof(pa_mempool_stat) / sizeof(pa_atomic_t); j++) {
+        int v = 0;
+
+        for (i = 0; i < STAT_SHARDS; i++) {
+            shard = (pa_atomic_t*) &p->stat_shards[i].stat;
+            v += pa_atomic_load(&shard[j]);
+        }
+
+        pa_atomic_store(&sum[j], v);
+    }
+
     return &p->stat;
 }
 
@@ -835,30 +1096,51 @@ const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p) {
 size_t pa_mempool_block_size_max(pa_mempool *p) {
     pa_assert(p);
 
-    return p->block_size - PA_ALIGN(sizeof(pa_memblock));
+    return p->classes[p->default_class].slot_size - PA_ALIGN(sizeof(pa_memblock));
+}
+
+/* No lock necessary */
+int pa_mempool_get_slot_class(pa_mempool *p, unsigned c, size_t *slot_size, unsigned *n_slots) {
+    pa_assert(p);
+
+    if (c >= p->n_classes)
+        return -1;
+
+    if (slot_size)
+        *slot_size = p->classes[c].slot_size;
+
+    if (n_slots)
+        *n_slots = p->classes[c].n_slots;
+
+    return 0;
 }
 
 /* No lock necessary */
 void pa_mempool_vacuum(pa_mempool *p) {
     struct mempool_slot *slot;
-    pa_flist *list;
+    unsigned c;
 
     pa_assert(p);
 
-    list = pa_flist_new(p->n_blocks);
+    for (c = 0; c < p->n_classes; c++) {
+        struct mempool_slot_class *k = p->classes + c;
+        pa_flist *list;
+
+        list = pa_flist_new(k->n_slots);
 
-    while ((slot = pa_flist_pop(p->free_slots)))
-        while (pa_flist_push(list, slot) < 0)
-            ;
+        while ((slot = pa_flist_pop(k->free_slots)))
+            while (pa_flist_push(list, slot) < 0)
+                ;
 
-    while ((slot = pa_flist_pop(list))) {
-        pa_shm_punch(&p->memory, (size_t) ((uint8_t*) slot - (uint8_t*) p->memory.ptr), p->block_size);
+        while ((slot = pa_flist_pop(list))) {
+            pa_shm_punch(&p->memory, (size_t) ((uint8_t*) slot - (uint8_t*) p->memory.ptr), k->slot_size);
 
-        while (pa_flist_push(p->free_slots, slot))
-            ;
-    }
+            while (pa_flist_push(k->free_slots, slot))
+                ;
+        }
 
-    pa_flist_free(list, NULL);
+        pa_flist_free(list, NULL);
+    }
 }
 
 /* No lock necessary */
@@ -880,6 +1162,20 @@ pa_bool_t pa_mempool_is_shared(pa_mempool *p) {
     return !!p->memory.shared;
 }
 
+/* No lock necessary */
+pa_bool_t pa_mempool_is_memfd(pa_mempool *p) {
+    pa_assert(p);
+
+    return !!p->memory.memfd;
+}
+
+/* No lock necessary. The descriptor stays owned by the pool. */
+int pa_mempool_get_memfd_fd(pa_mempool *p) {
+    pa_assert(p);
+
+    return p->memory.memfd ? p->memory.fd : -1;
+}
+
 /* For receiving blocks from other nodes */
 pa_memimport* pa_memimport_new(pa_mempool *p, pa_memimport_release_cb_t cb, void *userdata) {
     pa_memimport *i;
@@ -928,6 +1224,7 @@ static pa_memimport_segment* segment_attach(pa_memimport *i, uint32_t shm_id) {
 /* Should be called locked */
 static void segment_detach(pa_memimport_segment *seg) {
     pa_assert(seg);
+    pa_assert(seg->n_blocks == 0);
 
     pa_hashmap_remove(seg->import->segments, PA_UINT32_TO_PTR(seg->memory.id));
     pa_shm_free(&seg->memory);
@@ -942,6 +1239,7 @@ static void segment_detach(pa_memimport_segment *seg) {
 void pa_memimport_free(pa_memimport *i) {
     pa_memexport *e;
     pa_memblock *b;
+    pa_memimport_segment *seg;
 
     pa_assert(i);
 
@@ -950,7 +1248,10 @@ void pa_memimport_free(pa_memimport *i) {
     while ((b = pa_hashmap_first(i->blocks)))
         memblock_replace_import(b);
 
-    pa_assert(pa_hashmap_size(i->segments) == 0);
+    while ((seg = pa_hashmap_first(i->segments))) {
+        pa_assert(seg->permanent);
+        segment_detach(seg);
+    }
 
     pa_mutex_unlock(i->mutex);
 
@@ -972,6 +1273,47 @@ void pa_memimport_free(pa_memimport *i) {
     pa_xfree(i);
 }
 
+/* Self-locked. Makes a memfd segment of the other side available to
+ * pa_memimport_get(), takes ownership of fd. */
+int pa_memimport_attach_memfd(pa_memimport *i, uint32_t shm_id, int fd) {
+    pa_memimport_segment *seg;
+    int ret = -1;
+
+    pa_assert(i);
+    pa_assert(fd >= 0);
+
+    pa_mutex_lock(i->mutex);
+
+    if (pa_hashmap_get(i->segments, PA_UINT32_TO_PTR(shm_id)) ||
+        pa_hashmap_size(i->segments) >= PA_MEMIMPORT_SEGMENTS_MAX) {
+        pa_close(fd);
+        goto finish;
+    }
+
+    seg = pa_xnew0(pa_memimport_segment, 1);
+
+    if (pa_shm_attach_memfd(&seg->memory, shm_id, fd) < 0) {
+        pa_xfree(seg);
+        goto finish;
+    }
+
+    seg->import = i;
+    seg->permanent = TRUE;
+
+    /* A sealed segment can't be truncated by the other side, so
+     * accessing it will never SIGBUS */
+    if (!seg->memory.sealed)
+        seg->trap = pa_memtrap_add(seg->memory.ptr, seg->memory.size);
+
+    pa_hashmap_put(i->segments, PA_UINT32_TO_PTR(seg->memory.id), seg);
+    ret = 0;
+
+finish:
+    pa_mutex_unlock(i->mutex);
+
+    return ret;
+}
+
 /* Self-locked */
 pa_memblock* pa_memimport_get(pa_memimport *i, uint32_t block_id, uint32_t shm_id, size_t offset, size_t size) {
     pa_memblock *b = NULL;
@@ -1108,11 +1450,11 @@ int pa_memexport_process_release(pa_memexport *e, uint32_t id) {
 
 /*     pa_log("Processing release for %u", id); */
 
-    pa_assert(pa_atomic_load(&e->pool->stat.n_exported) > 0);
-    pa_assert(pa_atomic_load(&e->pool->stat.exported_size) >= (int) b->length);
+    pa_assert_fp(STAT_SUM(e->pool, n_exported) > 0);
+    pa_assert_fp(STAT_SUM(e->pool, exported_size) >= (int) b->length);
 
-    pa_atomic_dec(&e->pool->stat.n_exported);
-    pa_atomic_sub(&e->pool->stat.exported_size, (int) b->length);
+    pa_atomic_dec(&stat_shard(e->pool)->n_exported);
+    pa_atomic_sub(&stat_shard(e->pool)->exported_size, (int) b->length);
 
     pa_memblock_unref(b);
 
@@ -1155,12 +1497,14 @@ static pa_memblock *memblock_shared_copy(pa_mempool *p, pa_memblock *b) {
     pa_assert(p);
     pa_assert(b);
 
-    if (b->type == PA_MEMBLOCK_IMPORTED ||
-        b->type == PA_MEMBLOCK_POOL ||
-        b->type == PA_MEMBLOCK_POOL_EXTERNAL) {
-        pa_assert(b->pool == p);
+    /* Blocks from another pool, such as the private pool of a
+     * connection, and blocks imported from a memfd segment can't be
+     * referred to by ID, so they need to be copied */
+    if (b->pool == p &&
+        ((b->type == PA_MEMBLOCK_IMPORTED && !b->per_type.imported.segment->memory.memfd) ||
+         b->type == PA_MEMBLOCK_POOL ||
+         b->type == PA_MEMBLOCK_POOL_EXTERNAL))
         return pa_memblock_ref(b);
-    }
 
     if (!(n = pa_memblock_new_pool(p, b->length)))
         return NULL;
@@ -1181,7 +1525,6 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32
     pa_assert(shm_id);
     pa_assert(offset);
     pa_assert(size);
-    pa_assert(b->pool == e->pool);
 
     if (!(b = memblock_shared_copy(e->pool, b)))
         return -1;
@@ -1226,8 +1569,8 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32
 
     pa_memblock_release(b);
 
-    pa_atomic_inc(&e->pool->stat.n_exported);
-    pa_atomic_add(&e->pool->stat.exported_size, (int) b->length);
+    pa_atomic_inc(&stat_shard(e->pool)->n_exported);
+    pa_atomic_add(&stat_shard(e->pool)->exported_size, (int) b->length);
 
     return 0;
 }
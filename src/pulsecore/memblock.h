@@ -54,13 +54,17 @@ typedef struct pa_memimport_segment pa_memimport_segment;
 typedef struct pa_memimport pa_memimport;
 typedef struct pa_memexport pa_memexport;
 
+/* The pool hands out slots of up to this many different sizes */
+#define PA_MEMPOOL_SLOT_CLASSES_MAX 4
+
 typedef void (*pa_memimport_release_cb_t)(pa_memimport *i, uint32_t block_id, void *userdata);
 typedef void (*pa_memexport_revoke_cb_t)(pa_memexport *e, uint32_t block_id, void *userdata);
 
 /* Please note that updates to this structure are not locked,
  * i.e. n_allocated might be updated at a point in time where
  * n_accumulated is not yet. Take these values with a grain of salt,
- * they are here for purely statistical reasons.*/
+ * they are here for purely statistical reasons. The values are only
+ * brought up to date by pa_mempool_get_stat(). */
 struct pa_mempool_stat {
     pa_atomic_t n_allocated;
     pa_atomic_t n_accumulated;
@@ -76,6 +80,12 @@ struct pa_mempool_stat {
 
     pa_atomic_t n_allocated_by_type[PA_MEMBLOCK_TYPE_MAX];
     pa_atomic_t n_accumulated_by_type[PA_MEMBLOCK_TYPE_MAX];
+
+    /* Slots in use and ever used per slot class, and how often a
+     * class had no free slot left */
+    pa_atomic_t n_slots_allocated_by_class[PA_MEMPOOL_SLOT_CLASSES_MAX];
+    pa_atomic_t n_slots_accumulated_by_class[PA_MEMPOOL_SLOT_CLASSES_MAX];
+    pa_atomic_t n_class_full_by_class[PA_MEMPOOL_SLOT_CLASSES_MAX];
 };
 
 /* Allocate a new memory block of type PA_MEMBLOCK_MEMPOOL or PA_MEMBLOCK_APPENDED, depending on the size */
@@ -120,16 +130,22 @@ pa_memblock *pa_memblock_will_need(pa_memblock *b);
 
 /* The memory block manager */
 pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size);
+pa_mempool* pa_mempool_new_memfd(size_t size);
+pa_mempool* pa_mempool_ref(pa_mempool *p);
 void pa_mempool_free(pa_mempool *p);
 const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p);
 void pa_mempool_vacuum(pa_mempool *p);
 int pa_mempool_get_shm_id(pa_mempool *p, uint32_t *id);
 pa_bool_t pa_mempool_is_shared(pa_mempool *p);
+pa_bool_t pa_mempool_is_memfd(pa_mempool *p);
+int pa_mempool_get_memfd_fd(pa_mempool *p);
 size_t pa_mempool_block_size_max(pa_mempool *p);
+int pa_mempool_get_slot_class(pa_mempool *p, unsigned c, size_t *slot_size, unsigned *n_slots);
 
 /* For receiving blocks from other nodes */
 pa_memimport* pa_memimport_new(pa_mempool *p, pa_memimport_release_cb_t cb, void *userdata);
 void pa_memimport_free(pa_memimport *i);
+int pa_memimport_attach_memfd(pa_memimport *i, uint32_t shm_id, int fd);
 pa_memblock* pa_memimport_get(pa_memimport *i, uint32_t block_id, uint32_t shm_id, size_t offset, size_t size);
 int pa_memimport_process_revoke(pa_memimport *i, uint32_t block_id);
 
@@ -38,6 +38,14 @@
 
 /* #define MEMBLOCKQ_DEBUG */
 
+/* Writes up to this size are copied together into blocks of
+ * COALESCE_BLOCK_SIZE while the queue is in ring mode */
+#define COALESCE_BLOCK_SIZE ((size_t) 4096)
+#define COALESCE_MAX (COALESCE_BLOCK_SIZE/4)
+
+#define RING_SIZE_MIN 16U
+
+/* In ring mode the entries live in bq->ring and next/prev are unused */
 struct list_item {
     struct list_item *next, *prev;
     int64_t index;
@@ -50,6 +58,11 @@ struct pa_memblockq {
     struct list_item *blocks, *blocks_tail;
     struct list_item *current_read, *current_write;
     unsigned n_blocks;
+    pa_bool_t use_ring, no_ring;
+    struct list_item *ring;
+    unsigned ring_size, ring_first;
+    pa_memblock *append_block;
+    size_t append_index;
     size_t maxlength, tlength, base, prebuf, minreq, maxrewind;
     int64_t read_index, write_index;
     pa_bool_t in_prebuf;
@@ -82,6 +95,13 @@ pa_memblockq* pa_memblockq_new(
     bq->current_read = bq->current_write = NULL;
     bq->n_blocks = 0;
 
+    bq->no_ring = !!getenv("PULSE_NO_MEMBLOCKQ_RING");
+    bq->use_ring = !bq->no_ring;
+    bq->ring = NULL;
+    bq->ring_size = bq->ring_first = 0;
+    bq->append_block = NULL;
+    bq->append_index = 0;
+
     bq->sample_spec = *sample_spec;
     bq->base = pa_frame_size(sample_spec);
     bq->read_index = bq->write_index = idx;
@@ -124,13 +144,158 @@ void pa_memblockq_free(pa_memblockq* bq) {
     if (bq->mcalign)
         pa_mcalign_free(bq->mcalign);
 
+    pa_xfree(bq->ring);
     pa_xfree(bq->name);
     pa_xfree(bq);
 }
 
+static inline struct list_item *ring_item(pa_memblockq *bq, unsigned i) {
+    return bq->ring + ((bq->ring_first + i) & (bq->ring_size - 1));
+}
+
+static inline unsigned ring_pos(pa_memblockq *bq, struct list_item *q) {
+    return ((unsigned) (q - bq->ring) - bq->ring_first) & (bq->ring_size - 1);
+}
+
+static struct list_item *first_item(pa_memblockq *bq) {
+    if (bq->use_ring)
+        return bq->n_blocks > 0 ? ring_item(bq, 0) : NULL;
+
+    return bq->blocks;
+}
+
+static struct list_item *last_item(pa_memblockq *bq) {
+    if (bq->use_ring)
+        return bq->n_blocks > 0 ? ring_item(bq, bq->n_blocks - 1) : NULL;
+
+    return bq->blocks_tail;
+}
+
+static struct list_item *next_item(pa_memblockq *bq, struct list_item *q) {
+    unsigned i;
+
+    if (!bq->use_ring)
+        return q->next;
+
+    i = ring_pos(bq, q) + 1;
+    return i < bq->n_blocks ? ring_item(bq, i) : NULL;
+}
+
+static void ring_grow(pa_memblockq *bq) {
+    struct list_item *ring;
+    unsigned size, i, pos = 0;
+
+    size = bq->ring_size > 0 ? bq->ring_size * 2 : RING_SIZE_MIN;
+    ring = pa_xnew(struct list_item, size);
+
+    if (bq->current_read)
+        pos = ring_pos(bq, bq->current_read);
+
+    for (i = 0; i < bq->n_blocks; i++)
+        ring[i] = *ring_item(bq, i);
+
+    if (bq->current_read)
+        bq->current_read = ring + pos;
+
+    pa_xfree(bq->ring);
+    bq->ring = ring;
+    bq->ring_size = size;
+    bq->ring_first = 0;
+}
+
+/* Moves all entries over to the list, which can deal with writes into
+ * the middle of the queue */
+static void ring_to_list(pa_memblockq *bq) {
+    struct list_item *current_read = NULL;
+    unsigned i;
+
+    pa_assert(bq->use_ring);
+    pa_assert(!bq->blocks);
+
+    for (i = 0; i < bq->n_blocks; i++) {
+        struct list_item *q, *n;
+
+        q = ring_item(bq, i);
+
+        if (!(n = pa_flist_pop(PA_STATIC_FLIST_GET(list_items))))
+            n = pa_xnew(struct list_item, 1);
+
+        n->index = q->index;
+        n->chunk = q->chunk;
+
+        n->next = NULL;
+        if ((n->prev = bq->blocks_tail))
+            n->prev->next = n;
+        else
+            bq->blocks = n;
+        bq->blocks_tail = n;
+
+        if (q == bq->current_read)
+            current_read = n;
+    }
+
+    bq->current_read = current_read;
+    bq->current_write = NULL;
+    bq->ring_first = 0;
+    bq->use_ring = FALSE;
+
+    if (bq->append_block) {
+        pa_memblock_unref(bq->append_block);
+        bq->append_block = NULL;
+    }
+
+    pa_log_debug("[%s] Write into the middle of the queue, switching from ring to list.", bq->name);
+}
+
+static void fix_current_read_ring(pa_memblockq *bq) {
+    struct list_item *q;
+    unsigned l, r;
+
+    if (PA_UNLIKELY(bq->n_blocks <= 0)) {
+        bq->current_read = NULL;
+        return;
+    }
+
+    /* Usually we are still in the same entry or just moved on to the
+     * next one */
+    if (PA_LIKELY((q = bq->current_read) != NULL) && PA_LIKELY(q->index <= bq->read_index)) {
+
+        if (bq->read_index < q->index + (int64_t) q->chunk.length)
+            return;
+
+        if ((q = next_item(bq, q)) && bq->read_index < q->index + (int64_t) q->chunk.length) {
+            bq->current_read = q;
+            return;
+        }
+    }
+
+    /* After a rewind or a longer jump look up the first entry that
+     * has not been played completely */
+    l = 0;
+    r = bq->n_blocks;
+
+    while (l < r) {
+        unsigned m = l + (r - l) / 2;
+
+        q = ring_item(bq, m);
+
+        if (q->index + (int64_t) q->chunk.length <= bq->read_index)
+            l = m + 1;
+        else
+            r = m;
+    }
+
+    bq->current_read = l < bq->n_blocks ? ring_item(bq, l) : NULL;
+}
+
 static void fix_current_read(pa_memblockq *bq) {
     pa_assert(bq);
 
+    if (bq->use_ring) {
+        fix_current_read_ring(bq);
+        return;
+    }
+
     if (PA_UNLIKELY(!bq->blocks)) {
         bq->current_read = NULL;
         return;
@@ -190,6 +355,20 @@ static void drop_block(pa_memblockq *bq, struct list_item *q) {
 
     pa_assert(bq->n_blocks >= 1);
 
+    if (bq->use_ring) {
+        /* Entries only ever leave the ring at the front */
+        pa_assert(q == ring_item(bq, 0));
+
+        if (bq->current_read == q)
+            bq->current_read = next_item(bq, q);
+
+        pa_memblock_unref(q->chunk.memblock);
+
+        bq->ring_first = (bq->ring_first + 1) & (bq->ring_size - 1);
+        bq->n_blocks--;
+        return;
+    }
+
     if (q->prev)
         q->prev->next = q->next;
     else {
@@ -219,16 +398,18 @@ static void drop_block(pa_memblockq *bq, struct list_item *q) {
 }
 
 static void drop_backlog(pa_memblockq *bq) {
+    struct list_item *q;
     int64_t boundary;
     pa_assert(bq);
 
     boundary = bq->read_index - (int64_t) bq->maxrewind;
 
-    while (bq->blocks && (bq->blocks->index + (int64_t) bq->blocks->chunk.length <= boundary))
-        drop_block(bq, bq->blocks);
+    while ((q = first_item(bq)) && (q->index + (int64_t) q->chunk.length <= boundary))
+        drop_block(bq, q);
 }
 
 static pa_bool_t can_push(pa_memblockq *bq, size_t l) {
+    struct list_item *q;
     int64_t end;
 
     pa_assert(bq);
@@ -242,7 +423,8 @@ static pa_bool_t can_push(pa_memblockq *bq, size_t l) {
             return TRUE;
     }
 
-    end = bq->blocks_tail ? bq->blocks_tail->index + (int64_t) bq->blocks_tail->chunk.length : bq->write_index;
+    q = last_item(bq);
+    end = q ? q->index + (int64_t) q->chunk.length : bq->write_index;
 
     /* Make sure that the list doesn't get too long */
     if (bq->write_index + (int64_t) l > end)
@@ -282,6 +464,84 @@ static void read_index_changed(pa_memblockq *bq, int64_t old_read_index) {
 #endif
 }
 
+/* Copies a small chunk into the block we are currently filling, so that
+ * a writer doing lots of tiny writes leaves a few large entries in the
+ * queue instead of one entry and one pinned memblock per write. The
+ * block is marked as silence as long as everything in it is. */
+static void coalesce(pa_memblockq *bq, pa_memchunk *chunk) {
+    void *src, *dst;
+    pa_bool_t silence;
+
+    if (chunk->length > COALESCE_MAX)
+        return;
+
+    silence = pa_memblock_is_silence(chunk->memblock);
+
+    if (!bq->append_block || bq->append_index + chunk->length > pa_memblock_get_length(bq->append_block)) {
+
+        if (bq->append_block)
+            pa_memblock_unref(bq->append_block);
+
+        bq->append_block = pa_memblock_new(pa_memblock_get_pool(chunk->memblock), COALESCE_BLOCK_SIZE);
+        bq->append_index = 0;
+
+        pa_memblock_set_is_silence(bq->append_block, silence);
+    } else if (!silence)
+        pa_memblock_set_is_silence(bq->append_block, FALSE);
+
+    src = pa_memblock_acquire(chunk->memblock);
+    dst = pa_memblock_acquire(bq->append_block);
+    memcpy((uint8_t*) dst + bq->append_index, (uint8_t*) src + chunk->index, chunk->length);
+    pa_memblock_release(bq->append_block);
+    pa_memblock_release(chunk->memblock);
+
+    chunk->memblock = bq->append_block;
+    chunk->index = bq->append_index;
+    bq->append_index += chunk->length;
+}
+
+/* Appends at or after the end of the queue. Nothing in the queue is
+ * touched, so unlike the list case this never needs to truncate or
+ * split entries */
+static pa_bool_t extend_last(pa_memblockq *bq, struct list_item *q, const pa_memchunk *chunk) {
+    if (!q ||
+        q->chunk.memblock != chunk->memblock ||
+        q->chunk.index + q->chunk.length != chunk->index ||
+        bq->write_index != q->index + (int64_t) q->chunk.length)
+        return FALSE;
+
+    q->chunk.length += chunk->length;
+    bq->write_index += (int64_t) chunk->length;
+    return TRUE;
+}
+
+static void push_ring(pa_memblockq *bq, pa_memchunk *chunk) {
+    struct list_item *q, *n;
+
+    q = last_item(bq);
+
+    /* A chunk continuing the last one in the same block needs no copy */
+    if (extend_last(bq, q, chunk))
+        return;
+
+    coalesce(bq, chunk);
+
+    if (extend_last(bq, q, chunk))
+        return;
+
+    if (bq->n_blocks >= bq->ring_size)
+        ring_grow(bq);
+
+    n = ring_item(bq, bq->n_blocks);
+    n->next = n->prev = NULL;
+    n->chunk = *chunk;
+    pa_memblock_ref(n->chunk.memblock);
+    n->index = bq->write_index;
+    bq->write_index += (int64_t) n->chunk.length;
+
+    bq->n_blocks++;
+}
+
 int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
     struct list_item *q, *n;
     pa_memchunk chunk;
@@ -302,6 +562,17 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
     old = bq->write_index;
     chunk = *uchunk;
 
+    if (bq->use_ring) {
+        q = last_item(bq);
+
+        if (!q || bq->write_index >= q->index + (int64_t) q->chunk.length) {
+            push_ring(bq, &chunk);
+            goto finish;
+        }
+
+        ring_to_list(bq);
+    }
+
     fix_current_write(bq);
     q = bq->current_write;
 
@@ -362,6 +633,7 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
 
                 /* Drop it from the new entry */
                 p->index = q->index + (int64_t) d;
+                p->chunk.index += d;
                 p->chunk.length -= d;
 
                 /* Add it to the list */
@@ -590,7 +862,7 @@ int pa_memblockq_peek_fixed_size(pa_memblockq *bq, size_t block_size, pa_memchun
             tchunk.length -= (size_t) d;
 
             /* Go to next item for the next iteration */
-            item = item->next;
+            item = next_item(bq, item);
         }
 
         rchunk.length = tchunk.length = PA_MIN(tchunk.length, block_size - rchunk.index);
@@ -713,9 +985,12 @@ void pa_memblockq_seek(pa_memblockq *bq, int64_t offset, pa_seek_mode_t seek, pa
         case PA_SEEK_RELATIVE_ON_READ:
             bq->write_index = bq->read_index + offset;
             break;
-        case PA_SEEK_RELATIVE_END:
-            bq->write_index = (bq->blocks_tail ? bq->blocks_tail->index + (int64_t) bq->blocks_tail->chunk.length : bq->read_index) + offset;
+        case PA_SEEK_RELATIVE_END: {
+            struct list_item *q = last_item(bq);
+
+            bq->write_index = (q ? q->index + (int64_t) q->chunk.length : bq->read_index) + offset;
             break;
+        }
         default:
             pa_assert_not_reached();
     }
@@ -987,7 +1262,7 @@ void pa_memblockq_willneed(pa_memblockq *bq) {
 
     fix_current_read(bq);
 
-    for (q = bq->current_read; q; q = q->next)
+    for (q = bq->current_read; q; q = next_item(bq, q))
         pa_memchunk_will_need(&q->chunk);
 }
 
@@ -1007,16 +1282,54 @@ void pa_memblockq_set_silence(pa_memblockq *bq, pa_memchunk *silence) {
 pa_bool_t pa_memblockq_is_empty(pa_memblockq *bq) {
     pa_assert(bq);
 
-    return !bq->blocks;
+    return bq->n_blocks <= 0;
 }
 
 void pa_memblockq_silence(pa_memblockq *bq) {
+    struct list_item *q;
+
     pa_assert(bq);
 
-    while (bq->blocks)
-        drop_block(bq, bq->blocks);
+    while ((q = first_item(bq)))
+        drop_block(bq, q);
 
     pa_assert(bq->n_blocks == 0);
+
+    if (bq->append_block) {
+        pa_memblock_unref(bq->append_block);
+        bq->append_block = NULL;
+    }
+
+    /* Once the queue is empty a writer that seeked backwards before
+     * may use the ring again */
+    bq->use_ring = !bq->no_ring;
+    bq->ring_first = 0;
+}
+
+size_t pa_memblockq_trim(pa_memblockq *bq) {
+    size_t size = 0;
+
+    pa_assert(bq);
+
+    if (bq->n_blocks > 0)
+        return 0;
+
+    if (bq->append_block) {
+        size += pa_memblock_get_length(bq->append_block);
+        pa_memblock_unref(bq->append_block);
+        bq->append_block = NULL;
+    }
+
+    if (bq->ring) {
+        size += bq->ring_size * sizeof(struct list_item);
+        pa_xfree(bq->ring);
+        bq->ring = NULL;
+        bq->ring_size = bq->ring_first = 0;
+    }
+
+    bq->current_read = bq->current_write = NULL;
+
+    return size;
 }
 
 unsigned pa_memblockq_get_nblocks(pa_memblockq *bq) {
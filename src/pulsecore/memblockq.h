@@ -33,7 +33,14 @@
  * perfect). It is similar to the ring buffers used by most other
  * audio software. In contrast to a ring buffer this memblockq data
  * type doesn't need to copy any data around, it just maintains
- * references to reference counted memory blocks. */
+ * references to reference counted memory blocks.
+ *
+ * As long as the writer only appends, the references are kept in a
+ * contiguous ring, and writes that are very small are copied together
+ * into larger blocks, so that lots of tiny client writes don't leave
+ * thousands of entries in the queue. The first write into data that is
+ * already queued switches the queue over to a linked list until it is
+ * flushed. Set $PULSE_NO_MEMBLOCKQ_RING to always use the list. */
 
 typedef struct pa_memblockq pa_memblockq;
 
@@ -184,6 +191,10 @@ pa_bool_t pa_memblockq_is_empty(pa_memblockq *bq);
 /* Drop everything in the queue, but don't modify the indexes */
 void pa_memblockq_silence(pa_memblockq *bq);
 
+/* Free the memory an empty queue keeps around for future writes.
+ * Returns the number of bytes freed. */
+size_t pa_memblockq_trim(pa_memblockq *bq);
+
 /* Check whether we currently are in prebuf state */
 pa_bool_t pa_memblockq_prebuf_active(pa_memblockq *bq);
 
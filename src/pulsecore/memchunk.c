@@ -34,12 +34,20 @@
 #include "memchunk.h"
 
 pa_memchunk* pa_memchunk_make_writable(pa_memchunk *c, size_t min) {
+    pa_assert(c);
+    pa_assert(c->memblock);
+
+    return pa_memchunk_make_writable_pool(c, pa_memblock_get_pool(c->memblock), min);
+}
+
+pa_memchunk* pa_memchunk_make_writable_pool(pa_memchunk *c, pa_mempool *pool, size_t min) {
     pa_memblock *n;
     size_t l;
     void *tdata, *sdata;
 
     pa_assert(c);
     pa_assert(c->memblock);
+    pa_assert(pool);
 
     if (pa_memblock_ref_is_one(c->memblock) &&
         !pa_memblock_is_read_only(c->memblock) &&
@@ -48,7 +56,7 @@ pa_memchunk* pa_memchunk_make_writable(pa_memchunk *c, size_t min) {
 
     l = PA_MAX(c->length, min);
 
-    n = pa_memblock_new(pa_memblock_get_pool(c->memblock), l);
+    n = pa_memblock_new(pool, l);
 
     sdata = pa_memblock_acquire(c->memblock);
     tdata = pa_memblock_acquire(n);
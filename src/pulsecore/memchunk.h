@@ -23,6 +23,7 @@
 ***/
 
 typedef struct pa_memchunk pa_memchunk;
+struct pa_mempool;
 
 #include <pulsecore/memblock.h>
 
@@ -42,6 +43,10 @@ struct pa_memchunk {
  * specified size, i.e. is enlarged if necessary. */
 pa_memchunk* pa_memchunk_make_writable(pa_memchunk *c, size_t min);
 
+/* Same as pa_memchunk_make_writable(), but a copy is allocated from
+ * the specified pool instead of the one of the original memblock */
+pa_memchunk* pa_memchunk_make_writable_pool(pa_memchunk *c, struct pa_mempool *pool, size_t min);
+
 /* Invalidate a memchunk. This does not free the containing memblock,
  * but sets all members to zero. */
 pa_memchunk* pa_memchunk_reset(pa_memchunk *c);
@@ -0,0 +1,187 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-x86.h"
+
+#include "sample-util.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+#include <immintrin.h>
+
+static pa_do_mix_func_t fallback_s16ne, fallback_s32ne, fallback_float32ne;
+
+/* See mix_sse.c */
+static size_t vector_samples(size_t n, unsigned channels, unsigned width) {
+    unsigned a = channels, b = width;
+
+    while (b) {
+        unsigned t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return n - n % (channels / a * width);
+}
+
+static void pa_mix_s16ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    size_t n, k;
+    unsigned channel = 0, advance = 8 % channels;
+
+    n = vector_samples(((uint8_t*) end - (uint8_t*) data) / sizeof(int16_t), channels, 8);
+
+    for (k = 0; k < n; k += 8) {
+        __m256i sum = _mm256_setzero_si256();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            __m256i cv, v, hi, lo;
+
+            cv = _mm256_loadu_si256((const __m256i*) &m->linear[channel].i);
+            v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) m->ptr));
+
+            /* Same split as the C version: both partial products fit
+             * into 32 bits once the samples are widened */
+            hi = _mm256_srai_epi32(cv, 16);
+            lo = _mm256_and_si256(cv, _mm256_set1_epi32(0xFFFF));
+
+            sum = _mm256_add_epi32(sum, _mm256_srai_epi32(_mm256_mullo_epi32(v, lo), 16));
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(v, hi));
+
+            m->ptr = (uint8_t*) m->ptr + 8 * sizeof(int16_t);
+        }
+
+        _mm_storeu_si128((__m128i*) data, _mm_packs_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1)));
+        data = (uint8_t*) data + 8 * sizeof(int16_t);
+
+        channel += advance;
+        if (channel >= channels)
+            channel -= channels;
+    }
+
+    if (data < end)
+        fallback_s16ne(streams, nstreams, channels, data, end);
+}
+
+static void pa_mix_s32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    size_t n, k;
+    unsigned channel = 0, advance = 4 % channels;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max = _mm256_set1_epi64x(0x7FFFFFFFLL);
+    const __m256i min = _mm256_set1_epi64x(-0x80000000LL);
+    const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+    n = vector_samples(((uint8_t*) end - (uint8_t*) data) / sizeof(int32_t), channels, 4);
+
+    for (k = 0; k < n; k += 4) {
+        __m256i sum = _mm256_setzero_si256();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            __m256i cv, v;
+
+            cv = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*) &m->linear[channel].i));
+            v = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*) m->ptr));
+            v = _mm256_mul_epi32(v, cv);
+
+            /* There is no 64bit arithmetic shift before AVX-512, so
+             * shift logically and put the sign bits back in */
+            v = _mm256_or_si256(_mm256_srli_epi64(v, 16), _mm256_slli_epi64(_mm256_cmpgt_epi64(zero, v), 48));
+            sum = _mm256_add_epi64(sum, v);
+
+            m->ptr = (uint8_t*) m->ptr + 4 * sizeof(int32_t);
+        }
+
+        sum = _mm256_blendv_epi8(sum, max, _mm256_cmpgt_epi64(sum, max));
+        sum = _mm256_blendv_epi8(sum, min, _mm256_cmpgt_epi64(min, sum));
+
+        _mm_storeu_si128((__m128i*) data, _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(sum, even)));
+        data = (uint8_t*) data + 4 * sizeof(int32_t);
+
+        channel += advance;
+        if (channel >= channels)
+            channel -= channels;
+    }
+
+    if (data < end)
+        fallback_s32ne(streams, nstreams, channels, data, end);
+}
+
+static void pa_mix_float32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    size_t n, k;
+    unsigned channel = 0, advance = 8 % channels;
+    const __m256 zero = _mm256_setzero_ps();
+
+    n = vector_samples(((uint8_t*) end - (uint8_t*) data) / sizeof(float), channels, 8);
+
+    for (k = 0; k < n; k += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            __m256 cv, v;
+
+            cv = _mm256_loadu_ps(&m->linear[channel].f);
+            v = _mm256_mul_ps(_mm256_loadu_ps((const float*) m->ptr), cv);
+
+            /* No FMA here, the C version rounds after the multiply */
+            sum = _mm256_add_ps(sum, _mm256_and_ps(v, _mm256_cmp_ps(cv, zero, _CMP_GT_OQ)));
+
+            m->ptr = (uint8_t*) m->ptr + 8 * sizeof(float);
+        }
+
+        _mm256_storeu_ps((float*) data, sum);
+        data = (uint8_t*) data + 8 * sizeof(float);
+
+        channel += advance;
+        if (channel >= channels)
+            channel -= channels;
+    }
+
+    if (data < end)
+        fallback_float32ne(streams, nstreams, channels, data, end);
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_mix_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized mixing functions.");
+
+        fallback_s16ne = pa_get_mix_func(PA_SAMPLE_S16NE);
+        fallback_s32ne = pa_get_mix_func(PA_SAMPLE_S32NE);
+        fallback_float32ne = pa_get_mix_func(PA_SAMPLE_FLOAT32NE);
+
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_avx2);
+        pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_avx2);
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_avx2);
+    }
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
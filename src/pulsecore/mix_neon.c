@@ -0,0 +1,186 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-arm.h"
+
+#include "sample-util.h"
+
+#if (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__)
+
+#include <arm_neon.h>
+
+static pa_do_mix_func_t fallback_s16ne, fallback_s32ne, fallback_float32ne;
+
+/* See mix_sse.c */
+static size_t vector_samples(size_t n, unsigned channels, unsigned width) {
+    unsigned a = channels, b = width;
+
+    while (b) {
+        unsigned t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return n - n % (channels / a * width);
+}
+
+static void pa_mix_s16ne_neon(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    size_t n, k;
+    unsigned channel = 0, advance = 8 % channels;
+    const int32x4_t mask = vdupq_n_s32(0xFFFF);
+
+    n = vector_samples(((uint8_t*) end - (uint8_t*) data) / sizeof(int16_t), channels, 8);
+
+    for (k = 0; k < n; k += 8) {
+        int32x4_t sum_lo = vdupq_n_s32(0), sum_hi = vdupq_n_s32(0);
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32x4_t cv0, cv1, v0, v1;
+            int16x8_t v;
+
+            cv0 = vld1q_s32(&m->linear[channel].i);
+            cv1 = vld1q_s32(&m->linear[channel + 4].i);
+
+            v = vld1q_s16((const int16_t*) m->ptr);
+            v0 = vmovl_s16(vget_low_s16(v));
+            v1 = vmovl_s16(vget_high_s16(v));
+
+            /* Same split of the volume factor as the C version */
+            sum_lo = vaddq_s32(sum_lo, vshrq_n_s32(vmulq_s32(v0, vandq_s32(cv0, mask)), 16));
+            sum_hi = vaddq_s32(sum_hi, vshrq_n_s32(vmulq_s32(v1, vandq_s32(cv1, mask)), 16));
+            sum_lo = vaddq_s32(sum_lo, vmulq_s32(v0, vshrq_n_s32(cv0, 16)));
+            sum_hi = vaddq_s32(sum_hi, vmulq_s32(v1, vshrq_n_s32(cv1, 16)));
+
+            m->ptr = (uint8_t*) m->ptr + 8 * sizeof(int16_t);
+        }
+
+        /* Saturating narrow does the clamping */
+        vst1q_s16((int16_t*) data, vcombine_s16(vqmovn_s32(sum_lo), vqmovn_s32(sum_hi)));
+        data = (uint8_t*) data + 8 * sizeof(int16_t);
+
+        channel += advance;
+        if (channel >= channels)
+            channel -= channels;
+    }
+
+    if (data < end)
+        fallback_s16ne(streams, nstreams, channels, data, end);
+}
+
+static void pa_mix_s32ne_neon(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    size_t n, k;
+    unsigned channel = 0, advance = 4 % channels;
+
+    n = vector_samples(((uint8_t*) end - (uint8_t*) data) / sizeof(int32_t), channels, 4);
+
+    for (k = 0; k < n; k += 4) {
+        int64x2_t sum_lo = vdupq_n_s64(0), sum_hi = vdupq_n_s64(0);
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32x4_t cv, v;
+
+            cv = vld1q_s32(&m->linear[channel].i);
+            v = vld1q_s32((const int32_t*) m->ptr);
+
+            sum_lo = vaddq_s64(sum_lo, vshrq_n_s64(vmull_s32(vget_low_s32(v), vget_low_s32(cv)), 16));
+            sum_hi = vaddq_s64(sum_hi, vshrq_n_s64(vmull_s32(vget_high_s32(v), vget_high_s32(cv)), 16));
+
+            m->ptr = (uint8_t*) m->ptr + 4 * sizeof(int32_t);
+        }
+
+        vst1q_s32((int32_t*) data, vcombine_s32(vqmovn_s64(sum_lo), vqmovn_s64(sum_hi)));
+        data = (uint8_t*) data + 4 * sizeof(int32_t);
+
+        channel += advance;
+        if (channel >= channels)
+            channel -= channels;
+    }
+
+    if (data < end)
+        fallback_s32ne(streams, nstreams, channels, data, end);
+}
+
+static void pa_mix_float32ne_neon(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    size_t n, k;
+    unsigned channel = 0, advance = 4 % channels;
+    const float32x4_t zero = vdupq_n_f32(0);
+
+    n = vector_samples(((uint8_t*) end - (uint8_t*) data) / sizeof(float), channels, 4);
+
+    for (k = 0; k < n; k += 4) {
+        float32x4_t sum = vdupq_n_f32(0);
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            float32x4_t cv, v;
+            uint32x4_t gt;
+
+            cv = vld1q_f32(&m->linear[channel].f);
+            v = vmulq_f32(vld1q_f32((const float*) m->ptr), cv);
+            gt = vcgtq_f32(cv, zero);
+
+            sum = vaddq_f32(sum, vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(v), gt)));
+
+            m->ptr = (uint8_t*) m->ptr + 4 * sizeof(float);
+        }
+
+        vst1q_f32((float*) data, sum);
+        data = (uint8_t*) data + 4 * sizeof(float);
+
+        channel += advance;
+        if (channel >= channels)
+            channel -= channels;
+    }
+
+    if (data < end)
+        fallback_float32ne(streams, nstreams, channels, data, end);
+}
+
+#endif /* (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__) */
+
+void pa_mix_func_init_neon(pa_cpu_arm_flag_t flags) {
+#if (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__)
+    if (flags & PA_CPU_ARM_NEON) {
+        pa_log_info("Initialising NEON optimized mixing functions.");
+
+        fallback_s16ne = pa_get_mix_func(PA_SAMPLE_S16NE);
+        fallback_s32ne = pa_get_mix_func(PA_SAMPLE_S32NE);
+        fallback_float32ne = pa_get_mix_func(PA_SAMPLE_FLOAT32NE);
+
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_neon);
+        pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_neon);
+
+        /* NEON flushes denormals to zero, which is the only deviation
+         * from the C version */
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_neon);
+    }
+#endif /* (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__) */
+}
@@ -0,0 +1,157 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-x86.h"
+
+#include "sample-util.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+#include <emmintrin.h>
+
+static pa_do_mix_func_t fallback_s16ne, fallback_float32ne;
+
+/* The vector loops only handle whole multiples of both the vector width
+ * and the frame size, so that the C fallback can pick up the rest
+ * starting at the first channel again. */
+static size_t vector_samples(size_t n, unsigned channels, unsigned width) {
+    unsigned a = channels, b = width;
+
+    while (b) {
+        unsigned t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return n - n % (channels / a * width);
+}
+
+static void pa_mix_s16ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    size_t n, k;
+    unsigned channel = 0, advance = 8 % channels;
+
+    n = vector_samples(((uint8_t*) end - (uint8_t*) data) / sizeof(int16_t), channels, 8);
+
+    for (k = 0; k < n; k += 8) {
+        __m128i sum_lo = _mm_setzero_si128(), sum_hi = _mm_setzero_si128();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            const __m128i *cv = (const __m128i*) &m->linear[channel].i;
+            __m128i cv0, cv1, hi, lo, v, t, p_lo, p_hi;
+
+            /* Split the 32bit volume factors into a signed 16bit high
+             * part and the low part reinterpreted as signed 16bit */
+            cv0 = _mm_loadu_si128(cv);
+            cv1 = _mm_loadu_si128(cv + 1);
+            hi = _mm_packs_epi32(_mm_srai_epi32(cv0, 16), _mm_srai_epi32(cv1, 16));
+            lo = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(cv0, 16), 16),
+                                 _mm_srai_epi32(_mm_slli_epi32(cv1, 16), 16));
+
+            v = _mm_loadu_si128((const __m128i*) m->ptr);
+
+            /* (v * lo) >> 16 with lo unsigned: correct the signed high
+             * product by v wherever the top bit of lo is set */
+            t = _mm_add_epi16(_mm_mulhi_epi16(v, lo), _mm_and_si128(v, _mm_srai_epi16(lo, 15)));
+
+            /* v * hi as full 32bit products */
+            p_lo = _mm_mullo_epi16(v, hi);
+            p_hi = _mm_mulhi_epi16(v, hi);
+
+            sum_lo = _mm_add_epi32(sum_lo, _mm_unpacklo_epi16(p_lo, p_hi));
+            sum_hi = _mm_add_epi32(sum_hi, _mm_unpackhi_epi16(p_lo, p_hi));
+            sum_lo = _mm_add_epi32(sum_lo, _mm_srai_epi32(_mm_unpacklo_epi16(t, t), 16));
+            sum_hi = _mm_add_epi32(sum_hi, _mm_srai_epi32(_mm_unpackhi_epi16(t, t), 16));
+
+            m->ptr = (uint8_t*) m->ptr + 8 * sizeof(int16_t);
+        }
+
+        /* Saturating pack does the clamping */
+        _mm_storeu_si128((__m128i*) data, _mm_packs_epi32(sum_lo, sum_hi));
+        data = (uint8_t*) data + 8 * sizeof(int16_t);
+
+        channel += advance;
+        if (channel >= channels)
+            channel -= channels;
+    }
+
+    if (data < end)
+        fallback_s16ne(streams, nstreams, channels, data, end);
+}
+
+static void pa_mix_float32ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    size_t n, k;
+    unsigned channel = 0, advance = 4 % channels;
+    const __m128 zero = _mm_setzero_ps();
+
+    n = vector_samples(((uint8_t*) end - (uint8_t*) data) / sizeof(float), channels, 4);
+
+    for (k = 0; k < n; k += 4) {
+        __m128 sum = _mm_setzero_ps();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            __m128 cv, v;
+
+            cv = _mm_loadu_ps(&m->linear[channel].f);
+            v = _mm_mul_ps(_mm_loadu_ps((const float*) m->ptr), cv);
+
+            /* Channels with a zero factor are skipped entirely by the C
+             * version, so mask them instead of adding v * 0 */
+            sum = _mm_add_ps(sum, _mm_and_ps(v, _mm_cmpgt_ps(cv, zero)));
+
+            m->ptr = (uint8_t*) m->ptr + 4 * sizeof(float);
+        }
+
+        _mm_storeu_ps((float*) data, sum);
+        data = (uint8_t*) data + 4 * sizeof(float);
+
+        channel += advance;
+        if (channel >= channels)
+            channel -= channels;
+    }
+
+    if (data < end)
+        fallback_float32ne(streams, nstreams, channels, data, end);
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_mix_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+    if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized mixing functions.");
+
+        fallback_s16ne = pa_get_mix_func(PA_SAMPLE_S16NE);
+        fallback_float32ne = pa_get_mix_func(PA_SAMPLE_FLOAT32NE);
+
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_sse2);
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_sse2);
+    }
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
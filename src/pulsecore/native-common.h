@@ -176,6 +176,12 @@ enum {
     /* Supported since protocol v27 (3.0) */
     PA_COMMAND_SET_PORT_LATENCY_OFFSET,
 
+    /* Supported since protocol v28 (4.0) */
+    PA_COMMAND_PLAYBACK_RING_DOORBELL,
+
+    /* Supported since protocol v31 (4.0) */
+    PA_COMMAND_GET_LATENCY_STATS,
+
     PA_COMMAND_MAX
 };
 
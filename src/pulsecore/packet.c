@@ -27,19 +27,33 @@
 
 #include <pulse/xmalloc.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/flist.h>
 
 #include "packet.h"
 
+/* Packets of up to this size are allocated with room for exactly this
+ * much data, and recycled */
+#define POOLED_SIZE (4*1024)
+
+PA_STATIC_FLIST_DECLARE(packets, 32, pa_xfree);
+
 pa_packet* pa_packet_new(size_t length) {
     pa_packet *p;
 
     pa_assert(length > 0);
 
-    p = pa_xmalloc(PA_ALIGN(sizeof(pa_packet)) + length);
+    if (length <= POOLED_SIZE) {
+        if (!(p = pa_flist_pop(PA_STATIC_FLIST_GET(packets))))
+            p = pa_xmalloc(PA_ALIGN(sizeof(pa_packet)) + POOLED_SIZE);
+        p->type = PA_PACKET_POOLED;
+    } else {
+        p = pa_xmalloc(PA_ALIGN(sizeof(pa_packet)) + length);
+        p->type = PA_PACKET_APPENDED;
+    }
+
     PA_REFCNT_INIT(p);
     p->length = length;
     p->data = (uint8_t*) p + PA_ALIGN(sizeof(pa_packet));
-    p->type = PA_PACKET_APPENDED;
 
     return p;
 }
@@ -74,6 +88,9 @@ void pa_packet_unref(pa_packet *p) {
     if (PA_REFCNT_DEC(p) <= 0) {
         if (p->type == PA_PACKET_DYNAMIC)
             pa_xfree(p->data);
-        pa_xfree(p);
+
+        if (p->type != PA_PACKET_POOLED ||
+            pa_flist_push(PA_STATIC_FLIST_GET(packets), p) < 0)
+            pa_xfree(p);
     }
 }
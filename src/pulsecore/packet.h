@@ -29,7 +29,7 @@
 
 typedef struct pa_packet {
     PA_REFCNT_DECLARE;
-    enum { PA_PACKET_APPENDED, PA_PACKET_DYNAMIC } type;
+    enum { PA_PACKET_APPENDED, PA_PACKET_DYNAMIC, PA_PACKET_POOLED } type;
     size_t length;
     uint8_t *data;
 } pa_packet;
@@ -44,8 +44,6 @@
 
 /* #define DEBUG_OPCODES */
 
-#ifdef DEBUG_OPCODES
-
 static const char *command_names[PA_COMMAND_MAX] = {
     /* Generic commands */
     [PA_COMMAND_ERROR] = "ERROR",
@@ -157,7 +155,7 @@ static const char *command_names[PA_COMMAND_MAX] = {
 
     /* Supported since protocol v13 (0.9.11) */
     [PA_COMMAND_UPDATE_RECORD_STREAM_PROPLIST] = "UPDATE_RECORD_STREAM_PROPLIST",
-    [PA_COMMAND_UPDATE_PLAYBACK_STREAM_PROPLIST] = "UPDATE_RECORD_STREAM_PROPLIST",
+    [PA_COMMAND_UPDATE_PLAYBACK_STREAM_PROPLIST] = "UPDATE_PLAYBACK_STREAM_PROPLIST",
     [PA_COMMAND_UPDATE_CLIENT_PROPLIST] = "UPDATE_CLIENT_PROPLIST",
     [PA_COMMAND_REMOVE_RECORD_STREAM_PROPLIST] = "REMOVE_RECORD_STREAM_PROPLIST",
     [PA_COMMAND_REMOVE_PLAYBACK_STREAM_PROPLIST] = "REMOVE_PLAYBACK_STREAM_PROPLIST",
@@ -190,9 +188,15 @@ static const char *command_names[PA_COMMAND_MAX] = {
     [PA_COMMAND_SET_SOURCE_OUTPUT_VOLUME] = "SET_SOURCE_OUTPUT_VOLUME",
     [PA_COMMAND_SET_SOURCE_OUTPUT_MUTE] = "SET_SOURCE_OUTPUT_MUTE",
 
-};
+    /* Supported since protocol v27 (3.0) */
+    [PA_COMMAND_SET_PORT_LATENCY_OFFSET] = "SET_PORT_LATENCY_OFFSET",
 
-#endif
+    /* Supported since protocol v28 (4.0) */
+    [PA_COMMAND_PLAYBACK_RING_DOORBELL] = "PLAYBACK_RING_DOORBELL",
+
+    /* Supported since protocol v31 (4.0) */
+    [PA_COMMAND_GET_LATENCY_STATS] = "GET_LATENCY_STATS",
+};
 
 PA_STATIC_FLIST_DECLARE(reply_infos, 0, pa_xfree);
 
@@ -216,6 +220,7 @@ struct pa_pdispatch {
     void *drain_userdata;
     const pa_creds *creds;
     pa_bool_t use_rtclock;
+    pa_histogram *stats;
 };
 
 static void reply_info_free(struct reply_info *r) {
@@ -333,7 +338,13 @@ int pa_pdispatch_run(pa_pdispatch *pd, pa_packet*packet, const pa_creds *creds,
     } else if (pd->callback_table && (command < pd->n_commands) && pd->callback_table[command]) {
         const pa_pdispatch_cb_t *cb = pd->callback_table+command;
 
-        (*cb)(pd, command, tag, ts, userdata);
+        if (pd->stats) {
+            pa_usec_t start = pa_rtclock_now();
+
+            (*cb)(pd, command, tag, ts, userdata);
+            pa_histogram_add(&pd->stats[command], pa_rtclock_now() - start);
+        } else
+            (*cb)(pd, command, tag, ts, userdata);
     } else {
         pa_log("Received unsupported command %u", command);
         goto finish;
@@ -437,3 +448,17 @@ const pa_creds * pa_pdispatch_creds(pa_pdispatch *pd) {
 
     return pd->creds;
 }
+
+void pa_pdispatch_set_stats(pa_pdispatch *pd, pa_histogram *stats) {
+    pa_assert(pd);
+    pa_assert(PA_REFCNT_VALUE(pd) >= 1);
+
+    pd->stats = stats;
+}
+
+const char *pa_pdispatch_command_name(uint32_t command) {
+    if (command >= PA_COMMAND_MAX)
+        return NULL;
+
+    return command_names[command];
+}
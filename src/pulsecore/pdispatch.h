@@ -31,6 +31,7 @@
 #include <pulsecore/tagstruct.h>
 #include <pulsecore/packet.h>
 #include <pulsecore/creds.h>
+#include <pulsecore/histogram.h>
 
 typedef struct pa_pdispatch pa_pdispatch;
 
@@ -54,4 +55,12 @@ void pa_pdispatch_unregister_reply(pa_pdispatch *pd, void *userdata);
 
 const pa_creds * pa_pdispatch_creds(pa_pdispatch *pd);
 
+/* Add the time each command handler takes to stats, which has an
+ * entry for each command of the table */
+void pa_pdispatch_set_stats(pa_pdispatch *pd, pa_histogram *stats);
+
+/* The name of a command, without the PA_COMMAND_ prefix, NULL if it
+ * is not known */
+const char *pa_pdispatch_command_name(uint32_t command);
+
 #endif
@@ -207,6 +207,9 @@ pa_sink_input* pa_memblockq_sink_input_new(
     pa_proplist_update(data.proplist, PA_UPDATE_REPLACE, p);
     data.flags |= flags;
 
+    /* Our pop() only works on our own memblockq */
+    data.flags |= PA_SINK_INPUT_PARALLEL_PEEK;
+
     pa_sink_input_new(&u->sink_input, sink->core, &data);
     pa_sink_input_new_data_done(&data);
 
@@ -57,6 +57,8 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/ipacl.h>
 #include <pulsecore/thread-mq.h>
+#include <pulsecore/shmring.h>
+#include <pulsecore/resampler-cache.h>
 
 #include "protocol-native.h"
 
@@ -84,6 +86,10 @@ typedef struct record_stream {
     pa_source_output *source_output;
     pa_memblockq *memblockq;
 
+    /* Keeps the connection's pool alive for as long as the queue and
+     * pending messages may hold blocks from it */
+    pa_mempool *mempool;
+
     pa_bool_t adjust_latency:1;
     pa_bool_t early_requests:1;
 
@@ -121,6 +127,12 @@ typedef struct playback_stream {
     pa_sink_input *sink_input;
     pa_memblockq *memblockq;
 
+    /* Audio data the client writes into shared memory instead of
+     * sending it through the socket, if it does so */
+    pa_shmring *ring;
+    /* The sum of offset and length of everything read from the ring */
+    int64_t ring_read;
+
     pa_bool_t adjust_latency:1;
     pa_bool_t early_requests:1;
 
@@ -134,6 +146,8 @@ typedef struct playback_stream {
     int64_t seek_windex;
 
     pa_atomic_t missing;
+    pa_atomic_t request_pending; /* REQUEST_DATA is queued */
+    pa_atomic_t doorbell_pending; /* RING_DOORBELL is queued */
     pa_usec_t configured_sink_latency;
     /* Requested buffer attributes */
     pa_buffer_attr buffer_attr_req;
@@ -181,6 +195,10 @@ struct pa_native_connection {
     uint32_t rrobin_index;
     pa_subscription *subscription;
     pa_time_event *auth_timeout_event;
+
+    /* The memfd pool we export memory blocks to this client from, so
+     * that it cannot see anything that is not meant for it */
+    pa_mempool *mempool;
 };
 
 #define PA_NATIVE_CONNECTION(o) (pa_native_connection_cast(o))
@@ -196,6 +214,9 @@ struct pa_native_protocol {
     pa_hook hooks[PA_NATIVE_HOOK_MAX];
 
     pa_hashmap *extensions;
+
+    /* Handler run times, by command, of all connections */
+    pa_histogram command_stats[PA_COMMAND_MAX];
 };
 
 enum {
@@ -210,7 +231,8 @@ enum {
     SINK_INPUT_MESSAGE_SEEK,
     SINK_INPUT_MESSAGE_PREBUF_FORCE,
     SINK_INPUT_MESSAGE_UPDATE_LATENCY,
-    SINK_INPUT_MESSAGE_UPDATE_BUFFER_ATTR
+    SINK_INPUT_MESSAGE_UPDATE_BUFFER_ATTR,
+    SINK_INPUT_MESSAGE_RING_DOORBELL /* new data in the shm ring */
 };
 
 enum {
@@ -293,6 +315,8 @@ static void command_extension(pa_pdispatch *pd, uint32_t command, uint32_t tag,
 static void command_set_card_profile(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_sink_or_source_port(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_port_latency_offset(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_playback_ring_doorbell(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_get_latency_stats(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 
 static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_ERROR] = NULL,
@@ -396,6 +420,10 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
 
     [PA_COMMAND_SET_PORT_LATENCY_OFFSET] = command_set_port_latency_offset,
 
+    [PA_COMMAND_PLAYBACK_RING_DOORBELL] = command_playback_ring_doorbell,
+
+    [PA_COMMAND_GET_LATENCY_STATS] = command_get_latency_stats,
+
     [PA_COMMAND_EXTENSION] = command_extension
 };
 
@@ -490,6 +518,10 @@ static void record_stream_free(pa_object *o) {
     record_stream_unlink(s);
 
     pa_memblockq_free(s->memblockq);
+
+    if (s->mempool)
+        pa_mempool_free(s->mempool);
+
     pa_xfree(s);
 }
 
@@ -686,6 +718,10 @@ static record_stream* record_stream_new(
         data.resample_method = PA_RESAMPLER_PEAKS;
     data.flags = flags;
 
+    /* Whatever needs to be converted for the client already ends up
+     * in its pool, so that it can be exported without another copy */
+    data.mempool = c->mempool;
+
     *ret = -pa_source_output_new(&source_output, c->protocol->core, &data);
 
     pa_source_output_new_data_done(&data);
@@ -698,6 +734,7 @@ static record_stream* record_stream_new(
     s->parent.process_msg = record_stream_process_msg;
     s->connection = c;
     s->source_output = source_output;
+    s->mempool = c->mempool ? pa_mempool_ref(c->mempool) : NULL;
     s->buffer_attr_req = *attr;
     s->adjust_latency = adjust_latency;
     s->early_requests = early_requests;
@@ -784,6 +821,9 @@ static void playback_stream_free(pa_object* o) {
 
     playback_stream_unlink(s);
 
+    if (s->ring)
+        pa_shmring_free(s->ring);
+
     pa_memblockq_free(s->memblockq);
     pa_xfree(s);
 }
@@ -1076,11 +1116,13 @@ static playback_stream* playback_stream_new(
         pa_bool_t early_requests,
         pa_bool_t relative_volume,
         uint32_t syncid,
+        pa_shmring *ring,
         uint32_t *missing,
         int *ret) {
 
     /* Note: This function takes ownership of the 'formats' param, so we need
-     * to take extra care to not leak it */
+     * to take extra care to not leak it. The ring is only taken over if
+     * we succeed. */
 
     playback_stream *ssync;
     playback_stream *s = NULL;
@@ -1160,9 +1202,13 @@ static playback_stream* playback_stream_new(
     s->connection = c;
     s->syncid = syncid;
     s->sink_input = sink_input;
+    s->ring = ring;
+    s->ring_read = 0;
     s->is_underrun = TRUE;
     s->drain_request = FALSE;
     pa_atomic_store(&s->missing, 0);
+    pa_atomic_store(&s->request_pending, 0);
+    pa_atomic_store(&s->doorbell_pending, 0);
     s->buffer_attr_req = *a;
     s->adjust_latency = adjust_latency;
     s->early_requests = early_requests;
@@ -1255,7 +1301,7 @@ static void playback_stream_request_bytes(playback_stream *s) {
 
     if (pa_memblockq_prebuf_active(s->memblockq) ||
         (previous_missing < (int) minreq && previous_missing + (int) m >= (int) minreq))
-        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_REQUEST_DATA, NULL, 0, NULL, NULL);
+        pa_asyncmsgq_post_coalesced(pa_thread_mq_get()->outq, &s->request_pending, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_REQUEST_DATA, 0);
 }
 
 /* Called from main context */
@@ -1316,8 +1362,15 @@ static void native_connection_unlink(pa_native_connection *c) {
         else
             upload_stream_unlink(UPLOAD_STREAM(o));
 
-    if (c->subscription)
+    if (c->subscription) {
+        uint64_t delivered, suppressed;
+
+        pa_subscription_get_stats(c->subscription, &delivered, &suppressed);
+        pa_log_debug("Client %u got %llu subscription events, %llu were saved by merging.",
+                     c->client->index, (unsigned long long) delivered, (unsigned long long) suppressed);
+
         pa_subscription_free(c->subscription);
+    }
 
     if (c->pstream)
         pa_pstream_unlink(c->pstream);
@@ -1347,6 +1400,9 @@ static void native_connection_free(pa_object *o) {
     pa_pstream_unref(c->pstream);
     pa_client_free(c->client);
 
+    if (c->mempool)
+        pa_mempool_free(c->mempool);
+
     pa_xfree(c);
 }
 
@@ -1428,6 +1484,61 @@ static void flush_write_no_account(pa_memblockq *q) {
     pa_memblockq_flush_write(q, FALSE);
 }
 
+/* Called from thread context */
+static void playback_stream_push(playback_stream *s, int64_t offset, pa_seek_mode_t seek, pa_memchunk *chunk, int64_t *windex) {
+    playback_stream_assert_ref(s);
+
+    if (seek != PA_SEEK_RELATIVE || offset != 0) {
+        /* The client side is incapable of accounting correctly
+         * for seeks of a type != PA_SEEK_RELATIVE. We need to be
+         * able to deal with that. */
+
+        pa_memblockq_seek(s->memblockq, offset, seek, seek == PA_SEEK_RELATIVE);
+        *windex = PA_MIN(*windex, pa_memblockq_get_write_index(s->memblockq));
+    }
+
+    if (chunk && pa_memblockq_push_align(s->memblockq, chunk) < 0) {
+        if (pa_log_ratelimit(PA_LOG_WARN))
+            pa_log_warn("Failed to push data into queue");
+        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_OVERFLOW, NULL, 0, NULL, NULL);
+        pa_memblockq_seek(s->memblockq, (int64_t) chunk->length, PA_SEEK_RELATIVE, TRUE);
+    }
+}
+
+/* Called from thread context. Moves everything the client has written
+ * into the shm ring so far into our queue. */
+static pa_bool_t drain_ring(playback_stream *s, pa_bool_t seek) {
+    pa_memchunk chunk;
+    int64_t offset, windex;
+    pa_seek_mode_t seek_mode;
+    pa_bool_t got_data = FALSE;
+
+    playback_stream_assert_ref(s);
+
+    if (!s->ring)
+        return FALSE;
+
+    windex = pa_memblockq_get_write_index(s->memblockq);
+
+    while (pa_shmring_read(s->ring, s->sink_input->core->mempool, &chunk, &offset, &seek_mode) > 0) {
+        s->ring_read += offset + (int64_t) chunk.length;
+        playback_stream_push(s, offset, seek_mode, &chunk, &windex);
+        pa_memblock_unref(chunk.memblock);
+        got_data = TRUE;
+    }
+
+    if (!got_data || !seek)
+        return got_data;
+
+    /* Data from the socket is still on its way, let that do the rewinding */
+    if (pa_atomic_load(&s->seek_or_post_in_queue) > 0)
+        s->seek_windex = s->seek_windex == -1 ? windex : PA_MIN(windex, s->seek_windex);
+    else
+        handle_seek(s, windex);
+
+    return TRUE;
+}
+
 /* Called from thread context */
 static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
     pa_sink_input *i = PA_SINK_INPUT(o);
@@ -1437,27 +1548,20 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
     s = PLAYBACK_STREAM(i->userdata);
     playback_stream_assert_ref(s);
 
+    /* Whatever the client wrote into the ring before sending this
+     * comes first */
+    drain_ring(s, TRUE);
+
     switch (code) {
 
         case SINK_INPUT_MESSAGE_SEEK:
         case SINK_INPUT_MESSAGE_POST_DATA: {
             int64_t windex = pa_memblockq_get_write_index(s->memblockq);
 
-            if (code == SINK_INPUT_MESSAGE_SEEK) {
-                /* The client side is incapable of accounting correctly
-                 * for seeks of a type != PA_SEEK_RELATIVE. We need to be
-                 * able to deal with that. */
-
-                pa_memblockq_seek(s->memblockq, offset, PA_PTR_TO_UINT(userdata), PA_PTR_TO_UINT(userdata) == PA_SEEK_RELATIVE);
-                windex = PA_MIN(windex, pa_memblockq_get_write_index(s->memblockq));
-            }
-
-            if (chunk && pa_memblockq_push_align(s->memblockq, chunk) < 0) {
-                if (pa_log_ratelimit(PA_LOG_WARN))
-                    pa_log_warn("Failed to push data into queue");
-                pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_OVERFLOW, NULL, 0, NULL, NULL);
-                pa_memblockq_seek(s->memblockq, (int64_t) chunk->length, PA_SEEK_RELATIVE, TRUE);
-            }
+            if (code == SINK_INPUT_MESSAGE_SEEK)
+                playback_stream_push(s, offset, PA_PTR_TO_UINT(userdata), chunk, &windex);
+            else
+                playback_stream_push(s, 0, PA_SEEK_RELATIVE, chunk, &windex);
 
             /* If more data is in queue, we rewind later instead. */
             if (s->seek_windex != -1)
@@ -1498,6 +1602,11 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
                     pa_assert_not_reached();
             }
 
+            /* The client put a fence into the ring before sending this,
+             * what follows it is meant for after this request */
+            if (s->ring)
+                pa_shmring_pass_fence(s->ring);
+
             windex = pa_memblockq_get_write_index(s->memblockq);
             func(s->memblockq);
             handle_seek(s, windex);
@@ -1529,10 +1638,23 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
             return 0;
         }
 
+        case SINK_INPUT_MESSAGE_RING_DOORBELL:
+            /* We already picked up the data above */
+            return 0;
+
         case SINK_INPUT_MESSAGE_UPDATE_LATENCY:
             /* Atomically get a snapshot of all timing parameters... */
             s->read_index = pa_memblockq_get_read_index(s->memblockq);
             s->write_index = pa_memblockq_get_write_index(s->memblockq);
+
+            /* ...with the write index as it was when we had read from
+             * the ring exactly what the client had written into it
+             * when it asked. Whatever it wrote since is in its write
+             * index corrections already. Relative writes move the
+             * write index by offset + length, and if the client wrote
+             * anything else since asking, its corrections ignore what
+             * we report here anyway. */
+            s->write_index -= s->ring_read - offset;
             s->render_memblockq_length = pa_memblockq_get_length(s->sink_input->thread_info.render_memblockq);
             s->current_sink_latency = pa_sink_get_latency_within_thread(s->sink_input->sink);
             s->underrun_for = s->sink_input->thread_info.underrun_for;
@@ -1586,6 +1708,18 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     pa_log("%s, pop(): %lu", pa_proplist_gets(i->proplist, PA_PROP_MEDIA_NAME), (unsigned long) pa_memblockq_get_length(s->memblockq));
 #endif
 
+    if (s->ring) {
+        drain_ring(s, FALSE);
+
+        /* If we run dry, have the client tell us when it wrote
+         * something. Check again afterwards, in case it did so just
+         * before it could notice. */
+        if (!pa_memblockq_is_readable(s->memblockq)) {
+            pa_shmring_want_doorbell(s->ring);
+            drain_ring(s, FALSE);
+        }
+    }
+
     if (pa_memblockq_is_readable(s->memblockq))
         s->is_underrun = FALSE;
     else {
@@ -1965,7 +2099,8 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
     uint8_t n_formats = 0;
     pa_format_info *format;
     pa_idxset *formats = NULL;
-    uint32_t i;
+    uint32_t i, ring_shm_id = PA_INVALID_INDEX;
+    pa_shmring *ring = NULL;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
@@ -2087,6 +2222,14 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
         }
     }
 
+    if (c->version >= 28) {
+
+        if (pa_tagstruct_getu32(t, &ring_shm_id) < 0) {
+            protocol_error(c);
+            goto finish;
+        }
+    }
+
     if (n_formats == 0) {
         CHECK_VALIDITY_GOTO(c->pstream, pa_sample_spec_valid(&ss), tag, PA_ERR_INVALID, finish);
         CHECK_VALIDITY_GOTO(c->pstream, map.channels == ss.channels && volume.channels == ss.channels, tag, PA_ERR_INVALID, finish);
@@ -2134,12 +2277,22 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
      * flag. For older versions we synthesize it here */
     muted_set = muted_set || muted;
 
-    s = playback_stream_new(c, sink, &ss, &map, formats, &attr, volume_set ? &volume : NULL, muted, muted_set, flags, p, adjust_latency, early_requests, relative_volume, syncid, &missing, &ret);
+    /* The ring lives in shared memory, so only take it if we may use
+     * that with this client. If we can't attach to it, the client
+     * will just send its data through the socket. */
+    if (ring_shm_id != PA_INVALID_INDEX && pa_pstream_get_shm(c->pstream))
+        if (!(ring = pa_shmring_new_consumer(ring_shm_id)))
+            pa_log_debug("Failed to attach to the playback ring of the client.");
+
+    s = playback_stream_new(c, sink, &ss, &map, formats, &attr, volume_set ? &volume : NULL, muted, muted_set, flags, p, adjust_latency, early_requests, relative_volume, syncid, ring, &missing, &ret);
     /* We no longer own the formats idxset */
     formats = NULL;
 
     CHECK_VALIDITY_GOTO(c->pstream, s, tag, ret, finish);
 
+    /* Now owned by the stream */
+    ring = NULL;
+
     reply = reply_new(tag);
     pa_tagstruct_putu32(reply, s->index);
     pa_assert(s->sink_input);
@@ -2187,6 +2340,9 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
         }
     }
 
+    if (c->version >= 28)
+        pa_tagstruct_putu32(reply, s->ring ? pa_shmring_get_shm_id(s->ring) : PA_INVALID_INDEX);
+
     pa_pstream_send_tagstruct(c->pstream, reply);
 
 finish:
@@ -2194,6 +2350,8 @@ finish:
         pa_proplist_free(p);
     if (formats)
         pa_idxset_free(formats, (pa_free2_cb_t) pa_format_info_free2, NULL);
+    if (ring)
+        pa_shmring_free(ring);
 }
 
 static void command_delete_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -2536,7 +2694,7 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     const void*cookie;
     pa_tagstruct *reply;
-    pa_bool_t shm_on_remote = FALSE, do_shm;
+    pa_bool_t shm_on_remote = FALSE, memfd_on_remote = FALSE, do_shm, do_memfd = FALSE;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
@@ -2559,9 +2717,15 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
        not. */
     if (c->version >= 13) {
         shm_on_remote = !!(c->version & 0x80000000U);
-        c->version &= 0x7FFFFFFFU;
+        memfd_on_remote = !!(c->version & 0x40000000U);
+        c->version &= 0x3FFFFFFFU;
     }
 
+    /* Starting with protocol version 29 the second bit reflects if the
+       client uses a memfd pool and wants one for what we send, too. */
+    if (c->version < 29)
+        memfd_on_remote = FALSE;
+
     pa_log_debug("Protocol version: remote %u, local %u", c->version, PA_PROTOCOL_VERSION);
 
     pa_proplist_setf(c->client->proplist, "native-protocol.version", "%u", c->version);
@@ -2643,11 +2807,20 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     }
 #endif
 
-    pa_log_debug("Negotiated SHM: %s", pa_yes_no(do_shm));
+#ifdef HAVE_CREDS
+    /* A repeated AUTH keeps the pool the client already knows */
+    if (do_shm && memfd_on_remote) {
+        if (!c->mempool)
+            c->mempool = pa_mempool_new_memfd(c->options->client_pool_size);
+        do_memfd = !!c->mempool;
+    }
+#endif
+
+    pa_log_debug("Negotiated SHM: %s, memfd: %s", pa_yes_no(do_shm), pa_yes_no(do_memfd));
     pa_pstream_enable_shm(c->pstream, do_shm);
 
     reply = reply_new(tag);
-    pa_tagstruct_putu32(reply, PA_PROTOCOL_VERSION | (do_shm ? 0x80000000 : 0));
+    pa_tagstruct_putu32(reply, PA_PROTOCOL_VERSION | (do_shm ? 0x80000000 : 0) | (do_memfd ? 0x40000000 : 0));
 
 #ifdef HAVE_CREDS
 {
@@ -2659,6 +2832,11 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     ucred.gid = getgid();
 
     pa_pstream_send_tagstruct_with_creds(c->pstream, reply, &ucred);
+
+    /* Only after the reply, so that the client has enabled SHM by the
+     * time it gets the pool */
+    if (do_memfd)
+        pa_pstream_register_memfd_mempool(c->pstream, c->mempool);
 }
 #else
     pa_pstream_send_tagstruct(c->pstream, reply);
@@ -2786,6 +2964,110 @@ static void command_stat(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     pa_tagstruct_putu32(reply, (uint32_t) pa_atomic_load(&stat->n_accumulated));
     pa_tagstruct_putu32(reply, (uint32_t) pa_atomic_load(&stat->accumulated_size));
     pa_tagstruct_putu32(reply, (uint32_t) pa_scache_total_size(c->protocol->core));
+
+    if (c->version >= 32) {
+        pa_resampler_cache_stat cache;
+
+        pa_resampler_cache_get_stat(&cache);
+        pa_tagstruct_putu32(reply, (uint32_t) cache.size);
+        pa_tagstruct_putu32(reply, (uint32_t) cache.saved);
+    }
+
+    if (c->version >= 33) {
+        uint64_t delivered = 0, suppressed = 0;
+
+        if (c->subscription)
+            pa_subscription_get_stats(c->subscription, &delivered, &suppressed);
+
+        pa_tagstruct_putu64(reply, c->protocol->core->n_subscription_events_delivered);
+        pa_tagstruct_putu64(reply, c->protocol->core->n_subscription_events_suppressed);
+        pa_tagstruct_putu64(reply, delivered);
+        pa_tagstruct_putu64(reply, suppressed);
+    }
+
+    pa_pstream_send_tagstruct(c->pstream, reply);
+}
+
+static void put_latency_stat(pa_tagstruct *t, const char *name, const pa_histogram *h) {
+    pa_tagstruct_puts(t, name);
+    pa_tagstruct_putu64(t, h->count);
+    pa_tagstruct_put_usec(t, pa_histogram_percentile(h, 50));
+    pa_tagstruct_put_usec(t, pa_histogram_percentile(h, 99));
+    pa_tagstruct_put_usec(t, h->max);
+}
+
+struct io_thread_stat {
+    char *name;
+    pa_histogram stats;
+};
+
+static void command_get_latency_stats(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    pa_core *core;
+    pa_tagstruct *reply;
+    pa_idxset *queues;
+    struct io_thread_stat *threads;
+    unsigned n_threads = 0, i;
+    uint32_t n_commands = 0, idx;
+    pa_sink *sink;
+    pa_source *source;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (!pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+
+    core = c->protocol->core;
+
+    for (i = 0; i < PA_COMMAND_MAX; i++)
+        if (c->protocol->command_stats[i].count > 0 && pa_pdispatch_command_name(i))
+            n_commands++;
+
+    /* Filter sinks and monitor sources share the message queue, and
+     * hence the IO thread, of the sink they belong to */
+    threads = pa_xnew(struct io_thread_stat, pa_idxset_size(core->sinks) + pa_idxset_size(core->sources));
+    queues = pa_idxset_new(NULL, NULL);
+
+    PA_IDXSET_FOREACH(sink, core->sinks, idx) {
+        if (!sink->asyncmsgq || pa_idxset_put(queues, sink->asyncmsgq, NULL) < 0)
+            continue;
+
+        threads[n_threads].name = pa_sprintf_malloc("sink %s", sink->name);
+        pa_asyncmsgq_get_send_stats(sink->asyncmsgq, &threads[n_threads].stats);
+        n_threads++;
+    }
+
+    PA_IDXSET_FOREACH(source, core->sources, idx) {
+        if (!source->asyncmsgq || pa_idxset_put(queues, source->asyncmsgq, NULL) < 0)
+            continue;
+
+        threads[n_threads].name = pa_sprintf_malloc("source %s", source->name);
+        pa_asyncmsgq_get_send_stats(source->asyncmsgq, &threads[n_threads].stats);
+        n_threads++;
+    }
+
+    pa_idxset_free(queues, NULL, NULL);
+
+    reply = reply_new(tag);
+
+    pa_tagstruct_putu32(reply, n_commands);
+    for (i = 0; i < PA_COMMAND_MAX; i++)
+        if (c->protocol->command_stats[i].count > 0 && pa_pdispatch_command_name(i))
+            put_latency_stat(reply, pa_pdispatch_command_name(i), &c->protocol->command_stats[i]);
+
+    pa_tagstruct_putu32(reply, (uint32_t) n_threads);
+    for (i = 0; i < n_threads; i++) {
+        put_latency_stat(reply, threads[i].name, &threads[i].stats);
+        pa_xfree(threads[i].name);
+    }
+
+    pa_xfree(threads);
+
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
@@ -2795,12 +3077,14 @@ static void command_get_playback_latency(pa_pdispatch *pd, uint32_t command, uin
     playback_stream *s;
     struct timeval tv, now;
     uint32_t idx;
+    int64_t ring_written = 0;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
 
     if (pa_tagstruct_getu32(t, &idx) < 0 ||
         pa_tagstruct_get_timeval(t, &tv) < 0 ||
+        (c->version >= 28 && pa_tagstruct_gets64(t, &ring_written) < 0) ||
         !pa_tagstruct_eof(t)) {
         protocol_error(c);
         return;
@@ -2812,7 +3096,7 @@ static void command_get_playback_latency(pa_pdispatch *pd, uint32_t command, uin
     CHECK_VALIDITY(c->pstream, playback_stream_isinstance(s), tag, PA_ERR_NOENTITY);
 
     /* Get an atomic snapshot of all timing parameters */
-    pa_assert_se(pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_UPDATE_LATENCY, s, 0, NULL) == 0);
+    pa_assert_se(pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_UPDATE_LATENCY, s, ring_written, NULL) == 0);
 
     reply = reply_new(tag);
     pa_tagstruct_put_usec(reply,
@@ -3077,7 +3361,14 @@ static void fixup_sample_spec(pa_native_connection *c, pa_sample_spec *fixed, co
     }
 }
 
-static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink *sink) {
+static void put_proplist(pa_tagstruct *t, pa_proplist *p, const char * const keys[]) {
+    if (keys)
+        pa_tagstruct_put_proplist_keys(t, p, keys);
+    else
+        pa_tagstruct_put_proplist(t, p);
+}
+
+static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink *sink, const char * const keys[]) {
     pa_sample_spec fixed_ss;
 
     pa_assert(t);
@@ -3103,7 +3394,7 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
         PA_TAG_INVALID);
 
     if (c->version >= 13) {
-        pa_tagstruct_put_proplist(t, sink->proplist);
+        put_proplist(t, sink->proplist, keys);
         pa_tagstruct_put_usec(t, pa_sink_get_requested_latency(sink));
     }
 
@@ -3147,7 +3438,7 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
     }
 }
 
-static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source *source) {
+static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source *source, const char * const keys[]) {
     pa_sample_spec fixed_ss;
 
     pa_assert(t);
@@ -3173,7 +3464,7 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
         PA_TAG_INVALID);
 
     if (c->version >= 13) {
-        pa_tagstruct_put_proplist(t, source->proplist);
+        put_proplist(t, source->proplist, keys);
         pa_tagstruct_put_usec(t, pa_source_get_requested_latency(source));
     }
 
@@ -3217,7 +3508,7 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
     }
 }
 
-static void client_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_client *client) {
+static void client_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_client *client, const char * const keys[]) {
     pa_assert(t);
     pa_assert(client);
 
@@ -3227,10 +3518,10 @@ static void client_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_c
     pa_tagstruct_puts(t, client->driver);
 
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, client->proplist);
+        put_proplist(t, client->proplist, keys);
 }
 
-static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_card *card) {
+static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_card *card, const char * const keys[]) {
     void *state = NULL;
     pa_card_profile *p;
     pa_device_port *port;
@@ -3254,7 +3545,7 @@ static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_car
     }
 
     pa_tagstruct_puts(t, card->active_profile->name);
-    pa_tagstruct_put_proplist(t, card->proplist);
+    put_proplist(t, card->proplist, keys);
 
     if (c->version < 26)
         return;
@@ -3281,7 +3572,7 @@ static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_car
     }
 }
 
-static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_module *module) {
+static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_module *module, const char * const keys[]) {
     pa_assert(t);
     pa_assert(module);
 
@@ -3294,10 +3585,10 @@ static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_m
         pa_tagstruct_put_boolean(t, FALSE); /* autoload is obsolete */
 
     if (c->version >= 15)
-        pa_tagstruct_put_proplist(t, module->proplist);
+        put_proplist(t, module->proplist, keys);
 }
 
-static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink_input *s) {
+static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink_input *s, const char * const keys[]) {
     pa_sample_spec fixed_ss;
     pa_usec_t sink_latency;
     pa_cvolume v;
@@ -3329,7 +3620,7 @@ static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t,
     if (c->version >= 11)
         pa_tagstruct_put_boolean(t, pa_sink_input_get_mute(s));
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, s->proplist);
+        put_proplist(t, s->proplist, keys);
     if (c->version >= 19)
         pa_tagstruct_put_boolean(t, (pa_sink_input_get_state(s) == PA_SINK_INPUT_CORKED));
     if (c->version >= 20) {
@@ -3340,7 +3631,7 @@ static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t,
         pa_tagstruct_put_format_info(t, s->format);
 }
 
-static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source_output *s) {
+static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source_output *s, const char * const keys[]) {
     pa_sample_spec fixed_ss;
     pa_usec_t source_latency;
     pa_cvolume v;
@@ -3369,7 +3660,7 @@ static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *
     pa_tagstruct_puts(t, pa_resample_method_to_string(pa_source_output_get_resample_method(s)));
     pa_tagstruct_puts(t, s->driver);
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, s->proplist);
+        put_proplist(t, s->proplist, keys);
     if (c->version >= 19)
         pa_tagstruct_put_boolean(t, (pa_source_output_get_state(s) == PA_SOURCE_OUTPUT_CORKED));
     if (c->version >= 22) {
@@ -3381,7 +3672,7 @@ static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *
     }
 }
 
-static void scache_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_scache_entry *e) {
+static void scache_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_scache_entry *e, const char * const keys[]) {
     pa_sample_spec fixed_ss;
     pa_cvolume v;
 
@@ -3410,7 +3701,7 @@ static void scache_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
     pa_tagstruct_puts(t, e->filename);
 
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, e->proplist);
+        put_proplist(t, e->proplist, keys);
 }
 
 static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -3492,34 +3783,110 @@ static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, p
 
     reply = reply_new(tag);
     if (sink)
-        sink_fill_tagstruct(c, reply, sink);
+        sink_fill_tagstruct(c, reply, sink, NULL);
     else if (source)
-        source_fill_tagstruct(c, reply, source);
+        source_fill_tagstruct(c, reply, source, NULL);
     else if (client)
-        client_fill_tagstruct(c, reply, client);
+        client_fill_tagstruct(c, reply, client, NULL);
     else if (card)
-        card_fill_tagstruct(c, reply, card);
+        card_fill_tagstruct(c, reply, card, NULL);
     else if (module)
-        module_fill_tagstruct(c, reply, module);
+        module_fill_tagstruct(c, reply, module, NULL);
     else if (si)
-        sink_input_fill_tagstruct(c, reply, si);
+        sink_input_fill_tagstruct(c, reply, si, NULL);
     else if (so)
-        source_output_fill_tagstruct(c, reply, so);
+        source_output_fill_tagstruct(c, reply, so, NULL);
     else
-        scache_fill_tagstruct(c, reply, sce);
+        scache_fill_tagstruct(c, reply, sce, NULL);
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
+/* Upper limit for the property keys a client may ask for in a list
+ * request */
+#define MAX_LIST_KEYS 64
+
+static void fill_list_entry(pa_native_connection *c, pa_tagstruct *reply, uint32_t command, void *p, const char * const keys[]) {
+    if (command == PA_COMMAND_GET_SINK_INFO_LIST)
+        sink_fill_tagstruct(c, reply, p, keys);
+    else if (command == PA_COMMAND_GET_SOURCE_INFO_LIST)
+        source_fill_tagstruct(c, reply, p, keys);
+    else if (command == PA_COMMAND_GET_CLIENT_INFO_LIST)
+        client_fill_tagstruct(c, reply, p, keys);
+    else if (command == PA_COMMAND_GET_CARD_INFO_LIST)
+        card_fill_tagstruct(c, reply, p, keys);
+    else if (command == PA_COMMAND_GET_MODULE_INFO_LIST)
+        module_fill_tagstruct(c, reply, p, keys);
+    else if (command == PA_COMMAND_GET_SINK_INPUT_INFO_LIST)
+        sink_input_fill_tagstruct(c, reply, p, keys);
+    else if (command == PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST)
+        source_output_fill_tagstruct(c, reply, p, keys);
+    else {
+        pa_assert(command == PA_COMMAND_GET_SAMPLE_INFO_LIST);
+        scache_fill_tagstruct(c, reply, p, keys);
+    }
+}
+
+/* Indexes are handed out in ascending order and idxsets iterate in
+ * insertion order, so a page simply starts at the first object at or
+ * after start_index. */
+static void *list_first(pa_idxset *i, uint32_t start_index, uint32_t *idx) {
+    void *p;
+
+    if (start_index == 0)
+        return pa_idxset_first(i, idx);
+
+    if ((p = pa_idxset_get_by_index(i, start_index))) {
+        *idx = start_index;
+        return p;
+    }
+
+    *idx = start_index - 1;
+    return pa_idxset_next(i, idx);
+}
+
 static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     pa_idxset *i;
-    uint32_t idx;
+    pa_subscription_event_type_t facility;
+    uint32_t idx, end = PA_INVALID_INDEX;
+    uint32_t start_index = 0, max_entries = 0, n_keys = PA_INVALID_INDEX;
+    uint64_t changed_since = 0;
+    const char *keys[MAX_LIST_KEYS+1];
+    pa_bool_t paged = FALSE;
     void *p;
     pa_tagstruct *reply;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
 
+    if (c->version >= 30 && !pa_tagstruct_eof(t)) {
+        uint32_t k;
+
+        if (pa_tagstruct_getu32(t, &start_index) < 0 ||
+            pa_tagstruct_getu32(t, &max_entries) < 0 ||
+            pa_tagstruct_getu64(t, &changed_since) < 0 ||
+            pa_tagstruct_getu32(t, &n_keys) < 0) {
+            protocol_error(c);
+            return;
+        }
+
+        CHECK_VALIDITY(c->pstream, n_keys == PA_INVALID_INDEX || n_keys <= MAX_LIST_KEYS, tag, PA_ERR_INVALID);
+
+        for (k = 0; n_keys != PA_INVALID_INDEX && k < n_keys; k++) {
+            if (pa_tagstruct_gets(t, &keys[k]) < 0) {
+                protocol_error(c);
+                return;
+            }
+
+            CHECK_VALIDITY(c->pstream, keys[k] && pa_proplist_key_valid(keys[k]), tag, PA_ERR_INVALID);
+        }
+
+        if (n_keys != PA_INVALID_INDEX)
+            keys[n_keys] = NULL;
+
+        paged = TRUE;
+    }
+
     if (!pa_tagstruct_eof(t)) {
         protocol_error(c);
         return;
@@ -3529,45 +3896,60 @@ static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t t
 
     reply = reply_new(tag);
 
-    if (command == PA_COMMAND_GET_SINK_INFO_LIST)
+    if (command == PA_COMMAND_GET_SINK_INFO_LIST) {
         i = c->protocol->core->sinks;
-    else if (command == PA_COMMAND_GET_SOURCE_INFO_LIST)
+        facility = PA_SUBSCRIPTION_EVENT_SINK;
+    } else if (command == PA_COMMAND_GET_SOURCE_INFO_LIST) {
         i = c->protocol->core->sources;
-    else if (command == PA_COMMAND_GET_CLIENT_INFO_LIST)
+        facility = PA_SUBSCRIPTION_EVENT_SOURCE;
+    } else if (command == PA_COMMAND_GET_CLIENT_INFO_LIST) {
         i = c->protocol->core->clients;
-    else if (command == PA_COMMAND_GET_CARD_INFO_LIST)
+        facility = PA_SUBSCRIPTION_EVENT_CLIENT;
+    } else if (command == PA_COMMAND_GET_CARD_INFO_LIST) {
         i = c->protocol->core->cards;
-    else if (command == PA_COMMAND_GET_MODULE_INFO_LIST)
+        facility = PA_SUBSCRIPTION_EVENT_CARD;
+    } else if (command == PA_COMMAND_GET_MODULE_INFO_LIST) {
         i = c->protocol->core->modules;
-    else if (command == PA_COMMAND_GET_SINK_INPUT_INFO_LIST)
+        facility = PA_SUBSCRIPTION_EVENT_MODULE;
+    } else if (command == PA_COMMAND_GET_SINK_INPUT_INFO_LIST) {
         i = c->protocol->core->sink_inputs;
-    else if (command == PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST)
+        facility = PA_SUBSCRIPTION_EVENT_SINK_INPUT;
+    } else if (command == PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST) {
         i = c->protocol->core->source_outputs;
-    else {
+        facility = PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT;
+    } else {
         pa_assert(command == PA_COMMAND_GET_SAMPLE_INFO_LIST);
         i = c->protocol->core->scache;
+        facility = PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE;
+    }
+
+    /* The header comes first, so if the page is limited we need to
+     * find out where it ends before filling it in */
+    if (i && max_entries > 0) {
+        uint32_t n = 0;
+
+        for (p = list_first(i, start_index, &idx); p && n < max_entries; p = pa_idxset_next(i, &idx))
+            if (changed_since == 0 || pa_subscription_get_generation(c->protocol->core, facility, idx) > changed_since)
+                n++;
+
+        if (p)
+            end = idx;
+    }
+
+    if (paged) {
+        pa_tagstruct_putu32(reply, end);
+        pa_tagstruct_putu64(reply, c->protocol->core->generation);
+
+        if (c->version >= 34)
+            pa_tagstruct_putu64(reply, c->protocol->core->removed_generations[facility]);
     }
 
     if (i) {
-        PA_IDXSET_FOREACH(p, i, idx) {
-            if (command == PA_COMMAND_GET_SINK_INFO_LIST)
-                sink_fill_tagstruct(c, reply, p);
-            else if (command == PA_COMMAND_GET_SOURCE_INFO_LIST)
-                source_fill_tagstruct(c, reply, p);
-            else if (command == PA_COMMAND_GET_CLIENT_INFO_LIST)
-                client_fill_tagstruct(c, reply, p);
-            else if (command == PA_COMMAND_GET_CARD_INFO_LIST)
-                card_fill_tagstruct(c, reply, p);
-            else if (command == PA_COMMAND_GET_MODULE_INFO_LIST)
-                module_fill_tagstruct(c, reply, p);
-            else if (command == PA_COMMAND_GET_SINK_INPUT_INFO_LIST)
-                sink_input_fill_tagstruct(c, reply, p);
-            else if (command == PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST)
-                source_output_fill_tagstruct(c, reply, p);
-            else {
-                pa_assert(command == PA_COMMAND_GET_SAMPLE_INFO_LIST);
-                scache_fill_tagstruct(c, reply, p);
-            }
+        for (p = list_first(i, start_index, &idx); p && idx != end; p = pa_idxset_next(i, &idx)) {
+            if (changed_since > 0 && pa_subscription_get_generation(c->protocol->core, facility, idx) <= changed_since)
+                continue;
+
+            fill_list_entry(c, reply, command, p, n_keys != PA_INVALID_INDEX ? keys : NULL);
         }
     }
 
@@ -3654,8 +4036,17 @@ static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag,
         pa_subscription_free(c->subscription);
 
     if (m != 0) {
+        uint32_t rate = c->options->subscription_rate_limit;
+        const char *v;
+
+        /* Clients that need to see every event may opt out */
+        if ((v = pa_proplist_gets(c->client->proplist, PA_PROP_APPLICATION_SUBSCRIPTION_RATE_LIMIT)))
+            if (pa_atou(v, &rate) < 0)
+                rate = c->options->subscription_rate_limit;
+
         c->subscription = pa_subscription_new(c->protocol->core, m, subscription_cb, c);
         pa_assert(c->subscription);
+        pa_subscription_set_rate_limit(c->subscription, rate);
     } else
         c->subscription = NULL;
 
@@ -4765,6 +5156,34 @@ static void command_set_port_latency_offset(pa_pdispatch *pd, uint32_t command,
     pa_pstream_send_simple_ack(c->pstream, tag);
 }
 
+static void command_playback_ring_doorbell(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    uint32_t channel;
+    playback_stream *s;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &channel) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    /* This is sent without waiting for a reply, so don't send any */
+    if (!c->authorized)
+        return;
+
+    if (!(s = pa_idxset_get_by_index(c->output_streams, channel)) ||
+        !playback_stream_isinstance(s) ||
+        !s->ring) {
+        pa_log_debug("Client rang the doorbell of an invalid stream.");
+        return;
+    }
+
+    pa_asyncmsgq_post_coalesced(s->sink_input->sink->asyncmsgq, &s->doorbell_pending, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_RING_DOORBELL, 0);
+}
+
 /*** pstream callbacks ***/
 
 static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
@@ -5004,12 +5423,14 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     pa_pstream_set_release_callback(c->pstream, pstream_release_callback, c);
 
     c->pdispatch = pa_pdispatch_new(p->core->mainloop, TRUE, command_table, PA_COMMAND_MAX);
+    pa_pdispatch_set_stats(c->pdispatch, p->command_stats);
 
     c->record_streams = pa_idxset_new(NULL, NULL);
     c->output_streams = pa_idxset_new(NULL, NULL);
 
     c->rrobin_index = PA_IDXSET_INVALID;
     c->subscription = NULL;
+    c->mempool = NULL;
 
     pa_idxset_put(p->connections, c, NULL);
 
@@ -5048,6 +5469,8 @@ static pa_native_protocol* native_protocol_new(pa_core *c) {
 
     p->extensions = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
 
+    memset(p->command_stats, 0, sizeof(p->command_stats));
+
     for (h = 0; h < PA_NATIVE_HOOK_MAX; h++)
         pa_hook_init(&p->hooks[h], p);
 
@@ -5160,6 +5583,9 @@ pa_native_options* pa_native_options_new(void) {
     o = pa_xnew0(pa_native_options, 1);
     PA_REFCNT_INIT(o);
 
+    o->client_pool_size = PA_NATIVE_CLIENT_POOL_SIZE_DEFAULT;
+    o->subscription_rate_limit = PA_NATIVE_SUBSCRIPTION_RATE_LIMIT_DEFAULT;
+
     return o;
 }
 
@@ -5267,6 +5693,19 @@ int pa_native_options_parse(pa_native_options *o, pa_core *c, pa_modargs *ma) {
     } else
           o->auth_cookie = NULL;
 
+    if (pa_modargs_get_value_u32(ma, "client-pool-size", &o->client_pool_size) < 0 ||
+        o->client_pool_size < PA_NATIVE_CLIENT_POOL_SIZE_MIN ||
+        o->client_pool_size > PA_NATIVE_CLIENT_POOL_SIZE_MAX) {
+        pa_log("client-pool-size= expects a size between %u and %u bytes.",
+               PA_NATIVE_CLIENT_POOL_SIZE_MIN, PA_NATIVE_CLIENT_POOL_SIZE_MAX);
+        return -1;
+    }
+
+    if (pa_modargs_get_value_u32(ma, "subscription-rate-limit", &o->subscription_rate_limit) < 0) {
+        pa_log("subscription-rate-limit= expects a number of events per second.");
+        return -1;
+    }
+
     return 0;
 }
 
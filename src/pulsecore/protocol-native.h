@@ -47,8 +47,22 @@ typedef struct pa_native_options {
     char *auth_group;
     pa_ip_acl *auth_ip_acl;
     pa_auth_cookie *auth_cookie;
+
+    /* Size of the memfd pool each client that supports it gets for
+     * what we send to it */
+    uint32_t client_pool_size;
+
+    /* Subscription events per second each client gets at most, 0 for
+     * no limit */
+    uint32_t subscription_rate_limit;
 } pa_native_options;
 
+#define PA_NATIVE_CLIENT_POOL_SIZE_DEFAULT (4*1024*1024)
+#define PA_NATIVE_CLIENT_POOL_SIZE_MIN (256*1024)
+#define PA_NATIVE_CLIENT_POOL_SIZE_MAX (64*1024*1024)
+
+#define PA_NATIVE_SUBSCRIPTION_RATE_LIMIT_DEFAULT 200
+
 typedef enum pa_native_hook {
     PA_NATIVE_HOOK_SERVERS_CHANGED,
     PA_NATIVE_HOOK_CONNECTION_PUT,
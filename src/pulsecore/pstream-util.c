@@ -23,21 +23,45 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulsecore/native-common.h>
 #include <pulsecore/macro.h>
 
 #include "pstream-util.h"
 
-void pa_pstream_send_tagstruct_with_creds(pa_pstream *p, pa_tagstruct *t, const pa_creds *creds) {
+pa_packet *pa_pstream_packet_from_tagstruct(pa_tagstruct *t) {
+    const uint8_t *data;
     size_t length;
-    uint8_t *data;
+    pa_packet *packet;
+
+    pa_assert(t);
+
+    data = pa_tagstruct_data(t, &length);
+
+    /* Copying small tagstructs lets their buffer go back to the pool,
+     * big ones would cost more to copy than to allocate */
+    if (length <= PA_TAGSTRUCT_BUFFER_SIZE) {
+        pa_assert_se(packet = pa_packet_new(length));
+        memcpy(packet->data, data, length);
+        pa_tagstruct_free(t);
+    } else {
+        uint8_t *p;
+
+        pa_assert_se(p = pa_tagstruct_free_data(t, &length));
+        pa_assert_se(packet = pa_packet_new_dynamic(p, length));
+    }
+
+    return packet;
+}
+
+void pa_pstream_send_tagstruct_with_creds(pa_pstream *p, pa_tagstruct *t, const pa_creds *creds) {
     pa_packet *packet;
 
     pa_assert(p);
     pa_assert(t);
 
-    pa_assert_se(data = pa_tagstruct_free_data(t, &length));
-    pa_assert_se(packet = pa_packet_new_dynamic(data, length));
+    pa_assert_se(packet = pa_pstream_packet_from_tagstruct(t));
     pa_pstream_send_packet(p, packet, creds);
     pa_packet_unref(packet);
 }
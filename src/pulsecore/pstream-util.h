@@ -27,6 +27,9 @@
 #include <pulsecore/tagstruct.h>
 #include <pulsecore/creds.h>
 
+/* The tagstruct is freed!*/
+pa_packet *pa_pstream_packet_from_tagstruct(pa_tagstruct *t);
+
 /* The tagstruct is freed!*/
 void pa_pstream_send_tagstruct_with_creds(pa_pstream *p, pa_tagstruct *t, const pa_creds *creds);
 
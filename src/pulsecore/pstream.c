@@ -26,6 +26,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #ifdef HAVE_NETINET_IN_H
@@ -36,6 +37,7 @@
 
 #include <pulsecore/socket.h>
 #include <pulsecore/queue.h>
+#include <pulsecore/core-util.h>
 #include <pulsecore/log.h>
 #include <pulsecore/creds.h>
 #include <pulsecore/refcnt.h>
@@ -48,6 +50,7 @@
 #define PA_FLAG_SHMDATA    0x80000000LU
 #define PA_FLAG_SHMRELEASE 0x40000000LU
 #define PA_FLAG_SHMREVOKE  0xC0000000LU
+#define PA_FLAG_SHMMEMFD   0x20000000LU
 #define PA_FLAG_SHMMASK    0xFF000000LU
 #define PA_FLAG_SEEKMASK   0x000000FFLU
 
@@ -79,6 +82,14 @@ typedef uint32_t pa_pstream_descriptor[PA_PSTREAM_DESCRIPTOR_MAX];
  */
 #define FRAME_SIZE_MAX_ALLOW (1024*1024*16)
 
+/* At most this many queued frames are gathered into one write */
+#define WRITE_BATCH_MAX 32
+
+/* Descriptors and payloads shorter than this are read through a buffer,
+ * so that a single read picks up all frames that are already waiting on
+ * the socket */
+#define READ_BUFFER_SIZE (16*1024)
+
 PA_STATIC_FLIST_DECLARE(items, 0, pa_xfree);
 
 struct item_info {
@@ -86,7 +97,8 @@ struct item_info {
         PA_PSTREAM_ITEM_PACKET,
         PA_PSTREAM_ITEM_MEMBLOCK,
         PA_PSTREAM_ITEM_SHMRELEASE,
-        PA_PSTREAM_ITEM_SHMREVOKE
+        PA_PSTREAM_ITEM_SHMREVOKE,
+        PA_PSTREAM_ITEM_SHMMEMFD
     } type;
 
     /* packet info */
@@ -104,6 +116,17 @@ struct item_info {
 
     /* release/revoke info */
     uint32_t block_id;
+
+    /* memfd info, the pool keeps ownership of the descriptor */
+    uint32_t shm_id;
+    int memfd;
+};
+
+struct write_frame {
+    pa_pstream_descriptor descriptor;
+    struct item_info *item;
+    uint32_t shm_info[PA_PSTREAM_SHM_MAX];
+    pa_memchunk memchunk;
 };
 
 struct pa_pstream {
@@ -118,12 +141,11 @@ struct pa_pstream {
     pa_bool_t dead;
 
     struct {
-        pa_pstream_descriptor descriptor;
-        struct item_info* current;
-        uint32_t shm_info[PA_PSTREAM_SHM_MAX];
-        void *data;
+        /* Frames taken off send_queue, index counts the bytes of
+         * frames[0] that are written already */
+        struct write_frame frames[WRITE_BATCH_MAX];
+        unsigned n_frames;
         size_t index;
-        pa_memchunk memchunk;
     } write;
 
     struct {
@@ -133,12 +155,24 @@ struct pa_pstream {
         uint32_t shm_info[PA_PSTREAM_SHM_MAX];
         void *data;
         size_t index;
+
+        /* Data that was read but not parsed yet */
+        uint8_t *buffer;
+        size_t buffer_index, buffer_length;
+#ifdef HAVE_CREDS
+        pa_bool_t buffer_creds_valid;
+#endif
     } read;
 
+    pa_bool_t batching;
+
     pa_bool_t use_shm;
     pa_memimport *import;
     pa_memexport *export;
 
+    /* The pool handed to the other side, if any */
+    pa_mempool *memfd_pool;
+
     pa_pstream_packet_cb_t receive_packet_callback;
     void *receive_packet_callback_userdata;
 
@@ -160,8 +194,12 @@ struct pa_pstream {
     pa_mempool *mempool;
 
 #ifdef HAVE_CREDS
-    pa_creds read_creds, write_creds;
-    pa_bool_t read_creds_valid, send_creds_now;
+    pa_creds read_creds;
+    pa_bool_t read_creds_valid;
+
+    /* A file descriptor that was received, for the memfd frame it was
+     * sent with */
+    int read_fd;
 #endif
 };
 
@@ -221,6 +259,7 @@ static void defer_callback(pa_mainloop_api *m, pa_defer_event *e, void*userdata)
 }
 
 static void memimport_release_cb(pa_memimport *i, uint32_t block_id, void *userdata);
+static void memexport_revoke_cb(pa_memexport *e, uint32_t block_id, void *userdata);
 
 pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *pool) {
     pa_pstream *p;
@@ -241,12 +280,15 @@ pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *poo
 
     p->send_queue = pa_queue_new();
 
-    p->write.current = NULL;
+    p->write.n_frames = 0;
     p->write.index = 0;
-    pa_memchunk_reset(&p->write.memchunk);
     p->read.memblock = NULL;
     p->read.packet = NULL;
     p->read.index = 0;
+    p->read.buffer = NULL;
+    p->read.buffer_index = p->read.buffer_length = 0;
+
+    p->batching = !getenv("PULSE_NO_PSTREAM_BATCHING");
 
     p->receive_packet_callback = NULL;
     p->receive_packet_callback_userdata = NULL;
@@ -265,6 +307,7 @@ pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *poo
 
     p->use_shm = FALSE;
     p->export = NULL;
+    p->memfd_pool = NULL;
 
     /* We do importing unconditionally */
     p->import = pa_memimport_new(p->mempool, memimport_release_cb, p);
@@ -273,8 +316,9 @@ pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *poo
     pa_iochannel_socket_set_sndbuf(io, pa_mempool_block_size_max(p->mempool));
 
 #ifdef HAVE_CREDS
-    p->send_creds_now = FALSE;
     p->read_creds_valid = FALSE;
+    p->read.buffer_creds_valid = FALSE;
+    p->read_fd = -1;
 #endif
     return p;
 }
@@ -295,18 +339,26 @@ static void item_free(void *item) {
         pa_xfree(i);
 }
 
+static void write_frame_done(struct write_frame *f) {
+    pa_assert(f);
+
+    item_free(f->item);
+
+    if (f->memchunk.memblock)
+        pa_memblock_unref(f->memchunk.memblock);
+}
+
 static void pstream_free(pa_pstream *p) {
+    unsigned i;
+
     pa_assert(p);
 
     pa_pstream_unlink(p);
 
     pa_queue_free(p->send_queue, item_free);
 
-    if (p->write.current)
-        item_free(p->write.current);
-
-    if (p->write.memchunk.memblock)
-        pa_memblock_unref(p->write.memchunk.memblock);
+    for (i = 0; i < p->write.n_frames; i++)
+        write_frame_done(&p->write.frames[i]);
 
     if (p->read.memblock)
         pa_memblock_unref(p->read.memblock);
@@ -314,6 +366,11 @@ static void pstream_free(pa_pstream *p) {
     if (p->read.packet)
         pa_packet_unref(p->read.packet);
 
+    pa_xfree(p->read.buffer);
+
+    if (p->memfd_pool)
+        pa_mempool_free(p->memfd_pool);
+
     pa_xfree(p);
 }
 
@@ -448,6 +505,58 @@ void pa_pstream_send_revoke(pa_pstream *p, uint32_t block_id) {
     p->mainloop->defer_enable(p->defer_event, 1);
 }
 
+#ifdef HAVE_CREDS
+
+/* Blocks are exported from pool from now on, which the other side
+ * learns about by the descriptor passed along with this frame */
+int pa_pstream_register_memfd_mempool(pa_pstream *p, pa_mempool *pool) {
+    struct item_info *item;
+    uint32_t shm_id;
+
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(pool);
+    pa_assert(p->use_shm);
+    pa_assert(pa_mempool_is_memfd(pool));
+
+    if (p->dead)
+        return -1;
+
+    /* The other side may still refer to blocks of the export we'd
+     * replace, so we only register once */
+    if (p->memfd_pool) {
+        if (p->memfd_pool == pool)
+            return 0;
+
+        pa_log_warn("Refusing to replace the already registered memfd pool.");
+        return -1;
+    }
+
+    pa_assert_se(pa_mempool_get_shm_id(pool, &shm_id) == 0);
+
+    /* Nothing can have been exported from the default export yet, the
+     * pool is registered right after authentication */
+    if (p->export)
+        pa_memexport_free(p->export);
+
+    p->memfd_pool = pa_mempool_ref(pool);
+    p->export = pa_memexport_new(pool, memexport_revoke_cb, p);
+
+    if (!(item = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
+        item = pa_xnew(struct item_info, 1);
+    item->type = PA_PSTREAM_ITEM_SHMMEMFD;
+    item->shm_id = shm_id;
+    item->memfd = pa_mempool_get_memfd_fd(pool);
+    item->with_creds = FALSE;
+
+    pa_queue_push(p->send_queue, item);
+    p->mainloop->defer_enable(p->defer_event, 1);
+
+    return 0;
+}
+
+#endif
+
 /* might be called from thread context */
 static void memexport_revoke_cb(pa_memexport *e, uint32_t block_id, void *userdata) {
     pa_pstream *p = userdata;
@@ -461,62 +570,68 @@ static void memexport_revoke_cb(pa_memexport *e, uint32_t block_id, void *userda
         pa_pstream_send_revoke(p, block_id);
 }
 
-static void prepare_next_write_item(pa_pstream *p) {
+static pa_bool_t prepare_next_write_frame(pa_pstream *p) {
+    struct write_frame *f;
+    struct item_info *item;
+
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(p->write.n_frames < WRITE_BATCH_MAX);
 
-    p->write.current = pa_queue_pop(p->send_queue);
+    if (!(item = pa_queue_pop(p->send_queue)))
+        return FALSE;
 
-    if (!p->write.current)
-        return;
+    f = &p->write.frames[p->write.n_frames++];
+    f->item = item;
+    pa_memchunk_reset(&f->memchunk);
 
-    p->write.index = 0;
-    p->write.data = NULL;
-    pa_memchunk_reset(&p->write.memchunk);
+    f->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
+    f->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
+    f->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
+    f->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
+    f->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
 
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
+    if (item->type == PA_PSTREAM_ITEM_PACKET) {
 
-    if (p->write.current->type == PA_PSTREAM_ITEM_PACKET) {
+        pa_assert(item->packet);
+        f->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) item->packet->length);
 
-        pa_assert(p->write.current->packet);
-        p->write.data = p->write.current->packet->data;
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) p->write.current->packet->length);
+    } else if (item->type == PA_PSTREAM_ITEM_SHMRELEASE) {
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
+        f->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
+        f->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(item->block_id);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+    } else if (item->type == PA_PSTREAM_ITEM_SHMREVOKE) {
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
+        f->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
+        f->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(item->block_id);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+    } else if (item->type == PA_PSTREAM_ITEM_SHMMEMFD) {
+
+        f->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMMEMFD);
+        f->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(item->shm_id);
 
     } else {
         uint32_t flags;
         pa_bool_t send_payload = TRUE;
 
-        pa_assert(p->write.current->type == PA_PSTREAM_ITEM_MEMBLOCK);
-        pa_assert(p->write.current->chunk.memblock);
+        pa_assert(item->type == PA_PSTREAM_ITEM_MEMBLOCK);
+        pa_assert(item->chunk.memblock);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(p->write.current->channel);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) p->write.current->offset) >> 32));
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) p->write.current->offset));
+        f->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(item->channel);
+        f->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) item->offset) >> 32));
+        f->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) item->offset));
 
-        flags = (uint32_t) (p->write.current->seek_mode & PA_FLAG_SEEKMASK);
+        flags = (uint32_t) (item->seek_mode & PA_FLAG_SEEKMASK);
 
-        if (p->use_shm) {
+        /* A memfd pool can only be exported from once it has been
+         * registered with the other side */
+        if (p->use_shm && p->export) {
             uint32_t block_id, shm_id;
             size_t offset, length;
 
-            pa_assert(p->export);
-
             if (pa_memexport_put(p->export,
-                                 p->write.current->chunk.memblock,
+                                 item->chunk.memblock,
                                  &block_id,
                                  &shm_id,
                                  &offset,
@@ -525,111 +640,217 @@ static void prepare_next_write_item(pa_pstream *p) {
                 flags |= PA_FLAG_SHMDATA;
                 send_payload = FALSE;
 
-                p->write.shm_info[PA_PSTREAM_SHM_BLOCKID] = htonl(block_id);
-                p->write.shm_info[PA_PSTREAM_SHM_SHMID] = htonl(shm_id);
-                p->write.shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + p->write.current->chunk.index));
-                p->write.shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
+                f->shm_info[PA_PSTREAM_SHM_BLOCKID] = htonl(block_id);
+                f->shm_info[PA_PSTREAM_SHM_SHMID] = htonl(shm_id);
+                f->shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + item->chunk.index));
+                f->shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) item->chunk.length);
 
-                p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(sizeof(p->write.shm_info));
-                p->write.data = p->write.shm_info;
+                f->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(sizeof(f->shm_info));
             }
 /*             else */
 /*                 pa_log_warn("Failed to export memory block."); */
         }
 
         if (send_payload) {
-            p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
-            p->write.memchunk = p->write.current->chunk;
-            pa_memblock_ref(p->write.memchunk.memblock);
-            p->write.data = NULL;
+            f->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) item->chunk.length);
+            f->memchunk = item->chunk;
+            pa_memblock_ref(f->memchunk.memblock);
         }
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
+        f->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
     }
 
-#ifdef HAVE_CREDS
-    if ((p->send_creds_now = p->write.current->with_creds))
-        p->write_creds = p->write.current->creds;
-#endif
+    return TRUE;
+}
+
+static size_t write_frame_size(struct write_frame *f) {
+    pa_assert(f);
+
+    return PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(f->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
 }
 
 static int do_write(pa_pstream *p) {
-    void *d;
-    size_t l;
+    struct iovec iov[2*WRITE_BATCH_MAX];
+    pa_memblock *release_memblocks[WRITE_BATCH_MAX];
+    unsigned i, n_iov = 0, n_release = 0, n_done = 0;
     ssize_t r;
-    pa_memblock *release_memblock = NULL;
+#ifdef HAVE_CREDS
+    pa_bool_t send_creds = FALSE, send_fd = FALSE;
+#endif
 
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
-    if (!p->write.current)
-        prepare_next_write_item(p);
+    /* Take as many frames off the queue as we may send in one go. With
+     * batching disabled we write one descriptor or payload at a time. */
+    while (p->write.n_frames < (p->batching ? WRITE_BATCH_MAX : 1))
+        if (!prepare_next_write_frame(p))
+            break;
 
-    if (!p->write.current)
+    if (p->write.n_frames <= 0)
         return 0;
 
-    if (p->write.index < PA_PSTREAM_DESCRIPTOR_SIZE) {
-        d = (uint8_t*) p->write.descriptor + p->write.index;
-        l = PA_PSTREAM_DESCRIPTOR_SIZE - p->write.index;
-    } else {
-        pa_assert(p->write.data || p->write.memchunk.memblock);
+    for (i = 0; i < p->write.n_frames; i++) {
+        struct write_frame *f = &p->write.frames[i];
+        size_t skip, length;
 
-        if (p->write.data)
-            d = p->write.data;
-        else {
-            d = pa_memblock_acquire_chunk(&p->write.memchunk);
-            release_memblock = p->write.memchunk.memblock;
+#ifdef HAVE_CREDS
+        /* Credentials and file descriptors apply to all data of the
+         * write they are sent with, hence frames carrying them start a
+         * write of their own, and nothing else is appended to it */
+        if (f->item->with_creds || f->item->type == PA_PSTREAM_ITEM_SHMMEMFD) {
+            if (i > 0)
+                break;
+
+            if (f->item->with_creds)
+                send_creds = p->write.index == 0;
+            else
+                send_fd = p->write.index == 0;
         }
+#endif
 
-        d = (uint8_t*) d + p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE;
-        l = ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE);
-    }
+        skip = i == 0 ? p->write.index : 0;
+        length = ntohl(f->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
 
-    pa_assert(l > 0);
+        if (skip < PA_PSTREAM_DESCRIPTOR_SIZE) {
+            iov[n_iov].iov_base = (uint8_t*) f->descriptor + skip;
+            iov[n_iov].iov_len = PA_PSTREAM_DESCRIPTOR_SIZE - skip;
+            n_iov++;
+
+            if (!p->batching)
+                break;
+
+            skip = 0;
+        } else
+            skip -= PA_PSTREAM_DESCRIPTOR_SIZE;
+
+        if (skip < length) {
+            void *d;
+
+            if (f->memchunk.memblock) {
+                d = pa_memblock_acquire_chunk(&f->memchunk);
+                release_memblocks[n_release++] = f->memchunk.memblock;
+            } else if (f->item->type == PA_PSTREAM_ITEM_PACKET)
+                d = f->item->packet->data;
+            else
+                d = f->shm_info;
+
+            iov[n_iov].iov_base = (uint8_t*) d + skip;
+            iov[n_iov].iov_len = length - skip;
+            n_iov++;
+        }
 
 #ifdef HAVE_CREDS
-    if (p->send_creds_now) {
+        if (send_creds || send_fd)
+            break;
+#endif
+    }
 
-        if ((r = pa_iochannel_write_with_creds(p->io, d, l, &p->write_creds)) < 0)
-            goto fail;
+    pa_assert(n_iov > 0);
 
-        p->send_creds_now = FALSE;
-    } else
+#ifdef HAVE_CREDS
+    if (send_creds)
+        r = pa_iochannel_writev_with_creds(p->io, iov, n_iov, &p->write.frames[0].item->creds);
+    else if (send_fd)
+        r = pa_iochannel_writev_with_fd(p->io, iov, n_iov, p->write.frames[0].item->memfd);
+    else
 #endif
+        r = pa_iochannel_writev(p->io, iov, n_iov);
 
-    if ((r = pa_iochannel_write(p->io, d, l)) < 0)
-        goto fail;
+    for (i = 0; i < n_release; i++)
+        pa_memblock_release(release_memblocks[i]);
 
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
+    if (r < 0)
+        return -1;
 
     p->write.index += (size_t) r;
 
-    if (p->write.index >= PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH])) {
-        pa_assert(p->write.current);
-        item_free(p->write.current);
-        p->write.current = NULL;
-
-        if (p->write.memchunk.memblock)
-            pa_memblock_unref(p->write.memchunk.memblock);
+    while (n_done < p->write.n_frames && p->write.index >= write_frame_size(&p->write.frames[n_done])) {
+        p->write.index -= write_frame_size(&p->write.frames[n_done]);
+        write_frame_done(&p->write.frames[n_done]);
+        n_done++;
+    }
 
-        pa_memchunk_reset(&p->write.memchunk);
+    if (n_done > 0) {
+        p->write.n_frames -= n_done;
+        memmove(p->write.frames, p->write.frames + n_done, p->write.n_frames * sizeof(struct write_frame));
 
         if (p->drain_callback && !pa_pstream_is_pending(p))
             p->drain_callback(p, p->drain_callback_userdata);
     }
 
     return 0;
+}
 
-fail:
+/* Reads up to l bytes to d, from the buffer if it has data, otherwise
+ * from the socket */
+static ssize_t read_data(pa_pstream *p, void *d, size_t l) {
+    ssize_t r;
 
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
+    pa_assert(p);
+    pa_assert(d);
+    pa_assert(l > 0);
 
-    return -1;
+    if (p->read.buffer_index >= p->read.buffer_length) {
+        void *buf;
+        size_t n;
+
+        /* Larger payloads are read right into their destination */
+        if (p->batching && l < READ_BUFFER_SIZE) {
+            if (!p->read.buffer)
+                p->read.buffer = pa_xmalloc(READ_BUFFER_SIZE);
+
+            buf = p->read.buffer;
+            n = READ_BUFFER_SIZE;
+        } else {
+            buf = d;
+            n = l;
+        }
+
+#ifdef HAVE_CREDS
+        {
+            pa_bool_t b = 0;
+            int fd = -1;
+
+            if ((r = pa_iochannel_read_with_creds(p->io, buf, n, &p->read_creds, &b, &fd)) <= 0)
+                return r;
+
+            if (fd >= 0) {
+                /* Only one may be on its way at a time */
+                if (p->read_fd >= 0)
+                    pa_close(p->read_fd);
+
+                p->read_fd = fd;
+            }
+
+            if (buf == d) {
+                p->read_creds_valid = p->read_creds_valid || b;
+                return r;
+            }
+
+            p->read.buffer_creds_valid = b;
+        }
+#else
+        if ((r = pa_iochannel_read(p->io, buf, n)) <= 0 || buf == d)
+            return r;
+#endif
+
+        p->read.buffer_index = 0;
+        p->read.buffer_length = (size_t) r;
+    }
+
+    r = (ssize_t) PA_MIN(l, p->read.buffer_length - p->read.buffer_index);
+    memcpy(d, p->read.buffer + p->read.buffer_index, (size_t) r);
+    p->read.buffer_index += (size_t) r;
+
+#ifdef HAVE_CREDS
+    p->read_creds_valid = p->read_creds_valid || p->read.buffer_creds_valid;
+#endif
+
+    return r;
 }
 
-static int do_read(pa_pstream *p) {
+static int do_read_frame(pa_pstream *p) {
     void *d;
     size_t l;
     ssize_t r;
@@ -654,19 +875,8 @@ static int do_read(pa_pstream *p) {
         l = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (p->read.index - PA_PSTREAM_DESCRIPTOR_SIZE);
     }
 
-#ifdef HAVE_CREDS
-    {
-        pa_bool_t b = 0;
-
-        if ((r = pa_iochannel_read_with_creds(p->io, d, l, &p->read_creds, &b)) <= 0)
-            goto fail;
-
-        p->read_creds_valid = p->read_creds_valid || b;
-    }
-#else
-    if ((r = pa_iochannel_read(p->io, d, l)) <= 0)
+    if ((r = read_data(p, d, l)) <= 0)
         goto fail;
-#endif
 
     if (release_memblock)
         pa_memblock_release(release_memblock);
@@ -705,6 +915,34 @@ static int do_read(pa_pstream *p) {
             pa_memimport_process_revoke(p->import, ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]));
 
             goto frame_done;
+
+        } else if (flags == PA_FLAG_SHMMEMFD) {
+
+            /* This is a frame with no payload that registers a memfd
+             * segment of the other side, whose descriptor came with
+             * it */
+
+#ifdef HAVE_CREDS
+            int fd = p->read_fd;
+
+            if (fd < 0) {
+                pa_log_warn("Received memfd frame without file descriptor.");
+                return -1;
+            }
+
+            p->read_fd = -1;
+
+            pa_assert(p->import);
+            if (pa_memimport_attach_memfd(p->import, ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]), fd) < 0) {
+                pa_log_warn("Failed to attach memfd segment.");
+                return -1;
+            }
+
+            goto frame_done;
+#else
+            pa_log_warn("Received memfd frame, but file descriptor passing is not supported.");
+            return -1;
+#endif
         }
 
         length = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
@@ -882,6 +1120,19 @@ fail:
     return -1;
 }
 
+static int do_read(pa_pstream *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    /* Parse all frames a buffered read picked up, not only the first one */
+    do {
+        if (do_read_frame(p) < 0)
+            return -1;
+    } while (!p->dead && p->read.buffer_index < p->read.buffer_length);
+
+    return 0;
+}
+
 void pa_pstream_set_die_callback(pa_pstream *p, pa_pstream_notify_cb_t cb, void *userdata) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
@@ -939,7 +1190,7 @@ pa_bool_t pa_pstream_is_pending(pa_pstream *p) {
     if (p->dead)
         b = FALSE;
     else
-        b = p->write.current || !pa_queue_isempty(p->send_queue);
+        b = p->write.n_frames > 0 || !pa_queue_isempty(p->send_queue);
 
     return b;
 }
@@ -983,6 +1234,13 @@ void pa_pstream_unlink(pa_pstream *p) {
         p->io = NULL;
     }
 
+#ifdef HAVE_CREDS
+    if (p->read_fd >= 0) {
+        pa_close(p->read_fd);
+        p->read_fd = -1;
+    }
+#endif
+
     if (p->defer_event) {
         p->mainloop->defer_free(p->defer_event);
         p->defer_event = NULL;
@@ -1002,8 +1260,14 @@ void pa_pstream_enable_shm(pa_pstream *p, pa_bool_t enable) {
 
     if (enable) {
 
-        if (!p->export)
-            p->export = pa_memexport_new(p->mempool, memexport_revoke_cb, p);
+        /* The other side can only refer to memfd pools that have been
+         * registered, see pa_pstream_register_memfd_mempool() */
+        if (!p->export) {
+            if (p->memfd_pool)
+                p->export = pa_memexport_new(p->memfd_pool, memexport_revoke_cb, p);
+            else if (!pa_mempool_is_memfd(p->mempool))
+                p->export = pa_memexport_new(p->mempool, memexport_revoke_cb, p);
+        }
 
     } else {
 
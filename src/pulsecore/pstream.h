@@ -42,6 +42,10 @@ typedef void (*pa_pstream_memblock_cb_t)(pa_pstream *p, uint32_t channel, int64_
 typedef void (*pa_pstream_notify_cb_t)(pa_pstream *p, void *userdata);
 typedef void (*pa_pstream_block_id_cb_t)(pa_pstream *p, uint32_t block_id, void *userdata);
 
+/* Queued frames are written with as few system calls as possible, and a
+ * single read picks up all small frames that are waiting. Set
+ * $PULSE_NO_PSTREAM_BATCHING to transfer one descriptor or payload at a
+ * time. */
 pa_pstream* pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *p);
 
 pa_pstream* pa_pstream_ref(pa_pstream*p);
@@ -66,4 +70,13 @@ pa_bool_t pa_pstream_is_pending(pa_pstream *p);
 void pa_pstream_enable_shm(pa_pstream *p, pa_bool_t enable);
 pa_bool_t pa_pstream_get_shm(pa_pstream *p);
 
+#ifdef HAVE_CREDS
+/* Hands the memfd backed pool to the other side and exports all memory
+ * blocks from it from now on, copying those that come from elsewhere.
+ * SHM needs to be enabled first. A pool can only be registered once,
+ * registering it again is a no-op and registering another one
+ * fails. */
+int pa_pstream_register_memfd_mempool(pa_pstream *p, pa_mempool *pool);
+#endif
+
 #endif
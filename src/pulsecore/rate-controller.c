@@ -0,0 +1,103 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/macro.h>
+
+#include "rate-controller.h"
+
+/* With the latency error e sampled every T the loop is
+ *
+ *   e[k+1] = e[k] + (drift - (factor[k] - 1)) * T
+ *
+ * and with factor - 1 = (KP * e + KI * sum(e)) / T its closed loop
+ * poles are the roots of z^2 + (KP + KI - 2) z + (1 - KP). These gains
+ * put a double pole at 0.75: no overshoot, and an initial error is
+ * down to a tenth after about ten updates. */
+#define KP (7.0/16.0)
+#define KI (1.0/16.0)
+
+struct pa_rate_controller {
+    double adjust_time;
+    double max_deviation;
+
+    double integral;
+    double factor;
+};
+
+pa_rate_controller* pa_rate_controller_new(pa_usec_t adjust_time, double max_deviation) {
+    pa_rate_controller *c;
+
+    pa_assert(adjust_time > 0);
+    pa_assert(max_deviation > 0 && max_deviation < 1.0);
+
+    c = pa_xnew(pa_rate_controller, 1);
+    c->adjust_time = (double) adjust_time;
+    c->max_deviation = max_deviation;
+
+    pa_rate_controller_reset(c);
+
+    return c;
+}
+
+void pa_rate_controller_free(pa_rate_controller *c) {
+    pa_assert(c);
+
+    pa_xfree(c);
+}
+
+double pa_rate_controller_update(pa_rate_controller *c, int64_t error) {
+    double e, d;
+
+    pa_assert(c);
+
+    e = (double) error / c->adjust_time;
+    d = KP * e + KI * (c->integral + e);
+
+    /* Only integrate while not saturated, otherwise a long lasting
+     * large error would wind up the integral and overshoot later */
+    if (d > c->max_deviation)
+        d = c->max_deviation;
+    else if (d < -c->max_deviation)
+        d = -c->max_deviation;
+    else
+        c->integral += e;
+
+    c->factor = 1.0 + d;
+
+    return c->factor;
+}
+
+double pa_rate_controller_get(pa_rate_controller *c) {
+    pa_assert(c);
+
+    return c->factor;
+}
+
+void pa_rate_controller_reset(pa_rate_controller *c) {
+    pa_assert(c);
+
+    c->integral = 0;
+    c->factor = 1.0;
+}
@@ -0,0 +1,54 @@
+#ifndef foopulseratecontrollerhfoo
+#define foopulseratecontrollerhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/sample.h>
+
+/* A PI controller for drift compensation. It is fed the deviation of
+ * a buffer's latency from its target once every adjust_time and
+ * returns the factor to scale the consumer's input rate by, to be
+ * passed to pa_sink_input_set_rate_adjust(). The proportional part
+ * pulls the latency back to the target, the integral part learns the
+ * clock drift so that the error goes to zero in the steady state. */
+
+typedef struct pa_rate_controller pa_rate_controller;
+
+/* Rate changes of up to 2‰ can be considered inaudible */
+#define PA_RATE_CONTROLLER_MAX_DEVIATION 0.002
+
+/* The returned factor always stays within 1.0 +/- max_deviation */
+pa_rate_controller* pa_rate_controller_new(pa_usec_t adjust_time, double max_deviation);
+void pa_rate_controller_free(pa_rate_controller *c);
+
+/* error is the measured latency minus the target latency, i.e.
+ * positive if there is too much data buffered, which results in a
+ * factor > 1.0 that consumes it faster */
+double pa_rate_controller_update(pa_rate_controller *c, int64_t error);
+
+/* Returns the factor the last update returned */
+double pa_rate_controller_get(pa_rate_controller *c);
+
+/* Forget the learned drift, e.g. when one of the clocks changed */
+void pa_rate_controller_reset(pa_rate_controller *c);
+
+#endif
@@ -85,73 +85,98 @@ static void remap_mono_to_stereo_c(pa_remap_t *m, void *dst, const void *src, un
     }
 }
 
-static void remap_channels_matrix_c(pa_remap_t *m, void *dst, const void *src, unsigned n) {
-    unsigned oc, ic, i;
-    unsigned n_ic, n_oc;
+/* Every output channel is silent or a copy of one input channel */
+static void remap_arrange_c(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    unsigned oc, n_ic, n_oc;
+    int idx[PA_CHANNELS_MAX];
 
     n_ic = m->i_ss->channels;
     n_oc = m->o_ss->channels;
 
+    for (oc = 0; oc < n_oc; oc++)
+        idx[oc] = m->n_terms[oc] > 0 ? m->terms[oc][0] : -1;
+
     switch (*m->format) {
         case PA_SAMPLE_FLOAT32NE:
         {
-            float *d, *s;
+            float *d = dst;
+            const float *s = src;
 
-            memset(dst, 0, n * sizeof(float) * n_oc);
+            for (; n > 0; n--, s += n_ic, d += n_oc)
+                for (oc = 0; oc < n_oc; oc++)
+                    d[oc] = idx[oc] >= 0 ? s[idx[oc]] : 0.0f;
 
-            for (oc = 0; oc < n_oc; oc++) {
+            break;
+        }
+        case PA_SAMPLE_S16NE:
+        {
+            int16_t *d = dst;
+            const int16_t *s = src;
 
-                for (ic = 0; ic < n_ic; ic++) {
-                    float vol;
+            for (; n > 0; n--, s += n_ic, d += n_oc)
+                for (oc = 0; oc < n_oc; oc++)
+                    d[oc] = idx[oc] >= 0 ? s[idx[oc]] : 0;
 
-                    vol = m->map_table_f[oc][ic];
+            break;
+        }
+        default:
+            pa_assert_not_reached();
+    }
+}
 
-                    if (vol <= 0.0)
-                        continue;
+/* Goes through the frames one by one and only looks at the matrix entries
+ * that are actually set. Each output sample is summed up in the order of
+ * the input channels, which the optimized versions stick to as well, so
+ * that all of them produce the very same output. */
+void pa_remap_matrix_c(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    unsigned oc, k, n_ic, n_oc;
 
-                    d = (float *)dst + oc;
-                    s = (float *)src + ic;
+    n_ic = m->i_ss->channels;
+    n_oc = m->o_ss->channels;
+
+    switch (*m->format) {
+        case PA_SAMPLE_FLOAT32NE:
+        {
+            float *d = dst;
+            const float *s = src;
+
+            for (; n > 0; n--, s += n_ic, d += n_oc)
+                for (oc = 0; oc < n_oc; oc++) {
+                    float sum = 0.0f;
 
-                    if (vol >= 1.0) {
-                        for (i = n; i > 0; i--, s += n_ic, d += n_oc)
-                            *d += *s;
-                    } else {
-                        for (i = n; i > 0; i--, s += n_ic, d += n_oc)
-                            *d += *s * vol;
+                    for (k = 0; k < m->n_terms[oc]; k++) {
+                        unsigned ic = m->terms[oc][k];
+
+                        sum += s[ic] * m->coef_f[ic][oc];
                     }
+
+                    d[oc] = sum;
                 }
-            }
 
             break;
         }
         case PA_SAMPLE_S16NE:
         {
-            int16_t *d, *s;
-
-            memset(dst, 0, n * sizeof(int16_t) * n_oc);
-
-            for (oc = 0; oc < n_oc; oc++) {
+            int16_t *d = dst;
+            const int16_t *s = src;
 
-                for (ic = 0; ic < n_ic; ic++) {
-                    int32_t vol;
+            for (; n > 0; n--, s += n_ic, d += n_oc)
+                for (oc = 0; oc < n_oc; oc++) {
+                    int16_t sum = 0;
 
-                    vol = m->map_table_i[oc][ic];
+                    for (k = 0; k < m->n_terms[oc]; k++) {
+                        unsigned ic = m->terms[oc][k];
+                        int32_t vol = m->map_table_i[oc][ic];
 
-                    if (vol <= 0)
-                        continue;
-
-                    d = (int16_t *)dst + oc;
-                    s = (int16_t *)src + ic;
-
-                    if (vol >= 0x10000) {
-                        for (i = n; i > 0; i--, s += n_ic, d += n_oc)
-                            *d += *s;
-                    } else {
-                        for (i = n; i > 0; i--, s += n_ic, d += n_oc)
-                            *d += (int16_t) (((int32_t)*s * vol) >> 16);
+                        if (vol >= 0x10000)
+                            sum += s[ic];
+                        else
+                            sum += (int16_t) (((int32_t) s[ic] * vol) >> 16);
                     }
+
+                    d[oc] = sum;
                 }
-            }
+
             break;
         }
         default:
@@ -159,6 +184,57 @@ static void remap_channels_matrix_c(pa_remap_t *m, void *dst, const void *src, u
     }
 }
 
+/* Fills in everything the remapping functions need besides the matrices */
+static void calc_coefficients(pa_remap_t *m) {
+    unsigned oc, ic, n_oc, n_ic;
+    pa_bool_t used[PA_CHANNELS_MAX];
+
+    n_oc = m->o_ss->channels;
+    n_ic = m->i_ss->channels;
+
+    memset(m->coef_f, 0, sizeof(m->coef_f));
+    memset(m->coef_mul, 0, sizeof(m->coef_mul));
+    memset(m->coef_add, 0, sizeof(m->coef_add));
+    memset(used, 0, sizeof(used));
+
+    m->arrange = TRUE;
+
+    for (oc = 0; oc < n_oc; oc++) {
+        m->n_terms[oc] = 0;
+
+        for (ic = 0; ic < n_ic; ic++) {
+            float vol = m->map_table_f[oc][ic];
+            int32_t vol_i = m->map_table_i[oc][ic];
+
+            if (vol > 0.0f) {
+                m->terms[oc][m->n_terms[oc]++] = (uint8_t) ic;
+                m->coef_f[ic][oc] = vol >= 1.0f ? 1.0f : vol;
+                used[ic] = TRUE;
+
+                if (vol < 1.0f)
+                    m->arrange = FALSE;
+            }
+
+            if (vol_i >= 0x10000)
+                m->coef_add[ic][oc] = -1;
+            else if (vol_i >= 0x8000) {
+                /* (s * vol) >> 16 == ((s * (vol - 0x10000)) >> 16) + s */
+                m->coef_mul[ic][oc] = (int16_t) (vol_i - 0x10000);
+                m->coef_add[ic][oc] = -1;
+            } else if (vol_i > 0)
+                m->coef_mul[ic][oc] = (int16_t) vol_i;
+        }
+
+        if (m->n_terms[oc] > 1)
+            m->arrange = FALSE;
+    }
+
+    m->n_inputs = 0;
+    for (ic = 0; ic < n_ic; ic++)
+        if (used[ic])
+            m->inputs[m->n_inputs++] = (uint8_t) ic;
+}
+
 /* set the function that will execute the remapping based on the matrices */
 static void init_remap_c(pa_remap_t *m) {
     unsigned n_oc, n_ic;
@@ -171,8 +247,11 @@ static void init_remap_c(pa_remap_t *m) {
             m->map_table_f[0][0] >= 1.0 && m->map_table_f[1][0] >= 1.0) {
         m->do_remap = (pa_do_remap_func_t) remap_mono_to_stereo_c;
         pa_log_info("Using mono to stereo remapping");
+    } else if (m->arrange) {
+        m->do_remap = (pa_do_remap_func_t) remap_arrange_c;
+        pa_log_info("Using channel arrangement remapping");
     } else {
-        m->do_remap = (pa_do_remap_func_t) remap_channels_matrix_c;
+        m->do_remap = (pa_do_remap_func_t) pa_remap_matrix_c;
         pa_log_info("Using generic matrix remapping");
     }
 }
@@ -184,15 +263,16 @@ static pa_init_remap_func_t remap_func = init_remap_c;
 void pa_init_remap(pa_remap_t *m) {
     pa_assert(remap_func);
 
-    m->do_remap = NULL;
+    calc_coefficients(m);
 
-    /* call the installed remap init function */
-    remap_func(m);
+    /* The C version can do everything, the installed remap init
+     * function only needs to replace it where it knows better */
+    init_remap_c(m);
 
-    if (m->do_remap == NULL) {
-        /* nothing was installed, fallback to C version */
-        init_remap_c(m);
-    }
+    if (remap_func != init_remap_c)
+        remap_func(m);
+
+    pa_assert(m->do_remap);
 }
 
 pa_init_remap_func_t pa_get_init_remap_func(void) {
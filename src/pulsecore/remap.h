@@ -24,6 +24,7 @@
 ***/
 
 #include <pulse/sample.h>
+#include <pulsecore/macro.h>
 
 typedef struct pa_remap pa_remap_t;
 
@@ -35,10 +36,40 @@ struct pa_remap {
     float map_table_f[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
     int32_t map_table_i[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
     pa_do_remap_func_t do_remap;
+
+    /* The rest is derived from the matrices by pa_init_remap(), for the
+     * remapping functions. Like the matrix code always did, volumes <= 0
+     * are left out and volumes >= 1 count as 1. */
+
+    /* The input channels each output channel is the sum of, in
+     * ascending order */
+    unsigned n_terms[PA_CHANNELS_MAX];
+    uint8_t terms[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+
+    /* The input channels that go into any output channel, ascending */
+    unsigned n_inputs;
+    uint8_t inputs[PA_CHANNELS_MAX];
+
+    /* TRUE if every output channel is either silent or a copy of one
+     * input channel */
+    pa_bool_t arrange;
+
+    /* Row ic holds what input channel ic adds to each output channel,
+     * zero padded to PA_CHANNELS_MAX so that whole vectors can be loaded
+     * from it. For S16NE the term for a sample s is
+     * ((s * mul) >> 16) + (s & add), which is the same as the
+     * ((int32_t) s * vol) >> 16 of the C version for any vol. */
+    float coef_f[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+    int16_t coef_mul[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+    int16_t coef_add[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
 };
 
 void pa_init_remap (pa_remap_t *m);
 
+/* The generic C version, which handles any matrix. The optimized versions
+ * hand it the frames that don't fill a whole vector. */
+void pa_remap_matrix_c(pa_remap_t *m, void *dst, const void *src, unsigned n);
+
 /* custom installation of init functions */
 typedef void (*pa_init_remap_func_t) (pa_remap_t *m);
 
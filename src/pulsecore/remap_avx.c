@@ -0,0 +1,108 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/sample.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "remap.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+#include <immintrin.h>
+
+static pa_init_remap_func_t fallback_init;
+
+/* See remap_sse.c. Only float samples with many output channels are
+ * done here: for S16NE the SSE2 versions already fill a vector with 8
+ * samples, and gathering the inputs of a downmix from 8 frames costs more
+ * than the wider arithmetic saves. */
+static inline void remap_outputs_float32ne(pa_remap_t *m, float *d, const float *s, unsigned n, unsigned n_vec) {
+    unsigned n_ic = m->i_ss->channels, n_oc = m->o_ss->channels, spill, tail, i, j;
+
+    spill = n_vec * 8 - n_oc;
+    tail = PA_MIN((spill + n_oc - 1) / n_oc, n);
+
+    for (n -= tail; n > 0; n--, s += n_ic, d += n_oc) {
+        __m256 sum[PA_CHANNELS_MAX / 8];
+
+        for (j = 0; j < n_vec; j++)
+            sum[j] = _mm256_setzero_ps();
+
+        for (i = 0; i < m->n_inputs; i++) {
+            unsigned ic = m->inputs[i];
+            __m256 v = _mm256_set1_ps(s[ic]);
+
+            for (j = 0; j < n_vec; j++)
+                sum[j] = _mm256_add_ps(sum[j], _mm256_mul_ps(v, _mm256_loadu_ps(&m->coef_f[ic][j * 8])));
+        }
+
+        for (j = 0; j < n_vec; j++)
+            _mm256_storeu_ps(d + j * 8, sum[j]);
+    }
+
+    if (tail > 0)
+        pa_remap_matrix_c(m, d, s, tail);
+}
+
+static void remap_outputs_1_avx2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    remap_outputs_float32ne(m, dst, src, n, 1);
+}
+
+static void remap_outputs_n_avx2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    remap_outputs_float32ne(m, dst, src, n, (m->o_ss->channels + 7) / 8);
+}
+
+static void init_remap_avx2(pa_remap_t *m) {
+    unsigned n_oc, n_ic;
+
+    n_oc = m->o_ss->channels;
+    n_ic = m->i_ss->channels;
+
+    fallback_init(m);
+
+    /* Fewer output channels fit into two SSE vectors just as well */
+    if (*m->format != PA_SAMPLE_FLOAT32NE || m->arrange || n_oc < 8)
+        return;
+
+    m->do_remap = n_oc == 8 ? remap_outputs_1_avx2 : remap_outputs_n_avx2;
+
+    pa_log_info("Using AVX2 remapping from %u to %u channels", n_ic, n_oc);
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_remap_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized remappers.");
+
+        /* Don't chain up to ourselves when initialised twice */
+        if (pa_get_init_remap_func() != init_remap_avx2)
+            fallback_init = pa_get_init_remap_func();
+
+        pa_set_init_remap_func((pa_init_remap_func_t) init_remap_avx2);
+    }
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
@@ -0,0 +1,261 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/sample.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-arm.h"
+#include "remap.h"
+
+#if (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__)
+
+#include <arm_neon.h>
+
+/* See remap_sse.c */
+static inline float32x4_t load_frames_float32ne(const float *s, unsigned n_ic) {
+    float32x4_t v = vdupq_n_f32(0);
+
+    v = vld1q_lane_f32(s, v, 0);
+    v = vld1q_lane_f32(s + n_ic, v, 1);
+    v = vld1q_lane_f32(s + 2 * n_ic, v, 2);
+    v = vld1q_lane_f32(s + 3 * n_ic, v, 3);
+
+    return v;
+}
+
+static inline void remap_frames_float32ne(pa_remap_t *m, float *d, const float *s, unsigned n, unsigned n_oc) {
+    unsigned n_ic = m->i_ss->channels, i;
+
+    for (; n >= 4; n -= 4, s += 4 * n_ic, d += 4 * n_oc) {
+        float32x4x2_t lr;
+
+        lr.val[0] = lr.val[1] = vdupq_n_f32(0);
+
+        for (i = 0; i < m->n_inputs; i++) {
+            unsigned ic = m->inputs[i];
+            float32x4_t v = load_frames_float32ne(s + ic, n_ic);
+
+            /* Multiply and add separately, the C version may or may
+             * not be contracted into fused multiply-adds */
+            lr.val[0] = vaddq_f32(lr.val[0], vmulq_n_f32(v, m->coef_f[ic][0]));
+            if (n_oc == 2)
+                lr.val[1] = vaddq_f32(lr.val[1], vmulq_n_f32(v, m->coef_f[ic][1]));
+        }
+
+        if (n_oc == 1)
+            vst1q_f32(d, lr.val[0]);
+        else
+            vst2q_f32(d, lr);
+    }
+
+    if (n > 0)
+        pa_remap_matrix_c(m, d, s, n);
+}
+
+/* ((s * mul) >> 16) + (s & add), see remap.h */
+static inline int16x8_t remap_term_s16(int16x8_t v, int16x8_t mul, int16x8_t add) {
+    int16x8_t t;
+
+    t = vcombine_s16(vshrn_n_s32(vmull_s16(vget_low_s16(v), vget_low_s16(mul)), 16),
+                     vshrn_n_s32(vmull_s16(vget_high_s16(v), vget_high_s16(mul)), 16));
+
+    return vaddq_s16(t, vandq_s16(v, add));
+}
+
+static inline int16x8_t load_frames_s16ne(const int16_t *s, unsigned n_ic) {
+    int16x8_t v = vdupq_n_s16(0);
+
+    v = vld1q_lane_s16(s, v, 0);
+    v = vld1q_lane_s16(s + n_ic, v, 1);
+    v = vld1q_lane_s16(s + 2 * n_ic, v, 2);
+    v = vld1q_lane_s16(s + 3 * n_ic, v, 3);
+    v = vld1q_lane_s16(s + 4 * n_ic, v, 4);
+    v = vld1q_lane_s16(s + 5 * n_ic, v, 5);
+    v = vld1q_lane_s16(s + 6 * n_ic, v, 6);
+    v = vld1q_lane_s16(s + 7 * n_ic, v, 7);
+
+    return v;
+}
+
+static inline void remap_frames_s16ne(pa_remap_t *m, int16_t *d, const int16_t *s, unsigned n, unsigned n_oc) {
+    unsigned n_ic = m->i_ss->channels, i;
+
+    for (; n >= 8; n -= 8, s += 8 * n_ic, d += 8 * n_oc) {
+        int16x8x2_t lr;
+
+        lr.val[0] = lr.val[1] = vdupq_n_s16(0);
+
+        for (i = 0; i < m->n_inputs; i++) {
+            unsigned ic = m->inputs[i];
+            int16x8_t v = load_frames_s16ne(s + ic, n_ic);
+
+            /* Wraps around just like the C version */
+            lr.val[0] = vaddq_s16(lr.val[0], remap_term_s16(v, vdupq_n_s16(m->coef_mul[ic][0]), vdupq_n_s16(m->coef_add[ic][0])));
+            if (n_oc == 2)
+                lr.val[1] = vaddq_s16(lr.val[1], remap_term_s16(v, vdupq_n_s16(m->coef_mul[ic][1]), vdupq_n_s16(m->coef_add[ic][1])));
+        }
+
+        if (n_oc == 1)
+            vst1q_s16(d, lr.val[0]);
+        else
+            vst2q_s16(d, lr);
+    }
+
+    if (n > 0)
+        pa_remap_matrix_c(m, d, s, n);
+}
+
+static void remap_frames_1_neon(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    if (*m->format == PA_SAMPLE_FLOAT32NE)
+        remap_frames_float32ne(m, dst, src, n, 1);
+    else
+        remap_frames_s16ne(m, dst, src, n, 1);
+}
+
+static void remap_frames_2_neon(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    if (*m->format == PA_SAMPLE_FLOAT32NE)
+        remap_frames_float32ne(m, dst, src, n, 2);
+    else
+        remap_frames_s16ne(m, dst, src, n, 2);
+}
+
+static inline void remap_outputs_float32ne(pa_remap_t *m, float *d, const float *s, unsigned n, unsigned n_vec) {
+    unsigned n_ic = m->i_ss->channels, n_oc = m->o_ss->channels, spill, tail, i, j;
+
+    spill = n_vec * 4 - n_oc;
+    tail = PA_MIN((spill + n_oc - 1) / n_oc, n);
+
+    for (n -= tail; n > 0; n--, s += n_ic, d += n_oc) {
+        float32x4_t sum[PA_CHANNELS_MAX / 4];
+
+        for (j = 0; j < n_vec; j++)
+            sum[j] = vdupq_n_f32(0);
+
+        for (i = 0; i < m->n_inputs; i++) {
+            unsigned ic = m->inputs[i];
+
+            for (j = 0; j < n_vec; j++)
+                sum[j] = vaddq_f32(sum[j], vmulq_n_f32(vld1q_f32(&m->coef_f[ic][j * 4]), s[ic]));
+        }
+
+        for (j = 0; j < n_vec; j++)
+            vst1q_f32(d + j * 4, sum[j]);
+    }
+
+    if (tail > 0)
+        pa_remap_matrix_c(m, d, s, tail);
+}
+
+static inline void remap_outputs_s16ne(pa_remap_t *m, int16_t *d, const int16_t *s, unsigned n, unsigned n_vec) {
+    unsigned n_ic = m->i_ss->channels, n_oc = m->o_ss->channels, spill, tail, i, j;
+
+    spill = n_vec * 8 - n_oc;
+    tail = PA_MIN((spill + n_oc - 1) / n_oc, n);
+
+    for (n -= tail; n > 0; n--, s += n_ic, d += n_oc) {
+        int16x8_t sum[PA_CHANNELS_MAX / 8];
+
+        for (j = 0; j < n_vec; j++)
+            sum[j] = vdupq_n_s16(0);
+
+        for (i = 0; i < m->n_inputs; i++) {
+            unsigned ic = m->inputs[i];
+            int16x8_t v = vdupq_n_s16(s[ic]);
+
+            for (j = 0; j < n_vec; j++)
+                sum[j] = vaddq_s16(sum[j], remap_term_s16(v, vld1q_s16(&m->coef_mul[ic][j * 8]), vld1q_s16(&m->coef_add[ic][j * 8])));
+        }
+
+        for (j = 0; j < n_vec; j++)
+            vst1q_s16(d + j * 8, sum[j]);
+    }
+
+    if (tail > 0)
+        pa_remap_matrix_c(m, d, s, tail);
+}
+
+static void remap_outputs_1_neon(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    if (*m->format == PA_SAMPLE_FLOAT32NE)
+        remap_outputs_float32ne(m, dst, src, n, 1);
+    else
+        remap_outputs_s16ne(m, dst, src, n, 1);
+}
+
+static void remap_outputs_2_neon(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    if (*m->format == PA_SAMPLE_FLOAT32NE)
+        remap_outputs_float32ne(m, dst, src, n, 2);
+    else
+        remap_outputs_s16ne(m, dst, src, n, 2);
+}
+
+static void remap_outputs_n_neon(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    unsigned width = *m->format == PA_SAMPLE_FLOAT32NE ? 4 : 8;
+    unsigned n_vec = (m->o_ss->channels + width - 1) / width;
+
+    if (*m->format == PA_SAMPLE_FLOAT32NE)
+        remap_outputs_float32ne(m, dst, src, n, n_vec);
+    else
+        remap_outputs_s16ne(m, dst, src, n, n_vec);
+}
+
+static void init_remap_neon(pa_remap_t *m) {
+    unsigned n_oc, n_ic, width, n_vec;
+
+    n_oc = m->o_ss->channels;
+    n_ic = m->i_ss->channels;
+
+    /* Plain copying is left to the C version */
+    if (m->arrange)
+        return;
+
+    if (n_oc <= 2) {
+        m->do_remap = n_oc == 1 ? remap_frames_1_neon : remap_frames_2_neon;
+        pa_log_info("Using NEON remapping to %u channel(s)", n_oc);
+        return;
+    }
+
+    width = *m->format == PA_SAMPLE_FLOAT32NE ? 4 : 8;
+    n_vec = (n_oc + width - 1) / width;
+
+    if (n_vec == 1)
+        m->do_remap = remap_outputs_1_neon;
+    else if (n_vec == 2)
+        m->do_remap = remap_outputs_2_neon;
+    else
+        m->do_remap = remap_outputs_n_neon;
+
+    pa_log_info("Using NEON remapping from %u to %u channels", n_ic, n_oc);
+}
+
+#endif /* (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__) */
+
+void pa_remap_func_init_neon(pa_cpu_arm_flag_t flags) {
+#if (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__)
+    if (flags & PA_CPU_ARM_NEON) {
+        pa_log_info("Initialising NEON optimized remappers.");
+
+        pa_set_init_remap_func((pa_init_remap_func_t) init_remap_neon);
+    }
+#endif /* (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__) */
+}
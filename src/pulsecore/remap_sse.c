@@ -100,6 +100,9 @@
                 "4:                             \n\t"
 
 #if defined (__i386__) || defined (__amd64__)
+
+#include <emmintrin.h>
+
 static void remap_mono_to_stereo_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
     pa_reg_x86 temp, temp2;
 
@@ -129,9 +132,179 @@ static void remap_mono_to_stereo_sse2(pa_remap_t *m, void *dst, const void *src,
     }
 }
 
+/* Remapping to one or two output channels, e.g. downmixing to stereo:
+ * a vector holds the same channel of consecutive frames, so the sums
+ * come out in the lanes without any horizontal adding. The terms are
+ * added up in the order of the input channels, as in the C version. */
+static inline void remap_frames_float32ne(pa_remap_t *m, float *d, const float *s, unsigned n, unsigned n_oc) {
+    unsigned n_ic = m->i_ss->channels, i;
+
+    for (; n >= 4; n -= 4, s += 4 * n_ic, d += 4 * n_oc) {
+        __m128 l = _mm_setzero_ps(), r = _mm_setzero_ps();
+
+        for (i = 0; i < m->n_inputs; i++) {
+            unsigned ic = m->inputs[i];
+            __m128 v = _mm_setr_ps(s[ic], s[ic + n_ic], s[ic + 2 * n_ic], s[ic + 3 * n_ic]);
+
+            l = _mm_add_ps(l, _mm_mul_ps(v, _mm_set1_ps(m->coef_f[ic][0])));
+            if (n_oc == 2)
+                r = _mm_add_ps(r, _mm_mul_ps(v, _mm_set1_ps(m->coef_f[ic][1])));
+        }
+
+        if (n_oc == 1)
+            _mm_storeu_ps(d, l);
+        else {
+            _mm_storeu_ps(d, _mm_unpacklo_ps(l, r));
+            _mm_storeu_ps(d + 4, _mm_unpackhi_ps(l, r));
+        }
+    }
+
+    if (n > 0)
+        pa_remap_matrix_c(m, d, s, n);
+}
+
+static inline __m128i remap_term_s16(pa_remap_t *m, __m128i v, unsigned ic, unsigned oc) {
+    return _mm_add_epi16(_mm_mulhi_epi16(v, _mm_set1_epi16(m->coef_mul[ic][oc])),
+                         _mm_and_si128(v, _mm_set1_epi16(m->coef_add[ic][oc])));
+}
+
+static inline void remap_frames_s16ne(pa_remap_t *m, int16_t *d, const int16_t *s, unsigned n, unsigned n_oc) {
+    unsigned n_ic = m->i_ss->channels, i;
+
+    for (; n >= 8; n -= 8, s += 8 * n_ic, d += 8 * n_oc) {
+        __m128i l = _mm_setzero_si128(), r = _mm_setzero_si128();
+
+        for (i = 0; i < m->n_inputs; i++) {
+            unsigned ic = m->inputs[i];
+            __m128i v = _mm_setr_epi16(s[ic], s[ic + n_ic], s[ic + 2 * n_ic], s[ic + 3 * n_ic],
+                                       s[ic + 4 * n_ic], s[ic + 5 * n_ic], s[ic + 6 * n_ic], s[ic + 7 * n_ic]);
+
+            /* Wraps around just like the C version */
+            l = _mm_add_epi16(l, remap_term_s16(m, v, ic, 0));
+            if (n_oc == 2)
+                r = _mm_add_epi16(r, remap_term_s16(m, v, ic, 1));
+        }
+
+        if (n_oc == 1)
+            _mm_storeu_si128((__m128i*) d, l);
+        else {
+            _mm_storeu_si128((__m128i*) d, _mm_unpacklo_epi16(l, r));
+            _mm_storeu_si128((__m128i*) (d + 8), _mm_unpackhi_epi16(l, r));
+        }
+    }
+
+    if (n > 0)
+        pa_remap_matrix_c(m, d, s, n);
+}
+
+static void remap_frames_1_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    if (*m->format == PA_SAMPLE_FLOAT32NE)
+        remap_frames_float32ne(m, dst, src, n, 1);
+    else
+        remap_frames_s16ne(m, dst, src, n, 1);
+}
+
+static void remap_frames_2_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    if (*m->format == PA_SAMPLE_FLOAT32NE)
+        remap_frames_float32ne(m, dst, src, n, 2);
+    else
+        remap_frames_s16ne(m, dst, src, n, 2);
+}
+
+/* Remapping to more channels, e.g. upmixing from stereo: the vectors
+ * hold the output channels of one frame and every input sample is
+ * broadcast to them. Whole vectors are stored, the excess is overwritten
+ * by the next frame. Only the last frames, where that would write past
+ * the end, are left to the C version. */
+static inline void remap_outputs_float32ne(pa_remap_t *m, float *d, const float *s, unsigned n, unsigned n_vec) {
+    unsigned n_ic = m->i_ss->channels, n_oc = m->o_ss->channels, spill, tail, i, j;
+
+    spill = n_vec * 4 - n_oc;
+    tail = PA_MIN((spill + n_oc - 1) / n_oc, n);
+
+    for (n -= tail; n > 0; n--, s += n_ic, d += n_oc) {
+        __m128 sum[PA_CHANNELS_MAX / 4];
+
+        for (j = 0; j < n_vec; j++)
+            sum[j] = _mm_setzero_ps();
+
+        for (i = 0; i < m->n_inputs; i++) {
+            unsigned ic = m->inputs[i];
+            __m128 v = _mm_set1_ps(s[ic]);
+
+            for (j = 0; j < n_vec; j++)
+                sum[j] = _mm_add_ps(sum[j], _mm_mul_ps(v, _mm_loadu_ps(&m->coef_f[ic][j * 4])));
+        }
+
+        for (j = 0; j < n_vec; j++)
+            _mm_storeu_ps(d + j * 4, sum[j]);
+    }
+
+    if (tail > 0)
+        pa_remap_matrix_c(m, d, s, tail);
+}
+
+static inline void remap_outputs_s16ne(pa_remap_t *m, int16_t *d, const int16_t *s, unsigned n, unsigned n_vec) {
+    unsigned n_ic = m->i_ss->channels, n_oc = m->o_ss->channels, spill, tail, i, j;
+
+    spill = n_vec * 8 - n_oc;
+    tail = PA_MIN((spill + n_oc - 1) / n_oc, n);
+
+    for (n -= tail; n > 0; n--, s += n_ic, d += n_oc) {
+        __m128i sum[PA_CHANNELS_MAX / 8];
+
+        for (j = 0; j < n_vec; j++)
+            sum[j] = _mm_setzero_si128();
+
+        for (i = 0; i < m->n_inputs; i++) {
+            unsigned ic = m->inputs[i];
+            __m128i v = _mm_set1_epi16(s[ic]);
+
+            for (j = 0; j < n_vec; j++) {
+                __m128i mul = _mm_loadu_si128((const __m128i*) &m->coef_mul[ic][j * 8]);
+                __m128i add = _mm_loadu_si128((const __m128i*) &m->coef_add[ic][j * 8]);
+
+                sum[j] = _mm_add_epi16(sum[j], _mm_add_epi16(_mm_mulhi_epi16(v, mul), _mm_and_si128(v, add)));
+            }
+        }
+
+        for (j = 0; j < n_vec; j++)
+            _mm_storeu_si128((__m128i*) (d + j * 8), sum[j]);
+    }
+
+    if (tail > 0)
+        pa_remap_matrix_c(m, d, s, tail);
+}
+
+/* The usual upmixes fit into one or two vectors, having the count as a
+ * constant lets the compiler keep the sums in registers */
+static void remap_outputs_1_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    if (*m->format == PA_SAMPLE_FLOAT32NE)
+        remap_outputs_float32ne(m, dst, src, n, 1);
+    else
+        remap_outputs_s16ne(m, dst, src, n, 1);
+}
+
+static void remap_outputs_2_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    if (*m->format == PA_SAMPLE_FLOAT32NE)
+        remap_outputs_float32ne(m, dst, src, n, 2);
+    else
+        remap_outputs_s16ne(m, dst, src, n, 2);
+}
+
+static void remap_outputs_n_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    unsigned width = *m->format == PA_SAMPLE_FLOAT32NE ? 4 : 8;
+    unsigned n_vec = (m->o_ss->channels + width - 1) / width;
+
+    if (*m->format == PA_SAMPLE_FLOAT32NE)
+        remap_outputs_float32ne(m, dst, src, n, n_vec);
+    else
+        remap_outputs_s16ne(m, dst, src, n, n_vec);
+}
+
 /* set the function that will execute the remapping based on the matrices */
 static void init_remap_sse2(pa_remap_t *m) {
-    unsigned n_oc, n_ic;
+    unsigned n_oc, n_ic, width, n_vec;
 
     n_oc = m->o_ss->channels;
     n_ic = m->i_ss->channels;
@@ -141,7 +314,30 @@ static void init_remap_sse2(pa_remap_t *m) {
             m->map_table_f[0][0] >= 1.0 && m->map_table_f[1][0] >= 1.0) {
         m->do_remap = (pa_do_remap_func_t) remap_mono_to_stereo_sse2;
         pa_log_info("Using SSE mono to stereo remapping");
+        return;
+    }
+
+    /* Plain copying is left to the C version */
+    if (m->arrange)
+        return;
+
+    if (n_oc <= 2) {
+        m->do_remap = n_oc == 1 ? remap_frames_1_sse2 : remap_frames_2_sse2;
+        pa_log_info("Using SSE2 remapping to %u channel(s)", n_oc);
+        return;
     }
+
+    width = *m->format == PA_SAMPLE_FLOAT32NE ? 4 : 8;
+    n_vec = (n_oc + width - 1) / width;
+
+    if (n_vec == 1)
+        m->do_remap = remap_outputs_1_sse2;
+    else if (n_vec == 2)
+        m->do_remap = remap_outputs_2_sse2;
+    else
+        m->do_remap = remap_outputs_n_sse2;
+
+    pa_log_info("Using SSE2 remapping from %u to %u channels", n_ic, n_oc);
 }
 #endif /* defined (__i386__) || defined (__amd64__) */
 
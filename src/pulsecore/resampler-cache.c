@@ -0,0 +1,175 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
+
+#include "resampler-cache.h"
+
+/* How many tables without users we keep */
+#define MAX_UNUSED 4
+
+static pa_static_mutex mutex = PA_STATIC_MUTEX_INIT;
+
+/* Most recently released first */
+static PA_LLIST_HEAD(pa_resampler_table, tables);
+static unsigned n_unused;
+
+static pa_resampler_table *table_find(pa_resample_method_t method, uint32_t in_rate, uint32_t out_rate, unsigned quality) {
+    pa_resampler_table *t;
+
+    PA_LLIST_FOREACH(t, tables)
+        if (t->method == method && t->in_rate == in_rate &&
+            t->out_rate == out_rate && t->quality == quality)
+            return t;
+
+    return NULL;
+}
+
+static void table_free(pa_resampler_table *t) {
+    pa_assert(t);
+
+    if (t->free_cb)
+        t->free_cb(t->data);
+
+    pa_xfree(t);
+}
+
+/* Must be called with the mutex held */
+static void table_ref(pa_resampler_table *t) {
+    if (t->ref++ == 0)
+        n_unused--;
+}
+
+pa_resampler_table *pa_resampler_table_get(
+        pa_resample_method_t method,
+        uint32_t in_rate,
+        uint32_t out_rate,
+        unsigned quality,
+        pa_resampler_table_new_cb_t new_cb,
+        pa_free_cb_t free_cb,
+        void *userdata) {
+
+    pa_resampler_table *t, *n;
+    pa_mutex *m;
+
+    pa_assert(new_cb);
+
+    m = pa_static_mutex_get(&mutex, FALSE, TRUE);
+
+    pa_mutex_lock(m);
+    if ((t = table_find(method, in_rate, out_rate, quality)))
+        table_ref(t);
+    pa_mutex_unlock(m);
+
+    if (t)
+        return t;
+
+    n = pa_xnew0(pa_resampler_table, 1);
+    n->method = method;
+    n->in_rate = in_rate;
+    n->out_rate = out_rate;
+    n->quality = quality;
+    n->ref = 1;
+    n->free_cb = free_cb;
+
+    /* Building a table takes a while, don't block the other users of
+     * the cache for it. If somebody else was quicker we throw ours
+     * away. */
+    n->data = new_cb(n, &n->size, userdata);
+
+    pa_mutex_lock(m);
+    if ((t = table_find(method, in_rate, out_rate, quality)))
+        table_ref(t);
+    else {
+        PA_LLIST_PREPEND(pa_resampler_table, tables, n);
+        t = n;
+        n = NULL;
+    }
+    pa_mutex_unlock(m);
+
+    if (n)
+        table_free(n);
+    else
+        pa_log_debug("Cached %s filter table for %u -> %u, quality %u: %zu KiB.",
+                     pa_resample_method_to_string(method), in_rate, out_rate, quality, t->size / 1024);
+
+    return t;
+}
+
+void pa_resampler_table_unref(pa_resampler_table *t) {
+    pa_resampler_table *i, *victim = NULL;
+    pa_mutex *m;
+
+    pa_assert(t);
+
+    m = pa_static_mutex_get(&mutex, FALSE, TRUE);
+
+    pa_mutex_lock(m);
+    pa_assert(t->ref >= 1);
+
+    if (--t->ref == 0) {
+        /* Keep it, but make it the first to be found and the last to
+         * be evicted */
+        PA_LLIST_REMOVE(pa_resampler_table, tables, t);
+        PA_LLIST_PREPEND(pa_resampler_table, tables, t);
+
+        if (++n_unused > MAX_UNUSED) {
+            PA_LLIST_FOREACH(i, tables)
+                if (i->ref == 0)
+                    victim = i;
+
+            PA_LLIST_REMOVE(pa_resampler_table, tables, victim);
+            n_unused--;
+        }
+    }
+    pa_mutex_unlock(m);
+
+    if (victim)
+        table_free(victim);
+}
+
+void pa_resampler_cache_get_stat(pa_resampler_cache_stat *stat) {
+    pa_resampler_table *t;
+    pa_mutex *m;
+
+    pa_assert(stat);
+
+    pa_zero(*stat);
+
+    m = pa_static_mutex_get(&mutex, FALSE, TRUE);
+
+    pa_mutex_lock(m);
+    PA_LLIST_FOREACH(t, tables) {
+        stat->n_tables++;
+        stat->n_users += t->ref;
+        stat->size += t->size;
+
+        if (t->ref > 1)
+            stat->saved += (t->ref - 1) * t->size;
+    }
+    pa_mutex_unlock(m);
+}
@@ -0,0 +1,86 @@
+#ifndef fooresamplercachehfoo
+#define fooresamplercachehfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <sys/types.h>
+
+#include <pulse/def.h>
+
+#include <pulsecore/llist.h>
+#include <pulsecore/resampler.h>
+
+/* A process wide cache of filter coefficient tables. Resamplers using
+ * the same method, rates and quality get the same table instead of
+ * building their own. Tables are immutable once created and may be
+ * used from any thread. A few tables nobody uses anymore are kept
+ * around, so that short-lived streams and rates that go back and forth
+ * don't rebuild them every time. */
+
+typedef struct pa_resampler_table pa_resampler_table;
+
+struct pa_resampler_table {
+    /* The key. It is up to the implementation what it puts in there,
+     * e.g. rates reduced by their gcd. */
+    pa_resample_method_t method;
+    uint32_t in_rate, out_rate;
+    unsigned quality;
+
+    void *data;
+    size_t size;
+
+    /* Private */
+    unsigned ref;
+    pa_free_cb_t free_cb;
+    PA_LLIST_FIELDS(pa_resampler_table);
+};
+
+/* Builds the table data for the key, returning its size in *size */
+typedef void *(*pa_resampler_table_new_cb_t)(const pa_resampler_table *key, size_t *size, void *userdata);
+
+typedef struct pa_resampler_cache_stat {
+    unsigned n_tables;
+    unsigned n_users;
+
+    /* Memory of all cached tables */
+    size_t size;
+
+    /* Memory that would be needed on top if every user had its own
+     * copy */
+    size_t saved;
+} pa_resampler_cache_stat;
+
+/* Returns a reference to the table for the key, calling new_cb outside
+ * of any lock to build it if it isn't cached yet. free_cb is called on
+ * the data once the table is dropped from the cache. */
+pa_resampler_table *pa_resampler_table_get(
+        pa_resample_method_t method,
+        uint32_t in_rate,
+        uint32_t out_rate,
+        unsigned quality,
+        pa_resampler_table_new_cb_t new_cb,
+        pa_free_cb_t free_cb,
+        void *userdata);
+
+void pa_resampler_table_unref(pa_resampler_table *t);
+
+void pa_resampler_cache_get_stat(pa_resampler_cache_stat *stat);
+
+#endif
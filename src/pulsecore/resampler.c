@@ -23,7 +23,9 @@
 #include <config.h>
 #endif
 
+#include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #ifdef HAVE_LIBSAMPLERATE
 #include <samplerate.h>
@@ -40,6 +42,8 @@
 #include <pulsecore/strbuf.h>
 #include <pulsecore/remap.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/resampler-cache.h>
+#include <pulsecore/sinc.h>
 #include "ffmpeg/avcodec.h"
 
 #include "resampler.h"
@@ -47,15 +51,29 @@
 /* Number of samples of extra space we allow the resamplers to return */
 #define EXTRA_FRAMES 128
 
+/* Size of the scratch buffers of the fused format conversion and
+ * remapping pass, small enough for the data to stay in the cache */
+#define FUSE_BLOCK_SIZE 4096
+
 struct pa_resampler {
     pa_resample_method_t method;
     pa_resample_flags_t flags;
 
+    /* TRUE while the buffers are freed, because of PA_RESAMPLER_LAZY
+     * or pa_resampler_release() */
+    pa_bool_t released;
+
     pa_sample_spec i_ss, o_ss;
     pa_channel_map i_cm, o_cm;
     size_t i_fz, o_fz, w_sz;
     pa_mempool *mempool;
 
+    /* Factor on the input rate, see pa_resampler_set_rate_adjust(),
+     * and its deviation from 1 in parts per billion, which is what
+     * we compare */
+    double rate_adjust;
+    int32_t rate_adjust_ppb;
+
     pa_memchunk to_work_format_buf;
     pa_memchunk remap_buf;
     pa_memchunk resample_buf;
@@ -74,10 +92,15 @@ struct pa_resampler {
     pa_remap_t remap;
     pa_bool_t map_required;
 
+    /* Conversion and remapping stages that are run as one blocked pass
+     * instead of one pass and buffer each, see plan_pipeline() */
+    pa_bool_t fuse_input, fuse_all;
+
     void (*impl_free)(pa_resampler *r);
     void (*impl_update_rates)(pa_resampler *r);
     void (*impl_resample)(pa_resampler *r, const pa_memchunk *in, unsigned in_samples, pa_memchunk *out, unsigned *out_samples);
     void (*impl_reset)(pa_resampler *r);
+    void (*impl_release)(pa_resampler *r);
 
     struct { /* data specific to the trivial resampler */
         unsigned o_counter;
@@ -107,8 +130,41 @@ struct pa_resampler {
 
     struct { /* data specific to ffmpeg */
         struct AVResampleContext *state;
+        pa_resampler_table *table;
         pa_memchunk buf[PA_CHANNELS_MAX];
     } ffmpeg;
+
+    struct { /* data specific to the polyphase sinc resampler */
+        pa_sinc_bank *bank;
+        pa_sinc_dot_func_t dot;
+
+        /* Per output sample we advance m/l input samples, with both
+         * rates reduced by their gcd. phase counts in units of 1/l. */
+        uint32_t l, m, phase;
+
+        /* With PA_RESAMPLER_VARIABLE_RATE we advance step input
+         * samples per output sample instead, as 32.32 fixed point.
+         * After a rate change step moves towards target_step by
+         * step_inc for ramp more output samples. frac is the position
+         * between pos and the next input sample, as 0.32 fixed
+         * point. */
+        pa_bool_t adaptive;
+        uint64_t step, target_step;
+        int64_t step_inc;
+        unsigned ramp;
+        uint32_t frac;
+
+        /* One history buffer of size samples per channel. Output is
+         * generated for pos, up to n_valid - n_taps. Before pos we
+         * keep as much input as a bank with n_taps_max taps would
+         * need, so that the filter can grow without a gap. */
+        float *history;
+        unsigned pos, n_valid, size;
+        unsigned n_taps_max;
+
+        /* Scratch row for interpolated banks */
+        float *row;
+    } sinc;
 };
 
 static int copy_init(pa_resampler *r);
@@ -118,11 +174,13 @@ static int speex_init(pa_resampler*r);
 #endif
 static int ffmpeg_init(pa_resampler*r);
 static int peaks_init(pa_resampler*r);
+static int sinc_init(pa_resampler*r);
 #ifdef HAVE_LIBSAMPLERATE
 static int libsamplerate_init(pa_resampler*r);
 #endif
 
 static void calc_map_table(pa_resampler *r);
+static void plan_pipeline(pa_resampler *r);
 
 static int (* const init_table[])(pa_resampler*r) = {
 #ifdef HAVE_LIBSAMPLERATE
@@ -190,6 +248,10 @@ static int (* const init_table[])(pa_resampler*r) = {
     [PA_RESAMPLER_AUTO]                    = NULL,
     [PA_RESAMPLER_COPY]                    = copy_init,
     [PA_RESAMPLER_PEAKS]                   = peaks_init,
+    [PA_RESAMPLER_SINC_BASE+0]             = sinc_init,
+    [PA_RESAMPLER_SINC_BASE+1]             = sinc_init,
+    [PA_RESAMPLER_SINC_BASE+2]             = sinc_init,
+    [PA_RESAMPLER_SINC_BASE+3]             = sinc_init,
 };
 
 pa_resampler* pa_resampler_new(
@@ -245,6 +307,7 @@ pa_resampler* pa_resampler_new(
     r->mempool = pool;
     r->method = method;
     r->flags = flags;
+    r->rate_adjust = 1.0;
 
     /* Fill sample specs */
     r->i_ss = *a;
@@ -327,6 +390,14 @@ pa_resampler* pa_resampler_new(
     if (init_table[method](r) < 0)
         goto fail;
 
+    plan_pipeline(r);
+
+    /* The implementation and its filter tables are set up here in any
+     * case, so that failures show and the IO thread only has to
+     * allocate buffers */
+    if (flags & PA_RESAMPLER_LAZY)
+        pa_resampler_release(r);
+
     return r;
 
 fail:
@@ -335,12 +406,9 @@ fail:
     return NULL;
 }
 
-void pa_resampler_free(pa_resampler *r) {
+static void free_buffers(pa_resampler *r) {
     pa_assert(r);
 
-    if (r->impl_free)
-        r->impl_free(r);
-
     if (r->to_work_format_buf.memblock)
         pa_memblock_unref(r->to_work_format_buf.memblock);
     if (r->remap_buf.memblock)
@@ -349,10 +417,86 @@ void pa_resampler_free(pa_resampler *r) {
         pa_memblock_unref(r->resample_buf.memblock);
     if (r->from_work_format_buf.memblock)
         pa_memblock_unref(r->from_work_format_buf.memblock);
+}
+
+void pa_resampler_free(pa_resampler *r) {
+    pa_assert(r);
+
+    if (r->impl_free)
+        r->impl_free(r);
+
+    free_buffers(r);
 
     pa_xfree(r);
 }
 
+/* Picks up again after pa_resampler_release(). The buffers are
+ * allocated as they are needed. */
+static void setup_impl(pa_resampler *r) {
+    pa_assert(r);
+
+    if (!r->released)
+        return;
+
+    r->released = FALSE;
+    pa_resampler_reset(r);
+}
+
+/* Memory held by the buffers that pa_resampler_release() frees */
+static size_t state_size(pa_resampler *r) {
+    size_t size = 0;
+    unsigned c;
+
+    pa_assert(r);
+
+    if (r->to_work_format_buf.memblock)
+        size += pa_memblock_get_length(r->to_work_format_buf.memblock);
+    if (r->remap_buf.memblock)
+        size += pa_memblock_get_length(r->remap_buf.memblock);
+    if (r->resample_buf.memblock)
+        size += pa_memblock_get_length(r->resample_buf.memblock);
+    if (r->from_work_format_buf.memblock)
+        size += pa_memblock_get_length(r->from_work_format_buf.memblock);
+
+    for (c = 0; c < PA_ELEMENTSOF(r->ffmpeg.buf); c++)
+        if (r->ffmpeg.buf[c].memblock)
+            size += pa_memblock_get_length(r->ffmpeg.buf[c].memblock);
+
+    size += (size_t) r->sinc.size * r->o_ss.channels * sizeof(float);
+
+    return size;
+}
+
+size_t pa_resampler_release(pa_resampler *r) {
+    size_t size;
+
+    pa_assert(r);
+
+    if (r->released)
+        return 0;
+
+    size = state_size(r);
+
+    if (r->impl_release)
+        r->impl_release(r);
+
+    free_buffers(r);
+
+    pa_memchunk_reset(&r->to_work_format_buf);
+    pa_memchunk_reset(&r->remap_buf);
+    pa_memchunk_reset(&r->resample_buf);
+    pa_memchunk_reset(&r->from_work_format_buf);
+    r->to_work_format_buf_samples = 0;
+    r->remap_buf_size = 0;
+    r->resample_buf_samples = 0;
+    r->from_work_format_buf_samples = 0;
+    r->remap_buf_contains_leftover_data = FALSE;
+
+    r->released = TRUE;
+
+    return size;
+}
+
 void pa_resampler_set_input_rate(pa_resampler *r, uint32_t rate) {
     pa_assert(r);
     pa_assert(rate > 0);
@@ -377,6 +521,25 @@ void pa_resampler_set_output_rate(pa_resampler *r, uint32_t rate) {
     r->impl_update_rates(r);
 }
 
+void pa_resampler_set_rate_adjust(pa_resampler *r, double factor) {
+    int32_t ppb;
+
+    pa_assert(r);
+    pa_assert(factor > 0.5 && factor < 2.0);
+
+    /* Well below what any resampler can resolve */
+    ppb = (int32_t) lrint((factor - 1.0) * 1e9);
+
+    if (r->rate_adjust_ppb == ppb)
+        return;
+
+    r->rate_adjust_ppb = ppb;
+    r->rate_adjust = 1.0 + (double) ppb / 1e9;
+
+    if (r->impl_update_rates)
+        r->impl_update_rates(r);
+}
+
 size_t pa_resampler_request(pa_resampler *r, size_t out_length) {
     pa_assert(r);
 
@@ -440,6 +603,10 @@ size_t pa_resampler_max_block_size(pa_resampler *r) {
 void pa_resampler_reset(pa_resampler *r) {
     pa_assert(r);
 
+    /* Setting up again resets anyway, don't allocate anything now */
+    if (r->released)
+        return;
+
     if (r->impl_reset)
         r->impl_reset(r);
 
@@ -508,7 +675,11 @@ static const char * const resample_methods[] = {
     "ffmpeg",
     "auto",
     "copy",
-    "peaks"
+    "peaks",
+    "sinc-0",
+    "sinc-1",
+    "sinc-2",
+    "sinc-3"
 };
 
 const char *pa_resample_method_to_string(pa_resample_method_t m) {
@@ -539,6 +710,14 @@ int pa_resample_method_supported(pa_resample_method_t m) {
     return 1;
 }
 
+int pa_resample_method_adaptive(pa_resample_method_t m) {
+
+    if (!pa_resample_method_supported(m))
+        return 0;
+
+    return m <= PA_RESAMPLER_SRC_LINEAR || (m >= PA_RESAMPLER_SINC_BASE && m <= PA_RESAMPLER_SINC_MAX);
+}
+
 pa_resample_method_t pa_parse_resample_method(const char *string) {
     pa_resample_method_t m;
 
@@ -1092,6 +1271,31 @@ static void calc_map_table(pa_resampler *r) {
     pa_init_remap(m);
 }
 
+static void plan_pipeline(pa_resampler *r) {
+    unsigned n_stages;
+
+    pa_assert(r);
+
+    if (getenv("PULSE_NO_RESAMPLER_FUSION"))
+        return;
+
+    n_stages = !!r->to_work_format_func + !!r->map_required + !!r->from_work_format_func;
+
+    /* Without resampling the whole chain can be done in one pass, straight
+     * into the output block. Otherwise the input conversion can at least
+     * be merged into the remapping, which keeps its own buffer because of
+     * the leftover data that the resamplers may store there. Only 'copy'
+     * doesn't resample, the others may not be set up yet. */
+    if (r->method == PA_RESAMPLER_COPY && n_stages >= 2)
+        r->fuse_all = TRUE;
+    else if (r->to_work_format_func && r->map_required)
+        r->fuse_input = TRUE;
+
+    if (r->fuse_all || r->fuse_input)
+        pa_log_debug("Fusing %s into one pass.",
+                     r->fuse_all ? "format conversion and remapping" : "input conversion and remapping");
+}
+
 static pa_memchunk* convert_to_work_format(pa_resampler *r, pa_memchunk *input) {
     unsigned n_samples;
     void *src, *dst;
@@ -1130,6 +1334,48 @@ static pa_memchunk* convert_to_work_format(pa_resampler *r, pa_memchunk *input)
     return &r->to_work_format_buf;
 }
 
+/* Runs the conversion into the work format, the channel remapping and, if
+ * convert_from is set, the conversion out of the work format over blocks
+ * of frames, passing the data between the stages in scratch buffers on
+ * the stack. Stages that are not needed are skipped. */
+static void convert_and_remap(pa_resampler *r, void *dst, const void *src, unsigned n_frames, pa_bool_t convert_from) {
+    float a[FUSE_BLOCK_SIZE / sizeof(float)], b[FUSE_BLOCK_SIZE / sizeof(float)];
+    pa_convert_func_t from_func = convert_from ? r->from_work_format_func : NULL;
+    unsigned block;
+    size_t o_fz;
+
+    pa_assert(r);
+    pa_assert(dst);
+    pa_assert(src);
+
+    block = FUSE_BLOCK_SIZE / (unsigned) (r->w_sz * PA_MAX(r->i_ss.channels, r->o_ss.channels));
+    o_fz = from_func ? r->o_fz : r->w_sz * r->o_ss.channels;
+
+    while (n_frames > 0) {
+        unsigned n = PA_MIN(n_frames, block);
+        const void *p = src;
+
+        if (r->to_work_format_func) {
+            r->to_work_format_func(n * r->i_ss.channels, p, a);
+            p = a;
+        }
+
+        if (r->map_required) {
+            void *q = from_func ? b : dst;
+
+            r->remap.do_remap(&r->remap, q, p, n);
+            p = q;
+        }
+
+        if (from_func)
+            from_func(n * r->o_ss.channels, p, dst);
+
+        src = (const uint8_t*) src + n * r->i_fz;
+        dst = (uint8_t*) dst + n * o_fz;
+        n_frames -= n;
+    }
+}
+
 static pa_memchunk *remap_channels(pa_resampler *r, pa_memchunk *input) {
     unsigned in_n_samples, out_n_samples, in_n_frames, out_n_frames;
     void *src, *dst;
@@ -1152,8 +1398,13 @@ static pa_memchunk *remap_channels(pa_resampler *r, pa_memchunk *input) {
     else if (input->length <= 0)
         return &r->remap_buf;
 
-    in_n_samples = (unsigned) (input->length / r->w_sz);
-    in_n_frames = out_n_frames = in_n_samples / r->i_ss.channels;
+    /* With fuse_input set the input is still in the input format */
+    if (r->fuse_input)
+        in_n_frames = out_n_frames = (unsigned) (input->length / r->i_fz);
+    else {
+        in_n_samples = (unsigned) (input->length / r->w_sz);
+        in_n_frames = out_n_frames = in_n_samples / r->i_ss.channels;
+    }
 
     if (have_leftover) {
         leftover_length = r->remap_buf.length;
@@ -1191,7 +1442,9 @@ static pa_memchunk *remap_channels(pa_resampler *r, pa_memchunk *input) {
     src = pa_memblock_acquire_chunk(input);
     dst = (uint8_t *) pa_memblock_acquire(r->remap_buf.memblock) + leftover_length;
 
-    if (r->map_required) {
+    if (r->fuse_input)
+        convert_and_remap(r, dst, src, in_n_frames, FALSE);
+    else if (r->map_required) {
         pa_remap_t *remap = &r->remap;
 
         pa_assert(remap->do_remap);
@@ -1221,7 +1474,10 @@ static pa_memchunk *resample(pa_resampler *r, pa_memchunk *input) {
     in_n_samples = (unsigned) (input->length / r->w_sz);
     in_n_frames = (unsigned) (in_n_samples / r->o_ss.channels);
 
-    out_n_frames = ((in_n_frames*r->o_ss.rate)/r->i_ss.rate)+EXTRA_FRAMES;
+    if (r->rate_adjust_ppb == 0)
+        out_n_frames = ((in_n_frames*r->o_ss.rate)/r->i_ss.rate)+EXTRA_FRAMES;
+    else
+        out_n_frames = (unsigned) ((double) in_n_frames * r->o_ss.rate / (r->i_ss.rate * r->rate_adjust)) + EXTRA_FRAMES;
     out_n_samples = out_n_frames * r->o_ss.channels;
 
     r->resample_buf.index = 0;
@@ -1289,8 +1545,32 @@ void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out)
     pa_assert(in->memblock);
     pa_assert(in->length % r->i_fz == 0);
 
+    setup_impl(r);
+
+    if (r->fuse_all) {
+        unsigned n_frames = (unsigned) (in->length / r->i_fz);
+        pa_memchunk src_chunk = *in;
+        void *src, *dst;
+
+        /* in and out may be the same chunk, so don't touch out before
+         * we are done with in */
+        src = pa_memblock_acquire_chunk(&src_chunk);
+
+        out->index = 0;
+        out->length = n_frames * r->o_fz;
+        out->memblock = pa_memblock_new(r->mempool, out->length);
+
+        dst = pa_memblock_acquire(out->memblock);
+        convert_and_remap(r, dst, src, n_frames, TRUE);
+        pa_memblock_release(src_chunk.memblock);
+        pa_memblock_release(out->memblock);
+
+        return;
+    }
+
     buf = (pa_memchunk*) in;
-    buf = convert_to_work_format(r, buf);
+    if (!r->fuse_input)
+        buf = convert_to_work_format(r, buf);
     buf = remap_channels(r, buf);
     buf = resample(r, buf);
 
@@ -1351,7 +1631,7 @@ static void libsamplerate_resample(pa_resampler *r, const pa_memchunk *input, un
     data.data_out = pa_memblock_acquire_chunk(output);
     data.output_frames = (long int) *out_n_frames;
 
-    data.src_ratio = (double) r->o_ss.rate / r->i_ss.rate;
+    data.src_ratio = (double) r->o_ss.rate / (r->i_ss.rate * r->rate_adjust);
     data.end_of_input = 0;
 
     pa_assert_se(src_process(r->src.state, &data) == 0);
@@ -1372,7 +1652,7 @@ static void libsamplerate_resample(pa_resampler *r, const pa_memchunk *input, un
 static void libsamplerate_update_rates(pa_resampler *r) {
     pa_assert(r);
 
-    pa_assert_se(src_set_ratio(r->src.state, (double) r->o_ss.rate / r->i_ss.rate) == 0);
+    pa_assert_se(src_set_ratio(r->src.state, (double) r->o_ss.rate / (r->i_ss.rate * r->rate_adjust)) == 0);
 }
 
 static void libsamplerate_reset(pa_resampler *r) {
@@ -1766,26 +2046,76 @@ static void ffmpeg_free(pa_resampler *r) {
     if (r->ffmpeg.state)
         av_resample_close(r->ffmpeg.state);
 
+    if (r->ffmpeg.table)
+        pa_resampler_table_unref(r->ffmpeg.table);
+
     for (c = 0; c < PA_ELEMENTSOF(r->ffmpeg.buf); c++)
         if (r->ffmpeg.buf[c].memblock)
             pa_memblock_unref(r->ffmpeg.buf[c].memblock);
 }
 
+static void ffmpeg_release(pa_resampler *r) {
+    unsigned c;
+
+    pa_assert(r);
+
+    for (c = 0; c < PA_ELEMENTSOF(r->ffmpeg.buf); c++)
+        if (r->ffmpeg.buf[c].memblock) {
+            pa_memblock_unref(r->ffmpeg.buf[c].memblock);
+            pa_memchunk_reset(&r->ffmpeg.buf[c]);
+        }
+}
+
+static void ffmpeg_reset(pa_resampler *r) {
+    pa_assert(r);
+
+    ffmpeg_release(r);
+    av_resample_reset(r->ffmpeg.state);
+}
+
+/* We could probably implement different quality levels by adjusting
+ * the filter parameters here. However, ffmpeg internally only uses
+ * these hardcoded values, so let's use them here for now as well until
+ * ffmpeg makes this configurable. */
+#define FFMPEG_FILTER_SIZE 16
+#define FFMPEG_PHASE_SHIFT 10
+#define FFMPEG_CUTOFF 0.8
+
+static void *ffmpeg_table_new(const pa_resampler_table *key, size_t *size, void *userdata) {
+    int16_t *bank;
+
+    *size = (size_t) av_resample_filter_bank_size((int) key->out_rate, (int) key->in_rate,
+                                                  FFMPEG_FILTER_SIZE, FFMPEG_PHASE_SHIFT, FFMPEG_CUTOFF);
+
+    bank = pa_xmalloc0(*size);
+    av_resample_build_filter_bank(bank, (int) key->out_rate, (int) key->in_rate,
+                                  FFMPEG_FILTER_SIZE, FFMPEG_PHASE_SHIFT, FFMPEG_CUTOFF);
+
+    return bank;
+}
+
 static int ffmpeg_init(pa_resampler *r) {
     unsigned c;
+    uint32_t g;
 
     pa_assert(r);
 
-    /* We could probably implement different quality levels by
-     * adjusting the filter parameters here. However, ffmpeg
-     * internally only uses these hardcoded values, so let's use them
-     * here for now as well until ffmpeg makes this configurable. */
+    /* The filter only depends on the ratio of the rates */
+    g = pa_gcd(r->i_ss.rate, r->o_ss.rate);
+    r->ffmpeg.table = pa_resampler_table_get(PA_RESAMPLER_FFMPEG, r->i_ss.rate / g, r->o_ss.rate / g, 0,
+                                             ffmpeg_table_new, pa_xfree, NULL);
 
-    if (!(r->ffmpeg.state = av_resample_init((int) r->o_ss.rate, (int) r->i_ss.rate, 16, 10, 0, 0.8)))
+    if (!(r->ffmpeg.state = av_resample_init_shared((int) r->o_ss.rate, (int) r->i_ss.rate,
+                                                    FFMPEG_FILTER_SIZE, FFMPEG_PHASE_SHIFT, 0, FFMPEG_CUTOFF,
+                                                    r->ffmpeg.table->data))) {
+        pa_resampler_table_unref(r->ffmpeg.table);
         return -1;
+    }
 
     r->impl_free = ffmpeg_free;
     r->impl_resample = ffmpeg_resample;
+    r->impl_reset = ffmpeg_reset;
+    r->impl_release = ffmpeg_release;
 
     for (c = 0; c < PA_ELEMENTSOF(r->ffmpeg.buf); c++)
         pa_memchunk_reset(&r->ffmpeg.buf[c]);
@@ -1793,6 +2123,296 @@ static int ffmpeg_init(pa_resampler *r) {
     return 0;
 }
 
+/*** polyphase sinc implementation ***/
+
+/* With PA_RESAMPLER_VARIABLE_RATE rate changes are spread over this
+ * much output */
+#define SINC_RAMP_MSEC 10
+
+/* Makes sure there is room for n more samples per channel in the
+ * history, which is one block of size floats per channel */
+static void sinc_make_room(pa_resampler *r, unsigned n) {
+    float *h;
+    unsigned c, size;
+
+    pa_assert(r);
+
+    if (r->sinc.n_valid + n <= r->sinc.size)
+        return;
+
+    size = PA_MAX(r->sinc.n_valid + n, r->sinc.size * 2);
+    h = pa_xnew(float, (size_t) size * r->o_ss.channels);
+
+    if (r->sinc.history) {
+        for (c = 0; c < r->o_ss.channels; c++)
+            memcpy(h + c * size, r->sinc.history + c * r->sinc.size, r->sinc.n_valid * sizeof(float));
+
+        pa_xfree(r->sinc.history);
+    }
+
+    r->sinc.history = h;
+    r->sinc.size = size;
+}
+
+/* Moves the next output position, which is n_taps/2 - 1 samples after
+ * pos, to where the current bank needs it. If there is not enough
+ * history for that, which only happens at the start of the stream,
+ * silence is prepended. */
+static void sinc_set_center(pa_resampler *r, unsigned center) {
+    unsigned c, need;
+
+    pa_assert(r);
+
+    need = r->sinc.bank->n_taps / 2 - 1;
+
+    if (center >= need) {
+        r->sinc.pos = center - need;
+        return;
+    }
+
+    sinc_make_room(r, need - center);
+
+    for (c = 0; c < r->o_ss.channels; c++) {
+        float *h = r->sinc.history + c * r->sinc.size;
+
+        memmove(h + need - center, h, r->sinc.n_valid * sizeof(float));
+        memset(h, 0, (need - center) * sizeof(float));
+    }
+
+    r->sinc.n_valid += need - center;
+    r->sinc.pos = 0;
+}
+
+static const float *sinc_row(pa_resampler *r) {
+    const pa_sinc_bank *b = r->sinc.bank;
+    const float *r0, *r1;
+    uint64_t x;
+    float alpha;
+    unsigned k;
+
+    if (r->sinc.adaptive) {
+        x = (uint64_t) r->sinc.frac * b->n_phases;
+        r0 = pa_sinc_bank_row(b, (unsigned) (x >> 32));
+        alpha = (float) (uint32_t) x * (1.0f / 4294967296.0f);
+
+    } else if (!b->interpolate)
+        return pa_sinc_bank_row(b, r->sinc.phase);
+
+    else {
+        x = (uint64_t) r->sinc.phase * b->n_phases;
+        r0 = pa_sinc_bank_row(b, (unsigned) (x / r->sinc.l));
+        alpha = (float) (x % r->sinc.l) / (float) r->sinc.l;
+    }
+
+    r1 = r0 + b->n_taps;
+
+    for (k = 0; k < b->n_taps; k++)
+        r->sinc.row[k] = r0[k] + alpha * (r1[k] - r0[k]);
+
+    return r->sinc.row;
+}
+
+static void sinc_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
+    unsigned c, channels, n_taps, step, o = 0, drop;
+    uint32_t frac;
+    const float *src;
+    float *dst;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(output);
+    pa_assert(out_n_frames);
+
+    channels = r->o_ss.channels;
+    n_taps = r->sinc.bank->n_taps;
+    step = r->sinc.m / r->sinc.l;
+    frac = r->sinc.m % r->sinc.l;
+
+    /* Append the input to the history, one channel after another, so
+     * that the dot products run over consecutive samples */
+    sinc_make_room(r, in_n_frames);
+
+    src = pa_memblock_acquire_chunk(input);
+    for (c = 0; c < channels; c++) {
+        float *h = r->sinc.history + c * r->sinc.size + r->sinc.n_valid;
+        const float *s = src + c;
+        unsigned u;
+
+        for (u = 0; u < in_n_frames; u++, s += channels)
+            h[u] = *s;
+    }
+    pa_memblock_release(input->memblock);
+
+    r->sinc.n_valid += in_n_frames;
+
+    dst = pa_memblock_acquire_chunk(output);
+    while (r->sinc.pos + n_taps <= r->sinc.n_valid && o < *out_n_frames) {
+        const float *row = sinc_row(r);
+
+        for (c = 0; c < channels; c++)
+            *(dst++) = r->sinc.dot(r->sinc.history + c * r->sinc.size + r->sinc.pos, row, n_taps);
+
+        o++;
+
+        if (r->sinc.adaptive) {
+            uint64_t p = (uint64_t) r->sinc.frac + r->sinc.step;
+
+            r->sinc.pos += (unsigned) (p >> 32);
+            r->sinc.frac = (uint32_t) p;
+
+            if (r->sinc.ramp > 0) {
+                r->sinc.step += (uint64_t) r->sinc.step_inc;
+
+                if (--r->sinc.ramp == 0)
+                    r->sinc.step = r->sinc.target_step;
+            }
+
+            continue;
+        }
+
+        r->sinc.pos += step;
+        r->sinc.phase += frac;
+        if (r->sinc.phase >= r->sinc.l) {
+            r->sinc.phase -= r->sinc.l;
+            r->sinc.pos++;
+        }
+    }
+    pa_memblock_release(output->memblock);
+
+    *out_n_frames = o;
+
+    /* Drop whatever no further output sample needs, not even after the
+     * bank changed. Only once at least half of the history can go,
+     * so that moving the rest stays cheap. */
+    drop = PA_MIN(r->sinc.pos, r->sinc.n_valid);
+    drop -= PA_MIN(drop, (r->sinc.n_taps_max - n_taps) / 2);
+
+    if (drop > 0 && drop * 2 >= r->sinc.n_valid) {
+        for (c = 0; c < channels; c++) {
+            float *h = r->sinc.history + c * r->sinc.size;
+            memmove(h, h + drop, (r->sinc.n_valid - drop) * sizeof(float));
+        }
+
+        r->sinc.pos -= drop;
+        r->sinc.n_valid -= drop;
+    }
+}
+
+/* Input samples per output sample, as 32.32 fixed point */
+static uint64_t sinc_calc_step(pa_resampler *r) {
+    return (uint64_t) llrint((double) r->i_ss.rate * r->rate_adjust / r->o_ss.rate * 4294967296.0);
+}
+
+static void sinc_update_rates(pa_resampler *r) {
+    pa_sinc_bank *old;
+    uint32_t g, l;
+    unsigned center;
+
+    pa_assert(r);
+
+    old = r->sinc.bank;
+    center = r->sinc.pos + old->n_taps / 2 - 1;
+
+    g = pa_gcd(r->i_ss.rate, r->o_ss.rate);
+    l = r->o_ss.rate / g;
+
+    if (r->sinc.adaptive) {
+        /* Glide to the new ratio instead of jumping there */
+        r->sinc.target_step = sinc_calc_step(r);
+        r->sinc.ramp = PA_MAX(r->o_ss.rate * SINC_RAMP_MSEC / 1000, 1U);
+        r->sinc.step_inc = ((int64_t) r->sinc.target_step - (int64_t) r->sinc.step) / (int64_t) r->sinc.ramp;
+    } else
+        /* Keep the position between the input samples across the change */
+        r->sinc.phase = (uint32_t) ((uint64_t) r->sinc.phase * l / r->sinc.l);
+
+    r->sinc.l = l;
+    r->sinc.m = r->i_ss.rate / g;
+
+    /* Interpolated banks only depend on the cutoff, so as long as the
+     * nominal rates stay the same this is the bank we already have */
+    r->sinc.bank = pa_sinc_bank_get((unsigned) (r->method - PA_RESAMPLER_SINC_BASE), r->i_ss.rate, r->o_ss.rate, r->sinc.adaptive);
+
+    if (r->sinc.bank->n_taps != old->n_taps) {
+        pa_xfree(r->sinc.row);
+        r->sinc.row = pa_xnew(float, r->sinc.bank->n_taps);
+
+        /* Released resamplers start from scratch anyway */
+        if (r->sinc.history)
+            sinc_set_center(r, center);
+    }
+
+    pa_sinc_bank_unref(old);
+}
+
+static void sinc_reset(pa_resampler *r) {
+    pa_assert(r);
+
+    r->sinc.pos = r->sinc.n_valid = 0;
+    r->sinc.phase = 0;
+    r->sinc.frac = 0;
+    r->sinc.step = r->sinc.target_step;
+    r->sinc.ramp = 0;
+
+    /* Start with the first input sample in the center of the filter */
+    sinc_set_center(r, 0);
+}
+
+/* Frees the history, but keeps the bank */
+static void sinc_release(pa_resampler *r) {
+    pa_assert(r);
+
+    pa_xfree(r->sinc.history);
+    r->sinc.history = NULL;
+    r->sinc.size = 0;
+    r->sinc.pos = r->sinc.n_valid = 0;
+}
+
+static void sinc_free(pa_resampler *r) {
+    pa_assert(r);
+
+    if (r->sinc.bank)
+        pa_sinc_bank_unref(r->sinc.bank);
+
+    pa_xfree(r->sinc.history);
+    pa_xfree(r->sinc.row);
+}
+
+static int sinc_init(pa_resampler *r) {
+    unsigned q;
+    uint32_t g;
+
+    pa_assert(r);
+
+    q = (unsigned) (r->method - PA_RESAMPLER_SINC_BASE);
+
+    r->impl_free = sinc_free;
+    r->impl_update_rates = sinc_update_rates;
+    r->impl_resample = sinc_resample;
+    r->impl_reset = sinc_reset;
+    r->impl_release = sinc_release;
+
+    g = pa_gcd(r->i_ss.rate, r->o_ss.rate);
+    r->sinc.l = r->o_ss.rate / g;
+    r->sinc.m = r->i_ss.rate / g;
+
+    /* Drift compensation changes the rate in tiny steps. Instead of a
+     * new bank for every one, let the position between the phases of
+     * an interpolated bank follow the ratio. */
+    r->sinc.adaptive = !!(r->flags & PA_RESAMPLER_VARIABLE_RATE);
+    r->sinc.target_step = sinc_calc_step(r);
+
+    r->sinc.bank = pa_sinc_bank_get(q, r->i_ss.rate, r->o_ss.rate, r->sinc.adaptive);
+    r->sinc.n_taps_max = pa_sinc_taps_max(q);
+    r->sinc.row = pa_xnew(float, r->sinc.bank->n_taps);
+    r->sinc.dot = pa_get_sinc_dot_func();
+
+    pa_log_info("Choosing sinc quality setting %u, %u taps.", q, r->sinc.bank->n_taps);
+
+    sinc_reset(r);
+
+    return 0;
+}
+
 /*** copy (noop) implementation ***/
 
 static int copy_init(pa_resampler *r) {
@@ -45,6 +45,8 @@ typedef enum pa_resample_method {
     PA_RESAMPLER_AUTO, /* automatic select based on sample format */
     PA_RESAMPLER_COPY,
     PA_RESAMPLER_PEAKS,
+    PA_RESAMPLER_SINC_BASE,
+    PA_RESAMPLER_SINC_MAX = PA_RESAMPLER_SINC_BASE + 3,
     PA_RESAMPLER_MAX
 } pa_resample_method_t;
 
@@ -52,7 +54,8 @@ typedef enum pa_resample_flags {
     PA_RESAMPLER_VARIABLE_RATE = 0x0001U,
     PA_RESAMPLER_NO_REMAP      = 0x0002U,  /* implies NO_REMIX */
     PA_RESAMPLER_NO_REMIX      = 0x0004U,
-    PA_RESAMPLER_NO_LFE        = 0x0008U
+    PA_RESAMPLER_NO_LFE        = 0x0008U,
+    PA_RESAMPLER_LAZY          = 0x0010U   /* allocate the buffers on first use */
 } pa_resample_flags_t;
 
 pa_resampler* pa_resampler_new(
@@ -84,9 +87,23 @@ void pa_resampler_set_input_rate(pa_resampler *r, uint32_t rate);
 /* Change the output rate of the resampler object */
 void pa_resampler_set_output_rate(pa_resampler *r, uint32_t rate);
 
+/* Multiply the input rate by a factor close to 1, e.g. to compensate
+ * the drift between two clocks, without changing the input sample
+ * spec. Resamplers created with PA_RESAMPLER_VARIABLE_RATE using a
+ * method for which pa_resample_method_adaptive() is true take any
+ * fractional factor and move to it sample by sample. The others
+ * ignore it. */
+void pa_resampler_set_rate_adjust(pa_resampler *r, double factor);
+
 /* Reinitialize state of the resampler, possibly due to seeking or other discontinuities */
 void pa_resampler_reset(pa_resampler *r);
 
+/* Free the buffers, e.g. while the stream is idle. The implementation
+ * and its filter tables stay set up. The next pa_resampler_run()
+ * allocates the buffers again and continues as if after
+ * pa_resampler_reset(). Returns the number of bytes freed. */
+size_t pa_resampler_release(pa_resampler *r);
+
 /* Return the resampling method of the resampler object */
 pa_resample_method_t pa_resampler_get_method(pa_resampler *r);
 
@@ -99,6 +116,10 @@ const char *pa_resample_method_to_string(pa_resample_method_t m);
 /* Return 1 when the specified resampling method is supported */
 int pa_resample_method_supported(pa_resample_method_t m);
 
+/* Return 1 when the specified resampling method follows
+ * pa_resampler_set_rate_adjust() */
+int pa_resample_method_adaptive(pa_resample_method_t m);
+
 const pa_channel_map* pa_resampler_input_channel_map(pa_resampler *r);
 const pa_sample_spec* pa_resampler_input_sample_spec(pa_resampler *r);
 const pa_channel_map* pa_resampler_output_channel_map(pa_resampler *r);
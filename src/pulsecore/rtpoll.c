@@ -26,8 +26,16 @@
 
 #include <sys/types.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+
+#if defined(HAVE_EPOLL_CREATE1) && defined(HAVE_TIMERFD_CREATE)
+#define USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
 
 #include <pulse/xmalloc.h>
 #include <pulse/timeval.h>
@@ -46,10 +54,30 @@
 
 /* #define DEBUG_TIMING */
 
+#ifdef USE_EPOLL
+/* epoll_event.data.u32 of the timerfd, all others carry the index into
+ * the pollfd array */
+#define TIMER_FD_TAG ((uint32_t) -1)
+#endif
+
 struct pa_rtpoll {
     struct pollfd *pollfd, *pollfd2;
     unsigned n_pollfd_alloc, n_pollfd_used;
 
+#ifdef USE_EPOLL
+    int epoll_fd, timer_fd;
+
+    /* What we told the kernel about, parallel to pollfd */
+    struct pollfd *epoll_registered;
+    unsigned n_epoll_registered_alloc;
+
+    struct epoll_event *epoll_events;
+    unsigned n_epoll_events_alloc, n_epoll_events;
+
+    struct timeval timer_armed;
+    pa_bool_t epoll_resync:1;
+#endif
+
     struct timeval next_elapse;
     pa_bool_t timer_enabled:1;
 
@@ -86,7 +114,44 @@ struct pa_rtpoll_item {
 
 PA_STATIC_FLIST_DECLARE(items, 0, pa_xfree);
 
-pa_rtpoll *pa_rtpoll_new(void) {
+#ifdef USE_EPOLL
+static void epoll_close(pa_rtpoll *p) {
+    pa_assert(p);
+
+    if (p->epoll_fd >= 0)
+        pa_close(p->epoll_fd);
+
+    if (p->timer_fd >= 0)
+        pa_close(p->timer_fd);
+
+    p->epoll_fd = p->timer_fd = -1;
+
+    pa_xfree(p->epoll_registered);
+    p->epoll_registered = NULL;
+    p->n_epoll_registered_alloc = 0;
+
+    pa_xfree(p->epoll_events);
+    p->epoll_events = NULL;
+    p->n_epoll_events_alloc = p->n_epoll_events = 0;
+}
+
+static int epoll_open(pa_rtpoll *p) {
+    pa_assert(p);
+
+    if ((p->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC|TFD_NONBLOCK)) < 0) {
+        pa_log_debug("timerfd_create(): %s", pa_cstrerror(errno));
+        epoll_close(p);
+        return -1;
+    }
+
+    pa_zero(p->timer_armed);
+    p->epoll_resync = TRUE;
+
+    return 0;
+}
+#endif
+
+pa_rtpoll *pa_rtpoll_new_with_backend(pa_rtpoll_backend_t backend) {
     pa_rtpoll *p;
 
     p = pa_xnew0(pa_rtpoll, 1);
@@ -95,6 +160,16 @@ pa_rtpoll *pa_rtpoll_new(void) {
     p->pollfd = pa_xnew(struct pollfd, p->n_pollfd_alloc);
     p->pollfd2 = pa_xnew(struct pollfd, p->n_pollfd_alloc);
 
+#ifdef USE_EPOLL
+    p->epoll_fd = p->timer_fd = -1;
+
+    if (backend == PA_RTPOLL_BACKEND_DEFAULT)
+        backend = getenv("PULSE_NO_EPOLL") ? PA_RTPOLL_BACKEND_POLL : PA_RTPOLL_BACKEND_EPOLL;
+
+    if (backend == PA_RTPOLL_BACKEND_EPOLL)
+        epoll_open(p);
+#endif
+
 #ifdef DEBUG_TIMING
     p->timestamp = pa_rtclock_now();
 #endif
@@ -102,6 +177,21 @@ pa_rtpoll *pa_rtpoll_new(void) {
     return p;
 }
 
+pa_rtpoll *pa_rtpoll_new(void) {
+    return pa_rtpoll_new_with_backend(PA_RTPOLL_BACKEND_DEFAULT);
+}
+
+pa_rtpoll_backend_t pa_rtpoll_get_backend(pa_rtpoll *p) {
+    pa_assert(p);
+
+#ifdef USE_EPOLL
+    if (p->timer_fd >= 0)
+        return PA_RTPOLL_BACKEND_EPOLL;
+#endif
+
+    return PA_RTPOLL_BACKEND_POLL;
+}
+
 static void rtpoll_rebuild(pa_rtpoll *p) {
 
     struct pollfd *e, *t;
@@ -145,6 +235,11 @@ static void rtpoll_rebuild(pa_rtpoll *p) {
 
     if (ra)
         p->pollfd2 = pa_xrealloc(p->pollfd2, p->n_pollfd_alloc * sizeof(struct pollfd));
+
+#ifdef USE_EPOLL
+    /* The indexes have changed, start over with a fresh epoll set */
+    p->epoll_resync = TRUE;
+#endif
 }
 
 static void rtpoll_item_destroy(pa_rtpoll_item *i) {
@@ -173,6 +268,10 @@ void pa_rtpoll_free(pa_rtpoll *p) {
     pa_xfree(p->pollfd);
     pa_xfree(p->pollfd2);
 
+#ifdef USE_EPOLL
+    epoll_close(p);
+#endif
+
     pa_xfree(p);
 }
 
@@ -203,6 +302,164 @@ static void reset_all_revents(pa_rtpoll *p) {
     }
 }
 
+#ifdef USE_EPOLL
+/* Brings the epoll set in line with the pollfd array. Only entries
+ * whose fd or events changed since the last call cost a syscall. */
+static int epoll_sync(pa_rtpoll *p) {
+    struct epoll_event ev;
+    unsigned k;
+
+    pa_assert(p);
+
+    if (p->epoll_resync) {
+
+        if (p->epoll_fd >= 0)
+            pa_close(p->epoll_fd);
+
+        if ((p->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+            pa_log_debug("epoll_create1(): %s", pa_cstrerror(errno));
+            return -1;
+        }
+
+        pa_zero(ev);
+        ev.events = EPOLLIN;
+        ev.data.u32 = TIMER_FD_TAG;
+
+        if (epoll_ctl(p->epoll_fd, EPOLL_CTL_ADD, p->timer_fd, &ev) < 0) {
+            pa_log_debug("epoll_ctl(): %s", pa_cstrerror(errno));
+            return -1;
+        }
+
+        if (p->n_epoll_registered_alloc < p->n_pollfd_alloc) {
+            p->n_epoll_registered_alloc = p->n_pollfd_alloc;
+            p->epoll_registered = pa_xrealloc(p->epoll_registered, p->n_epoll_registered_alloc * sizeof(struct pollfd));
+        }
+
+        if (p->n_epoll_events_alloc < p->n_pollfd_alloc + 1) {
+            p->n_epoll_events_alloc = p->n_pollfd_alloc + 1;
+            p->epoll_events = pa_xrealloc(p->epoll_events, p->n_epoll_events_alloc * sizeof(struct epoll_event));
+        }
+
+        for (k = 0; k < p->n_pollfd_used; k++) {
+            p->epoll_registered[k].fd = -1;
+            p->pollfd[k].revents = 0;
+        }
+
+        p->n_epoll_events = 0;
+        p->epoll_resync = FALSE;
+    }
+
+    /* poll() clears all revents, we only need to clear those we set */
+    for (k = 0; k < p->n_epoll_events; k++)
+        if (p->epoll_events[k].data.u32 != TIMER_FD_TAG)
+            p->pollfd[p->epoll_events[k].data.u32].revents = 0;
+
+    p->n_epoll_events = 0;
+
+    /* Drop replaced fds first, so that fds that just moved to another
+     * slot can be added again in the second pass. The old fd might be
+     * closed already, which removed it from the set anyway. */
+    for (k = 0; k < p->n_pollfd_used; k++) {
+        struct pollfd *f = p->pollfd + k, *r = p->epoll_registered + k;
+
+        if (r->fd >= 0 && r->fd != f->fd) {
+            epoll_ctl(p->epoll_fd, EPOLL_CTL_DEL, r->fd, NULL);
+            r->fd = -1;
+        }
+    }
+
+    for (k = 0; k < p->n_pollfd_used; k++) {
+        struct pollfd *f = p->pollfd + k, *r = p->epoll_registered + k;
+
+        if (f->fd == r->fd && f->events == r->events)
+            continue;
+
+        if (f->fd >= 0) {
+            pa_zero(ev);
+            /* On Linux the EPOLL* bits have the same values as the POLL* ones */
+            ev.events = (uint32_t) f->events;
+            ev.data.u32 = k;
+
+            if (epoll_ctl(p->epoll_fd, r->fd == f->fd ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, f->fd, &ev) < 0) {
+                pa_log_debug("epoll_ctl(%i): %s", f->fd, pa_cstrerror(errno));
+                return -1;
+            }
+        }
+
+        r->fd = f->fd;
+        r->events = f->events;
+    }
+
+    return 0;
+}
+
+static int epoll_run(pa_rtpoll *p, pa_bool_t wait_op, const struct timeval *timeout) {
+    struct itimerspec its;
+    int timeout_ms = -1, n, k, r = 0;
+
+    pa_assert(p);
+    pa_assert(timeout);
+
+    if (!wait_op || p->quit || (p->timer_enabled && timeout->tv_sec == 0 && timeout->tv_usec == 0))
+        timeout_ms = 0;
+    else if (p->timer_enabled) {
+
+        /* epoll_wait() only has millisecond resolution, hence the
+         * timerfd, which is only rearmed when the time changes */
+        if (pa_timeval_cmp(&p->timer_armed, &p->next_elapse) != 0) {
+            pa_zero(its);
+            its.it_value.tv_sec = p->next_elapse.tv_sec;
+            its.it_value.tv_nsec = p->next_elapse.tv_usec * PA_NSEC_PER_USEC;
+
+            if (timerfd_settime(p->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+                pa_log_error("timerfd_settime(): %s", pa_cstrerror(errno));
+                return -1;
+            }
+
+            p->timer_armed = p->next_elapse;
+        }
+
+    } else if (p->timer_armed.tv_sec || p->timer_armed.tv_usec) {
+        pa_zero(its);
+
+        if (timerfd_settime(p->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+            pa_log_error("timerfd_settime(): %s", pa_cstrerror(errno));
+            return -1;
+        }
+
+        pa_zero(p->timer_armed);
+    }
+
+    if ((n = epoll_wait(p->epoll_fd, p->epoll_events, (int) p->n_epoll_events_alloc, timeout_ms)) < 0)
+        return -1;
+
+    p->n_epoll_events = (unsigned) n;
+
+    for (k = 0; k < n; k++) {
+        struct epoll_event *ev = p->epoll_events + k;
+
+        if (ev->data.u32 == TIMER_FD_TAG) {
+            uint64_t expirations;
+
+            /* The timer is disarmed now, so make sure the next
+             * deadline is set even if it is the same */
+            if (read(p->timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                pa_log_debug("read(timerfd): %s", pa_cstrerror(errno));
+
+            pa_zero(p->timer_armed);
+            continue;
+        }
+
+        pa_assert(ev->data.u32 < p->n_pollfd_used);
+        p->pollfd[ev->data.u32].revents = (short) ev->events;
+        r++;
+    }
+
+    /* Like poll(), 0 means that nothing but the timer woke us up */
+    return r;
+}
+#endif
+
 int pa_rtpoll_run(pa_rtpoll *p, pa_bool_t wait_op) {
     pa_rtpoll_item *i;
     int r = 0;
@@ -306,6 +563,16 @@ int pa_rtpoll_run(pa_rtpoll *p, pa_bool_t wait_op) {
 #endif
 
     /* OK, now let's sleep */
+#ifdef USE_EPOLL
+    if (p->timer_fd >= 0 && epoll_sync(p) < 0) {
+        pa_log_info("Cannot use epoll for all fds of this loop, falling back to poll().");
+        epoll_close(p);
+    }
+
+    if (p->timer_fd >= 0)
+        r = epoll_run(p, wait_op, &timeout);
+    else
+#endif
 #ifdef HAVE_PPOLL
     {
         struct timespec ts;
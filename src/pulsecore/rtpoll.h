@@ -53,7 +53,23 @@ typedef enum pa_rtpoll_priority {
     PA_RTPOLL_NEVER  = INT_MAX,       /* For stuff that doesn't register any callbacks, but only fds to listen on */
 } pa_rtpoll_priority_t;
 
+typedef enum pa_rtpoll_backend {
+    PA_RTPOLL_BACKEND_DEFAULT,        /* epoll if available, unless $PULSE_NO_EPOLL is set */
+    PA_RTPOLL_BACKEND_POLL,           /* ppoll()/poll() on the full pollfd array */
+    PA_RTPOLL_BACKEND_EPOLL,          /* Linux epoll with a timerfd for the timer */
+} pa_rtpoll_backend_t;
+
 pa_rtpoll *pa_rtpoll_new(void);
+
+/* The epoll backend keeps the fds registered between iterations and
+ * only passes changes of the pollfd data to the kernel, so the cost of
+ * a wakeup no longer grows with the number of fds. Closing an fd and
+ * reusing its number without freeing or changing the item is not
+ * noticed. If an fd cannot be handled by epoll the loop silently
+ * switches to the poll backend. */
+pa_rtpoll *pa_rtpoll_new_with_backend(pa_rtpoll_backend_t backend);
+pa_rtpoll_backend_t pa_rtpoll_get_backend(pa_rtpoll *p);
+
 void pa_rtpoll_free(pa_rtpoll *p);
 
 /* Sleep on the rtpoll until the time event, or any of the fd events
@@ -44,6 +44,11 @@ pa_memblock* pa_silence_memblock(pa_memblock *b, const pa_sample_spec *spec);
 
 pa_memchunk* pa_silence_memchunk_get(pa_silence_cache *cache, pa_mempool *pool, pa_memchunk* ret, const pa_sample_spec *spec, size_t length);
 
+/* pa_mix() repeats the per-channel volume factors this many times
+ * past the last channel, so that vectorized mixers can load a whole
+ * register of factors starting at any channel */
+#define PA_MIX_VOLUME_PADDING 8
+
 typedef struct pa_mix_info {
     pa_memchunk chunk;
     pa_cvolume volume;
@@ -55,7 +60,7 @@ typedef struct pa_mix_info {
     union {
         int32_t i;
         float f;
-    } linear[PA_CHANNELS_MAX];
+    } linear[PA_CHANNELS_MAX + PA_MIX_VOLUME_PADDING];
 } pa_mix_info;
 
 size_t pa_mix(
@@ -93,6 +98,15 @@ typedef void (*pa_do_volume_func_t) (void *samples, const void *volumes, unsigne
 pa_do_volume_func_t pa_get_volume_func(pa_sample_format_t f);
 void pa_set_volume_func(pa_sample_format_t f, pa_do_volume_func_t func);
 
+/* Mixes the samples between data and end. Each stream's ptr points to
+ * its input and must be advanced past the consumed samples; linear
+ * holds the per-channel factors, padded with PA_MIX_VOLUME_PADDING
+ * repeated entries. */
+typedef void (*pa_do_mix_func_t) (pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end);
+
+pa_do_mix_func_t pa_get_mix_func(pa_sample_format_t f);
+void pa_set_mix_func(pa_sample_format_t f, pa_do_mix_func_t func);
+
 size_t pa_convert_size(size_t size, const pa_sample_spec *from, const pa_sample_spec *to);
 
 #define PA_CHANNEL_POSITION_MASK_LEFT                                   \
@@ -0,0 +1,267 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-x86.h"
+
+#include "sconv.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+#include <immintrin.h>
+
+/* The kernels below convert 8 samples at a time and produce the same
+ * results as the C versions bit by bit: s16 is scaled in single
+ * precision, s32 and the 24bit formats go through double precision
+ * like lrint() does. Whatever is left over is handed to the previous
+ * implementation. */
+
+static pa_convert_func_t to_float32ne_fallback[PA_SAMPLE_MAX];
+static pa_convert_func_t from_float32ne_fallback[PA_SAMPLE_MAX];
+
+static inline __m128i swap16(__m128i v) {
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+}
+
+static inline __m256i swap32(__m256i v) {
+    return _mm256_shuffle_epi8(v, _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                                   3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+}
+
+static inline __m256 clamp(__m256 v) {
+    return _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(1.0f));
+}
+
+/* lrint((double) v * 0x7FFFFFFF) for 8 clamped floats */
+static inline __m256i float_to_s32(__m256 v) {
+    const __m256d scale = _mm256_set1_pd((double) 0x7FFFFFFF);
+    __m128i lo, hi;
+
+    lo = _mm256_cvtpd_epi32(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(v)), scale));
+    hi = _mm256_cvtpd_epi32(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)), scale));
+
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+/* Samples with the low byte cleared, as the 24bit formats produce them,
+ * are exact in single precision and the division by 2^31 is a multiply */
+static inline __m256 s24_to_float(__m256i v) {
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(1.0f / 2147483648.0f));
+}
+
+static inline void s16_to_float32ne(unsigned n, const int16_t *a, float *b, pa_bool_t swap) {
+    const __m256 scale = _mm256_set1_ps((float) 0x7FFF);
+
+    for (; n > 0; n -= 8, a += 8, b += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*) a);
+
+        if (swap)
+            v = swap16(v);
+
+        _mm256_storeu_ps(b, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)), scale));
+    }
+}
+
+static inline void s16_from_float32ne(unsigned n, const float *a, int16_t *b, pa_bool_t swap) {
+    const __m256 scale = _mm256_set1_ps((float) 0x7FFF);
+
+    for (; n > 0; n -= 8, a += 8, b += 8) {
+        __m256i s;
+        __m128i v;
+
+        s = _mm256_cvtps_epi32(_mm256_mul_ps(clamp(_mm256_loadu_ps(a)), scale));
+        v = _mm_packs_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+
+        if (swap)
+            v = swap16(v);
+
+        _mm_storeu_si128((__m128i*) b, v);
+    }
+}
+
+static inline void s32_to_float32ne(unsigned n, const int32_t *a, float *b, pa_bool_t swap) {
+    const __m256d scale = _mm256_set1_pd((double) 0x7FFFFFFF);
+
+    for (; n > 0; n -= 8, a += 8, b += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) a);
+        __m128 lo, hi;
+
+        if (swap)
+            v = swap32(v);
+
+        lo = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), scale));
+        hi = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), scale));
+
+        _mm256_storeu_ps(b, _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1));
+    }
+}
+
+static inline void s32_from_float32ne(unsigned n, const float *a, int32_t *b, pa_bool_t swap) {
+    for (; n > 0; n -= 8, a += 8, b += 8) {
+        __m256i v = float_to_s32(clamp(_mm256_loadu_ps(a)));
+
+        if (swap)
+            v = swap32(v);
+
+        _mm256_storeu_si256((__m256i*) b, v);
+    }
+}
+
+static inline void s24_32_to_float32ne(unsigned n, const uint32_t *a, float *b, pa_bool_t swap) {
+    for (; n > 0; n -= 8, a += 8, b += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) a);
+
+        if (swap)
+            v = swap32(v);
+
+        _mm256_storeu_ps(b, s24_to_float(_mm256_slli_epi32(v, 8)));
+    }
+}
+
+static inline void s24_32_from_float32ne(unsigned n, const float *a, uint32_t *b, pa_bool_t swap) {
+    for (; n > 0; n -= 8, a += 8, b += 8) {
+        __m256i v = _mm256_srli_epi32(float_to_s32(clamp(_mm256_loadu_ps(a))), 8);
+
+        if (swap)
+            v = swap32(v);
+
+        _mm256_storeu_si256((__m256i*) b, v);
+    }
+}
+
+/* Packed 24bit samples are moved so that each 128bit lane holds four of
+ * them, then shuffled into the top three bytes of each 32bit word. Loads
+ * and stores cover exactly 24 bytes so that nothing outside the buffers
+ * is touched. */
+
+static inline void s24_to_float32ne(unsigned n, const uint8_t *a, float *b, pa_bool_t be) {
+    const __m256i spread = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 5);
+    const __m256i le_mask = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                             -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m256i be_mask = _mm256_setr_epi8(-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9,
+                                             -1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9);
+
+    for (; n > 0; n -= 8, a += 24, b += 8) {
+        __m256i v;
+
+        v = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) a));
+        v = _mm256_inserti128_si256(v, _mm_loadl_epi64((const __m128i*) (a + 16)), 1);
+        v = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(v, spread), be ? be_mask : le_mask);
+
+        _mm256_storeu_ps(b, s24_to_float(v));
+    }
+}
+
+static inline void s24_from_float32ne(unsigned n, const float *a, uint8_t *b, pa_bool_t be) {
+    const __m256i gather = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+    const __m256i le_mask = _mm256_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1,
+                                             1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+    const __m256i be_mask = _mm256_setr_epi8(3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, -1, -1, -1, -1,
+                                             3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, -1, -1, -1, -1);
+
+    for (; n > 0; n -= 8, a += 8, b += 24) {
+        __m256i v;
+
+        v = _mm256_shuffle_epi8(float_to_s32(clamp(_mm256_loadu_ps(a))), be ? be_mask : le_mask);
+        v = _mm256_permutevar8x32_epi32(v, gather);
+
+        _mm_storeu_si128((__m128i*) b, _mm256_castsi256_si128(v));
+        _mm_storel_epi64((__m128i*) (b + 16), _mm256_extracti128_si256(v, 1));
+    }
+}
+
+#define DEFINE_TO_FLOAT32NE(name, format, kernel, type, width, swap)    \
+    static void name(unsigned n, const type *a, float *b) {             \
+        unsigned k = n & ~7U;                                           \
+                                                                        \
+        kernel(k, a, b, swap);                                          \
+        if (k < n)                                                      \
+            to_float32ne_fallback[format](n - k, a + k * width, b + k); \
+    }
+
+#define DEFINE_FROM_FLOAT32NE(name, format, kernel, type, width, swap)    \
+    static void name(unsigned n, const float *a, type *b) {               \
+        unsigned k = n & ~7U;                                             \
+                                                                          \
+        kernel(k, a, b, swap);                                            \
+        if (k < n)                                                        \
+            from_float32ne_fallback[format](n - k, a + k, b + k * width); \
+    }
+
+DEFINE_TO_FLOAT32NE(s16le_to_float32ne_avx2, PA_SAMPLE_S16LE, s16_to_float32ne, int16_t, 1, FALSE)
+DEFINE_TO_FLOAT32NE(s16be_to_float32ne_avx2, PA_SAMPLE_S16BE, s16_to_float32ne, int16_t, 1, TRUE)
+DEFINE_TO_FLOAT32NE(s32le_to_float32ne_avx2, PA_SAMPLE_S32LE, s32_to_float32ne, int32_t, 1, FALSE)
+DEFINE_TO_FLOAT32NE(s32be_to_float32ne_avx2, PA_SAMPLE_S32BE, s32_to_float32ne, int32_t, 1, TRUE)
+DEFINE_TO_FLOAT32NE(s24_32le_to_float32ne_avx2, PA_SAMPLE_S24_32LE, s24_32_to_float32ne, uint32_t, 1, FALSE)
+DEFINE_TO_FLOAT32NE(s24_32be_to_float32ne_avx2, PA_SAMPLE_S24_32BE, s24_32_to_float32ne, uint32_t, 1, TRUE)
+DEFINE_TO_FLOAT32NE(s24le_to_float32ne_avx2, PA_SAMPLE_S24LE, s24_to_float32ne, uint8_t, 3, FALSE)
+DEFINE_TO_FLOAT32NE(s24be_to_float32ne_avx2, PA_SAMPLE_S24BE, s24_to_float32ne, uint8_t, 3, TRUE)
+
+DEFINE_FROM_FLOAT32NE(s16le_from_float32ne_avx2, PA_SAMPLE_S16LE, s16_from_float32ne, int16_t, 1, FALSE)
+DEFINE_FROM_FLOAT32NE(s16be_from_float32ne_avx2, PA_SAMPLE_S16BE, s16_from_float32ne, int16_t, 1, TRUE)
+DEFINE_FROM_FLOAT32NE(s32le_from_float32ne_avx2, PA_SAMPLE_S32LE, s32_from_float32ne, int32_t, 1, FALSE)
+DEFINE_FROM_FLOAT32NE(s32be_from_float32ne_avx2, PA_SAMPLE_S32BE, s32_from_float32ne, int32_t, 1, TRUE)
+DEFINE_FROM_FLOAT32NE(s24_32le_from_float32ne_avx2, PA_SAMPLE_S24_32LE, s24_32_from_float32ne, uint32_t, 1, FALSE)
+DEFINE_FROM_FLOAT32NE(s24_32be_from_float32ne_avx2, PA_SAMPLE_S24_32BE, s24_32_from_float32ne, uint32_t, 1, TRUE)
+DEFINE_FROM_FLOAT32NE(s24le_from_float32ne_avx2, PA_SAMPLE_S24LE, s24_from_float32ne, uint8_t, 3, FALSE)
+DEFINE_FROM_FLOAT32NE(s24be_from_float32ne_avx2, PA_SAMPLE_S24BE, s24_from_float32ne, uint8_t, 3, TRUE)
+
+static void set_to_float32ne(pa_sample_format_t f, pa_convert_func_t func) {
+    to_float32ne_fallback[f] = pa_get_convert_to_float32ne_function(f);
+    pa_set_convert_to_float32ne_function(f, func);
+}
+
+static void set_from_float32ne(pa_sample_format_t f, pa_convert_func_t func) {
+    from_float32ne_fallback[f] = pa_get_convert_from_float32ne_function(f);
+    pa_set_convert_from_float32ne_function(f, func);
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_convert_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized conversions.");
+
+        set_to_float32ne(PA_SAMPLE_S16LE, (pa_convert_func_t) s16le_to_float32ne_avx2);
+        set_to_float32ne(PA_SAMPLE_S16BE, (pa_convert_func_t) s16be_to_float32ne_avx2);
+        set_to_float32ne(PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_to_float32ne_avx2);
+        set_to_float32ne(PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_to_float32ne_avx2);
+        set_to_float32ne(PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_to_float32ne_avx2);
+        set_to_float32ne(PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_to_float32ne_avx2);
+        set_to_float32ne(PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_to_float32ne_avx2);
+        set_to_float32ne(PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_to_float32ne_avx2);
+
+        set_from_float32ne(PA_SAMPLE_S16LE, (pa_convert_func_t) s16le_from_float32ne_avx2);
+        set_from_float32ne(PA_SAMPLE_S16BE, (pa_convert_func_t) s16be_from_float32ne_avx2);
+        set_from_float32ne(PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_from_float32ne_avx2);
+        set_from_float32ne(PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_from_float32ne_avx2);
+        set_from_float32ne(PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_from_float32ne_avx2);
+        set_from_float32ne(PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_from_float32ne_avx2);
+        set_from_float32ne(PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_from_float32ne_avx2);
+        set_from_float32ne(PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_from_float32ne_avx2);
+    }
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
@@ -0,0 +1,262 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-arm.h"
+
+#include "sconv.h"
+
+#if (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__)
+
+#include <arm_neon.h>
+
+/* 32bit NEON has neither a vector division nor double precision, and
+ * its float to integer conversion truncates. The kernels below scale by
+ * the reciprocal in single precision and round half away from zero, so
+ * the results may be off from the C versions by one in the last bit. */
+
+static pa_convert_func_t to_float32ne_fallback[PA_SAMPLE_MAX];
+static pa_convert_func_t from_float32ne_fallback[PA_SAMPLE_MAX];
+
+static inline float32x4_t clamp(float32x4_t v) {
+    return vminq_f32(vmaxq_f32(v, vdupq_n_f32(-1.0f)), vdupq_n_f32(1.0f));
+}
+
+static inline int32x4_t round_s32(float32x4_t v) {
+    uint32x4_t half;
+
+    half = vorrq_u32(vreinterpretq_u32_f32(vdupq_n_f32(0.5f)),
+                     vandq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(0x80000000)));
+
+    /* Saturates, so 1.0 * 2^31 ends up as 0x7FFFFFFF */
+    return vcvtq_s32_f32(vaddq_f32(v, vreinterpretq_f32_u32(half)));
+}
+
+static inline int32x4_t float_to_s32(float32x4_t v) {
+    return round_s32(vmulq_n_f32(clamp(v), 2147483648.0f));
+}
+
+static inline float32x4_t s32_to_float(int32x4_t v) {
+    return vmulq_n_f32(vcvtq_f32_s32(v), 1.0f / 2147483648.0f);
+}
+
+static inline void s16_to_float32ne(unsigned n, const int16_t *a, float *b, pa_bool_t swap) {
+    for (; n > 0; n -= 8, a += 8, b += 8) {
+        int16x8_t v = vld1q_s16(a);
+
+        if (swap)
+            v = vreinterpretq_s16_u8(vrev16q_u8(vreinterpretq_u8_s16(v)));
+
+        vst1q_f32(b, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.0f / 0x7FFF));
+        vst1q_f32(b + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0f / 0x7FFF));
+    }
+}
+
+static inline void s16_from_float32ne(unsigned n, const float *a, int16_t *b, pa_bool_t swap) {
+    for (; n > 0; n -= 8, a += 8, b += 8) {
+        int32x4_t lo, hi;
+        int16x8_t v;
+
+        lo = round_s32(vmulq_n_f32(clamp(vld1q_f32(a)), (float) 0x7FFF));
+        hi = round_s32(vmulq_n_f32(clamp(vld1q_f32(a + 4)), (float) 0x7FFF));
+        v = vcombine_s16(vmovn_s32(lo), vmovn_s32(hi));
+
+        if (swap)
+            v = vreinterpretq_s16_u8(vrev16q_u8(vreinterpretq_u8_s16(v)));
+
+        vst1q_s16(b, v);
+    }
+}
+
+static inline void s32_to_float32ne(unsigned n, const int32_t *a, float *b, pa_bool_t swap) {
+    for (; n > 0; n -= 8, a += 8, b += 8) {
+        int32x4_t lo = vld1q_s32(a), hi = vld1q_s32(a + 4);
+
+        if (swap) {
+            lo = vreinterpretq_s32_u8(vrev32q_u8(vreinterpretq_u8_s32(lo)));
+            hi = vreinterpretq_s32_u8(vrev32q_u8(vreinterpretq_u8_s32(hi)));
+        }
+
+        vst1q_f32(b, s32_to_float(lo));
+        vst1q_f32(b + 4, s32_to_float(hi));
+    }
+}
+
+static inline void s32_from_float32ne(unsigned n, const float *a, int32_t *b, pa_bool_t swap) {
+    for (; n > 0; n -= 8, a += 8, b += 8) {
+        int32x4_t lo = float_to_s32(vld1q_f32(a)), hi = float_to_s32(vld1q_f32(a + 4));
+
+        if (swap) {
+            lo = vreinterpretq_s32_u8(vrev32q_u8(vreinterpretq_u8_s32(lo)));
+            hi = vreinterpretq_s32_u8(vrev32q_u8(vreinterpretq_u8_s32(hi)));
+        }
+
+        vst1q_s32(b, lo);
+        vst1q_s32(b + 4, hi);
+    }
+}
+
+static inline void s24_32_to_float32ne(unsigned n, const uint32_t *a, float *b, pa_bool_t swap) {
+    for (; n > 0; n -= 8, a += 8, b += 8) {
+        uint32x4_t lo = vld1q_u32(a), hi = vld1q_u32(a + 4);
+
+        if (swap) {
+            lo = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(lo)));
+            hi = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(hi)));
+        }
+
+        vst1q_f32(b, s32_to_float(vreinterpretq_s32_u32(vshlq_n_u32(lo, 8))));
+        vst1q_f32(b + 4, s32_to_float(vreinterpretq_s32_u32(vshlq_n_u32(hi, 8))));
+    }
+}
+
+static inline void s24_32_from_float32ne(unsigned n, const float *a, uint32_t *b, pa_bool_t swap) {
+    for (; n > 0; n -= 8, a += 8, b += 8) {
+        uint32x4_t lo, hi;
+
+        lo = vshrq_n_u32(vreinterpretq_u32_s32(float_to_s32(vld1q_f32(a))), 8);
+        hi = vshrq_n_u32(vreinterpretq_u32_s32(float_to_s32(vld1q_f32(a + 4))), 8);
+
+        if (swap) {
+            lo = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(lo)));
+            hi = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(hi)));
+        }
+
+        vst1q_u32(b, lo);
+        vst1q_u32(b + 4, hi);
+    }
+}
+
+/* Packed 24bit samples are split into byte planes by the interleaving
+ * load and store, so they don't depend on the byte order of the CPU */
+
+static inline void s24_to_float32ne(unsigned n, const uint8_t *a, float *b, pa_bool_t be) {
+    for (; n > 0; n -= 8, a += 24, b += 8) {
+        uint8x8x3_t v = vld3_u8(a);
+        uint8x8_t low = be ? v.val[2] : v.val[0], high = be ? v.val[0] : v.val[2];
+        uint16x8x2_t s;
+
+        /* Interleaving the low and high halves gives the sample << 8 */
+        s = vzipq_u16(vshll_n_u8(low, 8), vorrq_u16(vmovl_u8(v.val[1]), vshll_n_u8(high, 8)));
+
+        vst1q_f32(b, s32_to_float(vreinterpretq_s32_u16(s.val[0])));
+        vst1q_f32(b + 4, s32_to_float(vreinterpretq_s32_u16(s.val[1])));
+    }
+}
+
+static inline void s24_from_float32ne(unsigned n, const float *a, uint8_t *b, pa_bool_t be) {
+    for (; n > 0; n -= 8, a += 8, b += 24) {
+        uint32x4_t lo, hi;
+        uint16x8_t low, high;
+        uint8x8x3_t v;
+
+        lo = vreinterpretq_u32_s32(float_to_s32(vld1q_f32(a)));
+        hi = vreinterpretq_u32_s32(float_to_s32(vld1q_f32(a + 4)));
+
+        /* Bits 8..23 and 16..31 of each sample */
+        low = vcombine_u16(vshrn_n_u32(lo, 8), vshrn_n_u32(hi, 8));
+        high = vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16));
+
+        v.val[be ? 2 : 0] = vmovn_u16(low);
+        v.val[1] = vshrn_n_u16(low, 8);
+        v.val[be ? 0 : 2] = vshrn_n_u16(high, 8);
+
+        vst3_u8(b, v);
+    }
+}
+
+#define DEFINE_TO_FLOAT32NE(name, format, kernel, type, width, swap)    \
+    static void name(unsigned n, const type *a, float *b) {             \
+        unsigned k = n & ~7U;                                           \
+                                                                        \
+        kernel(k, a, b, swap);                                          \
+        if (k < n)                                                      \
+            to_float32ne_fallback[format](n - k, a + k * width, b + k); \
+    }
+
+#define DEFINE_FROM_FLOAT32NE(name, format, kernel, type, width, swap)    \
+    static void name(unsigned n, const float *a, type *b) {               \
+        unsigned k = n & ~7U;                                             \
+                                                                          \
+        kernel(k, a, b, swap);                                            \
+        if (k < n)                                                        \
+            from_float32ne_fallback[format](n - k, a + k, b + k * width); \
+    }
+
+DEFINE_TO_FLOAT32NE(s16ne_to_float32ne_neon, PA_SAMPLE_S16NE, s16_to_float32ne, int16_t, 1, FALSE)
+DEFINE_TO_FLOAT32NE(s16re_to_float32ne_neon, PA_SAMPLE_S16RE, s16_to_float32ne, int16_t, 1, TRUE)
+DEFINE_TO_FLOAT32NE(s32ne_to_float32ne_neon, PA_SAMPLE_S32NE, s32_to_float32ne, int32_t, 1, FALSE)
+DEFINE_TO_FLOAT32NE(s32re_to_float32ne_neon, PA_SAMPLE_S32RE, s32_to_float32ne, int32_t, 1, TRUE)
+DEFINE_TO_FLOAT32NE(s24_32ne_to_float32ne_neon, PA_SAMPLE_S24_32NE, s24_32_to_float32ne, uint32_t, 1, FALSE)
+DEFINE_TO_FLOAT32NE(s24_32re_to_float32ne_neon, PA_SAMPLE_S24_32RE, s24_32_to_float32ne, uint32_t, 1, TRUE)
+DEFINE_TO_FLOAT32NE(s24le_to_float32ne_neon, PA_SAMPLE_S24LE, s24_to_float32ne, uint8_t, 3, FALSE)
+DEFINE_TO_FLOAT32NE(s24be_to_float32ne_neon, PA_SAMPLE_S24BE, s24_to_float32ne, uint8_t, 3, TRUE)
+
+DEFINE_FROM_FLOAT32NE(s16ne_from_float32ne_neon, PA_SAMPLE_S16NE, s16_from_float32ne, int16_t, 1, FALSE)
+DEFINE_FROM_FLOAT32NE(s16re_from_float32ne_neon, PA_SAMPLE_S16RE, s16_from_float32ne, int16_t, 1, TRUE)
+DEFINE_FROM_FLOAT32NE(s32ne_from_float32ne_neon, PA_SAMPLE_S32NE, s32_from_float32ne, int32_t, 1, FALSE)
+DEFINE_FROM_FLOAT32NE(s32re_from_float32ne_neon, PA_SAMPLE_S32RE, s32_from_float32ne, int32_t, 1, TRUE)
+DEFINE_FROM_FLOAT32NE(s24_32ne_from_float32ne_neon, PA_SAMPLE_S24_32NE, s24_32_from_float32ne, uint32_t, 1, FALSE)
+DEFINE_FROM_FLOAT32NE(s24_32re_from_float32ne_neon, PA_SAMPLE_S24_32RE, s24_32_from_float32ne, uint32_t, 1, TRUE)
+DEFINE_FROM_FLOAT32NE(s24le_from_float32ne_neon, PA_SAMPLE_S24LE, s24_from_float32ne, uint8_t, 3, FALSE)
+DEFINE_FROM_FLOAT32NE(s24be_from_float32ne_neon, PA_SAMPLE_S24BE, s24_from_float32ne, uint8_t, 3, TRUE)
+
+static void set_to_float32ne(pa_sample_format_t f, pa_convert_func_t func) {
+    to_float32ne_fallback[f] = pa_get_convert_to_float32ne_function(f);
+    pa_set_convert_to_float32ne_function(f, func);
+}
+
+static void set_from_float32ne(pa_sample_format_t f, pa_convert_func_t func) {
+    from_float32ne_fallback[f] = pa_get_convert_from_float32ne_function(f);
+    pa_set_convert_from_float32ne_function(f, func);
+}
+
+#endif /* (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__) */
+
+void pa_convert_func_init_neon(pa_cpu_arm_flag_t flags) {
+#if (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__)
+    if (flags & PA_CPU_ARM_NEON) {
+        pa_log_info("Initialising NEON optimized conversions.");
+
+        set_to_float32ne(PA_SAMPLE_S16NE, (pa_convert_func_t) s16ne_to_float32ne_neon);
+        set_to_float32ne(PA_SAMPLE_S16RE, (pa_convert_func_t) s16re_to_float32ne_neon);
+        set_to_float32ne(PA_SAMPLE_S32NE, (pa_convert_func_t) s32ne_to_float32ne_neon);
+        set_to_float32ne(PA_SAMPLE_S32RE, (pa_convert_func_t) s32re_to_float32ne_neon);
+        set_to_float32ne(PA_SAMPLE_S24_32NE, (pa_convert_func_t) s24_32ne_to_float32ne_neon);
+        set_to_float32ne(PA_SAMPLE_S24_32RE, (pa_convert_func_t) s24_32re_to_float32ne_neon);
+        set_to_float32ne(PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_to_float32ne_neon);
+        set_to_float32ne(PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_to_float32ne_neon);
+
+        set_from_float32ne(PA_SAMPLE_S16NE, (pa_convert_func_t) s16ne_from_float32ne_neon);
+        set_from_float32ne(PA_SAMPLE_S16RE, (pa_convert_func_t) s16re_from_float32ne_neon);
+        set_from_float32ne(PA_SAMPLE_S32NE, (pa_convert_func_t) s32ne_from_float32ne_neon);
+        set_from_float32ne(PA_SAMPLE_S32RE, (pa_convert_func_t) s32re_from_float32ne_neon);
+        set_from_float32ne(PA_SAMPLE_S24_32NE, (pa_convert_func_t) s24_32ne_from_float32ne_neon);
+        set_from_float32ne(PA_SAMPLE_S24_32RE, (pa_convert_func_t) s24_32re_from_float32ne_neon);
+        set_from_float32ne(PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_from_float32ne_neon);
+        set_from_float32ne(PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_from_float32ne_neon);
+    }
+#endif /* (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__) */
+}
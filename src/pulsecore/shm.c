@@ -39,6 +39,10 @@
 #include <sys/mman.h>
 #endif
 
+#ifdef HAVE_MEMFD
+#include <sys/syscall.h>
+#endif
+
 /* This is deprecated on glibc but is still used by FreeBSD */
 #if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
 # define MAP_ANONYMOUS MAP_ANON
@@ -60,9 +64,6 @@
 #define MADV_REMOVE 9
 #endif
 
-/* 1 GiB at max */
-#define MAX_SHM_SIZE (PA_ALIGN(1024*1024*1024))
-
 #ifdef __linux__
 /* On Linux we know that the shared memory blocks are files in
  * /dev/shm. We can use that information to list all blocks and
@@ -74,6 +75,27 @@
 
 #define SHM_MARKER ((int) 0xbeefcafe)
 
+#ifdef HAVE_MEMFD
+/* The headers might be older than the kernel */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS (1024 + 9)
+#define F_GET_SEALS (1024 + 10)
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+static int memfd_create_syscall(const char *name, unsigned flags) {
+    return (int) syscall(SYS_memfd_create, name, flags);
+}
+#endif
+
 /* We now put this SHM marker at the end of each segment. It's
  * optional, to not require a reboot when upgrading, though. Note that
  * on multiarch systems 32bit and 64bit processes might access this
@@ -105,7 +127,7 @@ int pa_shm_create_rw(pa_shm *m, size_t size, pa_bool_t shared, mode_t mode) {
 
     pa_assert(m);
     pa_assert(size > 0);
-    pa_assert(size <= MAX_SHM_SIZE);
+    pa_assert(size <= PA_SHM_SIZE_MAX);
     pa_assert(mode >= 0600);
 
     /* Each time we create a new SHM area, let's first drop all stale
@@ -181,6 +203,8 @@ int pa_shm_create_rw(pa_shm *m, size_t size, pa_bool_t shared, mode_t mode) {
     }
 
     m->shared = shared;
+    m->memfd = FALSE;
+    m->sealed = FALSE;
 
     return 0;
 
@@ -213,6 +237,16 @@ void pa_shm_free(pa_shm *m) {
         free(m->ptr);
 #else
         pa_xfree(m->ptr);
+#endif
+    } else if (m->memfd) {
+#ifdef HAVE_MEMFD
+        if (munmap(m->ptr, PA_PAGE_ALIGN(m->size)) < 0)
+            pa_log("munmap() failed: %s", pa_cstrerror(errno));
+
+        if (m->fd >= 0)
+            pa_assert_se(pa_close(m->fd) == 0);
+#else
+        pa_assert_not_reached();
 #endif
     } else {
 #ifdef HAVE_SHM_OPEN
@@ -305,7 +339,7 @@ int pa_shm_attach_ro(pa_shm *m, unsigned id) {
     }
 
     if (st.st_size <= 0 ||
-        st.st_size > (off_t) (MAX_SHM_SIZE+SHM_MARKER_SIZE) ||
+        st.st_size > (off_t) (PA_SHM_SIZE_MAX+SHM_MARKER_SIZE) ||
         PA_ALIGN((size_t) st.st_size) != (size_t) st.st_size) {
         pa_log("Invalid shared memory segment size");
         goto fail;
@@ -320,6 +354,8 @@ int pa_shm_attach_ro(pa_shm *m, unsigned id) {
 
     m->do_unlink = FALSE;
     m->shared = TRUE;
+    m->memfd = FALSE;
+    m->sealed = FALSE;
 
     pa_assert_se(pa_close(fd) == 0);
 
@@ -340,6 +376,130 @@ int pa_shm_attach_ro(pa_shm *m, unsigned id) {
 
 #endif /* HAVE_SHM_OPEN */
 
+pa_bool_t pa_shm_memfd_supported(void) {
+#ifdef HAVE_MEMFD
+    static pa_atomic_t supported = PA_ATOMIC_INIT(-1);
+    int s, fd;
+
+    if ((s = pa_atomic_load(&supported)) >= 0)
+        return !!s;
+
+    /* The kernel might be older than the headers we were built with */
+    if ((fd = memfd_create_syscall("pulseaudio", MFD_CLOEXEC)) >= 0)
+        pa_close(fd);
+
+    s = fd >= 0;
+    pa_atomic_store(&supported, s);
+
+    return !!s;
+#else
+    return FALSE;
+#endif
+}
+
+int pa_shm_create_memfd(pa_shm *m, size_t size) {
+#ifdef HAVE_MEMFD
+    int fd;
+
+    pa_assert(m);
+    pa_assert(size > 0);
+    pa_assert(size <= PA_SHM_SIZE_MAX);
+
+    size = PA_PAGE_ALIGN(size);
+
+    if ((fd = memfd_create_syscall("pulseaudio", MFD_CLOEXEC|MFD_ALLOW_SEALING)) < 0) {
+        pa_log("memfd_create() failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    if (ftruncate(fd, (off_t) size) < 0) {
+        pa_log("ftruncate() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    /* Once sealed, whoever we pass the segment to may access it
+     * without having to fear that we truncate it under their feet */
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK|F_SEAL_GROW|F_SEAL_SEAL) < 0) {
+        pa_log("fcntl(F_ADD_SEALS) failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    if ((m->ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_NORESERVE, fd, (off_t) 0)) == MAP_FAILED) {
+        pa_log("mmap() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    pa_random(&m->id, sizeof(m->id));
+    m->size = size;
+    m->fd = fd;
+    m->do_unlink = FALSE;
+    m->shared = TRUE;
+    m->memfd = TRUE;
+    m->sealed = TRUE;
+
+    return 0;
+
+fail:
+    pa_close(fd);
+
+    return -1;
+#else
+    return -1;
+#endif
+}
+
+int pa_shm_attach_memfd(pa_shm *m, unsigned id, int fd) {
+#ifdef HAVE_MEMFD
+    struct stat st;
+    int seals;
+
+    pa_assert(m);
+    pa_assert(fd >= 0);
+
+    if (fstat(fd, &st) < 0) {
+        pa_log("fstat() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    if (st.st_size <= 0 ||
+        st.st_size > (off_t) PA_SHM_SIZE_MAX ||
+        PA_ALIGN((size_t) st.st_size) != (size_t) st.st_size) {
+        pa_log("Invalid shared memory segment size");
+        goto fail;
+    }
+
+    m->size = (size_t) st.st_size;
+
+    if ((m->ptr = mmap(NULL, PA_PAGE_ALIGN(m->size), PROT_READ, MAP_SHARED, fd, (off_t) 0)) == MAP_FAILED) {
+        pa_log("mmap() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    /* Anything but a memfd fails this */
+    seals = fcntl(fd, F_GET_SEALS);
+
+    m->id = id;
+    m->fd = -1;
+    m->do_unlink = FALSE;
+    m->shared = TRUE;
+    m->memfd = TRUE;
+    m->sealed = seals >= 0 && (seals & F_SEAL_SHRINK);
+
+    pa_assert_se(pa_close(fd) == 0);
+
+    return 0;
+
+fail:
+    pa_close(fd);
+
+    return -1;
+#else
+    pa_close(fd);
+
+    return -1;
+#endif
+}
+
 int pa_shm_cleanup(void) {
 
 #ifdef HAVE_SHM_OPEN
@@ -26,17 +26,39 @@
 
 #include <pulsecore/macro.h>
 
+/* 1 GiB at max */
+#define PA_SHM_SIZE_MAX (PA_ALIGN(1024*1024*1024))
+
 typedef struct pa_shm {
     unsigned id;
     void *ptr;
     size_t size;
+
+    /* Only valid for memfd segments we created, since other processes
+     * can attach to them only through this descriptor */
+    int fd;
+
     pa_bool_t do_unlink:1;
     pa_bool_t shared:1;
+    pa_bool_t memfd:1;
+
+    /* The segment can neither shrink nor grow, so accessing it won't
+     * SIGBUS */
+    pa_bool_t sealed:1;
 } pa_shm;
 
 int pa_shm_create_rw(pa_shm *m, size_t size, pa_bool_t shared, mode_t mode);
 int pa_shm_attach_ro(pa_shm *m, unsigned id);
 
+/* Anonymous shared memory that is passed around as a file descriptor
+ * instead of by name, so that only processes it is explicitly handed
+ * to have access to it. Nothing is created in /dev/shm either. The
+ * ID only serves to refer to the segment once the descriptor has been
+ * passed. pa_shm_attach_memfd() takes ownership of fd. */
+pa_bool_t pa_shm_memfd_supported(void);
+int pa_shm_create_memfd(pa_shm *m, size_t size);
+int pa_shm_attach_memfd(pa_shm *m, unsigned id, int fd);
+
 void pa_shm_punch(pa_shm *m, size_t offset, size_t size);
 
 void pa_shm_free(pa_shm *m);
@@ -0,0 +1,407 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memtrap.h>
+#include <pulsecore/shm.h>
+
+#include "shmring.h"
+
+/* Both indexes count bytes and wrap around at 2^32, the ring size is a
+ * power of two so that this works out */
+
+/* At the start of the producer's segment, followed by the ring */
+struct ring_data {
+    pa_atomic_t write_index;
+    uint32_t size;
+};
+
+/* The consumer's segment */
+struct ring_status {
+    pa_atomic_t read_index;
+    pa_atomic_t doorbell;
+};
+
+/* Keep the ring apart from the index the producer keeps changing */
+#define RING_OFFSET 64
+
+struct record {
+    uint32_t length;
+    uint32_t seek_mode;
+    int64_t offset;
+};
+
+/* Instead of a seek mode, marks an empty record as a fence */
+#define RECORD_FENCE ((uint32_t) -1)
+
+struct pa_shmring {
+    pa_bool_t producer;
+    pa_bool_t broken;
+
+    pa_shm data_shm, status_shm;
+
+    /* Consumer: the producer may truncate its segment under our feet */
+    pa_memtrap *trap;
+
+    struct ring_data *data;
+    struct ring_status *status;
+    uint8_t *ring;
+    size_t size;
+
+    /* Our copies of the index we own */
+    uint32_t write_index, read_index;
+
+    /* Producer: the last doorbell request we answered. Consumer:
+     * whether a request is outstanding. */
+    int doorbell_seen;
+    pa_bool_t doorbell_wanted;
+
+    /* Consumer: what is left of the record being read */
+    size_t pending;
+};
+
+static void copy_in(pa_shmring *r, uint32_t idx, const void *d, size_t length) {
+    size_t o = idx & (r->size - 1), n;
+
+    n = PA_MIN(length, r->size - o);
+    memcpy(r->ring + o, d, n);
+    memcpy(r->ring, (const uint8_t*) d + n, length - n);
+}
+
+/* Returns FALSE if the producer's segment went away while we were
+ * copying, in which case d is filled with garbage */
+static pa_bool_t copy_out(pa_shmring *r, uint32_t idx, void *d, size_t length) {
+    size_t o = idx & (r->size - 1), n;
+
+    n = PA_MIN(length, r->size - o);
+    memcpy(d, r->ring + o, n);
+    memcpy((uint8_t*) d + n, r->ring, length - n);
+
+    return pa_memtrap_is_good(r->trap);
+}
+
+pa_shmring* pa_shmring_new_producer(size_t size) {
+    pa_shmring *r;
+
+    pa_assert(size > 0);
+    pa_assert((size & (size - 1)) == 0);
+
+    r = pa_xnew0(pa_shmring, 1);
+    r->producer = TRUE;
+
+    if (pa_shm_create_rw(&r->data_shm, RING_OFFSET + size, TRUE, 0700) < 0) {
+        pa_xfree(r);
+        return NULL;
+    }
+
+    r->data = r->data_shm.ptr;
+    r->ring = (uint8_t*) r->data_shm.ptr + RING_OFFSET;
+    r->size = size;
+
+    pa_atomic_store(&r->data->write_index, 0);
+    r->data->size = (uint32_t) size;
+
+    return r;
+}
+
+int pa_shmring_attach_consumer(pa_shmring *r, unsigned status_id) {
+    pa_assert(r);
+    pa_assert(r->producer);
+    pa_assert(!r->status);
+
+    if (pa_shm_attach_ro(&r->status_shm, status_id) < 0)
+        return -1;
+
+    if (r->status_shm.size < sizeof(struct ring_status)) {
+        pa_log_warn("Shared memory ring status segment too small.");
+        pa_shm_free(&r->status_shm);
+        return -1;
+    }
+
+    r->status = r->status_shm.ptr;
+    r->doorbell_seen = pa_atomic_load(&r->status->doorbell);
+
+    return 0;
+}
+
+static int write_record(pa_shmring *r, const void *data, size_t length, int64_t offset, uint32_t seek_mode) {
+    struct record rec;
+    uint32_t used;
+
+    pa_assert(r);
+    pa_assert(r->producer);
+    pa_assert(r->status);
+
+    used = r->write_index - (uint32_t) pa_atomic_load(&r->status->read_index);
+
+    if (used > r->size || r->size - used < sizeof(rec) || length > r->size - used - sizeof(rec))
+        return -1;
+
+    pa_zero(rec);
+    rec.length = (uint32_t) length;
+    rec.seek_mode = seek_mode;
+    rec.offset = offset;
+
+    copy_in(r, r->write_index, &rec, sizeof(rec));
+
+    if (length > 0)
+        copy_in(r, r->write_index + (uint32_t) sizeof(rec), data, length);
+
+    /* We are the only writer, but unlike a store the addition orders
+     * the copies above before the new index becomes visible */
+    r->write_index += (uint32_t) (sizeof(rec) + length);
+    pa_atomic_add(&r->data->write_index, (int) (sizeof(rec) + length));
+
+    return 0;
+}
+
+int pa_shmring_write(pa_shmring *r, const void *data, size_t length, int64_t offset, pa_seek_mode_t seek) {
+    pa_assert(data);
+    pa_assert(length > 0);
+
+    return write_record(r, data, length, offset, (uint32_t) seek);
+}
+
+int pa_shmring_write_fence(pa_shmring *r) {
+    return write_record(r, NULL, 0, 0, RECORD_FENCE);
+}
+
+pa_bool_t pa_shmring_doorbell_pending(pa_shmring *r) {
+    int d;
+
+    pa_assert(r);
+    pa_assert(r->producer);
+    pa_assert(r->status);
+
+    if ((d = pa_atomic_load(&r->status->doorbell)) == r->doorbell_seen)
+        return FALSE;
+
+    r->doorbell_seen = d;
+    return TRUE;
+}
+
+pa_shmring* pa_shmring_new_consumer(unsigned data_id) {
+    pa_shmring *r;
+    size_t size;
+
+    r = pa_xnew0(pa_shmring, 1);
+    r->producer = FALSE;
+
+    if (pa_shm_attach_ro(&r->data_shm, data_id) < 0)
+        goto fail;
+
+    r->trap = pa_memtrap_add(r->data_shm.ptr, r->data_shm.size);
+
+    if (r->data_shm.size < RING_OFFSET) {
+        pa_log_warn("Shared memory ring segment too small.");
+        goto fail;
+    }
+
+    r->data = r->data_shm.ptr;
+
+    /* The producer may change this at any time, so we go by our copy */
+    size = r->data->size;
+
+    if (!pa_memtrap_is_good(r->trap) ||
+        size <= sizeof(struct record) || (size & (size - 1)) != 0 || size > r->data_shm.size - RING_OFFSET) {
+        pa_log_warn("Shared memory ring has invalid size.");
+        goto fail;
+    }
+
+    r->ring = (uint8_t*) r->data_shm.ptr + RING_OFFSET;
+    r->size = size;
+    r->read_index = (uint32_t) pa_atomic_load(&r->data->write_index);
+
+    if (pa_shm_create_rw(&r->status_shm, sizeof(struct ring_status), TRUE, 0700) < 0)
+        goto fail;
+
+    r->status = r->status_shm.ptr;
+    pa_atomic_store(&r->status->read_index, (int) r->read_index);
+    pa_atomic_store(&r->status->doorbell, 0);
+
+    return r;
+
+fail:
+    if (r->trap)
+        pa_memtrap_remove(r->trap);
+
+    if (r->data_shm.ptr)
+        pa_shm_free(&r->data_shm);
+
+    pa_xfree(r);
+    return NULL;
+}
+
+/* Copies the next piece of audio into a new memblock. Records larger
+ * than a memblock come out in several pieces, all but the first one
+ * without a seek. Returns 1 if there was data, 0 if the ring is empty
+ * or the next record is a fence, and -1 if the producer wrote
+ * something invalid, in which case the ring is not used anymore. */
+int pa_shmring_read(pa_shmring *r, pa_mempool *pool, pa_memchunk *chunk, int64_t *offset, pa_seek_mode_t *seek) {
+    uint32_t start, avail;
+    size_t n;
+
+    pa_assert(r);
+    pa_assert(!r->producer);
+    pa_assert(pool);
+    pa_assert(chunk);
+    pa_assert(offset);
+    pa_assert(seek);
+
+    if (r->broken)
+        return 0;
+
+    start = r->read_index;
+    avail = (uint32_t) pa_atomic_load(&r->data->write_index) - start;
+
+    if (!pa_memtrap_is_good(r->trap) || avail > r->size || avail < r->pending)
+        goto fail;
+
+    if (r->pending <= 0) {
+        struct record rec;
+
+        if (avail <= 0)
+            return 0;
+
+        if (avail < sizeof(rec))
+            goto fail;
+
+        if (!copy_out(r, r->read_index, &rec, sizeof(rec)))
+            goto fail;
+
+        if (rec.seek_mode == RECORD_FENCE) {
+            if (rec.length != 0)
+                goto fail;
+
+            return 0;
+        }
+
+        if (rec.length <= 0 || rec.length > avail - sizeof(rec) || rec.seek_mode > PA_SEEK_RELATIVE_END)
+            goto fail;
+
+        r->read_index += (uint32_t) sizeof(rec);
+        r->pending = rec.length;
+
+        *offset = rec.offset;
+        *seek = (pa_seek_mode_t) rec.seek_mode;
+    } else {
+        *offset = 0;
+        *seek = PA_SEEK_RELATIVE;
+    }
+
+    n = PA_MIN(r->pending, pa_mempool_block_size_max(pool));
+
+    chunk->memblock = pa_memblock_new(pool, n);
+    chunk->index = 0;
+    chunk->length = n;
+
+    if (!copy_out(r, r->read_index, pa_memblock_acquire(chunk->memblock), n)) {
+        pa_memblock_release(chunk->memblock);
+        pa_memblock_unref(chunk->memblock);
+        pa_memchunk_reset(chunk);
+        goto fail;
+    }
+
+    pa_memblock_release(chunk->memblock);
+
+    r->read_index += (uint32_t) n;
+    r->pending -= n;
+    r->doorbell_wanted = FALSE;
+
+    /* Hand the space back only after we copied out of it */
+    pa_atomic_add(&r->status->read_index, (int) (r->read_index - start));
+
+    return 1;
+
+fail:
+    pa_log_warn("Invalid data in shared memory ring, ignoring it from now on.");
+    r->broken = TRUE;
+    return -1;
+}
+
+/* Skips the fence at the read position, if there is one */
+void pa_shmring_pass_fence(pa_shmring *r) {
+    struct record rec;
+    uint32_t avail;
+
+    pa_assert(r);
+    pa_assert(!r->producer);
+
+    if (r->broken || r->pending > 0)
+        return;
+
+    avail = (uint32_t) pa_atomic_load(&r->data->write_index) - r->read_index;
+
+    if (avail < sizeof(rec) || avail > r->size)
+        return;
+
+    if (!copy_out(r, r->read_index, &rec, sizeof(rec))) {
+        pa_log_warn("Shared memory ring segment went away, ignoring it from now on.");
+        r->broken = TRUE;
+        return;
+    }
+
+    if (rec.seek_mode != RECORD_FENCE || rec.length != 0)
+        return;
+
+    r->read_index += (uint32_t) sizeof(rec);
+    pa_atomic_add(&r->status->read_index, (int) sizeof(rec));
+}
+
+void pa_shmring_want_doorbell(pa_shmring *r) {
+    pa_assert(r);
+    pa_assert(!r->producer);
+
+    if (r->doorbell_wanted)
+        return;
+
+    pa_atomic_inc(&r->status->doorbell);
+    r->doorbell_wanted = TRUE;
+}
+
+unsigned pa_shmring_get_shm_id(pa_shmring *r) {
+    pa_assert(r);
+
+    return r->producer ? r->data_shm.id : r->status_shm.id;
+}
+
+void pa_shmring_free(pa_shmring *r) {
+    pa_assert(r);
+
+    if (r->trap)
+        pa_memtrap_remove(r->trap);
+
+    if (r->data_shm.ptr)
+        pa_shm_free(&r->data_shm);
+
+    if (r->status_shm.ptr)
+        pa_shm_free(&r->status_shm);
+
+    pa_xfree(r);
+}
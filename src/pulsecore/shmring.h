@@ -0,0 +1,68 @@
+#ifndef foopulseshmringhfoo
+#define foopulseshmringhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <sys/types.h>
+
+#include <pulse/def.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+
+/* A single producer, single consumer ring buffer for passing audio
+ * data between two processes through shared memory, without going
+ * through a socket.
+ *
+ * The producer owns the segment holding the data and the write index,
+ * the consumer owns a small segment holding the read index. Each side
+ * maps the segment of the other one read-only, and the consumer
+ * validates everything it reads.
+ *
+ * Every write is stored as a record together with its seek offset and
+ * mode. When the consumer finds the ring empty it may ask the producer
+ * to notify it of the next write by some other means, which
+ * pa_shmring_doorbell_pending() then reports to the producer.
+ *
+ * A fence stops the consumer until it passes it explicitly, so that
+ * data written after some out-of-band request is not read before the
+ * request arrived. */
+
+typedef struct pa_shmring pa_shmring;
+
+/* Producer side */
+pa_shmring* pa_shmring_new_producer(size_t size);
+int pa_shmring_attach_consumer(pa_shmring *r, unsigned status_id);
+int pa_shmring_write(pa_shmring *r, const void *data, size_t length, int64_t offset, pa_seek_mode_t seek);
+int pa_shmring_write_fence(pa_shmring *r);
+pa_bool_t pa_shmring_doorbell_pending(pa_shmring *r);
+
+/* Consumer side */
+pa_shmring* pa_shmring_new_consumer(unsigned data_id);
+int pa_shmring_read(pa_shmring *r, pa_mempool *pool, pa_memchunk *chunk, int64_t *offset, pa_seek_mode_t *seek);
+void pa_shmring_pass_fence(pa_shmring *r);
+void pa_shmring_want_doorbell(pa_shmring *r);
+
+/* The ID of the segment this side owns, to be passed to the other side */
+unsigned pa_shmring_get_shm_id(pa_shmring *r);
+
+void pa_shmring_free(pa_shmring *r);
+
+#endif
@@ -0,0 +1,236 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "sinc.h"
+
+/* Rate ratios that would need more phases than this, or more memory
+ * than the coefficient limit, get a bank of INTERPOLATE_PHASES phases
+ * that is linearly interpolated at run time instead */
+#define MAX_PHASES 1024
+#define MAX_COEFFS (256*1024)
+#define INTERPOLATE_PHASES 256
+
+static const struct {
+    unsigned n_taps;  /* when not downsampling */
+    double cutoff;    /* relative to the lower of both Nyquist frequencies */
+    double beta;      /* of the Kaiser window */
+} qualities[PA_SINC_QUALITY_MAX + 1] = {
+    {  16, 0.850,  6.0 },
+    {  48, 0.900,  8.0 },
+    {  96, 0.940, 10.0 },
+    { 192, 0.965, 12.0 }
+};
+
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0, y = x * x / 4.0;
+    unsigned k;
+
+    for (k = 1; k < 100 && term > sum * 1e-12; k++) {
+        term *= y / ((double) k * k);
+        sum += term;
+    }
+
+    return sum;
+}
+
+static unsigned calc_taps(unsigned quality, uint32_t scale) {
+    unsigned n;
+
+    /* When downsampling the cutoff goes down with the ratio, so the
+     * filter has to get longer by the same amount for the same
+     * transition band in output samples. Extreme ratios have to live
+     * with a wider transition band. */
+    n = (unsigned) PA_MIN(((uint64_t) qualities[quality].n_taps << 16) / scale,
+                          (uint64_t) qualities[quality].n_taps * 32);
+
+    return PA_ROUND_UP(n, PA_SINC_TAPS_ALIGN);
+}
+
+struct bank_params {
+    unsigned quality;
+    uint32_t scale;
+    unsigned n_taps;
+    unsigned n_phases;
+    pa_bool_t interpolate;
+};
+
+static void *bank_new(const pa_resampler_table *key, size_t *size, void *userdata) {
+    const struct bank_params *params = userdata;
+    pa_sinc_bank *b;
+    double fc, beta, half, i0_beta;
+    unsigned p, k, n_taps = params->n_taps, n_phases = params->n_phases;
+
+    b = pa_xnew0(pa_sinc_bank, 1);
+    b->table = (pa_resampler_table*) key;
+    b->quality = params->quality;
+    b->scale = params->scale;
+    b->n_taps = n_taps;
+    b->n_phases = n_phases;
+    b->interpolate = params->interpolate;
+    b->coeffs = pa_xnew(float, (size_t) (n_phases + 1) * n_taps);
+
+    fc = qualities[b->quality].cutoff * b->scale / 65536.0;
+    beta = qualities[b->quality].beta;
+    half = n_taps / 2;
+    i0_beta = bessel_i0(beta);
+
+    for (p = 0; p <= n_phases; p++) {
+        float *row = b->coeffs + (size_t) p * n_taps;
+        double sum = 0;
+
+        for (k = 0; k < n_taps; k++) {
+            double d, x, h;
+
+            d = (double) k - (half - 1) - (double) p / n_phases;
+            x = d / half;
+
+            if (x <= -1.0 || x >= 1.0)
+                h = 0;
+            else {
+                h = fc * bessel_i0(beta * sqrt(1.0 - x * x)) / i0_beta;
+
+                if (fabs(d) > 1e-9)
+                    h *= sin(M_PI * fc * d) / (M_PI * fc * d);
+            }
+
+            row[k] = (float) h;
+            sum += h;
+        }
+
+        /* Make every phase pass DC at exactly unity gain */
+        for (k = 0; k < n_taps; k++)
+            row[k] = (float) (row[k] / sum);
+    }
+
+    *size = sizeof(pa_sinc_bank) + (size_t) (n_phases + 1) * n_taps * sizeof(float);
+
+    pa_log_debug("Created sinc filter bank: quality %u, %u taps, %u phases%s.",
+                 b->quality, n_taps, n_phases, b->interpolate ? " (interpolated)" : "");
+
+    return b;
+}
+
+static void bank_free(void *p) {
+    pa_sinc_bank *b = p;
+
+    pa_assert(b);
+
+    pa_xfree(b->coeffs);
+    pa_xfree(b);
+}
+
+unsigned pa_sinc_taps_max(unsigned quality) {
+    pa_assert(quality <= PA_SINC_QUALITY_MAX);
+
+    /* The longest filter is the one for the lowest cutoff */
+    return calc_taps(quality, 1);
+}
+
+pa_sinc_bank *pa_sinc_bank_get(unsigned quality, uint32_t in_rate, uint32_t out_rate, pa_bool_t interpolate) {
+    struct bank_params params;
+    pa_resampler_table *t;
+    uint32_t g, l;
+
+    pa_assert(quality <= PA_SINC_QUALITY_MAX);
+    pa_assert(in_rate > 0);
+    pa_assert(out_rate > 0);
+
+    g = pa_gcd(in_rate, out_rate);
+    l = out_rate / g;
+
+    params.quality = quality;
+
+    /* The cutoff, as 16.16 fixed point. Rounding down errs on the side
+     * of less aliasing. */
+    if (out_rate >= in_rate)
+        params.scale = 0x10000;
+    else
+        params.scale = PA_MAX((uint32_t) (((uint64_t) out_rate << 16) / in_rate), 1U);
+
+    params.n_taps = calc_taps(quality, params.scale);
+    params.interpolate = interpolate || l > MAX_PHASES || (size_t) (l + 1) * params.n_taps > MAX_COEFFS;
+
+    if (!params.interpolate) {
+        params.n_phases = l;
+
+        t = pa_resampler_table_get(PA_RESAMPLER_SINC_BASE + quality, in_rate / g, l, quality,
+                                   bank_new, bank_free, &params);
+    } else {
+        params.n_phases = INTERPOLATE_PHASES;
+
+        /* Odd ratios are mostly the result of drift compensation, which
+         * changes the rate in small steps all the time. Quantize the
+         * cutoff more coarsely for them so that the steps can share
+         * banks. Interpolated banks only depend on the cutoff, so that
+         * is all that goes into the key. */
+        if (params.scale < 0x10000) {
+            params.scale = PA_MAX(params.scale & ~0xFFU, 0x100U);
+            params.n_taps = calc_taps(quality, params.scale);
+        }
+
+        t = pa_resampler_table_get(PA_RESAMPLER_SINC_BASE + quality, 0, params.scale, quality,
+                                   bank_new, bank_free, &params);
+    }
+
+    return t->data;
+}
+
+void pa_sinc_bank_unref(pa_sinc_bank *b) {
+    pa_assert(b);
+
+    pa_resampler_table_unref(b->table);
+}
+
+static float sinc_dot_c(const float *a, const float *b, unsigned n) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    unsigned i;
+
+    for (i = 0; i < n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i+1] * b[i+1];
+        s2 += a[i+2] * b[i+2];
+        s3 += a[i+3] * b[i+3];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+static pa_sinc_dot_func_t sinc_dot_func = sinc_dot_c;
+
+pa_sinc_dot_func_t pa_get_sinc_dot_func(void) {
+    return sinc_dot_func;
+}
+
+void pa_set_sinc_dot_func(pa_sinc_dot_func_t func) {
+    pa_assert(func);
+
+    sinc_dot_func = func;
+}
@@ -0,0 +1,80 @@
+#ifndef foosinchfoo
+#define foosinchfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/resampler-cache.h>
+
+/* Filter banks of the polyphase windowed-sinc resampler. A bank only
+ * depends on the quality level and the rate ratio, so all resamplers
+ * converting between the same rates share one through the resampler
+ * cache. */
+
+#define PA_SINC_QUALITY_MAX 3
+
+/* The number of taps is always a multiple of this, so that the dot
+ * product kernels don't need to handle any tail */
+#define PA_SINC_TAPS_ALIGN 16
+
+typedef struct pa_sinc_bank pa_sinc_bank;
+
+struct pa_sinc_bank {
+    pa_resampler_table *table;
+
+    unsigned quality;
+    uint32_t scale;
+
+    /* Row p holds the coefficients for an output sample p/n_phases
+     * input samples after the (n_taps/2 - 1)th tap. There is one extra
+     * row for n_phases itself, to interpolate between phases. */
+    unsigned n_taps;
+    unsigned n_phases;
+    float *coeffs;
+
+    /* If TRUE the bank has fewer phases than the rate ratio needs and
+     * the coefficients have to be interpolated between two rows */
+    pa_bool_t interpolate;
+};
+
+/* Returns a reference to the bank for resampling from in_rate to
+ * out_rate after reducing them by their gcd, creating it if needed. If
+ * interpolate is TRUE the bank is always an interpolated one, which
+ * works for any ratio close to that of the rates. */
+pa_sinc_bank *pa_sinc_bank_get(unsigned quality, uint32_t in_rate, uint32_t out_rate, pa_bool_t interpolate);
+void pa_sinc_bank_unref(pa_sinc_bank *b);
+
+/* The most taps any bank of the quality can have, whatever the rates */
+unsigned pa_sinc_taps_max(unsigned quality);
+
+static inline const float *pa_sinc_bank_row(const pa_sinc_bank *b, unsigned phase) {
+    return b->coeffs + (size_t) phase * b->n_taps;
+}
+
+/* Returns the dot product of n floats, n being a multiple of
+ * PA_SINC_TAPS_ALIGN */
+typedef float (*pa_sinc_dot_func_t) (const float *a, const float *b, unsigned n);
+
+pa_sinc_dot_func_t pa_get_sinc_dot_func(void);
+void pa_set_sinc_dot_func(pa_sinc_dot_func_t func);
+
+#endif
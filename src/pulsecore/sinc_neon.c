@@ -0,0 +1,63 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-arm.h"
+
+#include "sinc.h"
+
+#if (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__)
+
+#include <arm_neon.h>
+
+/* See sinc_sse.c */
+static float sinc_dot_neon(const float *a, const float *b, unsigned n) {
+    float32x4_t s0 = vdupq_n_f32(0), s1 = vdupq_n_f32(0);
+    float32x2_t s;
+    unsigned i;
+
+    for (i = 0; i < n; i += 8) {
+        s0 = vmlaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+        s1 = vmlaq_f32(s1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+
+    s0 = vaddq_f32(s0, s1);
+    s = vadd_f32(vget_low_f32(s0), vget_high_f32(s0));
+    s = vpadd_f32(s, s);
+
+    return vget_lane_f32(s, 0);
+}
+
+#endif /* (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__) */
+
+void pa_sinc_func_init_neon(pa_cpu_arm_flag_t flags) {
+#if (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__)
+    if (flags & PA_CPU_ARM_NEON) {
+        pa_log_info("Initialising NEON optimized resampler functions.");
+
+        pa_set_sinc_dot_func(sinc_dot_neon);
+    }
+#endif /* (defined (__arm__) && defined (__ARM_NEON__)) || defined (__aarch64__) */
+}
@@ -0,0 +1,63 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-x86.h"
+
+#include "sinc.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+#include <emmintrin.h>
+
+/* Two independent accumulators hide the latency of the additions. The
+ * history is at an arbitrary offset, so all loads are unaligned. */
+static float sinc_dot_sse2(const float *a, const float *b, unsigned n) {
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    unsigned i;
+
+    for (i = 0; i < n; i += 8) {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+
+    s0 = _mm_add_ps(s0, s1);
+    s0 = _mm_add_ps(s0, _mm_movehl_ps(s0, s0));
+    s0 = _mm_add_ss(s0, _mm_shuffle_ps(s0, s0, 1));
+
+    return _mm_cvtss_f32(s0);
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_sinc_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+    if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized resampler functions.");
+
+        pa_set_sinc_dot_func(sinc_dot_sse2);
+    }
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
@@ -26,11 +26,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 
 #include <pulse/utf8.h>
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
 #include <pulse/internal.h>
+#include <pulse/timeval.h>
 
 #include <pulsecore/sample-util.h>
 #include <pulsecore/core-subscribe.h>
@@ -232,6 +234,65 @@ static void reset_callbacks(pa_sink_input *i) {
     i->mute_changed = NULL;
 }
 
+/* Called from IO context */
+static void resampler_wakeup(pa_sink_input *i) {
+    pa_assert(i);
+    pa_assert(i->thread_info.resampler_idle);
+
+    pa_atomic_dec(&i->core->n_idle_resamplers);
+    pa_atomic_sub(&i->core->idle_resampler_size, (int) i->thread_info.resampler_released_size);
+
+    i->thread_info.resampler_idle = FALSE;
+    i->thread_info.resampler_released_size = 0;
+}
+
+/* Called from IO context */
+static void release_resampler(pa_sink_input *i) {
+    size_t size;
+
+    pa_assert(i);
+    pa_assert(i->thread_info.resampler);
+    pa_assert(!i->thread_info.resampler_idle);
+
+    /* By now the history in the render queue is only silence, which
+     * takes no memory, so whatever it keeps is for future writes */
+    size = pa_resampler_release(i->thread_info.resampler);
+    size += pa_memblockq_trim(i->thread_info.render_memblockq);
+
+    i->thread_info.resampler_idle = TRUE;
+    i->thread_info.resampler_released_size = size;
+
+    pa_atomic_inc(&i->core->n_idle_resamplers);
+    pa_atomic_add(&i->core->idle_resampler_size, (int) size);
+    pa_atomic_inc(&i->core->n_idle_resampler_releases);
+
+    pa_log_debug("Sink input %u is idle, released %lu bytes of resampler buffers.", i->index, (unsigned long) size);
+}
+
+/* Called from main context, or from IO context for sink inputs that
+ * aren't attached */
+static void set_resampler(pa_sink_input *i, pa_resampler *r) {
+    pa_assert(i);
+
+    if (i->thread_info.resampler_idle)
+        resampler_wakeup(i);
+
+    if (i->thread_info.resampler)
+        pa_resampler_free(i->thread_info.resampler);
+
+    i->thread_info.resampler = r;
+    i->thread_info.resampler_idle_for = 0;
+
+    /* New resamplers are created with PA_RESAMPLER_LAZY */
+    if (r) {
+        /* Keep the drift compensation across moves and the like */
+        pa_resampler_set_rate_adjust(r, i->rate_adjust);
+
+        i->thread_info.resampler_idle = TRUE;
+        pa_atomic_inc(&i->core->n_idle_resamplers);
+    }
+}
+
 /* Called from main context */
 int pa_sink_input_new(
         pa_sink_input **_i,
@@ -413,7 +474,8 @@ int pa_sink_input_new(
                           ((data->flags & PA_SINK_INPUT_VARIABLE_RATE) ? PA_RESAMPLER_VARIABLE_RATE : 0) |
                           ((data->flags & PA_SINK_INPUT_NO_REMAP) ? PA_RESAMPLER_NO_REMAP : 0) |
                           (core->disable_remixing || (data->flags & PA_SINK_INPUT_NO_REMIX) ? PA_RESAMPLER_NO_REMIX : 0) |
-                          (core->disable_lfe_remixing ? PA_RESAMPLER_NO_LFE : 0)))) {
+                          (core->disable_lfe_remixing ? PA_RESAMPLER_NO_LFE : 0) |
+                          PA_RESAMPLER_LAZY))) {
                 pa_log_warn("Unsupported resampling operation.");
                 return -PA_ERR_NOTSUPPORTED;
             }
@@ -435,6 +497,7 @@ int pa_sink_input_new(
 
     i->requested_resample_method = data->resample_method;
     i->actual_resample_method = resampler ? pa_resampler_get_method(resampler) : PA_RESAMPLER_INVALID;
+    i->rate_adjust = 1.0;
     i->sample_spec = data->sample_spec;
     i->channel_map = data->channel_map;
     i->format = pa_format_info_copy(data->format);
@@ -481,7 +544,10 @@ int pa_sink_input_new(
     i->thread_info.attached = FALSE;
     pa_atomic_store(&i->thread_info.drained, 1);
     i->thread_info.sample_spec = i->sample_spec;
-    i->thread_info.resampler = resampler;
+    i->thread_info.resampler = NULL;
+    i->thread_info.resampler_idle = FALSE;
+    i->thread_info.resampler_released_size = 0;
+    set_resampler(i, resampler);
     i->thread_info.soft_volume = i->soft_volume;
     i->thread_info.muted = i->muted;
     i->thread_info.requested_sink_latency = (pa_usec_t) -1;
@@ -685,8 +751,7 @@ static void sink_input_free(pa_object *o) {
     if (i->thread_info.render_memblockq)
         pa_memblockq_free(i->thread_info.render_memblockq);
 
-    if (i->thread_info.resampler)
-        pa_resampler_free(i->thread_info.resampler);
+    set_resampler(i, NULL);
 
     if (i->format)
         pa_format_info_free(i->format);
@@ -844,6 +909,14 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
             i->thread_info.playing_for = 0;
             if (i->thread_info.underrun_for != (uint64_t) -1)
                 i->thread_info.underrun_for += ilength;
+
+            if (i->thread_info.resampler && !i->thread_info.resampler_idle && i->core->resampler_idle_time >= 0) {
+                i->thread_info.resampler_idle_for += slength;
+
+                if (i->thread_info.resampler_idle_for >= pa_usec_to_bytes((pa_usec_t) i->core->resampler_idle_time * PA_USEC_PER_SEC, &i->sink->sample_spec))
+                    release_resampler(i);
+            }
+
             break;
         }
 
@@ -854,6 +927,11 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
 
         i->thread_info.underrun_for = 0;
         i->thread_info.playing_for += tchunk.length;
+        i->thread_info.resampler_idle_for = 0;
+
+        /* pa_resampler_run() allocates the buffers again */
+        if (i->thread_info.resampler_idle)
+            resampler_wakeup(i);
 
         while (tchunk.length > 0) {
             pa_memchunk wchunk;
@@ -1334,6 +1412,28 @@ int pa_sink_input_set_rate(pa_sink_input *i, uint32_t rate) {
     return 0;
 }
 
+/* Called from main context */
+int pa_sink_input_set_rate_adjust(pa_sink_input *i, double factor) {
+    pa_sink_input_assert_ref(i);
+    pa_assert_ctl_context();
+    pa_assert(PA_SINK_INPUT_IS_LINKED(i->state));
+    pa_return_val_if_fail(factor > 0.5 && factor < 2.0, -PA_ERR_INVALID);
+
+    if (!(i->flags & PA_SINK_INPUT_VARIABLE_RATE) ||
+        !i->thread_info.resampler ||
+        !pa_resample_method_adaptive(i->actual_resample_method))
+        return -PA_ERR_NOTSUPPORTED;
+
+    /* Always forwarded, in case the resampler was replaced since */
+    i->rate_adjust = factor;
+
+    /* Passed in parts per billion, which is well below what any
+     * resampler can resolve */
+    pa_asyncmsgq_post(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_RATE_ADJUST, NULL, (int64_t) llrint((factor - 1.0) * 1e9), NULL, NULL);
+
+    return 0;
+}
+
 /* Called from main context */
 void pa_sink_input_set_name(pa_sink_input *i, const char *name) {
     const char *old;
@@ -1834,6 +1934,13 @@ int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t
 
             return 0;
 
+        case PA_SINK_INPUT_MESSAGE_SET_RATE_ADJUST:
+
+            if (i->thread_info.resampler)
+                pa_resampler_set_rate_adjust(i->thread_info.resampler, 1.0 + (double) offset / 1e9);
+
+            return 0;
+
         case PA_SINK_INPUT_MESSAGE_SET_STATE: {
             pa_sink_input *ssync;
 
@@ -2053,7 +2160,8 @@ int pa_sink_input_update_rate(pa_sink_input *i) {
                                      i->requested_resample_method,
                                      ((i->flags & PA_SINK_INPUT_VARIABLE_RATE) ? PA_RESAMPLER_VARIABLE_RATE : 0) |
                                      ((i->flags & PA_SINK_INPUT_NO_REMAP) ? PA_RESAMPLER_NO_REMAP : 0) |
-                                     (i->core->disable_remixing || (i->flags & PA_SINK_INPUT_NO_REMIX) ? PA_RESAMPLER_NO_REMIX : 0));
+                                     (i->core->disable_remixing || (i->flags & PA_SINK_INPUT_NO_REMIX) ? PA_RESAMPLER_NO_REMIX : 0) |
+                                     PA_RESAMPLER_LAZY);
 
         if (!new_resampler) {
             pa_log_warn("Unsupported resampling operation.");
@@ -2065,10 +2173,7 @@ int pa_sink_input_update_rate(pa_sink_input *i) {
     if (new_resampler == i->thread_info.resampler)
         return 0;
 
-    if (i->thread_info.resampler)
-        pa_resampler_free(i->thread_info.resampler);
-
-    i->thread_info.resampler = new_resampler;
+    set_resampler(i, new_resampler);
 
     pa_memblockq_free(i->thread_info.render_memblockq);
 
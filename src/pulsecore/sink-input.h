@@ -61,7 +61,10 @@ typedef enum pa_sink_input_flags {
     PA_SINK_INPUT_DONT_INHIBIT_AUTO_SUSPEND = 256,
     PA_SINK_INPUT_NO_CREATE_ON_SUSPEND = 512,
     PA_SINK_INPUT_KILL_ON_SUSPEND = 1024,
-    PA_SINK_INPUT_PASSTHROUGH = 2048
+    PA_SINK_INPUT_PASSTHROUGH = 2048,
+    /* pop() only touches state of this input and may hence be called
+     * from a render worker while other inputs are peeked */
+    PA_SINK_INPUT_PARALLEL_PEEK = 4096
 } pa_sink_input_flags_t;
 
 struct pa_sink_input {
@@ -117,6 +120,10 @@ struct pa_sink_input {
 
     pa_resample_method_t requested_resample_method, actual_resample_method;
 
+    /* The fractional correction to the input rate last set with
+     * pa_sink_input_set_rate_adjust(), 1.0 if none */
+    double rate_adjust;
+
     /* Returns the chunk of audio data and drops it from the
      * queue. Returns -1 on failure. Called from IO thread context. If
      * data needs to be generated from scratch then please in the
@@ -228,6 +235,13 @@ struct pa_sink_input {
 
         pa_resampler *resampler;                     /* may be NULL */
 
+        /* TRUE while the resampler has no state, see
+         * pa_resampler_release(). resampler_idle_for counts the
+         * silence in sink bytes since we last resampled anything. */
+        pa_bool_t resampler_idle:1;
+        size_t resampler_released_size;
+        uint64_t resampler_idle_for;
+
         /* We maintain a history of resampled audio data here. */
         pa_memblockq *render_memblockq;
 
@@ -250,6 +264,7 @@ enum {
     PA_SINK_INPUT_MESSAGE_SET_SOFT_MUTE,
     PA_SINK_INPUT_MESSAGE_GET_LATENCY,
     PA_SINK_INPUT_MESSAGE_SET_RATE,
+    PA_SINK_INPUT_MESSAGE_SET_RATE_ADJUST,
     PA_SINK_INPUT_MESSAGE_SET_STATE,
     PA_SINK_INPUT_MESSAGE_SET_REQUESTED_LATENCY,
     PA_SINK_INPUT_MESSAGE_GET_REQUESTED_LATENCY,
@@ -338,6 +353,13 @@ void pa_sink_input_request_rewind(pa_sink_input *i, size_t nbytes, pa_bool_t rew
 void pa_sink_input_cork(pa_sink_input *i, pa_bool_t b);
 
 int pa_sink_input_set_rate(pa_sink_input *i, uint32_t rate);
+
+/* Scale the input rate by a factor close to 1.0 without changing the
+ * nominal rate, for drift compensation. Only works for sink inputs
+ * created with PA_SINK_INPUT_VARIABLE_RATE whose resampler can follow a
+ * fractional ratio, returns -PA_ERR_NOTSUPPORTED otherwise, in which
+ * case pa_sink_input_set_rate() is the fallback. */
+int pa_sink_input_set_rate_adjust(pa_sink_input *i, double factor);
 int pa_sink_input_update_rate(pa_sink_input *i);
 
 /* This returns the sink's fields converted into out sample type */
@@ -47,10 +47,12 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/play-memblockq.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/thread-mq.h>
 
 #include "sink.h"
 
 #define MAX_MIX_CHANNELS 32
+#define RENDER_POOL_MIN_INPUTS 4
 #define MIX_BUFFER_LENGTH (PA_PAGE_SIZE)
 #define ABSOLUTE_MIN_LATENCY (500)
 #define ABSOLUTE_MAX_LATENCY (10*PA_USEC_PER_SEC)
@@ -250,6 +252,7 @@ pa_sink* pa_sink_new(
     s->priority = 0;
     s->suspend_cause = 0;
     pa_sink_set_mixer_dirty(s, FALSE);
+    pa_atomic_store(&s->volume_update_pending, 0);
     s->name = pa_xstrdup(name);
     s->proplist = pa_proplist_copy(data->proplist);
     s->driver = pa_xstrdup(pa_path_get_filename(data->driver));
@@ -345,6 +348,9 @@ pa_sink* pa_sink_new(
     s->thread_info.volume_change_safety_margin = core->deferred_volume_safety_margin_usec;
     s->thread_info.volume_change_extra_delay = core->deferred_volume_extra_delay_usec;
     s->thread_info.latency_offset = s->latency_offset;
+    s->thread_info.render_threads = core->render_threads;
+    s->thread_info.render_pool = NULL;
+    pa_cycle_profile_init(&s->thread_info.cycle_profile);
 
     /* FIXME: This should probably be moved to pa_sink_put() */
     pa_assert_se(pa_idxset_put(core->sinks, s, &s->index) >= 0);
@@ -638,6 +644,17 @@ void pa_sink_put(pa_sink* s) {
     s->thread_info.soft_muted = s->muted;
     pa_sw_cvolume_multiply(&s->thread_info.current_hw_volume, &s->soft_volume, &s->real_volume);
 
+    /* Spawn the workers here rather than in the IO thread, which
+     * shouldn't be kept from rendering by that */
+    if (s->thread_info.render_threads > 0) {
+        char *t;
+
+        t = pa_sprintf_malloc("render-%u", s->index);
+        s->thread_info.render_pool = pa_worker_pool_new(t, s->thread_info.render_threads,
+                                                        s->core->realtime_scheduling ? s->core->realtime_priority : 0);
+        pa_xfree(t);
+    }
+
     pa_assert((s->flags & PA_SINK_HW_VOLUME_CTRL)
               || (s->base_volume == PA_VOLUME_NORM
                   && ((s->flags & PA_SINK_DECIBEL_VOLUME || (s->flags & PA_SINK_SHARE_VOLUME_WITH_MASTER)))));
@@ -697,6 +714,12 @@ void pa_sink_unlink(pa_sink* s) {
     else
         s->state = PA_SINK_UNLINKED;
 
+    /* The IO thread won't render anymore */
+    if (s->thread_info.render_pool) {
+        pa_worker_pool_free(s->thread_info.render_pool);
+        s->thread_info.render_pool = NULL;
+    }
+
     reset_callbacks(s);
 
     if (s->monitor_source)
@@ -734,6 +757,9 @@ static void sink_free(pa_object *o) {
 
     pa_hashmap_free(s->thread_info.inputs, NULL, NULL);
 
+    if (s->thread_info.render_pool)
+        pa_worker_pool_free(s->thread_info.render_pool);
+
     if (s->silence.memblock)
         pa_memblock_unref(s->silence.memblock);
 
@@ -938,6 +964,8 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     if (s->thread_info.state == PA_SINK_SUSPENDED)
         return;
 
+    pa_cycle_profile_begin(&s->thread_info.cycle_profile);
+
     if (nbytes > 0) {
         pa_log_debug("Processing rewind...");
         if (s->flags & PA_SINK_DEFERRED_VOLUME)
@@ -953,6 +981,99 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
         if (s->monitor_source && PA_SOURCE_IS_LINKED(s->monitor_source->thread_info.state))
             pa_source_process_rewind(s->monitor_source, nbytes);
     }
+
+    pa_cycle_profile_end(&s->thread_info.cycle_profile, PA_CYCLE_STAGE_REWIND);
+}
+
+struct peek_jobs {
+    pa_mix_info *info;
+    unsigned slots[MAX_MIX_CHANNELS];
+    size_t length;
+};
+
+/* Called from a worker of the render pool or the IO thread */
+static void peek_job(void *userdata, unsigned job) {
+    struct peek_jobs *jobs = userdata;
+    pa_mix_info *m = jobs->info + jobs->slots[job];
+
+    pa_sink_input_peek(m->userdata, jobs->length, &m->chunk, &m->volume);
+}
+
+/* Called from IO thread context. Does exactly what fill_mix_info()
+ * does, but lets the render pool peek the inputs that allow it. Every
+ * input is peeked into its own slot and the slots are then evaluated
+ * in the same order as in the serial case, so the result is
+ * identical. */
+static unsigned fill_mix_info_parallel(pa_sink *s, size_t *length, pa_mix_info *info, unsigned maxinfo) {
+    pa_sink_input *i = NULL;
+    unsigned n = 0;
+    void *state = NULL;
+    size_t mixlength = *length;
+    struct peek_jobs jobs;
+
+    pa_assert(maxinfo <= MAX_MIX_CHANNELS);
+
+    jobs.length = *length;
+
+    /* Silent inputs don't count, hence we might need more than one
+     * round to fill up the array */
+    while (maxinfo > 0) {
+        pa_mix_info *base = info;
+        unsigned j, k = 0, n_jobs = 0;
+
+        while (k < maxinfo && (i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL))) {
+            pa_sink_input_assert_ref(i);
+
+            base[k].userdata = i;
+
+            /* Inputs whose pop() might touch anything shared are
+             * peeked right here */
+            if (i->flags & PA_SINK_INPUT_PARALLEL_PEEK)
+                jobs.slots[n_jobs++] = k;
+            else
+                pa_sink_input_peek(i, *length, &base[k].chunk, &base[k].volume);
+
+            k++;
+        }
+
+        if (k <= 0)
+            break;
+
+        jobs.info = base;
+        pa_worker_pool_run(s->thread_info.render_pool, peek_job, &jobs, n_jobs);
+
+        for (j = 0; j < k; j++) {
+            pa_mix_info *m = base + j;
+
+            if (mixlength == 0 || m->chunk.length < mixlength)
+                mixlength = m->chunk.length;
+
+            if (pa_memblock_is_silence(m->chunk.memblock)) {
+                pa_memblock_unref(m->chunk.memblock);
+                continue;
+            }
+
+            pa_assert(m->chunk.memblock);
+            pa_assert(m->chunk.length > 0);
+
+            if (m != info)
+                *info = *m;
+
+            info->userdata = pa_sink_input_ref(info->userdata);
+
+            info++;
+            n++;
+            maxinfo--;
+        }
+
+        if (!i)
+            break;
+    }
+
+    if (mixlength > 0)
+        *length = mixlength;
+
+    return n;
 }
 
 /* Called from IO thread context */
@@ -966,6 +1087,10 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
     pa_sink_assert_io_context(s);
     pa_assert(info);
 
+    if (s->thread_info.render_pool &&
+        pa_hashmap_size(s->thread_info.inputs) >= RENDER_POOL_MIN_INPUTS)
+        return fill_mix_info_parallel(s, length, info, maxinfo);
+
     while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL)) && maxinfo > 0) {
         pa_sink_input_assert_ref(i);
 
@@ -1115,6 +1240,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
     }
 
     pa_sink_ref(s);
+    pa_cycle_profile_begin(&s->thread_info.cycle_profile);
 
     if (length <= 0)
         length = pa_frame_align(MIX_BUFFER_LENGTH, &s->sample_spec);
@@ -1174,6 +1300,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     inputs_drop(s, info, n, result);
 
+    pa_cycle_profile_end(&s->thread_info.cycle_profile, PA_CYCLE_STAGE_RENDER);
     pa_sink_unref(s);
 }
 
@@ -1200,6 +1327,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
     }
 
     pa_sink_ref(s);
+    pa_cycle_profile_begin(&s->thread_info.cycle_profile);
 
     length = target->length;
     block_size_max = pa_mempool_block_size_max(s->core->mempool);
@@ -1259,6 +1387,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
     inputs_drop(s, info, n, target);
 
+    pa_cycle_profile_end(&s->thread_info.cycle_profile, PA_CYCLE_STAGE_RENDER);
     pa_sink_unref(s);
 }
 
@@ -1411,6 +1540,19 @@ pa_bool_t pa_sink_update_rate(pa_sink *s, uint32_t rate, pa_bool_t passthrough)
     return FALSE;
 }
 
+/* Called from main thread */
+void pa_sink_get_cycle_profile(pa_sink *s, pa_cycle_profile *p) {
+    pa_sink_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(PA_SINK_IS_LINKED(s->state));
+    pa_assert(p);
+
+    /* Implementations that don't pass unknown messages on have
+     * nothing to show */
+    if (pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_GET_CYCLE_PROFILE, p, 0, NULL) < 0)
+        pa_cycle_profile_init(p);
+}
+
 /* Called from main thread */
 pa_usec_t pa_sink_get_latency(pa_sink *s) {
     pa_usec_t usec = 0;
@@ -2114,7 +2256,7 @@ void pa_sink_update_volume_and_mute(pa_sink *s) {
     pa_assert(s);
     pa_sink_assert_io_context(s);
 
-    pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_UPDATE_VOLUME_AND_MUTE, NULL, 0, NULL, NULL);
+    pa_asyncmsgq_post_coalesced(pa_thread_mq_get()->outq, &s->volume_update_pending, PA_MSGOBJECT(s), PA_SINK_MESSAGE_UPDATE_VOLUME_AND_MUTE, 0);
 }
 
 /* Called from main thread */
@@ -2837,6 +2979,10 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             s->thread_info.latency_offset = offset;
             return 0;
 
+        case PA_SINK_MESSAGE_GET_CYCLE_PROFILE:
+            pa_cycle_profile_copy(userdata, &s->thread_info.cycle_profile);
+            return 0;
+
         case PA_SINK_MESSAGE_GET_LATENCY:
         case PA_SINK_MESSAGE_MAX:
             ;
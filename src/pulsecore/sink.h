@@ -40,9 +40,11 @@ typedef struct pa_sink_volume_change pa_sink_volume_change;
 #include <pulsecore/source.h>
 #include <pulsecore/module.h>
 #include <pulsecore/asyncmsgq.h>
+#include <pulsecore/cycle-profile.h>
 #include <pulsecore/msgobject.h>
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/device-port.h>
+#include <pulsecore/worker-pool.h>
 #include <pulsecore/card.h>
 #include <pulsecore/queue.h>
 #include <pulsecore/thread-mq.h>
@@ -113,6 +115,9 @@ struct pa_sink {
     pa_device_port *active_port;
     pa_atomic_t mixer_dirty;
 
+    /* Set while an UPDATE_VOLUME_AND_MUTE message is queued */
+    pa_atomic_t volume_update_pending;
+
     /* The latency offset is inherited from the currently active port */
     int64_t latency_offset;
 
@@ -288,6 +293,16 @@ struct pa_sink {
         uint32_t volume_change_safety_margin;
         /* Usec delay added to all volume change events, may be negative. */
         int32_t volume_change_extra_delay;
+
+        /* If render_threads > 0 the inputs flagged with
+         * PA_SINK_INPUT_PARALLEL_PEEK are peeked in parallel once
+         * there are enough inputs. The pool is created in
+         * pa_sink_put(). */
+        unsigned render_threads;
+        pa_worker_pool *render_pool;
+
+        /* Where the IO thread spent its time, per cycle */
+        pa_cycle_profile cycle_profile;
     } thread_info;
 
     void *userdata;
@@ -324,6 +339,7 @@ typedef enum pa_sink_message {
     PA_SINK_MESSAGE_SET_PORT,
     PA_SINK_MESSAGE_UPDATE_VOLUME_AND_MUTE,
     PA_SINK_MESSAGE_SET_LATENCY_OFFSET,
+    PA_SINK_MESSAGE_GET_CYCLE_PROFILE,
     PA_SINK_MESSAGE_MAX
 } pa_sink_message_t;
 
@@ -418,6 +434,9 @@ pa_usec_t pa_sink_get_requested_latency(pa_sink *s);
 void pa_sink_get_latency_range(pa_sink *s, pa_usec_t *min_latency, pa_usec_t *max_latency);
 pa_usec_t pa_sink_get_fixed_latency(pa_sink *s);
 
+/* Copies what the IO thread has profiled so far */
+void pa_sink_get_cycle_profile(pa_sink *s, pa_cycle_profile *p);
+
 size_t pa_sink_get_max_rewind(pa_sink *s);
 size_t pa_sink_get_max_request(pa_sink *s);
 
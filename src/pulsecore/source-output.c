@@ -381,7 +381,7 @@ int pa_source_output_new(
 
         if (!pa_source_output_new_data_is_passthrough(data)) /* no resampler for passthrough content */
             if (!(resampler = pa_resampler_new(
-                        core->mempool,
+                        data->mempool ? data->mempool : core->mempool,
                         &data->source->sample_spec, &data->source->channel_map,
                         &data->sample_spec, &data->channel_map,
                         data->resample_method,
@@ -410,6 +410,7 @@ int pa_source_output_new(
 
     o->requested_resample_method = data->resample_method;
     o->actual_resample_method = resampler ? pa_resampler_get_method(resampler) : PA_RESAMPLER_INVALID;
+    o->mempool = pa_mempool_ref(data->mempool ? data->mempool : core->mempool);
     o->sample_spec = data->sample_spec;
     o->channel_map = data->channel_map;
     o->format = pa_format_info_copy(data->format);
@@ -619,6 +620,10 @@ static void source_output_free(pa_object* mo) {
     if (o->proplist)
         pa_proplist_free(o->proplist);
 
+    /* Only after everything that might still hold blocks from it */
+    if (o->mempool)
+        pa_mempool_free(o->mempool);
+
     pa_xfree(o->driver);
     pa_xfree(o);
 }
@@ -758,7 +763,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
 
         /* It might be necessary to adjust the volume here */
         if (!volume_is_norm) {
-            pa_memchunk_make_writable(&qchunk, 0);
+            pa_memchunk_make_writable_pool(&qchunk, o->mempool, 0);
 
             if (o->thread_info.muted) {
                 pa_silence_memchunk(&qchunk, &o->source->sample_spec);
@@ -780,7 +785,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
 
         if (!o->thread_info.resampler) {
             if (nvfs) {
-                pa_memchunk_make_writable(&qchunk, 0);
+                pa_memchunk_make_writable_pool(&qchunk, o->mempool, 0);
                 pa_volume_memchunk(&qchunk, &o->thread_info.sample_spec, &o->volume_factor_source);
             }
 
@@ -798,7 +803,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
 
             if (rchunk.length > 0) {
                 if (nvfs) {
-                    pa_memchunk_make_writable(&rchunk, 0);
+                    pa_memchunk_make_writable_pool(&rchunk, o->mempool, 0);
                     pa_volume_memchunk(&rchunk, &o->thread_info.sample_spec, &o->volume_factor_source);
                 }
 
@@ -1639,7 +1644,7 @@ int pa_source_output_update_rate(pa_source_output *o) {
          !pa_sample_spec_equal(&o->sample_spec, &o->source->sample_spec) ||
          !pa_channel_map_equal(&o->channel_map, &o->source->channel_map))) {
 
-        new_resampler = pa_resampler_new(o->core->mempool,
+        new_resampler = pa_resampler_new(o->mempool,
                                      &o->source->sample_spec, &o->source->channel_map,
                                      &o->sample_spec, &o->channel_map,
                                      o->requested_resample_method,
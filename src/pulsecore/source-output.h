@@ -108,6 +108,11 @@ struct pa_source_output {
 
     pa_resample_method_t requested_resample_method, actual_resample_method;
 
+    /* The pool data that is converted for this output is allocated
+     * from. Usually the core's, but a client may have one of its own
+     * that we can then hand out blocks from without copying them. */
+    pa_mempool *mempool;
+
     /* Pushes a new memchunk into the output. Called from IO thread
      * context. */
     void (*push)(pa_source_output *o, const pa_memchunk *chunk); /* may NOT be NULL */
@@ -250,6 +255,8 @@ typedef struct pa_source_output_new_data {
 
     pa_resample_method_t resample_method;
 
+    pa_mempool *mempool; /* may be NULL, then the core's pool is used */
+
     pa_sample_spec sample_spec;
     pa_channel_map channel_map;
     pa_format_info *format;
@@ -237,6 +237,7 @@ pa_source* pa_source_new(
     s->priority = 0;
     s->suspend_cause = 0;
     pa_source_set_mixer_dirty(s, FALSE);
+    pa_atomic_store(&s->volume_update_pending, 0);
     s->name = pa_xstrdup(name);
     s->proplist = pa_proplist_copy(data->proplist);
     s->driver = pa_xstrdup(pa_path_get_filename(data->driver));
@@ -330,6 +331,7 @@ pa_source* pa_source_new(
     s->thread_info.volume_change_safety_margin = core->deferred_volume_safety_margin_usec;
     s->thread_info.volume_change_extra_delay = core->deferred_volume_extra_delay_usec;
     s->thread_info.latency_offset = s->latency_offset;
+    pa_cycle_profile_init(&s->thread_info.cycle_profile);
 
     /* FIXME: This should probably be moved to pa_source_put() */
     pa_assert_se(pa_idxset_put(core->sources, s, &s->index) >= 0);
@@ -868,12 +870,16 @@ void pa_source_process_rewind(pa_source *s, size_t nbytes) {
     if (s->thread_info.state == PA_SOURCE_SUSPENDED)
         return;
 
+    pa_cycle_profile_begin(&s->thread_info.cycle_profile);
+
     pa_log_debug("Processing rewind...");
 
     PA_HASHMAP_FOREACH(o, s->thread_info.outputs, state) {
         pa_source_output_assert_ref(o);
         pa_source_output_process_rewind(o, nbytes);
     }
+
+    pa_cycle_profile_end(&s->thread_info.cycle_profile, PA_CYCLE_STAGE_REWIND);
 }
 
 /* Called from IO thread context */
@@ -889,6 +895,8 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
     if (s->thread_info.state == PA_SOURCE_SUSPENDED)
         return;
 
+    pa_cycle_profile_begin(&s->thread_info.cycle_profile);
+
     if (s->thread_info.soft_muted || !pa_cvolume_is_norm(&s->thread_info.soft_volume)) {
         pa_memchunk vchunk = *chunk;
 
@@ -917,6 +925,8 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
                 pa_source_output_push(o, chunk);
         }
     }
+
+    pa_cycle_profile_end(&s->thread_info.cycle_profile, PA_CYCLE_STAGE_RENDER);
 }
 
 /* Called from IO thread context */
@@ -931,6 +941,8 @@ void pa_source_post_direct(pa_source*s, pa_source_output *o, const pa_memchunk *
     if (s->thread_info.state == PA_SOURCE_SUSPENDED)
         return;
 
+    pa_cycle_profile_begin(&s->thread_info.cycle_profile);
+
     if (s->thread_info.soft_muted || !pa_cvolume_is_norm(&s->thread_info.soft_volume)) {
         pa_memchunk vchunk = *chunk;
 
@@ -947,6 +959,8 @@ void pa_source_post_direct(pa_source*s, pa_source_output *o, const pa_memchunk *
         pa_memblock_unref(vchunk.memblock);
     } else
         pa_source_output_push(o, chunk);
+
+    pa_cycle_profile_end(&s->thread_info.cycle_profile, PA_CYCLE_STAGE_RENDER);
 }
 
 /* Called from main thread */
@@ -1015,6 +1029,19 @@ pa_bool_t pa_source_update_rate(pa_source *s, uint32_t rate, pa_bool_t passthrou
     return FALSE;
 }
 
+/* Called from main thread */
+void pa_source_get_cycle_profile(pa_source *s, pa_cycle_profile *p) {
+    pa_source_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(PA_SOURCE_IS_LINKED(s->state));
+    pa_assert(p);
+
+    /* Implementations that don't pass unknown messages on have
+     * nothing to show */
+    if (pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_GET_CYCLE_PROFILE, p, 0, NULL) < 0)
+        pa_cycle_profile_init(p);
+}
+
 /* Called from main thread */
 pa_usec_t pa_source_get_latency(pa_source *s) {
     pa_usec_t usec;
@@ -1699,7 +1726,7 @@ void pa_source_update_volume_and_mute(pa_source *s) {
     pa_assert(s);
     pa_source_assert_io_context(s);
 
-    pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_UPDATE_VOLUME_AND_MUTE, NULL, 0, NULL, NULL);
+    pa_asyncmsgq_post_coalesced(pa_thread_mq_get()->outq, &s->volume_update_pending, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_UPDATE_VOLUME_AND_MUTE, 0);
 }
 
 /* Called from main thread */
@@ -2193,6 +2220,10 @@ int pa_source_process_msg(pa_msgobject *object, int code, void *userdata, int64_
             s->thread_info.latency_offset = offset;
             return 0;
 
+        case PA_SOURCE_MESSAGE_GET_CYCLE_PROFILE:
+            pa_cycle_profile_copy(userdata, &s->thread_info.cycle_profile);
+            return 0;
+
         case PA_SOURCE_MESSAGE_MAX:
             ;
     }
@@ -40,6 +40,7 @@ typedef struct pa_source_volume_change pa_source_volume_change;
 #include <pulsecore/sink.h>
 #include <pulsecore/module.h>
 #include <pulsecore/asyncmsgq.h>
+#include <pulsecore/cycle-profile.h>
 #include <pulsecore/msgobject.h>
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/card.h>
@@ -113,6 +114,9 @@ struct pa_source {
     pa_device_port *active_port;
     pa_atomic_t mixer_dirty;
 
+    /* Set while an UPDATE_VOLUME_AND_MUTE message is queued */
+    pa_atomic_t volume_update_pending;
+
     /* The latency offset is inherited from the currently active port */
     int64_t latency_offset;
 
@@ -229,6 +233,9 @@ struct pa_source {
         uint32_t volume_change_safety_margin;
         /* Usec delay added to all volume change events, may be negative. */
         int32_t volume_change_extra_delay;
+
+        /* Where the IO thread spent its time, per cycle */
+        pa_cycle_profile cycle_profile;
 } thread_info;
 
     void *userdata;
@@ -261,6 +268,7 @@ typedef enum pa_source_message {
     PA_SOURCE_MESSAGE_SET_PORT,
     PA_SOURCE_MESSAGE_UPDATE_VOLUME_AND_MUTE,
     PA_SOURCE_MESSAGE_SET_LATENCY_OFFSET,
+    PA_SOURCE_MESSAGE_GET_CYCLE_PROFILE,
     PA_SOURCE_MESSAGE_MAX
 } pa_source_message_t;
 
@@ -350,6 +358,9 @@ pa_usec_t pa_source_get_requested_latency(pa_source *s);
 void pa_source_get_latency_range(pa_source *s, pa_usec_t *min_latency, pa_usec_t *max_latency);
 pa_usec_t pa_source_get_fixed_latency(pa_source *s);
 
+/* Copies what the IO thread has profiled so far */
+void pa_source_get_cycle_profile(pa_source *s, pa_cycle_profile *p);
+
 size_t pa_source_get_max_rewind(pa_source *s);
 
 int pa_source_update_status(pa_source*s);
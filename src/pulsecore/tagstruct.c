@@ -37,6 +37,7 @@
 
 #include <pulsecore/socket.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/flist.h>
 
 #include "tagstruct.h"
 
@@ -50,14 +51,30 @@ struct pa_tagstruct {
     pa_bool_t dynamic;
 };
 
+/* Freed tagstructs, and the buffers of the ones written to unless they
+ * had to grow, are recycled. Replies are built and freed one after
+ * another, so they rarely need an allocation. */
+PA_STATIC_FLIST_DECLARE(tagstructs, 0, pa_xfree);
+PA_STATIC_FLIST_DECLARE(buffers, 32, pa_xfree);
+
 pa_tagstruct *pa_tagstruct_new(const uint8_t* data, size_t length) {
     pa_tagstruct*t;
 
     pa_assert(!data || (data && length));
 
-    t = pa_xnew(pa_tagstruct, 1);
-    t->data = (uint8_t*) data;
-    t->allocated = t->length = data ? length : 0;
+    if (!(t = pa_flist_pop(PA_STATIC_FLIST_GET(tagstructs))))
+        t = pa_xnew(pa_tagstruct, 1);
+
+    if (data) {
+        t->data = (uint8_t*) data;
+        t->allocated = t->length = length;
+    } else {
+        if (!(t->data = pa_flist_pop(PA_STATIC_FLIST_GET(buffers))))
+            t->data = pa_xmalloc(PA_TAGSTRUCT_BUFFER_SIZE);
+        t->allocated = PA_TAGSTRUCT_BUFFER_SIZE;
+        t->length = 0;
+    }
+
     t->rindex = 0;
     t->dynamic = !data;
 
@@ -68,8 +85,12 @@ void pa_tagstruct_free(pa_tagstruct*t) {
     pa_assert(t);
 
     if (t->dynamic)
-        pa_xfree(t->data);
-    pa_xfree(t);
+        if (t->allocated != PA_TAGSTRUCT_BUFFER_SIZE ||
+            pa_flist_push(PA_STATIC_FLIST_GET(buffers), t->data) < 0)
+            pa_xfree(t->data);
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(tagstructs), t) < 0)
+        pa_xfree(t);
 }
 
 uint8_t* pa_tagstruct_free_data(pa_tagstruct*t, size_t *l) {
@@ -81,7 +102,10 @@ uint8_t* pa_tagstruct_free_data(pa_tagstruct*t, size_t *l) {
 
     p = t->data;
     *l = t->length;
-    pa_xfree(t);
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(tagstructs), t) < 0)
+        pa_xfree(t);
+
     return p;
 }
 
@@ -92,7 +116,10 @@ static void extend(pa_tagstruct*t, size_t l) {
     if (t->length+l <= t->allocated)
         return;
 
-    t->data = pa_xrealloc(t->data, t->allocated = t->length+l+100);
+    /* Grow exponentially, so that large replies don't need a
+     * reallocation for every few entries */
+    t->allocated = PA_MAX(t->length+l, t->allocated*2);
+    t->data = pa_xrealloc(t->data, t->allocated);
 }
 
 void pa_tagstruct_puts(pa_tagstruct*t, const char *s) {
@@ -267,6 +294,9 @@ void pa_tagstruct_put_volume(pa_tagstruct *t, pa_volume_t vol) {
     t->length += 5;
 }
 
+/* How many properties pa_tagstruct_put_proplist() looks up at once */
+#define PROPLIST_BATCH 32
+
 void pa_tagstruct_put_proplist(pa_tagstruct *t, pa_proplist *p) {
     void *state = NULL;
     pa_assert(t);
@@ -277,17 +307,56 @@ void pa_tagstruct_put_proplist(pa_tagstruct *t, pa_proplist *p) {
     t->data[t->length++] = PA_TAG_PROPLIST;
 
     for (;;) {
-        const char *k;
-        const void *d;
-        size_t l;
+        struct {
+            const char *key;
+            const void *data;
+            size_t nbytes;
+        } e[PROPLIST_BATCH];
+        unsigned i, n = 0;
+        size_t size = 1;
+
+        /* Look up a batch of properties first, so that we can make
+         * room for all of them (and the terminator) at once */
+        while (n < PROPLIST_BATCH && (e[n].key = pa_proplist_iterate(p, &state))) {
+            pa_assert_se(pa_proplist_get(p, e[n].key, &e[n].data, &e[n].nbytes) >= 0);
+            size += strlen(e[n].key) + 2 + 5 + 5 + e[n].nbytes;
+            n++;
+        }
+
+        extend(t, size);
+
+        for (i = 0; i < n; i++) {
+            pa_tagstruct_puts(t, e[i].key);
+            pa_tagstruct_putu32(t, (uint32_t) e[i].nbytes);
+            pa_tagstruct_put_arbitrary(t, e[i].data, e[i].nbytes);
+        }
 
-        if (!(k = pa_proplist_iterate(p, &state)))
+        if (n < PROPLIST_BATCH)
             break;
+    }
+
+    pa_tagstruct_puts(t, NULL);
+}
+
+void pa_tagstruct_put_proplist_keys(pa_tagstruct *t, pa_proplist *p, const char * const keys[]) {
+    pa_assert(t);
+    pa_assert(p);
+    pa_assert(keys);
+
+    extend(t, 1);
+
+    t->data[t->length++] = PA_TAG_PROPLIST;
+
+    for (; *keys; keys++) {
+        const void *data;
+        size_t nbytes;
+
+        if (pa_proplist_get(p, *keys, &data, &nbytes) < 0)
+            continue;
 
-        pa_tagstruct_puts(t, k);
-        pa_assert_se(pa_proplist_get(p, k, &d, &l) >= 0);
-        pa_tagstruct_putu32(t, (uint32_t) l);
-        pa_tagstruct_put_arbitrary(t, d, l);
+        pa_tagstruct_puts(t, *keys);
+        pa_tagstruct_putu32(t, (uint32_t) nbytes);
+        pa_tagstruct_put_arbitrary(t, data, nbytes);
     }
 
     pa_tagstruct_puts(t, NULL);
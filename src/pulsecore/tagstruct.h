@@ -62,6 +62,10 @@ enum {
     PA_TAG_FORMAT_INFO = 'f',
 };
 
+/* Tagstructs for writing start out with a buffer of this size, which
+ * is recycled on pa_tagstruct_free() unless it had to grow */
+#define PA_TAGSTRUCT_BUFFER_SIZE (4*1024)
+
 pa_tagstruct *pa_tagstruct_new(const uint8_t* data, size_t length);
 void pa_tagstruct_free(pa_tagstruct*t);
 uint8_t* pa_tagstruct_free_data(pa_tagstruct*t, size_t *l);
@@ -84,6 +88,9 @@ void pa_tagstruct_put_usec(pa_tagstruct*t, pa_usec_t u);
 void pa_tagstruct_put_channel_map(pa_tagstruct *t, const pa_channel_map *map);
 void pa_tagstruct_put_cvolume(pa_tagstruct *t, const pa_cvolume *cvolume);
 void pa_tagstruct_put_proplist(pa_tagstruct *t, pa_proplist *p);
+/* Like pa_tagstruct_put_proplist(), but only with the properties
+ * listed in the NULL terminated keys array */
+void pa_tagstruct_put_proplist_keys(pa_tagstruct *t, pa_proplist *p, const char * const keys[]);
 void pa_tagstruct_put_volume(pa_tagstruct *t, pa_volume_t volume);
 void pa_tagstruct_put_format_info(pa_tagstruct *t, pa_format_info *f);
 
@@ -0,0 +1,213 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/thread.h>
+
+#include "worker-pool.h"
+
+struct pa_worker_pool {
+    pa_thread **threads;
+    unsigned n_threads;
+
+    int rtprio;
+
+    pa_mutex *mutex;
+    pa_cond *work_cond, *done_cond;
+
+    /* Protected by the mutex. A new generation is started for every
+     * call to pa_worker_pool_run(), n_active counts the workers
+     * currently looking for jobs. */
+    unsigned generation, n_active;
+    pa_bool_t stop;
+
+    pa_worker_pool_job_cb_t cb;
+    void *userdata;
+    unsigned n_jobs;
+
+    /* The thread_mq of the thread calling pa_worker_pool_run() */
+    pa_thread_mq *thread_mq;
+
+    pa_atomic_t next_job;
+};
+
+static void run_jobs(pa_worker_pool *p) {
+    int j;
+
+    while ((j = pa_atomic_inc(&p->next_job)) < (int) p->n_jobs)
+        p->cb(p->userdata, (unsigned) j);
+}
+
+static void thread_func(void *userdata) {
+    pa_worker_pool *p = userdata;
+    unsigned generation = 0;
+    pa_bool_t mq_installed = FALSE;
+
+    if (p->rtprio > 0)
+        pa_make_realtime(p->rtprio);
+
+    pa_mutex_lock(p->mutex);
+
+    for (;;) {
+        while (!p->stop && p->generation == generation)
+            pa_cond_wait(p->work_cond, p->mutex);
+
+        if (p->stop)
+            break;
+
+        generation = p->generation;
+        p->n_active++;
+
+        /* We learn about the thread_mq only now, since the pool is
+         * created before the thread that uses it is running */
+        if (!mq_installed && p->thread_mq) {
+            pa_thread_mq_install(p->thread_mq);
+            mq_installed = TRUE;
+        }
+
+        pa_mutex_unlock(p->mutex);
+
+        run_jobs(p);
+
+        pa_mutex_lock(p->mutex);
+        if (--p->n_active <= 0)
+            pa_cond_signal(p->done_cond, 0);
+    }
+
+    pa_mutex_unlock(p->mutex);
+}
+
+pa_worker_pool* pa_worker_pool_new(const char *name, unsigned n_threads, int rtprio) {
+    pa_worker_pool *p;
+    unsigned i;
+
+    pa_assert(name);
+    pa_assert(n_threads > 0);
+
+    p = pa_xnew0(pa_worker_pool, 1);
+    p->rtprio = rtprio;
+    p->mutex = pa_mutex_new(FALSE, TRUE);
+    p->work_cond = pa_cond_new();
+    p->done_cond = pa_cond_new();
+    pa_atomic_store(&p->next_job, 0);
+
+    p->threads = pa_xnew0(pa_thread*, n_threads);
+
+    for (i = 0; i < n_threads; i++) {
+        char *t;
+
+        t = pa_sprintf_malloc("%s-%u", name, i);
+        p->threads[p->n_threads] = pa_thread_new(t, thread_func, p);
+        pa_xfree(t);
+
+        if (!p->threads[p->n_threads]) {
+            pa_log_warn("Failed to create worker thread, continuing with %u.", p->n_threads);
+            break;
+        }
+
+        p->n_threads++;
+    }
+
+    pa_log_debug("Started %u workers for %s.", p->n_threads, name);
+
+    return p;
+}
+
+void pa_worker_pool_free(pa_worker_pool *p) {
+    unsigned i;
+
+    pa_assert(p);
+
+    pa_mutex_lock(p->mutex);
+    p->stop = TRUE;
+    pa_cond_signal(p->work_cond, 1);
+    pa_mutex_unlock(p->mutex);
+
+    for (i = 0; i < p->n_threads; i++)
+        pa_thread_free(p->threads[i]);
+
+    pa_xfree(p->threads);
+
+    pa_cond_free(p->work_cond);
+    pa_cond_free(p->done_cond);
+    pa_mutex_free(p->mutex);
+
+    pa_xfree(p);
+}
+
+unsigned pa_worker_pool_get_n_threads(pa_worker_pool *p) {
+    pa_assert(p);
+
+    return p->n_threads;
+}
+
+void pa_worker_pool_run(pa_worker_pool *p, pa_worker_pool_job_cb_t cb, void *userdata, unsigned n_jobs) {
+    pa_assert(p);
+    pa_assert(cb);
+
+    if (n_jobs <= 0)
+        return;
+
+    /* Not worth waking anybody up */
+    if (n_jobs == 1 || p->n_threads <= 0) {
+        unsigned j;
+
+        for (j = 0; j < n_jobs; j++)
+            cb(userdata, j);
+
+        return;
+    }
+
+    pa_mutex_lock(p->mutex);
+
+    /* A worker that woke up too late for the previous run might still
+     * be looking at its (empty) job counter */
+    while (p->n_active > 0)
+        pa_cond_wait(p->done_cond, p->mutex);
+
+    p->cb = cb;
+    p->userdata = userdata;
+    p->n_jobs = n_jobs;
+    p->thread_mq = pa_thread_mq_get();
+    pa_atomic_store(&p->next_job, 0);
+
+    p->generation++;
+    pa_cond_signal(p->work_cond, 1);
+    pa_mutex_unlock(p->mutex);
+
+    /* Do our share of the work */
+    run_jobs(p);
+
+    /* The jobs are all taken now, but some of them might still be
+     * running in the workers */
+    pa_mutex_lock(p->mutex);
+    while (p->n_active > 0)
+        pa_cond_wait(p->done_cond, p->mutex);
+    pa_mutex_unlock(p->mutex);
+}
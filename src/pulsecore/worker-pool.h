@@ -0,0 +1,50 @@
+#ifndef foopulseworkerpoolhfoo
+#define foopulseworkerpoolhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulsecore/thread-mq.h>
+
+/* A fixed set of threads that help an IO thread with work that can
+ * be split into independent jobs. pa_worker_pool_run() hands out the
+ * jobs to the workers and the calling thread alike and returns once
+ * all of them are done, so the caller doesn't need to synchronize
+ * anything itself. Which thread runs which job is not defined, hence
+ * jobs should write their results to per job storage and leave the
+ * combining of them to the caller. */
+
+typedef struct pa_worker_pool pa_worker_pool;
+
+typedef void (*pa_worker_pool_job_cb_t)(void *userdata, unsigned job);
+
+/* The pool may be created from any thread. The workers install the
+ * thread_mq of the thread calling pa_worker_pool_run() (if it has
+ * one) as their own, so that jobs can use pa_thread_mq_get() just
+ * like code running in that thread. A pool must hence always be run
+ * from the same thread. If rtprio is > 0 the workers are made
+ * realtime. */
+pa_worker_pool* pa_worker_pool_new(const char *name, unsigned n_threads, int rtprio);
+void pa_worker_pool_free(pa_worker_pool *p);
+
+unsigned pa_worker_pool_get_n_threads(pa_worker_pool *p);
+
+void pa_worker_pool_run(pa_worker_pool *p, pa_worker_pool_job_cb_t cb, void *userdata, unsigned n_jobs);
+
+#endif
@@ -23,10 +23,13 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <check.h>
 
+#include <pulse/rtclock.h>
+
 #include <pulsecore/asyncmsgq.h>
 #include <pulsecore/thread.h>
 #include <pulsecore/log.h>
@@ -107,6 +110,174 @@ START_TEST (asyncmsgq_test) {
 }
 END_TEST
 
+#define N_WRITERS 8
+#define N_MESSAGES 20000
+
+struct writer {
+    pa_asyncmsgq *q;
+    unsigned id;
+    unsigned n;
+};
+
+struct reader {
+    pa_asyncmsgq *q;
+    unsigned next[N_WRITERS];
+    unsigned n_received;
+    unsigned n_sent;
+};
+
+static void writer_thread(void *userdata) {
+    struct writer *w = userdata;
+    unsigned i;
+
+    for (i = 0; i < w->n; i++) {
+        void *data = PA_UINT_TO_PTR(w->id << 24 | i);
+
+        /* Mix in a few synchronous ones, which share the same path */
+        if (i % 1000 == 999)
+            pa_assert_se(pa_asyncmsgq_send(w->q, NULL, OPERATION_B, data, 0, NULL) == 1);
+        else
+            pa_asyncmsgq_post(w->q, NULL, OPERATION_A, data, 0, NULL, NULL);
+    }
+}
+
+static void reader_thread(void *userdata) {
+    struct reader *r = userdata;
+    int code;
+
+    do {
+        void *data;
+        unsigned id, i;
+
+        pa_assert_se(pa_asyncmsgq_get(r->q, NULL, &code, &data, NULL, NULL, TRUE) == 0);
+
+        if (code != QUIT) {
+            id = PA_PTR_TO_UINT(data) >> 24;
+            i = PA_PTR_TO_UINT(data) & 0xFFFFFF;
+
+            /* Messages of each writer must arrive in order */
+            pa_assert_se(id < N_WRITERS);
+            pa_assert_se(r->next[id] == i);
+            r->next[id]++;
+            r->n_received++;
+
+            if (code == OPERATION_B)
+                r->n_sent++;
+        }
+
+        pa_asyncmsgq_done(r->q, code == OPERATION_B ? 1 : 0);
+    } while (code != QUIT);
+}
+
+/* Returns the time it took until the reader got all messages */
+static pa_usec_t run_writers(unsigned size, unsigned n_writers, unsigned n) {
+    struct writer w[N_WRITERS];
+    pa_thread *wt[N_WRITERS], *rt;
+    struct reader r;
+    pa_usec_t start;
+    unsigned i;
+
+    pa_assert(n_writers <= N_WRITERS);
+
+    memset(&r, 0, sizeof(r));
+    r.q = pa_asyncmsgq_new(size);
+    fail_unless(r.q != NULL);
+
+    start = pa_rtclock_now();
+
+    rt = pa_thread_new("reader", reader_thread, &r);
+    fail_unless(rt != NULL);
+
+    for (i = 0; i < n_writers; i++) {
+        w[i].q = r.q;
+        w[i].id = i;
+        w[i].n = n;
+        wt[i] = pa_thread_new("writer", writer_thread, &w[i]);
+        fail_unless(wt[i] != NULL);
+    }
+
+    for (i = 0; i < n_writers; i++)
+        pa_thread_free(wt[i]);
+
+    pa_asyncmsgq_post(r.q, NULL, QUIT, NULL, 0, NULL, NULL);
+    pa_thread_free(rt);
+
+    start = pa_rtclock_now() - start;
+
+    fail_unless(r.n_received == n_writers * n);
+    fail_unless(r.n_sent == n_writers * (n / 1000));
+    for (i = 0; i < n_writers; i++)
+        fail_unless(r.next[i] == n);
+
+    pa_asyncmsgq_unref(r.q);
+
+    return start;
+}
+
+START_TEST (asyncmsgq_writers_test) {
+    /* A tiny ring overruns all the time, so this mostly exercises
+     * the overflow list */
+    run_writers(8, N_WRITERS, N_MESSAGES);
+    run_writers(0, N_WRITERS, N_MESSAGES);
+}
+END_TEST
+
+START_TEST (asyncmsgq_coalesce_test) {
+    pa_asyncmsgq *q;
+    pa_atomic_t pending = PA_ATOMIC_INIT(0);
+    int code;
+    unsigned i;
+
+    q = pa_asyncmsgq_new(0);
+    fail_unless(q != NULL);
+
+    for (i = 0; i < 10; i++) {
+        pa_asyncmsgq_post_coalesced(q, &pending, NULL, OPERATION_A, 0);
+        pa_asyncmsgq_post(q, NULL, OPERATION_B, NULL, 0, NULL, NULL);
+    }
+
+    /* Only the first one got queued */
+    fail_unless(pa_asyncmsgq_get(q, NULL, &code, NULL, NULL, NULL, FALSE) == 0);
+    fail_unless(code == OPERATION_A);
+    fail_unless(pa_atomic_load(&pending) == 0);
+    pa_asyncmsgq_done(q, 0);
+
+    /* Posting again once it has been taken off the queue works */
+    pa_asyncmsgq_post_coalesced(q, &pending, NULL, OPERATION_C, 0);
+
+    for (i = 0; i < 10; i++) {
+        fail_unless(pa_asyncmsgq_get(q, NULL, &code, NULL, NULL, NULL, FALSE) == 0);
+        fail_unless(code == OPERATION_B);
+        pa_asyncmsgq_done(q, 0);
+    }
+
+    fail_unless(pa_asyncmsgq_get(q, NULL, &code, NULL, NULL, NULL, FALSE) == 0);
+    fail_unless(code == OPERATION_C);
+    pa_asyncmsgq_done(q, 0);
+
+    fail_unless(pa_asyncmsgq_get(q, NULL, &code, NULL, NULL, NULL, FALSE) < 0);
+
+    pa_asyncmsgq_unref(q);
+}
+END_TEST
+
+START_TEST (asyncmsgq_benchmark) {
+    unsigned n;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    for (n = 1; n <= N_WRITERS; n *= 2) {
+        pa_usec_t t;
+
+        t = run_writers(0, n, N_MESSAGES * 5);
+        pa_log_debug("%u writers, %u messages: %llu usec, %llu nsec/message",
+                     n, n * N_MESSAGES * 5, (unsigned long long) t,
+                     (unsigned long long) (t * 1000 / (n * N_MESSAGES * 5)));
+    }
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -116,6 +287,10 @@ int main(int argc, char *argv[]) {
     s = suite_create("Async Message Queue");
     tc = tcase_create("asyncmsgq");
     tcase_add_test(tc, asyncmsgq_test);
+    tcase_add_test(tc, asyncmsgq_writers_test);
+    tcase_add_test(tc, asyncmsgq_coalesce_test);
+    tcase_add_test(tc, asyncmsgq_benchmark);
+    tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
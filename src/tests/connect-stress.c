@@ -33,6 +33,7 @@
 
 #include <pulse/pulseaudio.h>
 #include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
 
 #include <pulsecore/sink.h>
 
@@ -207,6 +208,103 @@ START_TEST (connect_stress_test) {
 }
 END_TEST
 
+/* The daemon accepts at most 64 native connections */
+#define NCLIENTS_MAX 60
+#define NITERATIONS 1000
+#define NROUNDTRIPS 100
+
+static void scaling_state_callback(pa_context *c, void *userdata) {
+    unsigned *n_ready = userdata;
+
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_READY:
+            (*n_ready)++;
+            break;
+
+        case PA_CONTEXT_FAILED:
+            fprintf(stderr, "Context error: %s\n", pa_strerror(pa_context_errno(c)));
+            fail();
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void server_info_callback(pa_context *c, const pa_server_info *i, void *userdata) {
+    fail_unless(i != NULL);
+}
+
+/* Measures how the cost of a main loop iteration grows with the number
+ * of connected clients: on our side with one pa_mainloop serving all
+ * contexts, and on the daemon side as the round trip time of a trivial
+ * request while the other clients are connected. Run with PULSE_NO_EPOLL
+ * set, for both the client and the daemon, to compare with poll(). Run
+ * only this case with CK_RUN_CASE=connectscaling. */
+static void run_scaling(unsigned n) {
+    pa_mainloop *m;
+    pa_mainloop_api *api;
+    pa_context *contexts[NCLIENTS_MAX];
+    pa_usec_t start, t_iterate, t_roundtrip;
+    unsigned i, n_ready = 0;
+
+    fail_unless(n <= NCLIENTS_MAX);
+
+    m = pa_mainloop_new();
+    fail_unless(m != NULL);
+    api = pa_mainloop_get_api(m);
+
+    for (i = 0; i < n; i++) {
+        contexts[i] = pa_context_new(api, bname);
+        fail_unless(contexts[i] != NULL);
+
+        pa_context_set_state_callback(contexts[i], scaling_state_callback, &n_ready);
+        fail_unless(pa_context_connect(contexts[i], NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) >= 0);
+    }
+
+    while (n_ready < n)
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) >= 0);
+
+    /* Nothing is pending, so this is pure overhead */
+    start = pa_rtclock_now();
+    for (i = 0; i < NITERATIONS; i++)
+        fail_unless(pa_mainloop_iterate(m, 0, NULL) >= 0);
+    t_iterate = pa_rtclock_now() - start;
+
+    start = pa_rtclock_now();
+    for (i = 0; i < NROUNDTRIPS; i++) {
+        pa_operation *o;
+
+        o = pa_context_get_server_info(contexts[i % n], server_info_callback, NULL);
+        fail_unless(o != NULL);
+
+        while (pa_operation_get_state(o) == PA_OPERATION_RUNNING)
+            fail_unless(pa_mainloop_iterate(m, 1, NULL) >= 0);
+
+        pa_operation_unref(o);
+    }
+    t_roundtrip = pa_rtclock_now() - start;
+
+    fprintf(stderr, "%u clients: %0.2f usec per idle iteration, %0.2f usec per round trip\n", n,
+            (double) t_iterate / NITERATIONS, (double) t_roundtrip / NROUNDTRIPS);
+
+    for (i = 0; i < n; i++) {
+        pa_context_disconnect(contexts[i]);
+        pa_context_unref(contexts[i]);
+    }
+
+    pa_mainloop_free(m);
+}
+
+START_TEST (connect_scaling_test) {
+    run_scaling(1);
+    run_scaling(8);
+    run_scaling(16);
+    run_scaling(32);
+    run_scaling(NCLIENTS_MAX);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -221,6 +319,11 @@ int main(int argc, char *argv[]) {
     tcase_set_timeout(tc, 20 * 60);
     suite_add_tcase(s, tc);
 
+    tc = tcase_create("connectscaling");
+    tcase_add_test(tc, connect_scaling_test);
+    tcase_set_timeout(tc, 5 * 60);
+    suite_add_tcase(s, tc);
+
     sr = srunner_create(s);
     srunner_run_all(sr, CK_NORMAL);
     failed = srunner_ntests_failed(sr);
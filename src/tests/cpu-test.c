@@ -7,6 +7,8 @@
 #include <math.h>
 
 #include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+#include <pulsecore/cpu-arm.h>
 #include <pulsecore/cpu-x86.h>
 #include <pulsecore/cpu-orc.h>
 #include <pulsecore/random.h>
@@ -223,6 +225,178 @@ START_TEST (sconv_sse_test) {
 }
 END_TEST
 
+/* sconv tests for the vectorized conversions to and from float32ne */
+#define SAMPLES 1019
+#define TIMES 1000
+
+static pa_usec_t time_convert(pa_convert_func_t func, const void *a, void *b) {
+    pa_usec_t start;
+    int i;
+
+    start = pa_rtclock_now();
+    for (i = 0; i < TIMES; i++)
+        func(SAMPLES, a, b);
+
+    return pa_rtclock_now() - start;
+}
+
+/* With exact == FALSE the results may be one off in the last bit */
+static void run_sconv_test(pa_sample_format_t f, pa_convert_func_t orig_to, pa_convert_func_t orig_from, pa_bool_t exact) {
+    pa_convert_func_t to = pa_get_convert_to_float32ne_function(f);
+    pa_convert_func_t from = pa_get_convert_from_float32ne_function(f);
+    size_t size = pa_sample_size_of_format(f);
+    uint8_t *samples, *samples_ref;
+    float *floats, *floats_ref, *input;
+    float lsb;
+    pa_usec_t t_to, t_to_orig, t_from, t_from_orig;
+    int i;
+
+    samples = pa_xnew(uint8_t, SAMPLES * size);
+    samples_ref = pa_xnew(uint8_t, SAMPLES * size);
+    floats = pa_xnew(float, SAMPLES);
+    floats_ref = pa_xnew(float, SAMPLES);
+    input = pa_xnew(float, SAMPLES);
+
+    /* Slightly out of range to check the clamping */
+    for (i = 0; i < SAMPLES; i++)
+        input[i] = 2.1f * (rand()/(float) RAND_MAX - 0.5f);
+    input[0] = 1.0f;
+    input[1] = -1.0f;
+    input[2] = 0.0f;
+
+    orig_from(SAMPLES, input, samples_ref);
+    from(SAMPLES, input, samples);
+
+    if (exact)
+        fail_unless(memcmp(samples, samples_ref, SAMPLES * size) == 0);
+    else {
+        /* A float has only 24 bits, which is the best we can check for
+         * s32 after converting back */
+        lsb = size == 2 ? 1.0f / 0x7FFF : 1.0f / (1 << 23);
+
+        orig_to(SAMPLES, samples, floats);
+        orig_to(SAMPLES, samples_ref, floats_ref);
+
+        for (i = 0; i < SAMPLES; i++)
+            if (fabsf(floats[i] - floats_ref[i]) > lsb) {
+                printf("%d: %f != %f (%f)\n", i, floats[i], floats_ref[i], input[i]);
+                fail();
+            }
+    }
+
+    /* All bit patterns, including the unused byte of s24_32 */
+    pa_random(samples, SAMPLES * size);
+
+    orig_to(SAMPLES, samples, floats_ref);
+    to(SAMPLES, samples, floats);
+
+    for (i = 0; i < SAMPLES; i++) {
+        if (exact ? memcmp(&floats[i], &floats_ref[i], sizeof(float)) == 0 :
+                    fabsf(floats[i] - floats_ref[i]) <= fabsf(floats_ref[i]) / (1 << 23))
+            continue;
+
+        printf("%d: %f != %f\n", i, floats[i], floats_ref[i]);
+        fail();
+    }
+
+    t_to = time_convert(to, samples, floats);
+    t_to_orig = time_convert(orig_to, samples, floats_ref);
+    t_from = time_convert(from, input, samples);
+    t_from_orig = time_convert(orig_from, input, samples_ref);
+
+    pa_log_debug("%s: to float32ne %llu usec (ref %llu usec), from float32ne %llu usec (ref %llu usec).",
+                 pa_sample_format_to_string(f),
+                 (long long unsigned int) t_to, (long long unsigned int) t_to_orig,
+                 (long long unsigned int) t_from, (long long unsigned int) t_from_orig);
+
+    pa_xfree(samples);
+    pa_xfree(samples_ref);
+    pa_xfree(floats);
+    pa_xfree(floats_ref);
+    pa_xfree(input);
+}
+
+static void get_convert_funcs(pa_convert_func_t to[PA_SAMPLE_MAX], pa_convert_func_t from[PA_SAMPLE_MAX]) {
+    pa_sample_format_t f;
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++) {
+        to[f] = pa_get_convert_to_float32ne_function(f);
+        from[f] = pa_get_convert_from_float32ne_function(f);
+    }
+}
+
+static void run_sconv_tests(pa_convert_func_t orig_to[PA_SAMPLE_MAX], pa_convert_func_t orig_from[PA_SAMPLE_MAX], pa_bool_t exact) {
+    static const pa_sample_format_t formats[] = {
+        PA_SAMPLE_S16LE, PA_SAMPLE_S16BE,
+        PA_SAMPLE_S24LE, PA_SAMPLE_S24BE,
+        PA_SAMPLE_S24_32LE, PA_SAMPLE_S24_32BE,
+        PA_SAMPLE_S32LE, PA_SAMPLE_S32BE
+    };
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(formats); i++) {
+        pa_sample_format_t f = formats[i];
+
+        fail_unless(pa_get_convert_to_float32ne_function(f) != orig_to[f]);
+        fail_unless(pa_get_convert_from_float32ne_function(f) != orig_from[f]);
+
+        pa_log_debug("Checking %s", pa_sample_format_to_string(f));
+        run_sconv_test(f, orig_to[f], orig_from[f], exact);
+    }
+}
+
+#undef SAMPLES
+#undef TIMES
+
+START_TEST (sconv_avx_test) {
+    pa_convert_func_t orig_to[PA_SAMPLE_MAX], orig_from[PA_SAMPLE_MAX];
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+#ifdef HAVE_AVX2_INTRINSICS
+    pa_log_debug("Checking AVX2 sconv");
+
+    get_convert_funcs(orig_to, orig_from);
+    pa_convert_func_init_avx(flags);
+    run_sconv_tests(orig_to, orig_from, TRUE);
+#else
+    pa_log_info("AVX2 conversions not built. Skipping");
+#endif
+}
+END_TEST
+
+#if (defined (__arm__) && defined (__linux__)) || defined (__aarch64__)
+START_TEST (sconv_neon_test) {
+    pa_convert_func_t orig_to[PA_SAMPLE_MAX], orig_from[PA_SAMPLE_MAX];
+    pa_cpu_arm_flag_t flags = 0;
+
+    /* There is no way to only query the flags, pa_cpu_init_arm()
+     * installs the NEON functions right away */
+    get_convert_funcs(orig_to, orig_from);
+    pa_cpu_init_arm(&flags);
+
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+#ifdef HAVE_NEON_INTRINSICS
+    pa_log_debug("Checking NEON sconv");
+
+    run_sconv_tests(orig_to, orig_from, FALSE);
+#else
+    pa_log_info("NEON conversions not built. Skipping");
+#endif
+}
+END_TEST
+#endif /* (defined (__arm__) && defined (__linux__)) || defined (__aarch64__) */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -238,8 +412,15 @@ int main(int argc, char *argv[]) {
     tcase_add_test(tc, svolume_sse_test);
     tcase_add_test(tc, svolume_orc_test);
     tcase_add_test(tc, sconv_sse_test);
+    tcase_add_test(tc, sconv_avx_test);
     suite_add_tcase(s, tc);
 
+#if (defined (__arm__) && defined (__linux__)) || defined (__aarch64__)
+    tc = tcase_create("arm");
+    tcase_add_test(tc, sconv_neon_test);
+    suite_add_tcase(s, tc);
+#endif
+
     sr = srunner_create(s);
     srunner_run_all(sr, CK_NORMAL);
     failed = srunner_ntests_failed(sr);
@@ -0,0 +1,298 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#define N_ENTRIES 5000
+
+START_TEST (hashmap_test) {
+    pa_hashmap *h;
+    char **keys;
+    void *state;
+    const void *key;
+    unsigned i;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    h = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+    keys = pa_xnew(char*, N_ENTRIES);
+
+    for (i = 0; i < N_ENTRIES; i++) {
+        keys[i] = pa_sprintf_malloc("key-%u", i);
+        fail_unless(pa_hashmap_put(h, keys[i], PA_UINT_TO_PTR(i + 1)) == 0);
+    }
+
+    fail_unless(pa_hashmap_put(h, "key-17", NULL) < 0);
+    fail_unless(pa_hashmap_size(h) == N_ENTRIES);
+
+    for (i = 0; i < N_ENTRIES; i++)
+        fail_unless(pa_hashmap_get(h, keys[i]) == PA_UINT_TO_PTR(i + 1));
+
+    /* Growing the table must not change the insertion order */
+    i = 0;
+    state = NULL;
+    while (pa_hashmap_iterate(h, &state, &key)) {
+        fail_unless(key == keys[i]);
+        i++;
+    }
+    fail_unless(i == N_ENTRIES);
+
+    /* Remove all odd entries while iterating, which shrinks the table */
+    i = 0;
+    state = NULL;
+    while (pa_hashmap_iterate(h, &state, &key)) {
+        if (i % 2)
+            fail_unless(pa_hashmap_remove(h, key) == PA_UINT_TO_PTR(i + 1));
+        i++;
+    }
+
+    for (i = 0; i < N_ENTRIES; i++)
+        fail_unless(pa_hashmap_get(h, keys[i]) == ((i % 2) ? NULL : PA_UINT_TO_PTR(i + 1)));
+
+    for (i = 0; i < N_ENTRIES; i += 2)
+        fail_unless(pa_hashmap_steal_first(h) == PA_UINT_TO_PTR(i + 1));
+
+    fail_unless(pa_hashmap_isempty(h));
+    fail_unless(pa_hashmap_put(h, keys[3], PA_UINT_TO_PTR(4)) == 0);
+    fail_unless(pa_hashmap_get(h, keys[3]) == PA_UINT_TO_PTR(4));
+
+    pa_hashmap_free(h, NULL, NULL);
+
+    for (i = 0; i < N_ENTRIES; i++)
+        pa_xfree(keys[i]);
+    pa_xfree(keys);
+}
+END_TEST
+
+START_TEST (idxset_test) {
+    pa_idxset *s;
+    uint32_t idx;
+    void *data;
+    unsigned i, n;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = pa_idxset_new(NULL, NULL);
+
+    for (i = 0; i < N_ENTRIES; i++) {
+        fail_unless(pa_idxset_put(s, PA_UINT_TO_PTR(i + 1), &idx) == 0);
+        fail_unless(idx == i);
+    }
+
+    fail_unless(pa_idxset_put(s, PA_UINT_TO_PTR(18), &idx) < 0);
+    fail_unless(idx == 17);
+
+    for (i = 0; i < N_ENTRIES; i++) {
+        fail_unless(pa_idxset_get_by_index(s, i) == PA_UINT_TO_PTR(i + 1));
+        fail_unless(pa_idxset_get_by_data(s, PA_UINT_TO_PTR(i + 1), &idx) == PA_UINT_TO_PTR(i + 1));
+        fail_unless(idx == i);
+    }
+
+    /* Keep only every tenth entry, so the tables shrink again */
+    for (i = 0; i < N_ENTRIES; i++)
+        if (i % 10)
+            fail_unless(pa_idxset_remove_by_index(s, i) == PA_UINT_TO_PTR(i + 1));
+
+    fail_unless(pa_idxset_size(s) == N_ENTRIES / 10);
+
+    /* pa_idxset_next() skips over removed indexes */
+    idx = 11;
+    fail_unless(pa_idxset_next(s, &idx) == PA_UINT_TO_PTR(21));
+    fail_unless(idx == 20);
+
+    /* pa_idxset_rrobin() walks in insertion order and wraps around */
+    idx = PA_IDXSET_INVALID;
+    for (i = 0, n = 0; i < N_ENTRIES / 10 + 1; i++) {
+        data = pa_idxset_rrobin(s, &idx);
+        fail_unless(data != NULL);
+        fail_unless(idx == (i % (N_ENTRIES / 10)) * 10);
+        n++;
+    }
+    fail_unless(n == N_ENTRIES / 10 + 1);
+
+    /* New entries keep counting up and stay in insertion order */
+    fail_unless(pa_idxset_put(s, PA_UINT_TO_PTR(N_ENTRIES + 1), &idx) == 0);
+    fail_unless(idx == N_ENTRIES);
+
+    i = 0;
+    for (data = pa_idxset_first(s, &idx); data; data = pa_idxset_next(s, &idx), i++)
+        fail_unless(idx == (i < N_ENTRIES / 10 ? i * 10 : N_ENTRIES));
+    fail_unless(i == N_ENTRIES / 10 + 1);
+
+    pa_idxset_free(s, NULL, NULL);
+}
+END_TEST
+
+/* The previous implementation, 127 fixed chained buckets per table, as
+ * a reference for the benchmark */
+
+#define OLD_NBUCKETS 127
+
+struct old_entry {
+    uint32_t idx;
+    void *data;
+    struct old_entry *data_next, *index_next;
+};
+
+struct old_idxset {
+    uint32_t current_index;
+    struct old_entry *by_data[OLD_NBUCKETS];
+    struct old_entry *by_index[OLD_NBUCKETS];
+};
+
+static void old_put(struct old_idxset *s, void *p) {
+    struct old_entry *e;
+    unsigned hash;
+
+    hash = pa_idxset_trivial_hash_func(p) % OLD_NBUCKETS;
+
+    for (e = s->by_data[hash]; e; e = e->data_next)
+        if (pa_idxset_trivial_compare_func(e->data, p) == 0)
+            return;
+
+    e = pa_xnew(struct old_entry, 1);
+    e->data = p;
+    e->idx = s->current_index++;
+
+    e->data_next = s->by_data[hash];
+    s->by_data[hash] = e;
+
+    e->index_next = s->by_index[e->idx % OLD_NBUCKETS];
+    s->by_index[e->idx % OLD_NBUCKETS] = e;
+}
+
+static void* old_get_by_index(struct old_idxset *s, uint32_t idx) {
+    struct old_entry *e;
+
+    for (e = s->by_index[idx % OLD_NBUCKETS]; e; e = e->index_next)
+        if (e->idx == idx)
+            return e->data;
+
+    return NULL;
+}
+
+static void old_free(struct old_idxset *s) {
+    unsigned i;
+
+    for (i = 0; i < OLD_NBUCKETS; i++)
+        while (s->by_index[i]) {
+            struct old_entry *e = s->by_index[i];
+            s->by_index[i] = e->index_next;
+            pa_xfree(e);
+        }
+
+    pa_xfree(s);
+}
+
+/* Pointers as they come out of the allocator, i.e. aligned */
+#define ENTRY_DATA(i) PA_UINT_TO_PTR(((i) + 1) * 16)
+
+static void run_benchmark(unsigned n) {
+    struct old_idxset *old;
+    pa_idxset *s;
+    pa_usec_t start, t_old_put, t_old_get, t_put, t_get;
+    unsigned i, j, lookups;
+
+    /* Roughly the same number of lookups for each size */
+    lookups = PA_MAX(100000 / n, 1U);
+
+    old = pa_xnew0(struct old_idxset, 1);
+
+    start = pa_rtclock_now();
+    for (i = 0; i < n; i++)
+        old_put(old, ENTRY_DATA(i));
+    t_old_put = pa_rtclock_now() - start;
+
+    start = pa_rtclock_now();
+    for (j = 0; j < lookups; j++)
+        for (i = 0; i < n; i++)
+            fail_unless(old_get_by_index(old, i) == ENTRY_DATA(i));
+    t_old_get = pa_rtclock_now() - start;
+
+    old_free(old);
+
+    s = pa_idxset_new(NULL, NULL);
+
+    start = pa_rtclock_now();
+    for (i = 0; i < n; i++)
+        pa_idxset_put(s, ENTRY_DATA(i), NULL);
+    t_put = pa_rtclock_now() - start;
+
+    start = pa_rtclock_now();
+    for (j = 0; j < lookups; j++)
+        for (i = 0; i < n; i++)
+            fail_unless(pa_idxset_get_by_index(s, i) == ENTRY_DATA(i));
+    t_get = pa_rtclock_now() - start;
+
+    pa_idxset_free(s, NULL, NULL);
+
+    pa_log_debug("%u entries: put %llu usec (fixed buckets: %llu usec), %u lookups %llu usec (fixed buckets: %llu usec)",
+                 n, (unsigned long long) t_put, (unsigned long long) t_old_put,
+                 n * lookups, (unsigned long long) t_get, (unsigned long long) t_old_get);
+}
+
+START_TEST (idxset_benchmark) {
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    run_benchmark(10);
+    run_benchmark(1000);
+    run_benchmark(100000);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Hashmap");
+    tc = tcase_create("hashmap");
+    tcase_add_test(tc, hashmap_test);
+    tcase_add_test(tc, idxset_test);
+    tcase_add_test(tc, idxset_benchmark);
+    /* The fixed bucket reference is slow with many entries */
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
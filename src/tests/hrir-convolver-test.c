@@ -0,0 +1,168 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include <modules/hrir-convolver.h>
+
+#define CHANNELS 8
+#define HRIR_CHANNELS 8
+#define FRAMES 4096
+#define TOLERANCE 1e-4f
+
+static const unsigned mapping_left[CHANNELS] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+static const unsigned mapping_right[CHANNELS] = { 1, 0, 2, 3, 5, 4, 7, 6 };
+
+static float random_sample(float amplitude) {
+    return amplitude * (2.0f * (float) rand() / (float) RAND_MAX - 1.0f);
+}
+
+static float *make_hrir(unsigned hrir_samples) {
+    float *hrir;
+    unsigned i;
+
+    hrir = pa_xnew(float, hrir_samples * HRIR_CHANNELS);
+
+    /* Decaying noise, scaled so that the sum cannot clip */
+    for (i = 0; i < hrir_samples * HRIR_CHANNELS; i++)
+        hrir[i] = random_sample(expf(-4.0f * (float) (i / HRIR_CHANNELS) / (float) hrir_samples)) / (float) (2 * CHANNELS);
+
+    return hrir;
+}
+
+/* Feeds the input in irregular pieces so that the FFT engine sees
+ * partial blocks as well as requests spanning several blocks */
+static void run_chunked(pa_hrir_convolver *c, const float *src, float *dst, unsigned frames) {
+    static const unsigned chunks[] = { 1, 7, 64, 128, 300, 3, 1000, 129 };
+    unsigned i = 0, done = 0;
+
+    while (done < frames) {
+        unsigned n = PA_MIN(chunks[i++ % PA_ELEMENTSOF(chunks)], frames - done);
+
+        pa_hrir_convolver_run(c, src + done * CHANNELS, dst + done * 2, n);
+        done += n;
+    }
+}
+
+static void compare(unsigned hrir_samples) {
+    pa_hrir_convolver *direct, *fft;
+    float *hrir, *src, *out_direct, *out_fft;
+    float max_diff = 0;
+    pa_usec_t start, t_direct, t_fft;
+    unsigned i, pass;
+
+    hrir = make_hrir(hrir_samples);
+
+    src = pa_xnew(float, FRAMES * CHANNELS);
+    for (i = 0; i < FRAMES * CHANNELS; i++)
+        src[i] = random_sample(0.5f);
+
+    out_direct = pa_xnew(float, FRAMES * 2);
+    out_fft = pa_xnew(float, FRAMES * 2);
+
+    direct = pa_hrir_convolver_new(PA_HRIR_CONVOLVER_DIRECT, hrir, hrir_samples, HRIR_CHANNELS, CHANNELS, mapping_left, mapping_right);
+    fft = pa_hrir_convolver_new(PA_HRIR_CONVOLVER_FFT, hrir, hrir_samples, HRIR_CHANNELS, CHANNELS, mapping_left, mapping_right);
+    fail_unless(direct != NULL);
+    fail_unless(fft != NULL);
+    fail_unless(pa_hrir_convolver_get_method(fft) == PA_HRIR_CONVOLVER_FFT);
+
+    /* The second pass checks that a reset really drops all history */
+    for (pass = 0; pass < 2; pass++) {
+        start = pa_rtclock_now();
+        pa_hrir_convolver_run(direct, src, out_direct, FRAMES);
+        t_direct = pa_rtclock_now() - start;
+
+        start = pa_rtclock_now();
+        run_chunked(fft, src, out_fft, FRAMES);
+        t_fft = pa_rtclock_now() - start;
+
+        for (i = 0; i < FRAMES * 2; i++) {
+            float d = fabsf(out_direct[i] - out_fft[i]);
+
+            if (d > max_diff)
+                max_diff = d;
+
+            if (d > TOLERANCE) {
+                pa_log_debug("%u taps, frame %u, ear %u: %f != %f", hrir_samples, i / 2, i % 2, out_direct[i], out_fft[i]);
+                fail();
+            }
+        }
+
+        pa_hrir_convolver_reset(direct);
+        pa_hrir_convolver_reset(fft);
+    }
+
+    pa_log_debug("%u taps: max deviation %g, direct %llu usec, fft %llu usec", hrir_samples, max_diff,
+                 (unsigned long long) t_direct, (unsigned long long) t_fft);
+
+    pa_hrir_convolver_free(direct);
+    pa_hrir_convolver_free(fft);
+
+    pa_xfree(out_fft);
+    pa_xfree(out_direct);
+    pa_xfree(src);
+    pa_xfree(hrir);
+}
+
+START_TEST (hrir_convolver_test) {
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    srand(0);
+
+    /* Single partition, non power of two and multiple partitions */
+    compare(1);
+    compare(100);
+    compare(512);
+    compare(700);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("HRIR convolver");
+    tc = tcase_create("hrir-convolver");
+    tcase_add_test(tc, hrir_convolver_test);
+    /* The direct reference is slow by design */
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
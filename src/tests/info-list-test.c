@@ -0,0 +1,477 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pulse/context.h>
+#include <pulse/introspect.h>
+#include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/iochannel.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/protocol-native.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/socket-server.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+/* Runs a native protocol server and a client in the same main loop,
+ * and has the client list the server's sink inputs the way a mixer
+ * application would. */
+
+#define N_SINKS 16
+#define N_STREAMS (N_SINKS * PA_MAX_INPUTS_PER_SINK)
+#define BENCH_ROUNDS 100
+
+struct server {
+    pa_mainloop *mainloop;
+    pa_core *core;
+    pa_rtpoll *rtpoll;
+    pa_thread_mq thread_mq;
+    pa_thread *thread;
+    pa_sink *sinks[N_SINKS];
+    pa_sink_input *inputs[N_STREAMS];
+    pa_native_protocol *protocol;
+    pa_native_options *options;
+    pa_socket_server *socket_server;
+    char *socket_path;
+};
+
+struct listing {
+    unsigned n;
+    pa_bool_t seen[N_STREAMS];
+    pa_bool_t done;
+    pa_bool_t have_cursor;
+    pa_info_list_cursor cursor;
+};
+
+static const pa_sample_spec ss = {
+    .format = PA_SAMPLE_S16NE,
+    .rate = 44100,
+    .channels = 2
+};
+
+static pa_channel_map map;
+
+static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    return -1;
+}
+
+static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+}
+
+static void sink_input_kill_cb(pa_sink_input *i) {
+    pa_sink_input_unlink(i);
+}
+
+static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+
+    /* Nothing is ever played */
+    if (code == PA_SINK_MESSAGE_GET_LATENCY) {
+        *((pa_usec_t*) data) = 0;
+        return 0;
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+static void thread_func(void *userdata) {
+    struct server *s = userdata;
+
+    pa_thread_mq_install(&s->thread_mq);
+
+    /* We only need to answer messages */
+    while (pa_rtpoll_run(s->rtpoll, TRUE) > 0)
+        ;
+}
+
+static void on_connection(pa_socket_server *ss, pa_iochannel *io, void *userdata) {
+    struct server *s = userdata;
+
+    pa_native_protocol_connect(s->protocol, io, s->options);
+}
+
+static void iterate(pa_mainloop *m) {
+    while (pa_mainloop_iterate(m, 0, NULL) > 0)
+        ;
+}
+
+static pa_sink *sink_new(struct server *s, unsigned k) {
+    pa_sink_new_data data;
+    pa_sink *sink;
+    char name[32];
+
+    pa_snprintf(name, sizeof(name), "sink%u", k);
+
+    pa_sink_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_new_data_set_name(&data, name);
+    pa_sink_new_data_set_sample_spec(&data, &ss);
+    pa_sink_new_data_set_channel_map(&data, &map);
+    sink = pa_sink_new(s->core, &data, 0);
+    pa_sink_new_data_done(&data);
+    fail_unless(sink != NULL);
+
+    sink->parent.process_msg = sink_process_msg;
+    pa_sink_set_asyncmsgq(sink, s->thread_mq.inq);
+    pa_sink_set_rtpoll(sink, s->rtpoll);
+    pa_sink_put(sink);
+
+    return sink;
+}
+
+static pa_sink_input *sink_input_new(struct server *s, unsigned k) {
+    pa_sink_input_new_data data;
+    pa_sink_input *i = NULL;
+
+    /* Roughly what a desktop client sets */
+    pa_sink_input_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_input_new_data_set_sink(&data, s->sinks[k % N_SINKS], FALSE);
+    pa_sink_input_new_data_set_sample_spec(&data, &ss);
+    pa_sink_input_new_data_set_channel_map(&data, &map);
+    pa_proplist_setf(data.proplist, PA_PROP_MEDIA_NAME, "Playback Stream %u", k);
+    pa_proplist_sets(data.proplist, PA_PROP_MEDIA_ROLE, "music");
+    pa_proplist_sets(data.proplist, PA_PROP_APPLICATION_NAME, "Some Media Player");
+    pa_proplist_sets(data.proplist, PA_PROP_APPLICATION_ID, "org.example.MediaPlayer");
+    pa_proplist_sets(data.proplist, PA_PROP_APPLICATION_ICON_NAME, "media-player");
+    pa_proplist_setf(data.proplist, PA_PROP_APPLICATION_PROCESS_ID, "%u", 1000 + k);
+    pa_proplist_sets(data.proplist, PA_PROP_APPLICATION_PROCESS_BINARY, "media-player");
+    pa_proplist_sets(data.proplist, PA_PROP_APPLICATION_LANGUAGE, "en_US.UTF-8");
+
+    pa_sink_input_new(&i, s->core, &data);
+    pa_sink_input_new_data_done(&data);
+    fail_unless(i != NULL);
+
+    i->pop = sink_input_pop_cb;
+    i->process_rewind = sink_input_process_rewind_cb;
+    i->kill = sink_input_kill_cb;
+
+    pa_sink_input_put(i);
+
+    return i;
+}
+
+static void server_new(struct server *s) {
+    char dir[] = "/tmp/info-list-test-XXXXXX";
+    unsigned k;
+
+    pa_zero(*s);
+
+    s->mainloop = pa_mainloop_new();
+    s->core = pa_core_new(pa_mainloop_get_api(s->mainloop), FALSE, 0);
+
+    s->rtpoll = pa_rtpoll_new();
+    pa_thread_mq_init(&s->thread_mq, pa_mainloop_get_api(s->mainloop), s->rtpoll);
+    s->thread = pa_thread_new("info-list-test", thread_func, s);
+    fail_unless(s->thread != NULL);
+
+    pa_channel_map_init_stereo(&map);
+
+    for (k = 0; k < N_SINKS; k++)
+        s->sinks[k] = sink_new(s, k);
+
+    for (k = 0; k < N_STREAMS; k++)
+        s->inputs[k] = sink_input_new(s, k);
+
+    s->protocol = pa_native_protocol_get(s->core);
+    s->options = pa_native_options_new();
+    s->options->auth_anonymous = TRUE;
+
+    fail_unless(mkdtemp(dir) != NULL);
+    s->socket_path = pa_sprintf_malloc("%s/native", dir);
+    s->socket_server = pa_socket_server_new_unix(pa_mainloop_get_api(s->mainloop), s->socket_path);
+    fail_unless(s->socket_server != NULL);
+    pa_socket_server_set_callback(s->socket_server, on_connection, s);
+
+    iterate(s->mainloop);
+}
+
+static void server_free(struct server *s) {
+    char *dir;
+    unsigned k;
+
+    pa_socket_server_unref(s->socket_server);
+    dir = pa_parent_dir(s->socket_path);
+    rmdir(dir);
+    pa_xfree(dir);
+    pa_xfree(s->socket_path);
+
+    pa_native_options_unref(s->options);
+    pa_native_protocol_unref(s->protocol);
+
+    for (k = 0; k < N_STREAMS; k++) {
+        if (!s->inputs[k])
+            continue;
+
+        pa_sink_input_unlink(s->inputs[k]);
+        pa_sink_input_unref(s->inputs[k]);
+    }
+
+    for (k = 0; k < N_SINKS; k++)
+        pa_sink_unlink(s->sinks[k]);
+
+    pa_asyncmsgq_send(s->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(s->thread);
+
+    iterate(s->mainloop);
+    pa_thread_mq_done(&s->thread_mq);
+
+    for (k = 0; k < N_SINKS; k++)
+        pa_sink_unref(s->sinks[k]);
+    pa_rtpoll_free(s->rtpoll);
+
+    pa_core_unref(s->core);
+    pa_mainloop_free(s->mainloop);
+}
+
+static pa_context *client_new(struct server *s) {
+    pa_context *c;
+    char *server;
+
+    c = pa_context_new(pa_mainloop_get_api(s->mainloop), "info-list-test");
+    fail_unless(c != NULL);
+
+    server = pa_sprintf_malloc("unix:%s", s->socket_path);
+    fail_unless(pa_context_connect(c, server, PA_CONTEXT_NOAUTOSPAWN, NULL) >= 0);
+    pa_xfree(server);
+
+    while (pa_context_get_state(c) != PA_CONTEXT_READY) {
+        fail_unless(PA_CONTEXT_IS_GOOD(pa_context_get_state(c)));
+        pa_mainloop_iterate(s->mainloop, 1, NULL);
+    }
+
+    return c;
+}
+
+static void client_free(struct server *s, pa_context *c) {
+    pa_context_disconnect(c);
+    pa_context_unref(c);
+
+    iterate(s->mainloop);
+}
+
+static void wait_for(struct server *s, pa_operation *o) {
+    fail_unless(o != NULL);
+
+    while (pa_operation_get_state(o) == PA_OPERATION_RUNNING)
+        pa_mainloop_iterate(s->mainloop, 1, NULL);
+
+    fail_unless(pa_operation_get_state(o) == PA_OPERATION_DONE);
+    pa_operation_unref(o);
+}
+
+static void sink_input_info_cb(pa_context *c, const pa_sink_input_info *i, int eol, void *userdata) {
+    struct listing *l = userdata;
+    char name[64];
+
+    fail_unless(eol >= 0);
+    fail_unless(!l->done);
+
+    if (eol) {
+        l->have_cursor = pa_context_get_info_list_cursor(c, &l->cursor) >= 0;
+        l->done = TRUE;
+        return;
+    }
+
+    /* The server is fresh, so indexes are handed out in order */
+    fail_unless(i->index < N_STREAMS);
+    fail_unless(!l->seen[i->index]);
+    fail_unless(i->sink == i->index % N_SINKS);
+
+    pa_snprintf(name, sizeof(name), "Playback Stream %u", i->index);
+    fail_unless(pa_streq(i->name, name));
+    fail_unless(pa_streq(pa_proplist_gets(i->proplist, PA_PROP_APPLICATION_ID), "org.example.MediaPlayer"));
+
+    l->seen[i->index] = TRUE;
+    l->n++;
+}
+
+START_TEST (info_list_test) {
+    struct server s;
+    struct listing l;
+    pa_context *c;
+
+    server_new(&s);
+    c = client_new(&s);
+
+    pa_zero(l);
+    wait_for(&s, pa_context_get_sink_input_info_list(c, sink_input_info_cb, &l));
+    fail_unless(l.done);
+    fail_unless(l.n == N_STREAMS);
+
+    /* A single entry, as for pa_context_get_sink_input_info() */
+    pa_zero(l);
+    wait_for(&s, pa_context_get_sink_input_info(c, 7, sink_input_info_cb, &l));
+    fail_unless(l.done);
+    fail_unless(l.n == 1 && l.seen[7]);
+
+    client_free(&s, c);
+    server_free(&s);
+}
+END_TEST
+
+START_TEST (info_list_paging_test) {
+    struct server s;
+    struct listing l, a, b;
+    pa_info_list_filter filter;
+    pa_info_list_cursor cursor;
+    pa_operation *o;
+    pa_proplist *p;
+    pa_context *c;
+    uint64_t generation;
+    unsigned n, n_pages = 0;
+
+    server_new(&s);
+    c = client_new(&s);
+
+    /* Page through all sink inputs until the cursor says that there
+     * are no more */
+    pa_zero(l);
+    pa_zero(filter);
+    filter.max_entries = 100;
+
+    do {
+        n = l.n;
+        l.done = FALSE;
+        wait_for(&s, pa_context_get_sink_input_info_list_filtered(c, &filter, sink_input_info_cb, &l));
+        fail_unless(l.done && l.have_cursor);
+        fail_unless(l.n - n == PA_MIN(100U, N_STREAMS - n));
+
+        filter.start_index = l.cursor.next_index;
+        n_pages++;
+    } while (filter.start_index != PA_INVALID_INDEX);
+
+    fail_unless(l.n == N_STREAMS);
+    fail_unless(n_pages == (N_STREAMS + 99) / 100);
+    fail_unless(l.cursor.removed_generation == 0);
+    generation = l.cursor.generation;
+
+    /* The cursor belongs to the query whose callback is running */
+    fail_unless(pa_context_get_info_list_cursor(c, &cursor) < 0);
+
+    pa_zero(a);
+    pa_zero(b);
+    filter.max_entries = 10;
+    filter.start_index = 0;
+    fail_unless((o = pa_context_get_sink_input_info_list_filtered(c, &filter, sink_input_info_cb, &a)) != NULL);
+    filter.start_index = 200;
+    wait_for(&s, pa_context_get_sink_input_info_list_filtered(c, &filter, sink_input_info_cb, &b));
+    wait_for(&s, o);
+
+    fail_unless(a.n == 10 && a.seen[0] && a.have_cursor && a.cursor.next_index == 10);
+    fail_unless(b.n == 10 && b.seen[200] && b.have_cursor && b.cursor.next_index == 210);
+
+    /* Nothing changed since */
+    pa_zero(l);
+    pa_zero(filter);
+    filter.changed_since = generation;
+    wait_for(&s, pa_context_get_sink_input_info_list_filtered(c, &filter, sink_input_info_cb, &l));
+    fail_unless(l.n == 0 && l.have_cursor);
+    fail_unless(l.cursor.next_index == PA_INVALID_INDEX);
+    fail_unless(l.cursor.removed_generation <= generation);
+
+    /* One stream changes and another one goes away */
+    p = pa_proplist_new();
+    pa_proplist_sets(p, PA_PROP_MEDIA_ROLE, "video");
+    pa_sink_input_update_proplist(s.inputs[42], PA_UPDATE_REPLACE, p);
+    pa_proplist_free(p);
+
+    pa_sink_input_unlink(s.inputs[43]);
+    pa_sink_input_unref(s.inputs[43]);
+    s.inputs[43] = NULL;
+
+    pa_zero(l);
+    wait_for(&s, pa_context_get_sink_input_info_list_filtered(c, &filter, sink_input_info_cb, &l));
+    fail_unless(l.n == 1 && l.seen[42] && l.have_cursor);
+    fail_unless(l.cursor.generation > generation);
+    fail_unless(l.cursor.removed_generation > generation);
+
+    client_free(&s, c);
+    server_free(&s);
+}
+END_TEST
+
+START_TEST (info_list_benchmark) {
+    struct server s;
+    struct listing l;
+    pa_context *c;
+    pa_usec_t start;
+    unsigned i;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    server_new(&s);
+    c = client_new(&s);
+
+    /* Warm up the pools */
+    pa_zero(l);
+    wait_for(&s, pa_context_get_sink_input_info_list(c, sink_input_info_cb, &l));
+
+    start = pa_rtclock_now();
+    for (i = 0; i < BENCH_ROUNDS; i++) {
+        pa_zero(l);
+        wait_for(&s, pa_context_get_sink_input_info_list(c, sink_input_info_cb, &l));
+    }
+    start = pa_rtclock_now() - start;
+
+    fail_unless(l.n == N_STREAMS);
+
+    pa_log_debug("Listing %u sink inputs took %llu usec", N_STREAMS, (unsigned long long) (start / BENCH_ROUNDS));
+
+    client_free(&s, c);
+    server_free(&s);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Info list");
+    tc = tcase_create("infolist");
+    tcase_add_test(tc, info_list_test);
+    tcase_add_test(tc, info_list_paging_test);
+    tcase_add_test(tc, info_list_benchmark);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
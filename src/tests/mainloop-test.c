@@ -22,6 +22,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <sys/time.h>
 #include <assert.h>
@@ -29,6 +30,7 @@
 
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
 
 #include <pulsecore/core-util.h>
 #include <pulsecore/core-rtclock.h>
@@ -122,6 +124,152 @@ START_TEST (mainloop_test) {
 }
 END_TEST
 
+#ifndef GLIB_MAIN_LOOP
+
+#define N_TIME_EVENTS 500
+#define N_IO_EVENTS 200
+
+static pa_usec_t last_fired;
+static unsigned n_fired;
+
+static void ordered_tcb(pa_mainloop_api*a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    struct timeval ttv = *tv;
+    pa_usec_t t;
+
+    ttv.tv_usec &= ~PA_TIMEVAL_RTCLOCK;
+    t = pa_timeval_load(&ttv);
+
+    fail_unless(t >= last_fired);
+    fail_unless(pa_rtclock_now() >= t);
+
+    last_fired = t;
+    n_fired++;
+}
+
+static void rearm_tcb(pa_mainloop_api*a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    struct timeval ntv;
+    unsigned *n = userdata;
+
+    /* Rearming in the past must not make the same dispatch spin */
+    if (++(*n) < 3)
+        a->time_restart(e, pa_timeval_rtstore(&ntv, 1, TRUE));
+}
+
+START_TEST (mainloop_time_test) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    pa_time_event *te[N_TIME_EVENTS], *rearm;
+    struct timeval tv;
+    pa_usec_t now;
+    unsigned i, n_expected = 0, n_rearm = 0;
+
+    m = pa_mainloop_new();
+    fail_if(!m);
+    a = pa_mainloop_get_api(m);
+
+    now = pa_rtclock_now();
+    srand(0);
+
+    for (i = 0; i < N_TIME_EVENTS; i++)
+        te[i] = a->time_new(a, pa_timeval_rtstore(&tv, now + (pa_usec_t) (rand() % 50000), TRUE), ordered_tcb, NULL);
+
+    /* Move some, disable some and free some */
+    for (i = 0; i < N_TIME_EVENTS; i += 3)
+        a->time_restart(te[i], pa_timeval_rtstore(&tv, now + (pa_usec_t) (rand() % 50000), TRUE));
+
+    for (i = 1; i < N_TIME_EVENTS; i += 7)
+        a->time_restart(te[i], NULL);
+
+    for (i = 2; i < N_TIME_EVENTS; i += 11) {
+        a->time_free(te[i]);
+        te[i] = NULL;
+    }
+
+    for (i = 0; i < N_TIME_EVENTS; i++)
+        if (te[i] && !(i % 7 == 1))
+            n_expected++;
+
+    rearm = a->time_new(a, pa_timeval_rtstore(&tv, 1, TRUE), rearm_tcb, &n_rearm);
+    fail_unless(pa_mainloop_iterate(m, 0, NULL) >= 1);
+    fail_unless(n_rearm == 1);
+
+    while (n_fired < n_expected)
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) >= 0);
+
+    fail_unless(n_fired == n_expected);
+    fail_unless(n_rearm == 3);
+
+    for (i = 0; i < N_TIME_EVENTS; i++)
+        if (te[i])
+            a->time_free(te[i]);
+    a->time_free(rearm);
+
+    pa_mainloop_free(m);
+}
+END_TEST
+
+static void count_iocb(pa_mainloop_api*a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    unsigned *n = userdata;
+    char c;
+
+    fail_unless(f == PA_IO_EVENT_INPUT);
+    pa_assert_se(read(fd, &c, sizeof(c)) == 1);
+    (*n)++;
+}
+
+START_TEST (mainloop_io_test) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    pa_io_event *ioe[N_IO_EVENTS];
+    int fds[N_IO_EVENTS][2];
+    unsigned i, n = 0;
+    char c = 'x';
+
+    m = pa_mainloop_new();
+    fail_if(!m);
+    a = pa_mainloop_get_api(m);
+
+    for (i = 0; i < N_IO_EVENTS; i++) {
+        fail_unless(pipe(fds[i]) == 0);
+        ioe[i] = a->io_new(a, fds[i][0], PA_IO_EVENT_INPUT, count_iocb, &n);
+    }
+
+    /* Only the written ones fire */
+    for (i = 0; i < N_IO_EVENTS; i += 10)
+        pa_assert_se(write(fds[i][1], &c, 1) == 1);
+
+    fail_unless(pa_mainloop_iterate(m, 1, NULL) == N_IO_EVENTS / 10);
+    fail_unless(n == N_IO_EVENTS / 10);
+
+    /* Disabled events don't fire, reenabled ones do */
+    a->io_enable(ioe[5], PA_IO_EVENT_NULL);
+    pa_assert_se(write(fds[5][1], &c, 1) == 1);
+    pa_assert_se(write(fds[6][1], &c, 1) == 1);
+    fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+
+    a->io_enable(ioe[5], PA_IO_EVENT_INPUT);
+    fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+    fail_unless(n == N_IO_EVENTS / 10 + 2);
+
+    /* Freed events don't fire even if their fd is ready */
+    a->io_free(ioe[7]);
+    ioe[7] = NULL;
+    pa_assert_se(write(fds[7][1], &c, 1) == 1);
+    fail_unless(pa_mainloop_iterate(m, 0, NULL) == 0);
+
+    for (i = 0; i < N_IO_EVENTS; i++) {
+        if (ioe[i])
+            a->io_free(ioe[i]);
+        pa_close(fds[i][0]);
+        pa_close(fds[i][1]);
+    }
+
+    pa_mainloop_free(m);
+}
+END_TEST
+
+#endif /* GLIB_MAIN_LOOP */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -131,6 +279,10 @@ int main(int argc, char *argv[]) {
     s = suite_create("MainLoop");
     tc = tcase_create("mainloop");
     tcase_add_test(tc, mainloop_test);
+#ifndef GLIB_MAIN_LOOP
+    tcase_add_test(tc, mainloop_time_test);
+    tcase_add_test(tc, mainloop_io_test);
+#endif
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -31,6 +31,8 @@
 #include <pulsecore/log.h>
 #include <pulsecore/memblock.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/shm.h>
+#include <pulsecore/thread.h>
 
 static void release_cb(pa_memimport *i, uint32_t block_id, void *userdata) {
     pa_log("%s: Imported block %u is released.", (char*) userdata, block_id);
@@ -177,6 +179,151 @@ START_TEST (memblock_test) {
 }
 END_TEST
 
+START_TEST (memblock_slot_class_test) {
+    pa_mempool *pool;
+    pa_memblock *small, *large, *fill[64];
+    size_t slot_size, prev_size = 0;
+    unsigned c, n_classes, n_slots, n_small_slots, i;
+
+    pool = pa_mempool_new(FALSE, 1024*1024);
+    fail_unless(pool != NULL);
+
+    for (n_classes = 0; pa_mempool_get_slot_class(pool, n_classes, &slot_size, &n_slots) >= 0; n_classes++) {
+        fail_unless(slot_size > prev_size);
+        fail_unless(n_slots >= 2);
+        prev_size = slot_size;
+    }
+
+    fail_unless(n_classes >= 1);
+    fail_unless(n_classes <= PA_MEMPOOL_SLOT_CLASSES_MAX);
+
+    /* The class of the default block size alone still holds the whole
+     * configured pool size */
+    for (c = 0; pa_mempool_get_slot_class(pool, c, &slot_size, &n_slots) >= 0; c++)
+        if (slot_size > pa_mempool_block_size_max(pool))
+            break;
+    fail_unless(n_slots * slot_size >= 1024*1024);
+
+    /* A tiny block takes a slot of the smallest class, a block larger
+     * than pa_mempool_block_size_max() still comes from the pool */
+    small = pa_memblock_new_pool(pool, 100);
+    fail_unless(small != NULL);
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool)->n_slots_allocated_by_class[0]) == 1);
+
+    large = pa_memblock_new_pool(pool, prev_size);
+    fail_unless(large != NULL);
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool)->n_slots_allocated_by_class[n_classes-1]) == 1);
+
+    fail_unless(pa_memblock_new_pool(pool, prev_size + 1) == NULL);
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool)->n_too_large_for_pool) == 1);
+
+    /* Exhausting a class spills over into the next one */
+    pa_assert_se(pa_mempool_get_slot_class(pool, 0, NULL, &n_small_slots) >= 0);
+    fail_unless(n_small_slots < PA_ELEMENTSOF(fill));
+
+    for (i = 0; i < n_small_slots; i++) {
+        fill[i] = pa_memblock_new_pool(pool, 100);
+        fail_unless(fill[i] != NULL);
+    }
+
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool)->n_class_full_by_class[0]) == 1);
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool)->n_slots_allocated_by_class[0]) == (int) n_small_slots);
+
+    if (n_classes > 1)
+        fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool)->n_slots_allocated_by_class[1]) == 1);
+
+    for (i = 0; i < n_small_slots; i++)
+        pa_memblock_unref(fill[i]);
+
+    pa_memblock_unref(small);
+    pa_memblock_unref(large);
+
+    for (c = 0; c < n_classes; c++)
+        fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool)->n_slots_allocated_by_class[c]) == 0);
+
+    /* Freed slots are reused */
+    small = pa_memblock_new_pool(pool, 100);
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool)->n_slots_allocated_by_class[0]) == 1);
+    pa_memblock_unref(small);
+
+    pa_mempool_free(pool);
+}
+END_TEST
+
+/* The classes take more than the configured size, but never more than
+ * a SHM segment may hold */
+START_TEST (memblock_large_pool_test) {
+    pa_mempool *pool;
+    pa_memblock *b;
+    size_t slot_size, total = 0;
+    unsigned c, n_slots;
+
+    pool = pa_mempool_new(FALSE, 1024*1024*1024);
+    fail_unless(pool != NULL);
+
+    for (c = 0; pa_mempool_get_slot_class(pool, c, &slot_size, &n_slots) >= 0; c++)
+        total += slot_size * n_slots;
+
+    fail_unless(total <= PA_SHM_SIZE_MAX);
+    fail_unless(total >= 512*1024*1024);
+
+    b = pa_memblock_new_pool(pool, pa_mempool_block_size_max(pool));
+    fail_unless(b != NULL);
+    pa_memblock_unref(b);
+
+    pa_mempool_free(pool);
+}
+END_TEST
+
+#define N_STAT_THREADS 4
+#define N_STAT_BLOCKS 256
+
+static void stat_thread(void *userdata) {
+    pa_memblock **blocks = userdata;
+    pa_mempool *pool = pa_memblock_get_pool(blocks[0]);
+    unsigned i;
+
+    for (i = 1; i < N_STAT_BLOCKS; i++)
+        pa_assert_se(blocks[i] = pa_memblock_new(pool, 100));
+}
+
+/* Blocks allocated in one thread and freed in another must add up */
+START_TEST (memblock_stat_threads_test) {
+    pa_mempool *pool;
+    pa_memblock *blocks[N_STAT_THREADS][N_STAT_BLOCKS];
+    pa_thread *threads[N_STAT_THREADS];
+    const pa_mempool_stat *stat;
+    unsigned i, j;
+
+    pool = pa_mempool_new(FALSE, 0);
+    fail_unless(pool != NULL);
+
+    for (i = 0; i < N_STAT_THREADS; i++) {
+        blocks[i][0] = pa_memblock_new(pool, 100);
+        threads[i] = pa_thread_new("stat", stat_thread, blocks[i]);
+    }
+
+    for (i = 0; i < N_STAT_THREADS; i++)
+        pa_thread_free(threads[i]);
+
+    stat = pa_mempool_get_stat(pool);
+    fail_unless(pa_atomic_load(&stat->n_allocated) == N_STAT_THREADS * N_STAT_BLOCKS);
+    fail_unless(pa_atomic_load(&stat->allocated_size) == N_STAT_THREADS * N_STAT_BLOCKS * 100);
+
+    for (i = 0; i < N_STAT_THREADS; i++)
+        for (j = 0; j < N_STAT_BLOCKS; j++)
+            pa_memblock_unref(blocks[i][j]);
+
+    stat = pa_mempool_get_stat(pool);
+    fail_unless(pa_atomic_load(&stat->n_allocated) == 0);
+    fail_unless(pa_atomic_load(&stat->allocated_size) == 0);
+    fail_unless(pa_atomic_load(&stat->n_accumulated) == N_STAT_THREADS * N_STAT_BLOCKS);
+    fail_unless(pa_atomic_load(&stat->n_slots_allocated_by_class[0]) == 0);
+
+    pa_mempool_free(pool);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -189,6 +336,9 @@ int main(int argc, char *argv[]) {
     s = suite_create("Memblock");
     tc = tcase_create("memblock");
     tcase_add_test(tc, memblock_test);
+    tcase_add_test(tc, memblock_slot_class_test);
+    tcase_add_test(tc, memblock_large_pool_test);
+    tcase_add_test(tc, memblock_stat_threads_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -23,6 +23,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <signal.h>
 
 #include <check.h>
@@ -33,6 +34,7 @@
 #include <pulsecore/strbuf.h>
 #include <pulsecore/core-util.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
 static const char *fixed[] = {
@@ -214,6 +216,212 @@ START_TEST (memblockq_test) {
 }
 END_TEST
 
+#define BENCH_N_CHUNKS 256
+#define BENCH_CHUNK_SIZE 64
+#define BENCH_READ_SIZE 1024
+#define BENCH_REWIND (4 * BENCH_READ_SIZE)
+#define BENCH_MAXREWIND (64 * 1024)
+
+static void check_pattern(const pa_memchunk *chunk, size_t length, int64_t idx) {
+    const uint8_t *d;
+    size_t i;
+
+    d = (const uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index;
+
+    for (i = 0; i < length; i++)
+        fail_unless(d[i] == (uint8_t) ((idx + (int64_t) i) / BENCH_CHUNK_SIZE));
+
+    pa_memblock_release(chunk->memblock);
+}
+
+/* Pushes n small chunks and then reads them back in sink sized blocks,
+ * rewinding every now and then like a sink does */
+static pa_usec_t run_queue(pa_memchunk chunks[], unsigned n, pa_bool_t ring, unsigned *n_blocks) {
+    pa_memblockq *bq;
+    pa_usec_t start;
+    unsigned i;
+    pa_sample_spec ss = {
+        .format = PA_SAMPLE_S16LE,
+        .rate = 48000,
+        .channels = 2
+    };
+
+    if (ring)
+        unsetenv("PULSE_NO_MEMBLOCKQ_RING");
+    else
+        setenv("PULSE_NO_MEMBLOCKQ_RING", "1", 1);
+
+    bq = pa_memblockq_new("benchmark memblockq", 0, n * BENCH_CHUNK_SIZE, 0, &ss, 0, 0, BENCH_MAXREWIND, NULL);
+    fail_unless(bq != NULL);
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < n; i++)
+        fail_unless(pa_memblockq_push(bq, &chunks[i % BENCH_N_CHUNKS]) == 0);
+
+    *n_blocks = pa_memblockq_get_nblocks(bq);
+
+    for (i = 0; pa_memblockq_get_length(bq) > 0; i++) {
+        size_t done = 0;
+
+        while (done < BENCH_READ_SIZE && pa_memblockq_get_length(bq) > 0) {
+            pa_memchunk chunk;
+            size_t l;
+
+            fail_unless(pa_memblockq_peek(bq, &chunk) == 0);
+            fail_unless(chunk.memblock != NULL);
+
+            l = PA_MIN(chunk.length, BENCH_READ_SIZE - done);
+            check_pattern(&chunk, l, pa_memblockq_get_read_index(bq));
+            pa_memblock_unref(chunk.memblock);
+
+            pa_memblockq_drop(bq, l);
+            done += l;
+        }
+
+        if (i % 16 == 15)
+            pa_memblockq_rewind(bq, (size_t) PA_MIN(pa_memblockq_get_read_index(bq), (int64_t) BENCH_REWIND));
+    }
+
+    fail_unless(pa_memblockq_get_read_index(bq) == (int64_t) n * BENCH_CHUNK_SIZE);
+
+    start = pa_rtclock_now() - start;
+
+    /* An empty queue gives back what it keeps for writing, and still
+     * works afterwards */
+    pa_memblockq_silence(bq);
+    fail_unless(!ring || pa_memblockq_trim(bq) > 0);
+    fail_unless(pa_memblockq_trim(bq) == 0);
+
+    fail_unless(pa_memblockq_push(bq, &chunks[0]) == 0);
+    fail_unless(pa_memblockq_get_nblocks(bq) == 1);
+
+    pa_memblockq_free(bq);
+    unsetenv("PULSE_NO_MEMBLOCKQ_RING");
+
+    return start;
+}
+
+static void run_benchmark(pa_memchunk chunks[], unsigned n) {
+    pa_usec_t t_ring, t_list;
+    unsigned n_ring, n_list;
+
+    t_ring = run_queue(chunks, n, TRUE, &n_ring);
+    t_list = run_queue(chunks, n, FALSE, &n_list);
+
+    /* Small writes are copied together in ring mode */
+    fail_unless(n_list == n);
+    fail_unless(n_ring < n_list);
+
+    pa_log_debug("%u pushes: ring %llu usec (%u entries), list %llu usec (%u entries)",
+                 n, (unsigned long long) t_ring, n_ring, (unsigned long long) t_list, n_list);
+}
+
+START_TEST (memblockq_benchmark) {
+    pa_mempool *p;
+    pa_memchunk chunks[BENCH_N_CHUNKS];
+    unsigned i;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    p = pa_mempool_new(FALSE, 0);
+
+    for (i = 0; i < BENCH_N_CHUNKS; i++) {
+        chunks[i].memblock = pa_memblock_new(p, BENCH_CHUNK_SIZE);
+        chunks[i].index = 0;
+        chunks[i].length = BENCH_CHUNK_SIZE;
+
+        memset(pa_memblock_acquire(chunks[i].memblock), i, BENCH_CHUNK_SIZE);
+        pa_memblock_release(chunks[i].memblock);
+    }
+
+    run_benchmark(chunks, 1000);
+    run_benchmark(chunks, 10000);
+    run_benchmark(chunks, 100000);
+
+    for (i = 0; i < BENCH_N_CHUNKS; i++)
+        pa_memblock_unref(chunks[i].memblock);
+
+    pa_mempool_free(p);
+}
+END_TEST
+
+static pa_memchunk *chunk_new(pa_mempool *p, pa_memchunk *c, size_t length, int value, pa_bool_t silence) {
+    c->memblock = pa_memblock_new(p, length);
+    c->index = 0;
+    c->length = length;
+
+    memset(pa_memblock_acquire(c->memblock), value, length);
+    pa_memblock_release(c->memblock);
+    pa_memblock_set_is_silence(c->memblock, silence);
+
+    return c;
+}
+
+/* Small writes that are copied together keep the silence flag as long
+ * as all of them had it, and writes continuing the last one in the same
+ * block are not copied at all */
+START_TEST (memblockq_coalesce_test) {
+    pa_mempool *p;
+    pa_memblockq *bq;
+    pa_memchunk silence, loud, large, chunk;
+    unsigned i;
+    pa_sample_spec ss = {
+        .format = PA_SAMPLE_S16LE,
+        .rate = 48000,
+        .channels = 2
+    };
+
+    unsetenv("PULSE_NO_MEMBLOCKQ_RING");
+
+    p = pa_mempool_new(FALSE, 0);
+    bq = pa_memblockq_new("coalesce memblockq", 0, 64 * 1024, 0, &ss, 0, 0, 0, NULL);
+    fail_unless(bq != NULL);
+
+    chunk_new(p, &silence, 64, 0, TRUE);
+    chunk_new(p, &loud, 64, 1, FALSE);
+    chunk_new(p, &large, 4096, 2, FALSE);
+
+    for (i = 0; i < 4; i++)
+        fail_unless(pa_memblockq_push(bq, &silence) == 0);
+
+    fail_unless(pa_memblockq_peek(bq, &chunk) == 0);
+    fail_unless(chunk.memblock != silence.memblock);
+    fail_unless(chunk.length == 4 * 64);
+    fail_unless(pa_memblock_is_silence(chunk.memblock));
+    pa_memblock_unref(chunk.memblock);
+    pa_memblockq_drop(bq, 4 * 64);
+
+    fail_unless(pa_memblockq_push(bq, &loud) == 0);
+    fail_unless(pa_memblockq_push(bq, &silence) == 0);
+
+    fail_unless(pa_memblockq_peek(bq, &chunk) == 0);
+    fail_unless(chunk.length == 2 * 64);
+    fail_unless(!pa_memblock_is_silence(chunk.memblock));
+    pa_memblock_unref(chunk.memblock);
+    pa_memblockq_drop(bq, 2 * 64);
+
+    large.length = 2048;
+    fail_unless(pa_memblockq_push(bq, &large) == 0);
+    large.index = 2048;
+    large.length = 256;
+    fail_unless(pa_memblockq_push(bq, &large) == 0);
+
+    fail_unless(pa_memblockq_peek(bq, &chunk) == 0);
+    fail_unless(chunk.memblock == large.memblock);
+    fail_unless(chunk.index == 0 && chunk.length == 2048 + 256);
+    pa_memblock_unref(chunk.memblock);
+
+    pa_memblockq_free(bq);
+
+    pa_memblock_unref(silence.memblock);
+    pa_memblock_unref(loud.memblock);
+    pa_memblock_unref(large.memblock);
+    pa_mempool_free(p);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -223,6 +431,8 @@ int main(int argc, char *argv[]) {
     s = suite_create("Memblock Queue");
     tc = tcase_create("memblockq");
     tcase_add_test(tc, memblockq_test);
+    tcase_add_test(tc, memblockq_coalesce_test);
+    tcase_add_test(tc, memblockq_benchmark);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -26,12 +26,17 @@
 
 #include <check.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/sample.h>
 #include <pulse/volume.h>
+#include <pulse/xmalloc.h>
 
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/endianmacros.h>
 #include <pulsecore/memblock.h>
+#include <pulsecore/random.h>
 #include <pulsecore/sample-util.h>
 
 
@@ -465,6 +470,216 @@ START_TEST (mix_test) {
 }
 END_TEST
 
+#define FRAMES 1021
+#define NSTREAMS 5
+#define TIMES 200
+
+static void fill_random(const pa_sample_spec *ss, void *d, size_t length) {
+    if (ss->format == PA_SAMPLE_FLOAT32NE) {
+        float *f = d;
+        size_t i;
+
+        for (i = 0; i < length / sizeof(float); i++)
+            f[i] = 2.0f * (float) rand() / (float) RAND_MAX - 1.0f;
+    } else
+        pa_random(d, length);
+}
+
+static void mix_with(pa_do_mix_func_t func, pa_mix_info m[], const pa_sample_spec *ss, void *d, size_t length) {
+    pa_sample_format_t f = ss->format;
+    pa_do_mix_func_t orig_func = pa_get_mix_func(f);
+
+    pa_set_mix_func(f, func);
+    pa_mix(m, NSTREAMS, d, length, ss, NULL, FALSE);
+    pa_set_mix_func(f, orig_func);
+}
+
+/* Mixes random data with random volumes, some of them muted or
+ * amplified so that the result clips, and checks that func produces
+ * exactly the same output as orig_func */
+static void run_mix_test(pa_do_mix_func_t func, pa_do_mix_func_t orig_func, pa_sample_format_t f) {
+    static const unsigned channel_counts[] = { 1, 2, 3, 6, 8, 11 };
+    pa_mempool *pool;
+    pa_sample_spec ss;
+    unsigned c, i, k;
+
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+
+    ss.format = f;
+    ss.rate = 44100;
+
+    for (c = 0; c < PA_ELEMENTSOF(channel_counts); c++) {
+        pa_mix_info m[NSTREAMS];
+        void *d, *d_ref;
+        size_t length;
+        pa_usec_t start, t_orig, t_func;
+
+        ss.channels = channel_counts[c];
+        length = FRAMES * pa_frame_size(&ss);
+
+        for (i = 0; i < NSTREAMS; i++) {
+            void *p;
+
+            m[i].chunk.memblock = pa_memblock_new(pool, length);
+            m[i].chunk.index = 0;
+            m[i].chunk.length = length;
+
+            p = pa_memblock_acquire(m[i].chunk.memblock);
+            fill_random(&ss, p, length);
+            pa_memblock_release(m[i].chunk.memblock);
+
+            m[i].volume.channels = ss.channels;
+            for (k = 0; k < ss.channels; k++) {
+                switch (rand() % 4) {
+                    case 0:
+                        m[i].volume.values[k] = PA_VOLUME_MUTED;
+                        break;
+                    case 1:
+                        m[i].volume.values[k] = pa_sw_volume_from_dB(11.0);
+                        break;
+                    default:
+                        m[i].volume.values[k] = (pa_volume_t) (rand() % (PA_VOLUME_NORM + 1));
+                        break;
+                }
+            }
+        }
+
+        d = pa_xmalloc(length);
+        d_ref = pa_xmalloc(length);
+
+        mix_with(orig_func, m, &ss, d_ref, length);
+        mix_with(func, m, &ss, d, length);
+
+        if (memcmp(d, d_ref, length) != 0) {
+            for (k = 0; k < length / pa_sample_size(&ss); k++)
+                if (memcmp((uint8_t*) d + k * pa_sample_size(&ss), (uint8_t*) d_ref + k * pa_sample_size(&ss), pa_sample_size(&ss)) != 0) {
+                    pa_log_debug("%s, %u channels: sample %u differs", pa_sample_format_to_string(f), ss.channels, k);
+                    break;
+                }
+            fail();
+        }
+
+        start = pa_rtclock_now();
+        for (k = 0; k < TIMES; k++)
+            mix_with(orig_func, m, &ss, d_ref, length);
+        t_orig = pa_rtclock_now() - start;
+
+        start = pa_rtclock_now();
+        for (k = 0; k < TIMES; k++)
+            mix_with(func, m, &ss, d, length);
+        t_func = pa_rtclock_now() - start;
+
+        pa_log_debug("%s, %u channels, %u streams: reference %llu usec, optimized %llu usec",
+                     pa_sample_format_to_string(f), ss.channels, NSTREAMS,
+                     (unsigned long long) t_orig, (unsigned long long) t_func);
+
+        pa_xfree(d);
+        pa_xfree(d_ref);
+
+        for (i = 0; i < NSTREAMS; i++)
+            pa_memblock_unref(m[i].chunk.memblock);
+    }
+
+    pa_mempool_free(pool);
+}
+
+static void run_mix_tests(pa_do_mix_func_t orig_funcs[PA_SAMPLE_MAX]) {
+    pa_sample_format_t f;
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++) {
+        pa_do_mix_func_t func = pa_get_mix_func(f);
+
+        if (func == orig_funcs[f])
+            continue;
+
+        pa_log_debug("Checking %s", pa_sample_format_to_string(f));
+        run_mix_test(func, orig_funcs[f], f);
+
+        /* Leave the C version in place for the next instruction set */
+        pa_set_mix_func(f, orig_funcs[f]);
+    }
+}
+
+static void get_mix_funcs(pa_do_mix_func_t funcs[PA_SAMPLE_MAX]) {
+    pa_sample_format_t f;
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++)
+        funcs[f] = pa_get_mix_func(f);
+}
+
+#if defined (__i386__) || defined (__amd64__)
+START_TEST (mix_sse_test) {
+    pa_do_mix_func_t orig_funcs[PA_SAMPLE_MAX];
+    pa_cpu_x86_flag_t flags = 0;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+#ifdef HAVE_SSE2_INTRINSICS
+    get_mix_funcs(orig_funcs);
+    pa_mix_func_init_sse(flags);
+    run_mix_tests(orig_funcs);
+#else
+    pa_log_info("SSE2 mixing functions not built. Skipping");
+#endif
+}
+END_TEST
+
+START_TEST (mix_avx_test) {
+    pa_do_mix_func_t orig_funcs[PA_SAMPLE_MAX];
+    pa_cpu_x86_flag_t flags = 0;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+#ifdef HAVE_AVX2_INTRINSICS
+    get_mix_funcs(orig_funcs);
+    pa_mix_func_init_avx(flags);
+    run_mix_tests(orig_funcs);
+#else
+    pa_log_info("AVX2 mixing functions not built. Skipping");
+#endif
+}
+END_TEST
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+#if (defined (__arm__) && defined (__linux__)) || defined (__aarch64__)
+START_TEST (mix_neon_test) {
+    pa_do_mix_func_t orig_funcs[PA_SAMPLE_MAX];
+    pa_cpu_arm_flag_t flags = 0;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    /* There is no way to only query the flags, pa_cpu_init_arm()
+     * installs the NEON functions right away */
+    get_mix_funcs(orig_funcs);
+    pa_cpu_init_arm(&flags);
+
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+    run_mix_tests(orig_funcs);
+}
+END_TEST
+#endif /* (defined (__arm__) && defined (__linux__)) || defined (__aarch64__) */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -474,6 +689,13 @@ int main(int argc, char *argv[]) {
     s = suite_create("Mix");
     tc = tcase_create("mix");
     tcase_add_test(tc, mix_test);
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, mix_sse_test);
+    tcase_add_test(tc, mix_avx_test);
+#endif
+#if (defined (__arm__) && defined (__linux__)) || defined (__aarch64__)
+    tcase_add_test(tc, mix_neon_test);
+#endif
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -0,0 +1,425 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/iochannel.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/pstream.h>
+#include <pulsecore/shm.h>
+#include <pulsecore/socket.h>
+
+#define N_PACKETS 200
+
+/* A client connection: the client end and the server end of a socket
+ * pair, running on the same main loop */
+struct connection {
+    pa_mainloop *mainloop;
+    pa_mempool *pool, *server_pool;
+    pa_pstream *client, *server;
+
+    /* Which packets the client sent credentials with */
+    pa_bool_t with_creds[N_PACKETS];
+
+    /* What the server got so far */
+    unsigned n_packets;
+    size_t memblock_bytes;
+    uint8_t expect;
+    pa_bool_t corrupt;
+};
+
+/* Unless server_pool is given, both ends share client_pool. The
+ * connection takes ownership of the pools. */
+static void connection_init_pools(struct connection *c, pa_bool_t batching, pa_mempool *client_pool, pa_mempool *server_pool) {
+    pa_mainloop_api *api;
+    pa_iochannel *io;
+    int fds[2];
+
+    pa_zero(*c);
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    pa_make_fd_nonblock(fds[0]);
+    pa_make_fd_nonblock(fds[1]);
+
+    c->mainloop = pa_mainloop_new();
+    api = pa_mainloop_get_api(c->mainloop);
+    c->pool = client_pool;
+    c->server_pool = server_pool;
+
+    if (!batching)
+        setenv("PULSE_NO_PSTREAM_BATCHING", "1", 1);
+
+    io = pa_iochannel_new(api, fds[1], fds[1]);
+#ifdef HAVE_CREDS
+    fail_unless(pa_iochannel_creds_enable(io) == 0);
+#endif
+
+    c->client = pa_pstream_new(api, pa_iochannel_new(api, fds[0], fds[0]), c->pool);
+    c->server = pa_pstream_new(api, io, c->server_pool ? c->server_pool : c->pool);
+
+    unsetenv("PULSE_NO_PSTREAM_BATCHING");
+}
+
+static void connection_init(struct connection *c, pa_bool_t batching) {
+    connection_init_pools(c, batching, pa_mempool_new(FALSE, 0), NULL);
+}
+
+static void connection_done(struct connection *c) {
+    pa_pstream_unlink(c->client);
+    pa_pstream_unref(c->client);
+    pa_pstream_unlink(c->server);
+    pa_pstream_unref(c->server);
+
+    pa_mempool_free(c->pool);
+    if (c->server_pool)
+        pa_mempool_free(c->server_pool);
+    pa_mainloop_free(c->mainloop);
+}
+
+/* Every payload byte is one more than the one before, across all frames,
+ * so anything lost, duplicated or reordered shows up */
+static void fill(uint8_t *d, size_t length, uint8_t *next) {
+    size_t i;
+
+    for (i = 0; i < length; i++)
+        d[i] = (*next)++;
+}
+
+static void check(struct connection *c, const uint8_t *d, size_t length) {
+    size_t i;
+
+    for (i = 0; i < length; i++)
+        if (d[i] != c->expect++)
+            c->corrupt = TRUE;
+}
+
+static void packet_cb(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
+    struct connection *c = userdata;
+
+    check(c, packet->data, packet->length);
+
+    /* Credentials must arrive with the frame they were sent with, even
+     * if it was written together with others */
+    if (c->n_packets < N_PACKETS && c->with_creds[c->n_packets])
+        fail_unless(creds != NULL);
+
+    c->n_packets++;
+}
+
+static void memblock_cb(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    struct connection *c = userdata;
+    uint8_t *d;
+
+    fail_unless(channel == 7);
+
+    d = pa_memblock_acquire(chunk->memblock);
+    check(c, d + chunk->index, chunk->length);
+    pa_memblock_release(chunk->memblock);
+
+    c->memblock_bytes += chunk->length;
+}
+
+static void send_packet(struct connection *c, size_t length, uint8_t *next, const pa_creds *creds) {
+    pa_packet *packet;
+
+    packet = pa_packet_new(length);
+    fill(packet->data, length, next);
+    pa_pstream_send_packet(c->client, packet, creds);
+    pa_packet_unref(packet);
+}
+
+static void send_memblock_from(pa_pstream *p, pa_mempool *pool, size_t length, uint8_t *next) {
+    pa_memchunk chunk;
+
+    chunk.memblock = pa_memblock_new(pool, length);
+    chunk.index = 0;
+    chunk.length = length;
+
+    fill(pa_memblock_acquire(chunk.memblock), length, next);
+    pa_memblock_release(chunk.memblock);
+
+    pa_pstream_send_memblock(p, 7, 0, PA_SEEK_RELATIVE, &chunk);
+    pa_memblock_unref(chunk.memblock);
+}
+
+static void send_memblock(struct connection *c, size_t length, uint8_t *next) {
+    send_memblock_from(c->client, c->pool, length, next);
+}
+
+/* Runs the main loop until the server has received n_packets packets and
+ * memblock_bytes bytes of audio */
+static void run(struct connection *c, unsigned n_packets, size_t memblock_bytes) {
+    while (c->n_packets < n_packets || c->memblock_bytes < memblock_bytes)
+        fail_unless(pa_mainloop_iterate(c->mainloop, 1, NULL) >= 0);
+
+    fail_unless(!pa_pstream_is_pending(c->client));
+}
+
+static void run_test(pa_bool_t batching) {
+    struct connection c;
+    uint8_t next = 0;
+    unsigned i;
+    size_t memblock_bytes = 0;
+
+    connection_init(&c, batching);
+
+    pa_pstream_set_receive_packet_callback(c.server, packet_cb, &c);
+    pa_pstream_set_receive_memblock_callback(c.server, memblock_cb, &c);
+
+    /* Small and large packets, audio data that is split into several
+     * frames, and frames bigger than the read buffer */
+    for (i = 0; i < N_PACKETS; i++) {
+        size_t length = (i % 17) * 97 + 1;
+        pa_creds *creds = NULL;
+
+#ifdef HAVE_CREDS
+        pa_creds ucred;
+
+        if (i % 10 == 3) {
+            ucred.uid = getuid();
+            ucred.gid = getgid();
+            creds = &ucred;
+            c.with_creds[i] = TRUE;
+        }
+#endif
+
+        send_packet(&c, length, &next, creds);
+
+        if (i % 7 == 0) {
+            length = i % 3 == 0 ? 200000 : i * 31 + 1;
+            send_memblock(&c, length, &next);
+            memblock_bytes += length;
+        }
+    }
+
+    run(&c, N_PACKETS, memblock_bytes);
+
+    fail_unless(!c.corrupt);
+    fail_unless(c.n_packets == N_PACKETS);
+    fail_unless(c.memblock_bytes == memblock_bytes);
+
+    connection_done(&c);
+}
+
+START_TEST (pstream_test) {
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    run_test(TRUE);
+    run_test(FALSE);
+}
+END_TEST
+
+#ifdef HAVE_CREDS
+
+/* Imported blocks are read-only, those that came through the socket
+ * are not */
+static void shm_memblock_cb(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    fail_unless(chunk->memblock != NULL);
+    fail_unless(pa_memblock_is_read_only(chunk->memblock));
+
+    memblock_cb(p, channel, offset, seek, chunk, userdata);
+}
+
+START_TEST (pstream_memfd_test) {
+    struct connection c;
+    pa_mempool *client_pool, *private_pool;
+    uint8_t next = 0;
+    unsigned i;
+    size_t memblock_bytes = 0;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    if (!pa_shm_memfd_supported()) {
+        pa_log_info("memfd not supported, skipping test.");
+        return;
+    }
+
+    /* Like a client with a memfd pool talking to the daemon, whose
+     * main pool is POSIX shared memory and which sends to the client
+     * from a memfd pool of its own */
+    fail_unless((client_pool = pa_mempool_new_memfd(0)) != NULL);
+    fail_unless((private_pool = pa_mempool_new_memfd(1024*1024)) != NULL);
+    connection_init_pools(&c, TRUE, client_pool, pa_mempool_new(TRUE, 0));
+
+    pa_pstream_enable_shm(c.client, TRUE);
+    pa_pstream_enable_shm(c.server, TRUE);
+    fail_unless(pa_pstream_register_memfd_mempool(c.client, c.pool) == 0);
+    fail_unless(pa_pstream_register_memfd_mempool(c.server, private_pool) == 0);
+
+    /* Like a repeated AUTH: the other side may still refer to blocks
+     * of the export, so it must not be replaced */
+    fail_unless(pa_pstream_register_memfd_mempool(c.server, private_pool) == 0);
+    fail_unless(pa_pstream_register_memfd_mempool(c.server, c.pool) < 0);
+
+    pa_pstream_set_receive_memblock_callback(c.server, shm_memblock_cb, &c);
+    pa_pstream_set_receive_memblock_callback(c.client, shm_memblock_cb, &c);
+
+    for (i = 0; i < 20; i++) {
+        size_t length = i * 997 + 1;
+
+        send_memblock(&c, length, &next);
+        memblock_bytes += length;
+        run(&c, 0, memblock_bytes);
+    }
+
+    /* What the server sends from its main pool ends up in the
+     * private one */
+    for (i = 0; i < 20; i++) {
+        size_t length = i * 997 + 1;
+
+        send_memblock_from(c.server, c.server_pool, length, &next);
+        memblock_bytes += length;
+
+        while (c.memblock_bytes < memblock_bytes)
+            fail_unless(pa_mainloop_iterate(c.mainloop, 1, NULL) >= 0);
+    }
+
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(private_pool)->n_accumulated) == 20);
+
+    /* What already is in the private pool is handed out as is */
+    for (i = 0; i < 20; i++) {
+        size_t length = i * 997 + 1;
+
+        send_memblock_from(c.server, private_pool, length, &next);
+        memblock_bytes += length;
+
+        while (c.memblock_bytes < memblock_bytes)
+            fail_unless(pa_mainloop_iterate(c.mainloop, 1, NULL) >= 0);
+    }
+
+    fail_unless(!c.corrupt);
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(private_pool)->n_accumulated) == 40);
+
+    connection_done(&c);
+    pa_mempool_free(private_pool);
+}
+END_TEST
+
+#endif
+
+/* A chatty client: bursts of small control packets, like the stream
+ * setup and volume changes of a busy desktop, with some audio in
+ * between */
+
+#define BENCH_BURSTS 2000
+#define BENCH_BURST_PACKETS 16
+#define BENCH_PACKET_SIZE 64
+#define BENCH_MEMBLOCK_SIZE 1024
+
+static pa_usec_t cpu_time(void) {
+    struct rusage ru;
+
+    pa_assert_se(getrusage(RUSAGE_SELF, &ru) == 0);
+
+    return pa_timeval_load(&ru.ru_utime) + pa_timeval_load(&ru.ru_stime);
+}
+
+static void run_benchmark(pa_bool_t batching, pa_usec_t *wall, pa_usec_t *cpu) {
+    struct connection c;
+    pa_usec_t start_wall, start_cpu;
+    uint8_t next = 0;
+    unsigned i, j, n_packets = 0;
+    size_t memblock_bytes = 0;
+
+    connection_init(&c, batching);
+
+    pa_pstream_set_receive_packet_callback(c.server, packet_cb, &c);
+    pa_pstream_set_receive_memblock_callback(c.server, memblock_cb, &c);
+
+    start_wall = pa_rtclock_now();
+    start_cpu = cpu_time();
+
+    for (i = 0; i < BENCH_BURSTS; i++) {
+
+        for (j = 0; j < BENCH_BURST_PACKETS; j++)
+            send_packet(&c, BENCH_PACKET_SIZE, &next, NULL);
+
+        send_memblock(&c, BENCH_MEMBLOCK_SIZE, &next);
+
+        n_packets += BENCH_BURST_PACKETS;
+        memblock_bytes += BENCH_MEMBLOCK_SIZE;
+
+        run(&c, n_packets, memblock_bytes);
+    }
+
+    *wall = pa_rtclock_now() - start_wall;
+    *cpu = cpu_time() - start_cpu;
+
+    fail_unless(!c.corrupt);
+
+    connection_done(&c);
+}
+
+START_TEST (pstream_benchmark) {
+    pa_usec_t wall, cpu, wall_batching, cpu_batching;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    run_benchmark(FALSE, &wall, &cpu);
+    run_benchmark(TRUE, &wall_batching, &cpu_batching);
+
+    pa_log_debug("%u bursts of %u packets and one memblock: %llu usec (%llu usec CPU) with batching, %llu usec (%llu usec CPU) without",
+                 BENCH_BURSTS, BENCH_BURST_PACKETS,
+                 (unsigned long long) wall_batching, (unsigned long long) cpu_batching,
+                 (unsigned long long) wall, (unsigned long long) cpu);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Packet stream");
+    tc = tcase_create("pstream");
+    tcase_add_test(tc, pstream_test);
+#ifdef HAVE_CREDS
+    tcase_add_test(tc, pstream_memfd_test);
+#endif
+    tcase_add_test(tc, pstream_benchmark);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,130 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <check.h>
+
+#include <pulse/timeval.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/rate-controller.h>
+
+#define ADJUST_TIME (10*PA_USEC_PER_SEC)
+#define MAX_DEVIATION PA_RATE_CONTROLLER_MAX_DEVIATION
+
+/* Simulates a buffer between two clocks that drift apart by drift,
+ * measured with up to +/- noise usec of jitter. Returns the mean
+ * absolute error of the last 50 of n updates, and in *factor the mean
+ * factor over them and in *undershoot how far the error went below
+ * zero at worst. */
+static double simulate(pa_rate_controller *c, double drift, double error, double noise, unsigned n, double *factor, double *undershoot) {
+    double sum = 0;
+    unsigned k;
+
+    *factor = 0;
+    *undershoot = 0;
+
+    for (k = 0; k < n; k++) {
+        double measured = error + noise * (2.0 * rand() / RAND_MAX - 1.0);
+        double f = pa_rate_controller_update(c, (int64_t) measured);
+
+        fail_unless(f >= 1.0 - MAX_DEVIATION && f <= 1.0 + MAX_DEVIATION);
+
+        error += (drift - (f - 1.0)) * ADJUST_TIME;
+
+        if (-error > *undershoot)
+            *undershoot = -error;
+
+        if (k + 50 >= n) {
+            sum += fabs(error);
+            *factor += f / 50;
+        }
+
+        pa_log_debug("%u\terror=%0.0f usec\tfactor=%0.6f", k, error, f);
+    }
+
+    return sum / 50;
+}
+
+START_TEST (convergence_test) {
+    pa_rate_controller *c;
+    double drift, factor, undershoot;
+
+    srand(0);
+
+    c = pa_rate_controller_new(ADJUST_TIME, MAX_DEVIATION);
+
+    /* Start 50 ms off with up to 100 ppm drift and 500 usec jitter */
+    for (drift = -1e-4; drift <= 1e-4; drift += 1e-4) {
+        pa_rate_controller_reset(c);
+
+        fail_unless(simulate(c, drift, 50 * PA_USEC_PER_MSEC, 500, 200, &factor, &undershoot) < PA_USEC_PER_MSEC);
+        fail_unless(fabs(factor - 1.0 - drift) < 5e-6);
+    }
+
+    pa_rate_controller_free(c);
+}
+END_TEST
+
+START_TEST (saturation_test) {
+    pa_rate_controller *c;
+    double factor, undershoot;
+
+    c = pa_rate_controller_new(ADJUST_TIME, MAX_DEVIATION);
+
+    /* Working off a huge error takes many saturated updates. Some swing
+     * past zero is what a PI controller does, but a wound up integral
+     * would make it as large as the error was. */
+    fail_unless(simulate(c, 0, 2 * PA_USEC_PER_SEC, 0, 300, &factor, &undershoot) < PA_USEC_PER_MSEC);
+    fail_unless(fabs(factor - 1.0) < 1e-6);
+    fail_unless(undershoot < 10 * PA_USEC_PER_MSEC);
+
+    pa_rate_controller_free(c);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Rate Controller");
+    tc = tcase_create("ratecontroller");
+    tcase_add_test(tc, convergence_test);
+    tcase_add_test(tc, saturation_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
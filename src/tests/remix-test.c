@@ -22,35 +22,187 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/sample.h>
+#include <pulse/xmalloc.h>
 
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
 #include <pulsecore/resampler.h>
+#include <pulsecore/remap.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/memblock.h>
+#include <pulsecore/random.h>
 
-int main(int argc, char *argv[]) {
+static const pa_channel_map maps[] = {
+    { 1, { PA_CHANNEL_POSITION_MONO } },
+    { 2, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT } },
+    { 3, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_CENTER } },
+    { 3, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_LFE } },
+    { 3, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_REAR_CENTER } },
+    { 4, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_CENTER, PA_CHANNEL_POSITION_LFE } },
+    { 4, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_CENTER, PA_CHANNEL_POSITION_REAR_CENTER } },
+    { 4, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT } },
+    { 5, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT, PA_CHANNEL_POSITION_CENTER } },
+    { 5, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT, PA_CHANNEL_POSITION_LFE } },
+    { 6, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT, PA_CHANNEL_POSITION_LFE, PA_CHANNEL_POSITION_CENTER } },
+    { 8, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT, PA_CHANNEL_POSITION_LFE, PA_CHANNEL_POSITION_CENTER, PA_CHANNEL_POSITION_SIDE_LEFT, PA_CHANNEL_POSITION_SIDE_RIGHT } },
+    { 0, { 0 } }
+};
+
+#define FRAMES 1021
+#define TIMES 200
+
+static void fill_random(pa_sample_format_t f, void *d, size_t length) {
+    if (f == PA_SAMPLE_FLOAT32NE) {
+        float *p = d;
+        size_t i;
+
+        for (i = 0; i < length / sizeof(float); i++)
+            p[i] = 2.0f * (float) rand() / (float) RAND_MAX - 1.0f;
+    } else
+        pa_random(d, length);
+}
+
+/* Integer samples have to match exactly. Whether a compiler contracts
+ * the float multiply-adds of the reference into FMAs depends on the
+ * architecture and flags, so float samples may differ in their last
+ * bits. */
+static pa_bool_t same_output(pa_sample_format_t f, const void *a, const void *b, size_t length) {
+    const float *x = a, *y = b;
+    size_t i;
+
+    if (f != PA_SAMPLE_FLOAT32NE)
+        return memcmp(a, b, length) == 0;
+
+    for (i = 0; i < length / sizeof(float); i++)
+        if (fabsf(x[i] - y[i]) > 8 * FLT_EPSILON * PA_MAX(fabsf(y[i]), 1.0f))
+            return FALSE;
+
+    return TRUE;
+}
+
+static void *remap_with(pa_resampler *r, const pa_memchunk *in, size_t *length) {
+    pa_memchunk out;
+    void *d;
+
+    pa_resampler_run(r, in, &out);
+
+    *length = out.length;
+    d = pa_xmemdup((uint8_t*) pa_memblock_acquire(out.memblock) + out.index, out.length);
+    pa_memblock_release(out.memblock);
+    pa_memblock_unref(out.memblock);
+
+    return d;
+}
+
+static pa_usec_t time_remap(pa_resampler *r, const pa_memchunk *in) {
+    pa_usec_t start;
+    unsigned k;
+
+    start = pa_rtclock_now();
+
+    for (k = 0; k < TIMES; k++) {
+        pa_memchunk out;
+
+        pa_resampler_run(r, in, &out);
+        pa_memblock_unref(out.memblock);
+    }
+
+    return pa_rtclock_now() - start;
+}
+
+/* Remaps random data between all the channel maps, with the remapping
+ * functions orig_func sets up and those that are installed now, and
+ * checks that both produce the same output, see same_output(). With benchmark set
+ * it also prints how long each takes. */
+static pa_bool_t run_remap_tests(pa_mempool *pool, pa_init_remap_func_t orig_func, const char *name, pa_bool_t benchmark) {
+    static const pa_sample_format_t formats[] = { PA_SAMPLE_S16NE, PA_SAMPLE_FLOAT32NE };
+    pa_init_remap_func_t func = pa_get_init_remap_func();
+    unsigned f, i, j;
+    pa_bool_t ok = TRUE;
+
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++)
+        for (i = 0; maps[i].channels > 0; i++)
+            for (j = 0; maps[j].channels > 0; j++) {
+                pa_sample_spec ss1, ss2;
+                pa_resampler *r_orig, *r;
+                pa_memchunk in;
+                void *d, *d_orig;
+                size_t length, length_orig;
+
+                ss1.format = ss2.format = formats[f];
+                ss1.rate = ss2.rate = 44100;
+                ss1.channels = maps[i].channels;
+                ss2.channels = maps[j].channels;
+
+                pa_set_init_remap_func(orig_func);
+                pa_assert_se(r_orig = pa_resampler_new(pool, &ss1, &maps[i], &ss2, &maps[j], PA_RESAMPLER_COPY, 0));
+                pa_set_init_remap_func(func);
+                pa_assert_se(r = pa_resampler_new(pool, &ss1, &maps[i], &ss2, &maps[j], PA_RESAMPLER_COPY, 0));
+
+                in.memblock = pa_memblock_new(pool, FRAMES * pa_frame_size(&ss1));
+                in.index = 0;
+                in.length = pa_memblock_get_length(in.memblock);
+                fill_random(formats[f], pa_memblock_acquire(in.memblock), in.length);
+                pa_memblock_release(in.memblock);
 
-    static const pa_channel_map maps[] = {
-        { 1, { PA_CHANNEL_POSITION_MONO } },
-        { 2, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT } },
-        { 3, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_CENTER } },
-        { 3, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_LFE } },
-        { 3, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_REAR_CENTER } },
-        { 4, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_CENTER, PA_CHANNEL_POSITION_LFE } },
-        { 4, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_CENTER, PA_CHANNEL_POSITION_REAR_CENTER } },
-        { 4, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT } },
-        { 5, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT, PA_CHANNEL_POSITION_CENTER } },
-        { 5, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT, PA_CHANNEL_POSITION_LFE } },
-        { 6, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT, PA_CHANNEL_POSITION_LFE, PA_CHANNEL_POSITION_CENTER } },
-        { 8, { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT, PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT, PA_CHANNEL_POSITION_LFE, PA_CHANNEL_POSITION_CENTER, PA_CHANNEL_POSITION_SIDE_LEFT, PA_CHANNEL_POSITION_SIDE_RIGHT } },
-        { 0, { 0 } }
-    };
+                d_orig = remap_with(r_orig, &in, &length_orig);
+                d = remap_with(r, &in, &length);
 
+                if (length != length_orig || !same_output(formats[f], d, d_orig, length)) {
+                    char a[PA_CHANNEL_MAP_SNPRINT_MAX], b[PA_CHANNEL_MAP_SNPRINT_MAX];
+
+                    pa_log_error("%s remapping from '%s' to '%s' for %s differs from the reference", name,
+                                 pa_channel_map_snprint(a, sizeof(a), &maps[i]),
+                                 pa_channel_map_snprint(b, sizeof(b), &maps[j]),
+                                 pa_sample_format_to_string(formats[f]));
+                    ok = FALSE;
+                }
+
+                pa_xfree(d);
+                pa_xfree(d_orig);
+
+                if (benchmark) {
+                    char a[PA_CHANNEL_MAP_SNPRINT_MAX], b[PA_CHANNEL_MAP_SNPRINT_MAX];
+                    pa_usec_t t_orig, t;
+
+                    t_orig = time_remap(r_orig, &in);
+                    t = time_remap(r, &in);
+
+                    printf("%s, '%s' to '%s': reference %llu usec, %s %llu usec\n",
+                           pa_sample_format_to_string(formats[f]),
+                           pa_channel_map_snprint(a, sizeof(a), &maps[i]),
+                           pa_channel_map_snprint(b, sizeof(b), &maps[j]),
+                           (unsigned long long) t_orig, name, (unsigned long long) t);
+                }
+
+                pa_memblock_unref(in.memblock);
+                pa_resampler_free(r);
+                pa_resampler_free(r_orig);
+            }
+
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
     unsigned i, j;
     pa_mempool *pool;
+    pa_init_remap_func_t orig_func;
+    pa_bool_t benchmark = FALSE, ok = TRUE;
 
-    pa_log_set_level(PA_LOG_DEBUG);
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    /* Timing all the optimized remapping functions against the C
+     * versions takes a while, so only do it if asked to */
+    if (argc > 1 && strcmp(argv[1], "--benchmark") == 0)
+        benchmark = TRUE;
 
     pa_assert_se(pool = pa_mempool_new(FALSE, 0));
 
@@ -76,8 +228,51 @@ int main(int argc, char *argv[]) {
             pa_resampler_free(r);
         }
 
+    /* The resampler logs its choices for every stream, that would drown
+     * the results */
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_WARN);
+
+    orig_func = pa_get_init_remap_func();
+
+#if defined (__i386__) || defined (__amd64__)
+    {
+        pa_cpu_x86_flag_t flags = 0;
+
+        pa_cpu_get_x86_flags(&flags);
+
+#ifdef HAVE_SSE2_INTRINSICS
+        if (flags & PA_CPU_X86_SSE2) {
+            pa_remap_func_init_sse(flags);
+            ok = run_remap_tests(pool, orig_func, "SSE2", benchmark) && ok;
+        }
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+        if (flags & PA_CPU_X86_AVX2) {
+            pa_remap_func_init_avx(flags);
+            ok = run_remap_tests(pool, orig_func, "AVX2", benchmark) && ok;
+        }
+#endif
+    }
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+#if ((defined (__arm__) && defined (__linux__)) || defined (__aarch64__)) && defined (HAVE_NEON_INTRINSICS)
+    {
+        pa_cpu_arm_flag_t flags = 0;
+
+        /* There is no way to only query the flags, pa_cpu_init_arm()
+         * installs the NEON functions right away */
+        pa_cpu_init_arm(&flags);
+
+        if (flags & PA_CPU_ARM_NEON)
+            ok = run_remap_tests(pool, orig_func, "NEON", benchmark) && ok;
+    }
+#endif
+
+    pa_set_init_remap_func(orig_func);
 
     pa_mempool_free(pool);
 
-    return 0;
+    return ok ? 0 : 1;
 }
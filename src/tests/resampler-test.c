@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <getopt.h>
 #include <locale.h>
+#include <math.h>
 
 #include <pulse/pulseaudio.h>
 
@@ -39,6 +40,11 @@
 #include <pulsecore/memblock.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/random.h>
+#include <pulsecore/resampler-cache.h>
+#include <pulsecore/sinc.h>
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
 
 static void dump_block(const char *label, const pa_sample_spec *ss, const pa_memchunk *chunk) {
     void *d;
@@ -253,6 +259,689 @@ static pa_memblock* generate_block(pa_mempool *pool, const pa_sample_spec *ss) {
     return r;
 }
 
+/* Runs each configuration through a resampler with and without the fused
+ * conversion pipeline, checks that both produce the same data and reports
+ * the memory blocks that were allocated and the time per frame */
+
+#define BENCHMARK_FRAMES 4096
+
+static const struct {
+    pa_sample_spec from, to;
+} benchmark_configs[] = {
+    { { PA_SAMPLE_S16LE, 44100, 2 }, { PA_SAMPLE_S16LE, 44100, 1 } },
+    { { PA_SAMPLE_S16LE, 48000, 2 }, { PA_SAMPLE_FLOAT32LE, 48000, 6 } },
+    { { PA_SAMPLE_S24LE, 48000, 2 }, { PA_SAMPLE_S16LE, 48000, 1 } },
+    { { PA_SAMPLE_S32LE, 48000, 6 }, { PA_SAMPLE_S16LE, 48000, 2 } },
+    { { PA_SAMPLE_FLOAT32LE, 44100, 2 }, { PA_SAMPLE_S16LE, 48000, 1 } },
+    { { PA_SAMPLE_S24LE, 44100, 6 }, { PA_SAMPLE_FLOAT32LE, 48000, 2 } },
+};
+
+static pa_usec_t benchmark_run(pa_resampler *r, pa_mempool *pool, const pa_memchunk *i, unsigned iterations, unsigned *n_allocated) {
+    const pa_mempool_stat *stat = pa_mempool_get_stat(pool);
+    unsigned n, k;
+    pa_usec_t ts;
+
+    n = (unsigned) pa_atomic_load(&stat->n_accumulated);
+    ts = pa_rtclock_now();
+
+    for (k = 0; k < iterations; k++) {
+        pa_memchunk j;
+
+        pa_resampler_run(r, i, &j);
+        if (j.memblock)
+            pa_memblock_unref(j.memblock);
+    }
+
+    ts = pa_rtclock_now() - ts;
+    *n_allocated = (unsigned) pa_atomic_load(&stat->n_accumulated) - n;
+
+    return ts;
+}
+
+static pa_bool_t run_pipeline_benchmark(pa_mempool *pool, pa_resample_method_t method, unsigned iterations) {
+    pa_bool_t ok = TRUE;
+    unsigned c, k;
+
+    for (c = 0; c < PA_ELEMENTSOF(benchmark_configs); c++) {
+        const pa_sample_spec *a = &benchmark_configs[c].from, *b = &benchmark_configs[c].to;
+        const pa_mempool_stat *stat = pa_mempool_get_stat(pool);
+        pa_resampler *plain, *fused;
+        pa_memchunk i, j_plain, j_fused;
+        pa_usec_t t_plain, t_fused;
+        unsigned n_plain, n_fused, kept_plain, kept_fused;
+        int before;
+        uint8_t *d;
+
+        before = pa_atomic_load(&stat->n_allocated);
+
+        pa_set_env_and_record("PULSE_NO_RESAMPLER_FUSION", "1");
+        pa_assert_se(plain = pa_resampler_new(pool, a, NULL, b, NULL, method, 0));
+        pa_unset_env_recorded();
+        pa_assert_se(fused = pa_resampler_new(pool, a, NULL, b, NULL, method, 0));
+
+        i.memblock = pa_memblock_new(pool, BENCHMARK_FRAMES * pa_frame_size(a));
+        i.index = 0;
+        i.length = pa_memblock_get_length(i.memblock);
+
+        /* Full scale noise */
+        d = pa_memblock_acquire(i.memblock);
+        if (a->format == PA_SAMPLE_FLOAT32LE)
+            for (k = 0; k < i.length / sizeof(float); k++)
+                ((float*) d)[k] = 2.0f * (rand() / (float) RAND_MAX - 0.5f);
+        else
+            pa_random(d, i.length);
+        pa_memblock_release(i.memblock);
+
+        t_plain = benchmark_run(plain, pool, &i, iterations, &n_plain);
+        t_fused = benchmark_run(fused, pool, &i, iterations, &n_fused);
+
+        /* Both went through the same data, so any resampler state is the
+         * same too */
+        pa_resampler_run(plain, &i, &j_plain);
+        pa_resampler_run(fused, &i, &j_fused);
+
+        if (j_plain.length != j_fused.length ||
+            memcmp(pa_memblock_acquire_chunk(&j_plain), pa_memblock_acquire_chunk(&j_fused), j_plain.length) != 0) {
+            pa_log_error("Fused pipeline differs for %s %u ch -> %s %u ch",
+                         pa_sample_format_to_string(a->format), a->channels,
+                         pa_sample_format_to_string(b->format), b->channels);
+            ok = FALSE;
+        }
+
+        pa_memblock_release(j_plain.memblock);
+        pa_memblock_release(j_fused.memblock);
+        pa_memblock_unref(j_plain.memblock);
+        pa_memblock_unref(j_fused.memblock);
+
+        pa_memblock_unref(i.memblock);
+
+        /* What is left now are the intermediate buffers of both resamplers */
+        kept_fused = (unsigned) (pa_atomic_load(&stat->n_allocated) - before);
+        pa_resampler_free(plain);
+        kept_plain = kept_fused - (unsigned) (pa_atomic_load(&stat->n_allocated) - before);
+        kept_fused -= kept_plain;
+        pa_resampler_free(fused);
+
+        pa_log_info("%s %u ch %u Hz -> %s %u ch %u Hz: %u blocks allocated, %u kept, %0.1f ns/frame; "
+                    "fused: %u blocks allocated, %u kept, %0.1f ns/frame",
+                    pa_sample_format_to_string(a->format), a->channels, a->rate,
+                    pa_sample_format_to_string(b->format), b->channels, b->rate,
+                    n_plain, kept_plain, (double) t_plain * 1000.0 / (iterations * BENCHMARK_FRAMES),
+                    n_fused, kept_fused, (double) t_fused * 1000.0 / (iterations * BENCHMARK_FRAMES));
+    }
+
+    return ok;
+}
+
+/* Quality of the actual rate conversion, measured with sine waves. A
+ * least squares fit gives the gain at the tone's frequency, everything
+ * else in the output counts as noise: images, aliases and rounding. */
+
+#define QUALITY_FRAMES 48000
+#define QUALITY_CHUNK 1000
+
+static const pa_resample_method_t quality_methods[] = {
+    PA_RESAMPLER_SINC_BASE + 0,
+    PA_RESAMPLER_SINC_BASE + 1,
+    PA_RESAMPLER_SINC_BASE + 2,
+    PA_RESAMPLER_SINC_BASE + 3,
+    PA_RESAMPLER_SPEEX_FLOAT_BASE + 1,
+    PA_RESAMPLER_SPEEX_FLOAT_BASE + 3,
+    PA_RESAMPLER_SPEEX_FLOAT_BASE + 6,
+    PA_RESAMPLER_SPEEX_FLOAT_BASE + 9,
+    PA_RESAMPLER_FFMPEG
+};
+
+/* Minimum SNR at 1 kHz and minimum gain at 80% of the lower Nyquist
+ * frequency that our own resampler must reach at each quality */
+static const double sinc_min_snr[] = { 40.0, 70.0, 85.0, 100.0 };
+static const double sinc_min_passband[] = { -6.0, -1.0, -0.2, -0.1 };
+
+static float *resample_float(pa_mempool *pool, pa_resampler *r, const float *in, unsigned n_in, unsigned channels, unsigned *n_out) {
+    float *out = NULL;
+    unsigned k, n = 0;
+
+    for (k = 0; k < n_in; k += QUALITY_CHUNK) {
+        pa_memchunk i, j;
+        unsigned frames = PA_MIN((unsigned) QUALITY_CHUNK, n_in - k);
+
+        i.memblock = pa_memblock_new_fixed(pool, (void*) (in + k * channels), frames * channels * sizeof(float), TRUE);
+        i.index = 0;
+        i.length = frames * channels * sizeof(float);
+
+        pa_resampler_run(r, &i, &j);
+        pa_memblock_unref_fixed(i.memblock);
+
+        if (!j.memblock)
+            continue;
+
+        out = pa_xrealloc(out, (n * channels * sizeof(float)) + j.length);
+        memcpy(out + n * channels, pa_memblock_acquire_chunk(&j), j.length);
+        pa_memblock_release(j.memblock);
+        pa_memblock_unref(j.memblock);
+
+        n += (unsigned) (j.length / (channels * sizeof(float)));
+    }
+
+    *n_out = n;
+    return out;
+}
+
+static void measure_tone(pa_mempool *pool, pa_resample_method_t method, uint32_t from, uint32_t to, double freq, double *gain_db, double *snr_db) {
+    pa_sample_spec a = { PA_SAMPLE_FLOAT32NE, from, 1 }, b = { PA_SAMPLE_FLOAT32NE, to, 1 };
+    pa_resampler *r;
+    float *in, *out;
+    unsigned k, n, skip;
+    double sss = 0, scc = 0, ssc = 0, sys = 0, syc = 0, det, sa, ca, signal = 0, noise = 0;
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, method, 0));
+
+    in = pa_xnew(float, QUALITY_FRAMES);
+    for (k = 0; k < QUALITY_FRAMES; k++)
+        in[k] = (float) (0.5 * sin(2.0 * M_PI * freq * k / from));
+
+    out = resample_float(pool, r, in, QUALITY_FRAMES, 1, &n);
+    pa_resampler_free(r);
+
+    /* Leave out the start, where the filters are still filling up */
+    skip = to / 10;
+    pa_assert_se(n > skip * 2);
+
+    for (k = skip; k < n; k++) {
+        double s = sin(2.0 * M_PI * freq * k / to), c = cos(2.0 * M_PI * freq * k / to);
+
+        sss += s * s;
+        scc += c * c;
+        ssc += s * c;
+        sys += out[k] * s;
+        syc += out[k] * c;
+    }
+
+    det = sss * scc - ssc * ssc;
+    sa = (sys * scc - syc * ssc) / det;
+    ca = (syc * sss - sys * ssc) / det;
+
+    for (k = skip; k < n; k++) {
+        double fit = sa * sin(2.0 * M_PI * freq * k / to) + ca * cos(2.0 * M_PI * freq * k / to);
+
+        signal += fit * fit;
+        noise += (out[k] - fit) * (out[k] - fit);
+    }
+
+    *gain_db = 20.0 * log10(sqrt(sa * sa + ca * ca) / 0.5);
+    *snr_db = 10.0 * log10(signal / PA_MAX(noise, 1e-30));
+
+    pa_xfree(in);
+    pa_xfree(out);
+}
+
+/* Returns the time spent per output frame in ns when converting stereo
+ * noise, and the output in *result if it is not NULL */
+static double measure_speed(pa_mempool *pool, pa_resample_method_t method, uint32_t from, uint32_t to, float **result, unsigned *n_result) {
+    pa_sample_spec a = { PA_SAMPLE_FLOAT32NE, from, 2 }, b = { PA_SAMPLE_FLOAT32NE, to, 2 };
+    pa_resampler *r;
+    float *in, *out;
+    unsigned k, n;
+    pa_usec_t ts;
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, method, 0));
+
+    in = pa_xnew(float, QUALITY_FRAMES * 2);
+    for (k = 0; k < QUALITY_FRAMES * 2; k++)
+        in[k] = 2.0f * (rand() / (float) RAND_MAX - 0.5f);
+
+    ts = pa_rtclock_now();
+    out = resample_float(pool, r, in, QUALITY_FRAMES, 2, &n);
+    ts = pa_rtclock_now() - ts;
+
+    pa_resampler_free(r);
+    pa_xfree(in);
+
+    if (result) {
+        *result = out;
+        *n_result = n;
+    } else
+        pa_xfree(out);
+
+    return (double) ts * 1000.0 / PA_MAX(n, 1U);
+}
+
+/* Drift compensation changes the rate all the time. Every step has to
+ * keep the stream continuous, also when the filter length changes. */
+static pa_bool_t run_variable_rate_test(pa_mempool *pool) {
+    pa_sample_spec a = { PA_SAMPLE_FLOAT32NE, 48000, 2 }, b = { PA_SAMPLE_FLOAT32NE, 44100, 2 };
+    pa_resampler *r;
+    float *in;
+    unsigned k, n = 0;
+    double expected = 0;
+    pa_bool_t ok = TRUE;
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, PA_RESAMPLER_SINC_BASE + 1, PA_RESAMPLER_VARIABLE_RATE));
+
+    in = pa_xnew(float, QUALITY_CHUNK * 2);
+    for (k = 0; k < QUALITY_CHUNK * 2; k++)
+        in[k] = (float) (0.5 * sin(2.0 * M_PI * 1000.0 * (k / 2) / 48000));
+
+    for (k = 0; k < 100; k++) {
+        float *out;
+        unsigned i, m;
+        uint32_t rate = 48000 + (k % 7) * 150 - 450 + (k % 2) * 3;
+
+        pa_resampler_set_input_rate(r, rate);
+        expected += QUALITY_CHUNK * 44100.0 / rate;
+
+        out = resample_float(pool, r, in, QUALITY_CHUNK, 2, &m);
+
+        for (i = 0; i < m * 2; i++)
+            if (!(fabsf(out[i]) < 0.6f)) {
+                pa_log_error("Variable rate sinc resampler output out of range: %f", out[i]);
+                ok = FALSE;
+                break;
+            }
+
+        pa_xfree(out);
+        n += m;
+    }
+
+    /* Only the filter delay may be missing */
+    if (n > expected + 1 || n + 100 < expected) {
+        pa_log_error("Variable rate sinc resampler returned %u frames, expected about %0.0f", n, expected);
+        ok = FALSE;
+    }
+
+    pa_xfree(in);
+    pa_resampler_free(r);
+
+    return ok;
+}
+
+/* When a rate change makes the filter longer, it needs input from
+ * before what the old one still looked at. A constant signal has to
+ * stay constant then. Silence in place of that input shows up as a
+ * dip, mostly a small one, as it only hits the ends of the window. */
+static pa_bool_t run_taps_change_test(pa_mempool *pool) {
+    static const uint32_t rates[] = { 44100, 96000, 44100, 192000, 48000 };
+    pa_sample_spec a = { PA_SAMPLE_FLOAT32NE, 44100, 1 }, b = { PA_SAMPLE_FLOAT32NE, 48000, 1 };
+    pa_resampler *r;
+    float *in;
+    unsigned k, i;
+    pa_bool_t ok = TRUE;
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, PA_RESAMPLER_SINC_BASE + 2, 0));
+
+    in = pa_xnew(float, QUALITY_CHUNK);
+    for (k = 0; k < QUALITY_CHUNK; k++)
+        in[k] = 0.5f;
+
+    for (k = 0; k < PA_ELEMENTSOF(rates); k++) {
+        float *out;
+        unsigned m;
+
+        pa_resampler_set_input_rate(r, rates[k]);
+        out = resample_float(pool, r, in, QUALITY_CHUNK, 1, &m);
+
+        /* Except for the start of the stream, which is preceded by
+         * silence */
+        for (i = k == 0 ? m / 2 : 0; i < m; i++)
+            if (fabsf(out[i] - 0.5f) > 0.0001f) {
+                pa_log_error("Sinc resampler output is %f after changing the input rate to %u", out[i], rates[k]);
+                ok = FALSE;
+                break;
+            }
+
+        pa_xfree(out);
+    }
+
+    pa_xfree(in);
+    pa_resampler_free(r);
+
+    return ok;
+}
+
+/* Drift compensation through pa_resampler_set_rate_adjust() must
+ * neither click nor look up a new filter bank */
+static pa_bool_t run_rate_adjust_test(pa_mempool *pool) {
+    pa_sample_spec a = { PA_SAMPLE_FLOAT32NE, 44100, 2 }, b = { PA_SAMPLE_FLOAT32NE, 48000, 2 };
+    pa_resampler_cache_stat before, stat;
+    pa_resampler *r;
+    float *in, *out = NULL;
+    unsigned k, n = 0;
+    double expected = 0, t = 0;
+    pa_bool_t ok = TRUE;
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, PA_RESAMPLER_SINC_BASE + 2, PA_RESAMPLER_VARIABLE_RATE));
+    pa_resampler_cache_get_stat(&before);
+
+    in = pa_xnew(float, QUALITY_CHUNK * 2);
+
+    for (k = 0; k < 200; k++) {
+        double factor = 1.0 + 0.002 * sin(k / 10.0);
+        float *o;
+        unsigned i, m;
+
+        for (i = 0; i < QUALITY_CHUNK; i++, t += 1.0 / 44100)
+            in[2*i] = in[2*i+1] = (float) (0.5 * sin(2.0 * M_PI * 1000.0 * t));
+
+        pa_resampler_set_rate_adjust(r, factor);
+        expected += QUALITY_CHUNK * 48000.0 / (44100.0 * factor);
+
+        o = resample_float(pool, r, in, QUALITY_CHUNK, 2, &m);
+        out = pa_xrealloc(out, (n + m) * 2 * sizeof(float));
+        memcpy(out + n * 2, o, m * 2 * sizeof(float));
+        pa_xfree(o);
+        n += m;
+    }
+
+    pa_resampler_cache_get_stat(&stat);
+
+    if (stat.n_tables != before.n_tables || stat.n_users != before.n_users) {
+        pa_log_error("Adjusting the rate changed the filter bank");
+        ok = FALSE;
+    }
+
+    if (n > expected + 1 || n + 100 < expected) {
+        pa_log_error("Rate adjusted sinc resampler returned %u frames, expected about %0.0f", n, expected);
+        ok = FALSE;
+    }
+
+    /* A 1 kHz tone of this amplitude bends by less than 0.01 per sample
+     * at 48 kHz, any jump in the ratio or the position would show */
+    for (k = 200; k + 1 < n; k++) {
+        float d = out[2*(k+1)] - 2.0f * out[2*k] + out[2*(k-1)];
+
+        if (fabsf(d) > 0.02f) {
+            pa_log_error("Rate adjusted sinc resampler output discontinuous at frame %u", k);
+            ok = FALSE;
+            break;
+        }
+    }
+
+    pa_xfree(in);
+    pa_xfree(out);
+    pa_resampler_free(r);
+
+    return ok;
+}
+
+static pa_bool_t run_quality_tests(pa_mempool *pool) {
+    static const struct {
+        uint32_t from, to;
+    } rates[] = {
+        { 44100, 48000 },
+        { 48000, 44100 },
+        { 8000, 48000 },
+        { 48000, 16000 }
+    };
+    pa_bool_t ok = TRUE;
+    unsigned c, k;
+
+    for (c = 0; c < PA_ELEMENTSOF(rates); c++) {
+        uint32_t from = rates[c].from, to = rates[c].to;
+        double edge = 0.8 * PA_MIN(from, to) / 2;
+
+        for (k = 0; k < PA_ELEMENTSOF(quality_methods); k++) {
+            pa_resample_method_t method = quality_methods[k];
+            double gain, snr, passband, dummy, ns;
+
+            if (!pa_resample_method_supported(method))
+                continue;
+
+            measure_tone(pool, method, from, to, 1000.0, &gain, &snr);
+            measure_tone(pool, method, from, to, edge, &passband, &dummy);
+            ns = measure_speed(pool, method, from, to, NULL, NULL);
+
+            pa_log_info("%u Hz -> %u Hz, %-14s SNR %6.1f dB, gain at %5.0f Hz %6.2f dB, %6.1f ns/frame",
+                        from, to, pa_resample_method_to_string(method), snr, edge, passband, ns);
+
+            if (method >= PA_RESAMPLER_SINC_BASE && method <= PA_RESAMPLER_SINC_MAX) {
+                unsigned q = method - PA_RESAMPLER_SINC_BASE;
+
+                if (snr < sinc_min_snr[q] || passband < sinc_min_passband[q] || fabs(gain) > 0.01) {
+                    pa_log_error("%s does not reach its quality for %u Hz -> %u Hz",
+                                 pa_resample_method_to_string(method), from, to);
+                    ok = FALSE;
+                }
+            }
+        }
+    }
+
+    return ok && run_variable_rate_test(pool) && run_taps_change_test(pool) && run_rate_adjust_test(pool);
+}
+
+/* Resamplers for the same rates and method share their filter tables */
+static pa_bool_t run_cache_test(pa_mempool *pool) {
+    static const pa_resample_method_t methods[] = {
+        PA_RESAMPLER_FFMPEG,
+        PA_RESAMPLER_SINC_BASE + 1
+    };
+    pa_sample_spec a = { PA_SAMPLE_S16NE, 44100, 2 }, b = { PA_SAMPLE_S16NE, 48000, 2 };
+    pa_resampler *r[16];
+    pa_resampler_cache_stat before, stat;
+    pa_bool_t ok = TRUE;
+    unsigned c, k;
+
+    for (c = 0; c < PA_ELEMENTSOF(methods); c++) {
+        pa_usec_t t_first, t_rest;
+
+        pa_resampler_cache_get_stat(&before);
+
+        t_first = pa_rtclock_now();
+        pa_assert_se(r[0] = pa_resampler_new(pool, &a, NULL, &b, NULL, methods[c], 0));
+        t_first = pa_rtclock_now() - t_first;
+
+        t_rest = pa_rtclock_now();
+        for (k = 1; k < PA_ELEMENTSOF(r); k++)
+            pa_assert_se(r[k] = pa_resampler_new(pool, &a, NULL, &b, NULL, methods[c], 0));
+        t_rest = pa_rtclock_now() - t_rest;
+
+        pa_resampler_cache_get_stat(&stat);
+
+        pa_log_info("%s: first resampler created in %llu usec, the others in %llu usec each, "
+                    "%zu bytes of filter tables, %zu bytes saved",
+                    pa_resample_method_to_string(methods[c]),
+                    (unsigned long long) t_first, (unsigned long long) (t_rest / (PA_ELEMENTSOF(r) - 1)),
+                    stat.size - before.size, stat.saved - before.saved);
+
+        if (stat.n_tables != before.n_tables + 1 ||
+            stat.n_users != before.n_users + PA_ELEMENTSOF(r) ||
+            stat.saved - before.saved != (PA_ELEMENTSOF(r) - 1) * (stat.size - before.size)) {
+            pa_log_error("%s resamplers don't share their filter table", pa_resample_method_to_string(methods[c]));
+            ok = FALSE;
+        }
+
+        for (k = 0; k < PA_ELEMENTSOF(r); k++)
+            pa_resampler_free(r[k]);
+
+        /* The table stays cached for the next stream */
+        pa_resampler_cache_get_stat(&before);
+        pa_assert_se(r[0] = pa_resampler_new(pool, &a, NULL, &b, NULL, methods[c], 0));
+        pa_resampler_cache_get_stat(&stat);
+        pa_resampler_free(r[0]);
+
+        if (stat.n_tables != before.n_tables || stat.n_users != before.n_users + 1) {
+            pa_log_error("%s filter table not kept after use", pa_resample_method_to_string(methods[c]));
+            ok = FALSE;
+        }
+    }
+
+    return ok;
+}
+
+/* Lazily set up and released resamplers must behave exactly like
+ * new ones */
+static pa_bool_t run_release_test(pa_mempool *pool) {
+    static const pa_resample_method_t methods[] = {
+        PA_RESAMPLER_TRIVIAL,
+        PA_RESAMPLER_FFMPEG,
+        PA_RESAMPLER_SINC_BASE + 1
+    };
+    pa_sample_spec a = { PA_SAMPLE_FLOAT32NE, 44100, 2 }, b = { PA_SAMPLE_FLOAT32NE, 48000, 2 };
+    pa_bool_t ok = TRUE;
+    float *in;
+    unsigned c, k;
+
+    in = pa_xnew(float, QUALITY_FRAMES * 2);
+    for (k = 0; k < QUALITY_FRAMES * 2; k++)
+        in[k] = 2.0f * (rand() / (float) RAND_MAX - 0.5f);
+
+    for (c = 0; c < PA_ELEMENTSOF(methods); c++) {
+        pa_resampler *r;
+        float *ref, *out;
+        unsigned n_ref, n, round;
+        size_t size;
+
+        pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, methods[c], 0));
+        ref = resample_float(pool, r, in, QUALITY_FRAMES, 2, &n_ref);
+        pa_resampler_free(r);
+
+        pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, methods[c], PA_RESAMPLER_LAZY));
+
+        for (round = 0; round < 2; round++) {
+            out = resample_float(pool, r, in, QUALITY_FRAMES, 2, &n);
+
+            if (n != n_ref || memcmp(out, ref, n * 2 * sizeof(float))) {
+                pa_log_error("%s resampler differs after %s", pa_resample_method_to_string(methods[c]),
+                             round == 0 ? "lazy set up" : "release");
+                ok = FALSE;
+            }
+
+            pa_xfree(out);
+
+            size = pa_resampler_release(r);
+            pa_log_info("%s: released %zu bytes", pa_resample_method_to_string(methods[c]), size);
+
+            /* Without format conversion the trivial resampler hands
+             * out all its buffers and keeps nothing */
+            if ((size == 0 && methods[c] != PA_RESAMPLER_TRIVIAL) || pa_resampler_release(r) != 0) {
+                pa_log_error("%s resampler didn't release its state once", pa_resample_method_to_string(methods[c]));
+                ok = FALSE;
+            }
+        }
+
+        pa_resampler_free(r);
+        pa_xfree(ref);
+    }
+
+    pa_xfree(in);
+
+    return ok;
+}
+
+/* Callers may pass the same chunk as input and output */
+static pa_bool_t run_in_place_test(pa_mempool *pool) {
+    pa_sample_spec a = { PA_SAMPLE_S16NE, 44100, 2 }, b = { PA_SAMPLE_FLOAT32NE, 44100, 1 };
+    pa_resampler *r;
+    pa_memchunk in, out, chunk;
+    pa_bool_t ok;
+    int16_t *d;
+    unsigned k;
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, PA_RESAMPLER_COPY, 0));
+
+    in.memblock = pa_memblock_new(pool, 1000 * 2 * sizeof(int16_t));
+    in.index = 0;
+    in.length = pa_memblock_get_length(in.memblock);
+
+    d = pa_memblock_acquire(in.memblock);
+    for (k = 0; k < 1000 * 2; k++)
+        d[k] = (int16_t) rand();
+    pa_memblock_release(in.memblock);
+
+    pa_resampler_run(r, &in, &out);
+
+    /* in keeps the reference to the input block */
+    chunk = in;
+    pa_resampler_run(r, &chunk, &chunk);
+
+    ok = chunk.length == out.length &&
+        memcmp(pa_memblock_acquire_chunk(&chunk), pa_memblock_acquire_chunk(&out), out.length) == 0;
+    pa_memblock_release(chunk.memblock);
+    pa_memblock_release(out.memblock);
+
+    if (!ok)
+        pa_log_error("Resampling in place differs");
+
+    pa_memblock_unref(chunk.memblock);
+    pa_memblock_unref(out.memblock);
+    pa_memblock_unref(in.memblock);
+    pa_resampler_free(r);
+
+    return ok;
+}
+
+/* The vectorized dot products must give the same result as the C
+ * version, give or take the order of the additions */
+static pa_bool_t check_sinc_func(pa_mempool *pool, const char *name, pa_sinc_dot_func_t ref_func) {
+    float *ref, *out;
+    unsigned n_ref, n, k;
+    double t_ref, t;
+    pa_bool_t ok = TRUE;
+
+    pa_sinc_dot_func_t func = pa_get_sinc_dot_func();
+
+    if (func == ref_func)
+        return TRUE;
+
+    pa_set_sinc_dot_func(ref_func);
+    srand(0);
+    t_ref = measure_speed(pool, PA_RESAMPLER_SINC_BASE + 2, 44100, 48000, &ref, &n_ref);
+
+    pa_set_sinc_dot_func(func);
+    srand(0);
+    t = measure_speed(pool, PA_RESAMPLER_SINC_BASE + 2, 44100, 48000, &out, &n);
+
+    if (n != n_ref)
+        ok = FALSE;
+    else
+        for (k = 0; k < n * 2; k++)
+            if (fabsf(out[k] - ref[k]) > 1e-5f) {
+                pa_log_error("%s sinc resampler differs at %u: %f != %f", name, k, out[k], ref[k]);
+                ok = FALSE;
+                break;
+            }
+
+    pa_log_info("%s sinc resampler: reference %0.1f ns/frame, optimized %0.1f ns/frame", name, t_ref, t);
+
+    pa_xfree(ref);
+    pa_xfree(out);
+
+    /* Leave the C version in place for the next instruction set */
+    pa_set_sinc_dot_func(ref_func);
+
+    return ok;
+}
+
+static pa_bool_t run_sinc_func_tests(pa_mempool *pool) {
+    pa_sinc_dot_func_t ref_func = pa_get_sinc_dot_func();
+    pa_bool_t ok = TRUE;
+
+#if defined (__i386__) || defined (__amd64__)
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+#ifdef HAVE_SSE2_INTRINSICS
+    pa_sinc_func_init_sse(flags);
+    ok = check_sinc_func(pool, "SSE2", ref_func) && ok;
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+    pa_sinc_func_init_avx(flags);
+    ok = check_sinc_func(pool, "AVX2", ref_func) && ok;
+#endif
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+#if ((defined (__arm__) && defined (__linux__)) || defined (__aarch64__)) && defined (HAVE_NEON_INTRINSICS)
+    pa_cpu_arm_flag_t flags = 0;
+
+    /* There is no way to only query the flags, pa_cpu_init_arm()
+     * installs the NEON functions right away */
+    pa_cpu_init_arm(&flags);
+    ok = check_sinc_func(pool, "NEON", ref_func) && ok;
+#endif
+
+    return ok;
+}
+
 static void help(const char *argv0) {
     printf(_("%s [options]\n\n"
              "-h, --help                            Show this help\n"
@@ -265,6 +954,7 @@ static void help(const char *argv0) {
              "      --to-channels=CHANNELS          To number of channels (defaults to 1)\n"
              "      --resample-method=METHOD        Resample method (defaults to auto)\n"
              "      --seconds=SECONDS               From stream duration (defaults to 60)\n"
+             "      --benchmark=ITERATIONS          Compare the fused and the staged conversion pipeline\n"
              "\n"
              "If the formats are not specified, the test performs all formats combinations,\n"
              "back and forth.\n"
@@ -286,7 +976,8 @@ enum {
     ARG_TO_CHANNELS,
     ARG_SECONDS,
     ARG_RESAMPLE_METHOD,
-    ARG_DUMP_RESAMPLE_METHODS
+    ARG_DUMP_RESAMPLE_METHODS,
+    ARG_BENCHMARK
 };
 
 static void dump_resample_methods(void) {
@@ -305,6 +996,7 @@ int main(int argc, char *argv[]) {
     pa_bool_t all_formats = TRUE;
     pa_resample_method_t method;
     int seconds;
+    int benchmark = 0;
 
     static const struct option long_options[] = {
         {"help",                  0, NULL, 'h'},
@@ -319,6 +1011,7 @@ int main(int argc, char *argv[]) {
         {"seconds",               1, NULL, ARG_SECONDS},
         {"resample-method",       1, NULL, ARG_RESAMPLE_METHOD},
         {"dump-resample-methods", 0, NULL, ARG_DUMP_RESAMPLE_METHODS},
+        {"benchmark",             1, NULL, ARG_BENCHMARK},
         {NULL,                    0, NULL, 0}
     };
 
@@ -392,6 +1085,10 @@ int main(int argc, char *argv[]) {
                 seconds = atoi(optarg);
                 break;
 
+            case ARG_BENCHMARK:
+                benchmark = atoi(optarg);
+                break;
+
             case ARG_RESAMPLE_METHOD:
                 if (*optarg == '\0' || pa_streq(optarg, "help")) {
                     dump_resample_methods();
@@ -409,6 +1106,11 @@ int main(int argc, char *argv[]) {
     ret = 0;
     pa_assert_se(pool = pa_mempool_new(FALSE, 0));
 
+    if (benchmark > 0) {
+        ret = run_pipeline_benchmark(pool, method, (unsigned) benchmark) ? 0 : 1;
+        goto quit;
+    }
+
     if (!all_formats) {
 
         pa_resampler *resampler;
@@ -473,6 +1175,14 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    /* A few rounds to make sure the fused pipeline gives the same results */
+    if (!run_pipeline_benchmark(pool, method, 10))
+        ret = 1;
+
+    if (!run_quality_tests(pool) || !run_sinc_func_tests(pool) || !run_cache_test(pool) ||
+        !run_release_test(pool) || !run_in_place_test(pool))
+        ret = 1;
+
  quit:
     if (pool)
         pa_mempool_free(pool);
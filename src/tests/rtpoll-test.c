@@ -23,10 +23,20 @@
 
 #include <check.h>
 #include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
 #include <pulsecore/poll.h>
 #include <pulsecore/log.h>
+#include <pulsecore/macro.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/thread.h>
 
 static int before(pa_rtpoll_item *i) {
     pa_log("before");
@@ -84,6 +94,250 @@ START_TEST (rtpoll_test) {
 }
 END_TEST
 
+#define N_ITERATIONS 200
+
+static const char *backend_to_string(pa_rtpoll_backend_t b) {
+    return b == PA_RTPOLL_BACKEND_EPOLL ? "epoll" : "poll";
+}
+
+/* n_idle pipes that never become readable plus one that is written
+ * to before every iteration */
+struct fd_set_up {
+    int *fds;
+    unsigned n;
+    pa_rtpoll_item *item;
+};
+
+#define READ_END(f, k) ((f)->fds[2 * (k)])
+#define WRITE_END(f, k) ((f)->fds[2 * (k) + 1])
+
+static void fd_set_up_new(struct fd_set_up *f, pa_rtpoll *p, unsigned n) {
+    struct pollfd *pollfd;
+    unsigned k;
+
+    f->n = n;
+    f->fds = pa_xnew(int, 2 * n);
+    f->item = pa_rtpoll_item_new(p, PA_RTPOLL_NEVER, n);
+
+    pollfd = pa_rtpoll_item_get_pollfd(f->item, NULL);
+
+    for (k = 0; k < n; k++) {
+        fail_unless(pipe(f->fds + 2 * k) == 0);
+        pa_make_fd_nonblock(READ_END(f, k));
+
+        pollfd[k].fd = READ_END(f, k);
+        pollfd[k].events = POLLIN;
+    }
+}
+
+static void fd_set_up_free(struct fd_set_up *f) {
+    unsigned k;
+
+    pa_rtpoll_item_free(f->item);
+
+    for (k = 0; k < f->n; k++) {
+        pa_close(READ_END(f, k));
+        pa_close(WRITE_END(f, k));
+    }
+
+    pa_xfree(f->fds);
+}
+
+static void check_revents(struct fd_set_up *f, unsigned active) {
+    struct pollfd *pollfd;
+    unsigned k;
+
+    pollfd = pa_rtpoll_item_get_pollfd(f->item, NULL);
+
+    for (k = 0; k < f->n; k++)
+        fail_unless(pollfd[k].revents == (k == active ? POLLIN : 0));
+}
+
+/* Both backends have to report exactly the same */
+static void run_semantics_test(pa_rtpoll_backend_t backend) {
+    pa_rtpoll *p;
+    struct fd_set_up f;
+    struct pollfd *pollfd;
+    char c = 'x';
+    pa_usec_t start;
+    unsigned k;
+
+    p = pa_rtpoll_new_with_backend(backend);
+    fd_set_up_new(&f, p, 8);
+
+    /* Timer only */
+    start = pa_rtclock_now();
+    pa_rtpoll_set_timer_relative(p, 20 * PA_USEC_PER_MSEC);
+    fail_unless(pa_rtpoll_run(p, TRUE) > 0);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+    fail_unless(pa_rtclock_now() - start >= 20 * PA_USEC_PER_MSEC);
+    check_revents(&f, (unsigned) -1);
+
+    /* A readable fd wins over a timer far in the future and revents of
+     * the previous iteration are cleared */
+    for (k = 0; k < f.n; k++) {
+        fail_unless(write(WRITE_END(&f, k), &c, 1) == 1);
+
+        pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_SEC);
+        fail_unless(pa_rtpoll_run(p, TRUE) > 0);
+        fail_unless(!pa_rtpoll_timer_elapsed(p));
+        check_revents(&f, k);
+
+        fail_unless(read(READ_END(&f, k), &c, 1) == 1);
+    }
+
+    /* Not waiting */
+    pa_rtpoll_set_timer_disabled(p);
+    fail_unless(pa_rtpoll_run(p, FALSE) > 0);
+    check_revents(&f, (unsigned) -1);
+
+    /* Changing the events in place is picked up */
+    fail_unless(write(WRITE_END(&f, 3), &c, 1) == 1);
+    pollfd = pa_rtpoll_item_get_pollfd(f.item, NULL);
+    pollfd[3].events = 0;
+    pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_MSEC);
+    fail_unless(pa_rtpoll_run(p, TRUE) > 0);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+    check_revents(&f, (unsigned) -1);
+
+    pollfd = pa_rtpoll_item_get_pollfd(f.item, NULL);
+    pollfd[3].events = POLLIN;
+    fail_unless(pa_rtpoll_run(p, TRUE) > 0);
+    check_revents(&f, 3);
+    fail_unless(read(READ_END(&f, 3), &c, 1) == 1);
+
+    /* Same for swapping the fd */
+    fail_unless(write(WRITE_END(&f, 5), &c, 1) == 1);
+    pollfd = pa_rtpoll_item_get_pollfd(f.item, NULL);
+    pollfd[2].fd = READ_END(&f, 5);
+    pollfd[5].fd = READ_END(&f, 2);
+    fail_unless(pa_rtpoll_run(p, TRUE) > 0);
+    check_revents(&f, 2);
+    fail_unless(read(READ_END(&f, 5), &c, 1) == 1);
+
+    fail_unless(pa_rtpoll_get_backend(p) == backend);
+
+    fd_set_up_free(&f);
+    pa_rtpoll_free(p);
+}
+
+START_TEST (rtpoll_semantics_test) {
+    pa_rtpoll *p;
+    pa_bool_t have_epoll;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    run_semantics_test(PA_RTPOLL_BACKEND_POLL);
+
+    p = pa_rtpoll_new_with_backend(PA_RTPOLL_BACKEND_EPOLL);
+    have_epoll = pa_rtpoll_get_backend(p) == PA_RTPOLL_BACKEND_EPOLL;
+    pa_rtpoll_free(p);
+
+    if (!have_epoll) {
+        pa_log_info("epoll not available. Skipping");
+        return;
+    }
+
+    run_semantics_test(PA_RTPOLL_BACKEND_EPOLL);
+}
+END_TEST
+
+struct wakeup_data {
+    int fd;
+    pa_usec_t written;
+};
+
+static void writer_thread(void *userdata) {
+    struct wakeup_data *d = userdata;
+    char c = 'x';
+
+    pa_usec_t until = pa_rtclock_now() + 2 * PA_USEC_PER_MSEC;
+
+    while (pa_rtclock_now() < until)
+        usleep(100);
+
+    d->written = pa_rtclock_now();
+    pa_assert_se(write(d->fd, &c, 1) == 1);
+}
+
+static void run_benchmark(pa_rtpoll_backend_t backend, unsigned n) {
+    pa_rtpoll *p;
+    struct fd_set_up f;
+    struct wakeup_data d;
+    char c = 'x';
+    pa_usec_t start, t_iteration, t_latency = 0, t_timer = 0;
+    unsigned k;
+
+    p = pa_rtpoll_new_with_backend(backend);
+    if (pa_rtpoll_get_backend(p) != backend) {
+        pa_rtpoll_free(p);
+        return;
+    }
+
+    fd_set_up_new(&f, p, n);
+
+    /* Cost of one iteration with one active fd */
+    start = pa_rtclock_now();
+    for (k = 0; k < N_ITERATIONS; k++) {
+        fail_unless(write(WRITE_END(&f, n - 1), &c, 1) == 1);
+        fail_unless(pa_rtpoll_run(p, TRUE) > 0);
+        fail_unless(read(READ_END(&f, n - 1), &c, 1) == 1);
+    }
+    t_iteration = (pa_rtclock_now() - start) / N_ITERATIONS;
+
+    /* Wakeup latency for an fd written from another thread */
+    d.fd = WRITE_END(&f, 0);
+    for (k = 0; k < 10; k++) {
+        pa_thread *t;
+
+        pa_assert_se(t = pa_thread_new("writer", writer_thread, &d));
+        fail_unless(pa_rtpoll_run(p, TRUE) > 0);
+        t_latency += pa_rtclock_now() - d.written;
+        pa_thread_free(t);
+
+        fail_unless(read(READ_END(&f, 0), &c, 1) == 1);
+    }
+
+    /* Overshoot of a 1 ms timer */
+    for (k = 0; k < 10; k++) {
+        start = pa_rtclock_now();
+        pa_rtpoll_set_timer_absolute(p, start + PA_USEC_PER_MSEC);
+        fail_unless(pa_rtpoll_run(p, TRUE) > 0);
+        fail_unless(pa_rtpoll_timer_elapsed(p));
+        t_timer += pa_rtclock_now() - start - PA_USEC_PER_MSEC;
+    }
+    pa_rtpoll_set_timer_disabled(p);
+
+    pa_log_debug("%s, %u fds: %llu usec per iteration, %llu usec fd wakeup latency, %llu usec timer overshoot",
+                 backend_to_string(backend), n, (unsigned long long) t_iteration,
+                 (unsigned long long) t_latency / 10, (unsigned long long) t_timer / 10);
+
+    fd_set_up_free(&f);
+    pa_rtpoll_free(p);
+}
+
+START_TEST (rtpoll_benchmark) {
+    static const unsigned counts[] = { 1, 16, 128, 1000 };
+    struct rlimit rl;
+    unsigned k, max_fds = 1000;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    /* Two fds per pipe */
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+        max_fds = PA_MIN(max_fds, (unsigned) (rl.rlim_cur - 32) / 2);
+
+    for (k = 0; k < PA_ELEMENTSOF(counts); k++) {
+        unsigned n = PA_MIN(counts[k], max_fds);
+
+        run_benchmark(PA_RTPOLL_BACKEND_POLL, n);
+        run_benchmark(PA_RTPOLL_BACKEND_EPOLL, n);
+    }
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -93,6 +347,8 @@ int main(int argc, char *argv[]) {
     s = suite_create("RT Poll");
     tc = tcase_create("rtpoll");
     tcase_add_test(tc, rtpoll_test);
+    tcase_add_test(tc, rtpoll_semantics_test);
+    tcase_add_test(tc, rtpoll_benchmark);
     /* the default timeout is too small,
      * set it to a reasonable large one.
      */
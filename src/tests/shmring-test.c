@@ -0,0 +1,295 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <stdlib.h>
+
+#ifdef HAVE_SHM_OPEN
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/memtrap.h>
+#include <pulsecore/shmring.h>
+#include <pulsecore/thread.h>
+
+#define RING_SIZE (64*1024)
+#define N_RECORDS 20000
+
+/* A producer and a consumer on the same pair of segments */
+static void ring_pair_new(pa_shmring **producer, pa_shmring **consumer) {
+    fail_unless((*producer = pa_shmring_new_producer(RING_SIZE)) != NULL);
+    fail_unless((*consumer = pa_shmring_new_consumer(pa_shmring_get_shm_id(*producer))) != NULL);
+    fail_unless(pa_shmring_attach_consumer(*producer, pa_shmring_get_shm_id(*consumer)) == 0);
+}
+
+/* Record sizes from a few bytes to several memblocks */
+static size_t record_length(unsigned i) {
+    return i % 50 == 0 ? 40000 : (i * 7919) % 3000 + 1;
+}
+
+static void producer_thread(void *userdata) {
+    pa_shmring *r = userdata;
+    uint8_t *data;
+    uint8_t next = 0;
+    unsigned i;
+
+    data = pa_xmalloc(40000);
+
+    for (i = 0; i < N_RECORDS; i++) {
+        size_t j, length = record_length(i);
+
+        for (j = 0; j < length; j++)
+            data[j] = next++;
+
+        /* The consumer is not done yet, try again */
+        while (pa_shmring_write(r, data, length, i, i % 3 == 0 ? PA_SEEK_ABSOLUTE : PA_SEEK_RELATIVE) < 0)
+            pa_thread_yield();
+    }
+
+    pa_xfree(data);
+}
+
+START_TEST (shmring_test) {
+    pa_mempool *pool;
+    pa_shmring *producer, *consumer;
+    pa_thread *thread;
+    unsigned i = 0;
+    size_t left = 0;
+    uint8_t expect = 0;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    fail_unless((pool = pa_mempool_new(FALSE, 0)) != NULL);
+    ring_pair_new(&producer, &consumer);
+
+    thread = pa_thread_new("producer", producer_thread, producer);
+
+    while (i < N_RECORDS || left > 0) {
+        pa_memchunk chunk;
+        int64_t offset;
+        pa_seek_mode_t seek;
+        const uint8_t *d;
+        size_t j;
+        int ret;
+
+        fail_unless((ret = pa_shmring_read(consumer, pool, &chunk, &offset, &seek)) >= 0);
+
+        if (ret == 0) {
+            pa_thread_yield();
+            continue;
+        }
+
+        /* Records come out whole or in pieces, but in order and with
+         * the seek on the first piece only */
+        if (left <= 0) {
+            fail_unless(offset == i);
+            fail_unless(seek == (i % 3 == 0 ? PA_SEEK_ABSOLUTE : PA_SEEK_RELATIVE));
+            left = record_length(i++);
+        } else {
+            fail_unless(offset == 0);
+            fail_unless(seek == PA_SEEK_RELATIVE);
+        }
+
+        fail_unless(chunk.length <= left);
+        fail_unless(chunk.length <= pa_mempool_block_size_max(pool));
+        left -= chunk.length;
+
+        d = pa_memblock_acquire(chunk.memblock);
+        for (j = 0; j < chunk.length; j++)
+            fail_unless(d[chunk.index + j] == expect++);
+        pa_memblock_release(chunk.memblock);
+
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    pa_thread_free(thread);
+
+    pa_shmring_free(consumer);
+    pa_shmring_free(producer);
+    pa_mempool_free(pool);
+}
+END_TEST
+
+START_TEST (shmring_fence_test) {
+    pa_mempool *pool;
+    pa_shmring *producer, *consumer;
+    pa_memchunk chunk;
+    int64_t offset;
+    pa_seek_mode_t seek;
+    uint8_t data[100] = { 0 };
+
+    fail_unless((pool = pa_mempool_new(FALSE, 0)) != NULL);
+    ring_pair_new(&producer, &consumer);
+
+    fail_unless(pa_shmring_write(producer, data, sizeof(data), 0, PA_SEEK_RELATIVE) == 0);
+    fail_unless(pa_shmring_write_fence(producer) == 0);
+    fail_unless(pa_shmring_write(producer, data, sizeof(data), 0, PA_SEEK_RELATIVE) == 0);
+
+    /* Nothing gets past the fence until we pass it */
+    fail_unless(pa_shmring_read(consumer, pool, &chunk, &offset, &seek) == 1);
+    pa_memblock_unref(chunk.memblock);
+    fail_unless(pa_shmring_read(consumer, pool, &chunk, &offset, &seek) == 0);
+    fail_unless(pa_shmring_read(consumer, pool, &chunk, &offset, &seek) == 0);
+
+    pa_shmring_pass_fence(consumer);
+    fail_unless(pa_shmring_read(consumer, pool, &chunk, &offset, &seek) == 1);
+    pa_memblock_unref(chunk.memblock);
+
+    /* Passing a fence that isn't there does nothing */
+    pa_shmring_pass_fence(consumer);
+    fail_unless(pa_shmring_write(producer, data, sizeof(data), 0, PA_SEEK_RELATIVE) == 0);
+    fail_unless(pa_shmring_read(consumer, pool, &chunk, &offset, &seek) == 1);
+    pa_memblock_unref(chunk.memblock);
+
+    /* Also when there is nothing after it yet */
+    fail_unless(pa_shmring_write_fence(producer) == 0);
+    fail_unless(pa_shmring_read(consumer, pool, &chunk, &offset, &seek) == 0);
+    pa_shmring_pass_fence(consumer);
+    fail_unless(pa_shmring_read(consumer, pool, &chunk, &offset, &seek) == 0);
+    fail_unless(pa_shmring_write(producer, data, sizeof(data), 0, PA_SEEK_RELATIVE) == 0);
+    fail_unless(pa_shmring_read(consumer, pool, &chunk, &offset, &seek) == 1);
+    pa_memblock_unref(chunk.memblock);
+
+    pa_shmring_free(consumer);
+    pa_shmring_free(producer);
+    pa_mempool_free(pool);
+}
+END_TEST
+
+START_TEST (shmring_doorbell_test) {
+    pa_mempool *pool;
+    pa_shmring *producer, *consumer;
+    pa_memchunk chunk;
+    int64_t offset;
+    pa_seek_mode_t seek;
+    uint8_t data[1000] = { 0 };
+    unsigned i;
+
+    fail_unless((pool = pa_mempool_new(FALSE, 0)) != NULL);
+    ring_pair_new(&producer, &consumer);
+
+    /* Nobody asked for it yet */
+    fail_unless(pa_shmring_write(producer, data, sizeof(data), 0, PA_SEEK_RELATIVE) == 0);
+    fail_unless(!pa_shmring_doorbell_pending(producer));
+
+    fail_unless(pa_shmring_read(consumer, pool, &chunk, &offset, &seek) == 1);
+    pa_memblock_unref(chunk.memblock);
+
+    /* Asking twice before getting anything rings only once */
+    pa_shmring_want_doorbell(consumer);
+    pa_shmring_want_doorbell(consumer);
+    fail_unless(pa_shmring_write(producer, data, sizeof(data), 0, PA_SEEK_RELATIVE) == 0);
+    fail_unless(pa_shmring_doorbell_pending(producer));
+    fail_unless(pa_shmring_write(producer, data, sizeof(data), 0, PA_SEEK_RELATIVE) == 0);
+    fail_unless(!pa_shmring_doorbell_pending(producer));
+
+    fail_unless(pa_shmring_read(consumer, pool, &chunk, &offset, &seek) == 1);
+    pa_memblock_unref(chunk.memblock);
+    fail_unless(pa_shmring_read(consumer, pool, &chunk, &offset, &seek) == 1);
+    pa_memblock_unref(chunk.memblock);
+
+    /* A full ring refuses more data instead of overwriting */
+    for (i = 0; pa_shmring_write(producer, data, sizeof(data), 0, PA_SEEK_RELATIVE) == 0; i++)
+        ;
+    fail_unless(i == RING_SIZE / (sizeof(data) + 16));
+
+    pa_shmring_free(consumer);
+    pa_shmring_free(producer);
+    pa_mempool_free(pool);
+}
+END_TEST
+
+#ifdef HAVE_SHM_OPEN
+START_TEST (shmring_truncate_test) {
+    pa_mempool *pool;
+    pa_shmring *producer, *consumer;
+    pa_memchunk chunk;
+    int64_t offset;
+    pa_seek_mode_t seek;
+    uint8_t data[1000] = { 0 };
+    char fn[32];
+    int fd;
+
+    pa_memtrap_install();
+
+    fail_unless((pool = pa_mempool_new(FALSE, 0)) != NULL);
+    ring_pair_new(&producer, &consumer);
+
+    fail_unless(pa_shmring_write(producer, data, sizeof(data), 0, PA_SEEK_RELATIVE) == 0);
+
+    /* A producer that cuts its segment short must not take the
+     * consumer down with a SIGBUS. The segment is created read-only,
+     * but its owner may change that. */
+    pa_snprintf(fn, sizeof(fn), "/pulse-shm-%u", pa_shmring_get_shm_id(producer));
+    fail_unless((fd = shm_open(fn, O_RDONLY, 0)) >= 0);
+    fail_unless(fchmod(fd, 0600) == 0);
+    pa_close(fd);
+    fail_unless((fd = shm_open(fn, O_RDWR, 0)) >= 0);
+    fail_unless(ftruncate(fd, 0) == 0);
+    pa_close(fd);
+
+    fail_unless(pa_shmring_read(consumer, pool, &chunk, &offset, &seek) < 0);
+    fail_unless(pa_shmring_read(consumer, pool, &chunk, &offset, &seek) == 0);
+    pa_shmring_pass_fence(consumer);
+
+    pa_shmring_free(consumer);
+    pa_shmring_free(producer);
+    pa_mempool_free(pool);
+}
+END_TEST
+#endif
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Shared memory ring");
+    tc = tcase_create("shmring");
+    tcase_add_test(tc, shmring_test);
+    tcase_add_test(tc, shmring_fence_test);
+    tcase_add_test(tc, shmring_doorbell_test);
+#ifdef HAVE_SHM_OPEN
+    tcase_add_test(tc, shmring_truncate_test);
+#endif
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,301 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/core.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+#define N_INPUTS 8
+#define N_CYCLES 50
+#define CYCLE_FRAMES 1024
+
+/* Renders the same set of inputs once serially and once with the
+ * render pool and expects the sink to hand out the same data. Some of
+ * the inputs are silent and some of them are not allowed to be peeked
+ * from a worker, so that the parallel path has to compact the mix
+ * array and mix serial with parallel peeks. */
+
+enum {
+    SINK_MESSAGE_RENDER = PA_SINK_MESSAGE_MAX
+};
+
+struct test_input {
+    pa_sink_input *sink_input;
+    unsigned id;
+    unsigned n_popped;
+};
+
+struct test_sink {
+    pa_mainloop *mainloop;
+    pa_core *core;
+    pa_rtpoll *rtpoll;
+    pa_thread_mq thread_mq;
+    pa_thread *thread;
+    pa_sink *sink;
+    struct test_input inputs[N_INPUTS];
+};
+
+static const pa_sample_spec ss = {
+    .format = PA_SAMPLE_S16NE,
+    .rate = 44100,
+    .channels = 2
+};
+
+static pa_channel_map map;
+
+static pa_atomic_t wrong_mq;
+
+static pa_bool_t input_is_silent(unsigned id) {
+    return id == 2 || id == 5;
+}
+
+static pa_bool_t input_is_parallel(unsigned id) {
+    return id != 3 && id != 6;
+}
+
+static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    struct test_input *t = i->userdata;
+    int16_t *d;
+    size_t k;
+
+    /* Whoever peeks us needs to be able to talk to the main thread */
+    if (pa_thread_mq_get() != &((struct test_sink *) i->sink->userdata)->thread_mq)
+        pa_atomic_inc(&wrong_mq);
+
+    if (input_is_silent(t->id))
+        return -1;
+
+    chunk->memblock = pa_memblock_new(i->core->mempool, nbytes);
+    chunk->index = 0;
+    chunk->length = nbytes;
+
+    d = pa_memblock_acquire(chunk->memblock);
+    for (k = 0; k < nbytes / sizeof(int16_t); k++)
+        d[k] = (int16_t) (((t->id + 1) * 997 + t->n_popped * 31 + k * 7) % 4001) - 2000;
+    pa_memblock_release(chunk->memblock);
+
+    t->n_popped++;
+
+    return 0;
+}
+
+static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+}
+
+static void sink_input_kill_cb(pa_sink_input *i) {
+    pa_sink_input_unlink(i);
+}
+
+static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    pa_sink *s = PA_SINK(o);
+
+    if (code == SINK_MESSAGE_RENDER) {
+        pa_sink_render_full(s, (size_t) offset, data);
+        return 0;
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+static void thread_func(void *userdata) {
+    struct test_sink *t = userdata;
+
+    pa_thread_mq_install(&t->thread_mq);
+
+    /* We only need to answer messages */
+    while (pa_rtpoll_run(t->rtpoll, TRUE) > 0)
+        ;
+}
+
+static void iterate(pa_mainloop *m) {
+    while (pa_mainloop_iterate(m, 0, NULL) > 0)
+        ;
+}
+
+static void test_sink_new(struct test_sink *t, unsigned render_threads) {
+    pa_sink_new_data data;
+    unsigned k;
+
+    pa_zero(*t);
+
+    t->mainloop = pa_mainloop_new();
+    t->core = pa_core_new(pa_mainloop_get_api(t->mainloop), FALSE, 0);
+    t->core->render_threads = render_threads;
+
+    t->rtpoll = pa_rtpoll_new();
+    pa_thread_mq_init(&t->thread_mq, pa_mainloop_get_api(t->mainloop), t->rtpoll);
+
+    pa_sink_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_new_data_set_name(&data, "render_test");
+    pa_sink_new_data_set_sample_spec(&data, &ss);
+    pa_sink_new_data_set_channel_map(&data, pa_channel_map_init_stereo(&map));
+    t->sink = pa_sink_new(t->core, &data, 0);
+    pa_sink_new_data_done(&data);
+    fail_unless(t->sink != NULL);
+
+    t->sink->parent.process_msg = sink_process_msg;
+    t->sink->userdata = t;
+    pa_sink_set_asyncmsgq(t->sink, t->thread_mq.inq);
+    pa_sink_set_rtpoll(t->sink, t->rtpoll);
+
+    t->thread = pa_thread_new("render-test", thread_func, t);
+    fail_unless(t->thread != NULL);
+
+    pa_sink_put(t->sink);
+    fail_unless(!t->sink->thread_info.render_pool == !render_threads);
+
+    for (k = 0; k < N_INPUTS; k++) {
+        pa_sink_input_new_data idata;
+        pa_cvolume v;
+
+        pa_sink_input_new_data_init(&idata);
+        idata.driver = __FILE__;
+        pa_sink_input_new_data_set_sink(&idata, t->sink, FALSE);
+        pa_sink_input_new_data_set_sample_spec(&idata, &ss);
+        pa_sink_input_new_data_set_channel_map(&idata, &map);
+        pa_sink_input_new_data_set_volume(&idata, pa_cvolume_set(&v, ss.channels, PA_VOLUME_NORM / (k + 1)));
+        if (input_is_parallel(k))
+            idata.flags |= PA_SINK_INPUT_PARALLEL_PEEK;
+
+        pa_sink_input_new(&t->inputs[k].sink_input, t->core, &idata);
+        pa_sink_input_new_data_done(&idata);
+        fail_unless(t->inputs[k].sink_input != NULL);
+
+        t->inputs[k].id = k;
+        t->inputs[k].sink_input->pop = sink_input_pop_cb;
+        t->inputs[k].sink_input->process_rewind = sink_input_process_rewind_cb;
+        t->inputs[k].sink_input->kill = sink_input_kill_cb;
+        t->inputs[k].sink_input->userdata = &t->inputs[k];
+
+        pa_sink_input_put(t->inputs[k].sink_input);
+    }
+
+    iterate(t->mainloop);
+}
+
+static void test_sink_free(struct test_sink *t) {
+    unsigned k;
+
+    for (k = 0; k < N_INPUTS; k++) {
+        pa_sink_input_unlink(t->inputs[k].sink_input);
+        pa_sink_input_unref(t->inputs[k].sink_input);
+    }
+
+    pa_sink_unlink(t->sink);
+
+    pa_asyncmsgq_send(t->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(t->thread);
+
+    iterate(t->mainloop);
+    pa_thread_mq_done(&t->thread_mq);
+
+    pa_sink_unref(t->sink);
+    pa_rtpoll_free(t->rtpoll);
+
+    pa_core_unref(t->core);
+    pa_mainloop_free(t->mainloop);
+}
+
+static void render(unsigned render_threads, uint8_t *out, size_t length) {
+    struct test_sink t;
+    size_t cycle = pa_frame_size(&ss) * CYCLE_FRAMES;
+
+    test_sink_new(&t, render_threads);
+
+    for (; length > 0; length -= cycle, out += cycle) {
+        pa_memchunk chunk;
+        void *d;
+
+        pa_assert_se(pa_asyncmsgq_send(t.sink->asyncmsgq, PA_MSGOBJECT(t.sink), SINK_MESSAGE_RENDER, &chunk, (int64_t) cycle, NULL) == 0);
+        fail_unless(chunk.length == cycle);
+
+        d = pa_memblock_acquire(chunk.memblock);
+        memcpy(out, (uint8_t *) d + chunk.index, cycle);
+        pa_memblock_release(chunk.memblock);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    test_sink_free(&t);
+}
+
+START_TEST (sink_render_test) {
+    size_t length = pa_frame_size(&ss) * CYCLE_FRAMES * N_CYCLES;
+    uint8_t *serial, *parallel;
+    unsigned n_threads;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    serial = pa_xmalloc(length);
+    parallel = pa_xmalloc(length);
+
+    pa_atomic_store(&wrong_mq, 0);
+    render(0, serial, length);
+
+    for (n_threads = 1; n_threads <= 4; n_threads++) {
+        memset(parallel, 0, length);
+        render(n_threads, parallel, length);
+
+        fail_unless(memcmp(serial, parallel, length) == 0);
+    }
+
+    fail_unless(pa_atomic_load(&wrong_mq) == 0);
+
+    pa_xfree(serial);
+    pa_xfree(parallel);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Sink render");
+    tc = tcase_create("sinkrender");
+    tcase_add_test(tc, sink_render_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
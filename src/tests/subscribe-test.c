@@ -0,0 +1,206 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <stdlib.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/core-subscribe.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#define N_EVENTS 1000
+
+struct received {
+    unsigned n;
+    pa_subscription_event_type_t type[2 * N_EVENTS];
+    uint32_t index[2 * N_EVENTS];
+};
+
+static void subscription_cb(pa_core *c, pa_subscription_event_type_t t, uint32_t idx, void *userdata) {
+    struct received *r = userdata;
+
+    fail_unless(r->n < 2 * N_EVENTS);
+
+    r->type[r->n] = t;
+    r->index[r->n] = idx;
+    r->n++;
+}
+
+static void iterate(pa_mainloop *m) {
+    while (pa_mainloop_iterate(m, 0, NULL) > 0)
+        ;
+}
+
+START_TEST (merge_test) {
+    pa_mainloop *m;
+    pa_core *c;
+    pa_subscription *s;
+    struct received r;
+    uint64_t delivered, suppressed;
+    unsigned i;
+
+    pa_zero(r);
+
+    m = pa_mainloop_new();
+    c = pa_core_new(pa_mainloop_get_api(m), FALSE, 0);
+    s = pa_subscription_new(c, PA_SUBSCRIPTION_MASK_ALL, subscription_cb, &r);
+
+    /* A volume ramp on one stream while another one comes and goes */
+    pa_subscription_post(c, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_NEW, 1);
+    for (i = 0; i < N_EVENTS; i++)
+        pa_subscription_post(c, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, 0);
+    pa_subscription_post(c, PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE, 0);
+    pa_subscription_post(c, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, 1);
+    pa_subscription_post(c, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_REMOVE, 1);
+
+    iterate(m);
+
+    fail_unless(r.n == 3);
+    fail_unless(r.type[0] == (PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE) && r.index[0] == 0);
+    fail_unless(r.type[1] == (PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE) && r.index[1] == 0);
+    fail_unless(r.type[2] == (PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_REMOVE) && r.index[2] == 1);
+
+    pa_subscription_get_stats(s, &delivered, &suppressed);
+    fail_unless(delivered == 3);
+    fail_unless(c->n_subscription_events_delivered == 3);
+    fail_unless(c->n_subscription_events_suppressed == N_EVENTS + 1);
+
+    pa_subscription_free(s);
+    iterate(m);
+
+    pa_core_unref(c);
+    pa_mainloop_free(m);
+}
+END_TEST
+
+/* At most the burst plus what the credit grew back since t0 */
+static pa_bool_t within_limit(unsigned n, unsigned rate, pa_usec_t t0) {
+    return n <= rate + (pa_rtclock_now() - t0) * rate / PA_USEC_PER_SEC + 1;
+}
+
+START_TEST (rate_limit_test) {
+    pa_mainloop *m;
+    pa_core *c;
+    pa_subscription *s;
+    struct received r;
+    uint64_t delivered, suppressed;
+    pa_usec_t t0;
+    unsigned i, j, rate = 100;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_zero(r);
+
+    m = pa_mainloop_new();
+    c = pa_core_new(pa_mainloop_get_api(m), FALSE, 0);
+    s = pa_subscription_new(c, PA_SUBSCRIPTION_MASK_ALL, subscription_cb, &r);
+
+    /* Only bounds are checked against the clock, so that a slow or
+     * busy machine can't make this fail */
+    t0 = pa_rtclock_now();
+    pa_subscription_set_rate_limit(s, rate);
+
+    /* Twice the burst of new objects */
+    for (i = 0; i < 2 * rate; i++)
+        pa_subscription_post(c, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_NEW, i);
+
+    iterate(m);
+    fail_unless(r.n >= rate);
+    fail_unless(within_limit(r.n, rate, t0));
+
+    /* Then a storm of changes on the ones that are held back, spread
+     * over many main loop iterations */
+    for (i = 0; i < N_EVENTS; i++) {
+        pa_subscription_post(c, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, rate + i % rate);
+        iterate(m);
+    }
+
+    fail_unless(within_limit(r.n, rate, t0));
+
+    /* Wait until everything that was held back went out */
+    for (;;) {
+        pa_subscription_get_stats(s, &delivered, &suppressed);
+        if (delivered + suppressed >= 2 * rate + N_EVENTS)
+            break;
+
+        pa_mainloop_iterate(m, 1, NULL);
+        fail_unless(within_limit(r.n, rate, t0));
+    }
+
+    pa_log_debug("Delivered %u events in %llu usec", r.n, (unsigned long long) (pa_rtclock_now() - t0));
+
+    fail_unless(delivered + suppressed == 2 * rate + N_EVENTS);
+    fail_unless(delivered == r.n);
+    fail_unless(suppressed > 0);
+
+    /* All new objects show up in order, and no change comes before the
+     * new event of its object: held back changes are merged into the
+     * held back "new" events */
+    for (i = 0, j = 0; i < r.n; i++) {
+        fail_unless(PA_SUBSCRIPTION_EVENT_SINK_INPUT == (r.type[i] & PA_SUBSCRIPTION_EVENT_FACILITY_MASK));
+
+        if ((r.type[i] & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_NEW) {
+            fail_unless(r.index[i] == j);
+            j++;
+        } else {
+            fail_unless((r.type[i] & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_CHANGE);
+            fail_unless(r.index[i] < j);
+        }
+    }
+
+    fail_unless(j == 2 * rate);
+
+    pa_subscription_free(s);
+    iterate(m);
+
+    pa_core_unref(c);
+    pa_mainloop_free(m);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Subscribe");
+    tc = tcase_create("subscribe");
+    tcase_add_test(tc, merge_test);
+    tcase_add_test(tc, rate_limit_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,273 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/format.h>
+#include <pulse/proplist.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/native-common.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/pstream-util.h>
+#include <pulsecore/tagstruct.h>
+
+#define N_STREAMS 500
+
+struct stream {
+    uint32_t index;
+    pa_sample_spec ss;
+    pa_channel_map map;
+    pa_cvolume volume;
+    pa_proplist *proplist;
+    pa_format_info *format;
+};
+
+static void stream_init(struct stream *s, uint32_t idx) {
+    s->index = idx;
+    s->ss.format = PA_SAMPLE_S16LE;
+    s->ss.rate = 44100;
+    s->ss.channels = 2;
+    pa_channel_map_init_stereo(&s->map);
+    pa_cvolume_set(&s->volume, 2, PA_VOLUME_NORM);
+
+    /* Roughly what a desktop client sets */
+    s->proplist = pa_proplist_new();
+    pa_proplist_setf(s->proplist, PA_PROP_MEDIA_NAME, "Playback Stream %u", idx);
+    pa_proplist_sets(s->proplist, PA_PROP_MEDIA_ROLE, "music");
+    pa_proplist_sets(s->proplist, PA_PROP_APPLICATION_NAME, "Some Media Player");
+    pa_proplist_sets(s->proplist, PA_PROP_APPLICATION_ID, "org.example.MediaPlayer");
+    pa_proplist_sets(s->proplist, PA_PROP_APPLICATION_ICON_NAME, "media-player");
+    pa_proplist_setf(s->proplist, PA_PROP_APPLICATION_PROCESS_ID, "%u", 1000 + idx);
+    pa_proplist_sets(s->proplist, PA_PROP_APPLICATION_PROCESS_USER, "user");
+    pa_proplist_sets(s->proplist, PA_PROP_APPLICATION_PROCESS_HOST, "localhost");
+    pa_proplist_sets(s->proplist, PA_PROP_APPLICATION_PROCESS_BINARY, "media-player");
+    pa_proplist_sets(s->proplist, PA_PROP_APPLICATION_LANGUAGE, "en_US.UTF-8");
+    pa_proplist_sets(s->proplist, PA_PROP_WINDOW_X11_DISPLAY, ":0");
+    pa_proplist_setf(s->proplist, "module-stream-restore.id", "sink-input-by-application-name:Stream %u", idx);
+
+    /* More than pa_tagstruct_put_proplist() looks up at once */
+    if (idx == 0) {
+        char key[32];
+        unsigned i;
+
+        for (i = 0; i < 100; i++) {
+            pa_snprintf(key, sizeof(key), "test.key%u", i);
+            pa_proplist_setf(s->proplist, key, "%u", i);
+        }
+    }
+
+    s->format = pa_format_info_new();
+    s->format->encoding = PA_ENCODING_PCM;
+    pa_format_info_set_rate(s->format, 44100);
+    pa_format_info_set_channels(s->format, 2);
+}
+
+static void stream_done(struct stream *s) {
+    pa_proplist_free(s->proplist);
+    pa_format_info_free(s->format);
+}
+
+/* The same as protocol-native does for a sink input info reply */
+static void put_stream(pa_tagstruct *t, struct stream *s) {
+    pa_tagstruct_putu32(t, s->index);
+    pa_tagstruct_puts(t, pa_proplist_gets(s->proplist, PA_PROP_MEDIA_NAME));
+    pa_tagstruct_putu32(t, PA_INVALID_INDEX);
+    pa_tagstruct_putu32(t, 7);
+    pa_tagstruct_putu32(t, 0);
+    pa_tagstruct_put_sample_spec(t, &s->ss);
+    pa_tagstruct_put_channel_map(t, &s->map);
+    pa_tagstruct_put_cvolume(t, &s->volume);
+    pa_tagstruct_put_usec(t, 25000);
+    pa_tagstruct_put_usec(t, 10000);
+    pa_tagstruct_puts(t, "speex-float-1");
+    pa_tagstruct_puts(t, "protocol-native.c");
+    pa_tagstruct_put_boolean(t, FALSE);
+    pa_tagstruct_put_proplist(t, s->proplist);
+    pa_tagstruct_put_boolean(t, FALSE);
+    pa_tagstruct_put_boolean(t, TRUE);
+    pa_tagstruct_put_boolean(t, TRUE);
+    pa_tagstruct_put_format_info(t, s->format);
+}
+
+static void get_stream(pa_tagstruct *t, struct stream *s) {
+    uint32_t idx, u;
+    const char *name, *str;
+    pa_sample_spec ss;
+    pa_channel_map map;
+    pa_cvolume volume;
+    pa_usec_t usec;
+    pa_bool_t b;
+    pa_proplist *p;
+    pa_format_info *f;
+
+    p = pa_proplist_new();
+    f = pa_format_info_new();
+
+    fail_unless(pa_tagstruct_getu32(t, &idx) == 0);
+    fail_unless(idx == s->index);
+    fail_unless(pa_tagstruct_gets(t, &name) == 0);
+    fail_unless(pa_streq(name, pa_proplist_gets(s->proplist, PA_PROP_MEDIA_NAME)));
+    fail_unless(pa_tagstruct_getu32(t, &u) == 0);
+    fail_unless(pa_tagstruct_getu32(t, &u) == 0);
+    fail_unless(pa_tagstruct_getu32(t, &u) == 0);
+    fail_unless(pa_tagstruct_get_sample_spec(t, &ss) == 0);
+    fail_unless(pa_sample_spec_equal(&ss, &s->ss));
+    fail_unless(pa_tagstruct_get_channel_map(t, &map) == 0);
+    fail_unless(pa_channel_map_equal(&map, &s->map));
+    fail_unless(pa_tagstruct_get_cvolume(t, &volume) == 0);
+    fail_unless(pa_cvolume_equal(&volume, &s->volume));
+    fail_unless(pa_tagstruct_get_usec(t, &usec) == 0);
+    fail_unless(pa_tagstruct_get_usec(t, &usec) == 0);
+    fail_unless(pa_tagstruct_gets(t, &str) == 0);
+    fail_unless(pa_tagstruct_gets(t, &str) == 0);
+    fail_unless(pa_tagstruct_get_boolean(t, &b) == 0);
+    fail_unless(pa_tagstruct_get_proplist(t, p) == 0);
+    fail_unless(pa_proplist_equal(p, s->proplist));
+    fail_unless(pa_tagstruct_get_boolean(t, &b) == 0);
+    fail_unless(pa_tagstruct_get_boolean(t, &b) == 0);
+    fail_unless(pa_tagstruct_get_boolean(t, &b) == 0);
+    fail_unless(pa_tagstruct_get_format_info(t, f) == 0);
+    fail_unless(f->encoding == s->format->encoding);
+    fail_unless(pa_proplist_equal(f->plist, s->format->plist));
+
+    pa_proplist_free(p);
+    pa_format_info_free(f);
+}
+
+static pa_packet *build_reply(struct stream *s, unsigned n) {
+    pa_tagstruct *t;
+    unsigned i;
+
+    t = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_putu32(t, PA_COMMAND_REPLY);
+    pa_tagstruct_putu32(t, 4711);
+
+    for (i = 0; i < n; i++)
+        put_stream(t, &s[i]);
+
+    return pa_pstream_packet_from_tagstruct(t);
+}
+
+static void check_reply(pa_packet *packet, struct stream *s, unsigned n) {
+    pa_tagstruct *t;
+    uint32_t command, tag;
+    unsigned i;
+
+    t = pa_tagstruct_new(packet->data, packet->length);
+    fail_unless(pa_tagstruct_getu32(t, &command) == 0);
+    fail_unless(command == PA_COMMAND_REPLY);
+    fail_unless(pa_tagstruct_getu32(t, &tag) == 0);
+    fail_unless(tag == 4711);
+
+    for (i = 0; i < n; i++)
+        get_stream(t, &s[i]);
+
+    fail_unless(pa_tagstruct_eof(t));
+    pa_tagstruct_free(t);
+}
+
+START_TEST (tagstruct_test) {
+    struct stream s[N_STREAMS];
+    unsigned i, n;
+
+    for (i = 0; i < N_STREAMS; i++)
+        stream_init(&s[i], i);
+
+    /* Replies that fit into the pooled buffers and ones that don't,
+     * several times over so that recycled buffers are written to */
+    for (n = 0; n < 3; n++)
+        for (i = 1; i <= N_STREAMS; i *= 3) {
+            pa_packet *packet;
+
+            packet = build_reply(s, i);
+            check_reply(packet, s, i);
+            pa_packet_unref(packet);
+        }
+
+    for (i = 0; i < N_STREAMS; i++)
+        stream_done(&s[i]);
+}
+END_TEST
+
+START_TEST (proplist_keys_test) {
+    const char * const keys[] = { PA_PROP_MEDIA_NAME, "does.not.exist", PA_PROP_APPLICATION_NAME, NULL };
+    const char * const no_keys[] = { NULL };
+    pa_proplist *p, *q;
+    pa_tagstruct *t;
+    uint32_t u;
+
+    p = pa_proplist_new();
+    pa_proplist_sets(p, PA_PROP_MEDIA_NAME, "Song");
+    pa_proplist_sets(p, PA_PROP_APPLICATION_NAME, "Player");
+    pa_proplist_sets(p, PA_PROP_APPLICATION_ICON_NAME, "player");
+
+    t = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_put_proplist_keys(t, p, keys);
+    pa_tagstruct_put_proplist_keys(t, p, no_keys);
+    pa_tagstruct_putu32(t, 4711);
+
+    q = pa_proplist_new();
+    fail_unless(pa_tagstruct_get_proplist(t, q) == 0);
+    fail_unless(pa_proplist_size(q) == 2);
+    fail_unless(pa_streq(pa_proplist_gets(q, PA_PROP_MEDIA_NAME), "Song"));
+    fail_unless(pa_streq(pa_proplist_gets(q, PA_PROP_APPLICATION_NAME), "Player"));
+
+    pa_proplist_clear(q);
+    fail_unless(pa_tagstruct_get_proplist(t, q) == 0);
+    fail_unless(pa_proplist_size(q) == 0);
+
+    fail_unless(pa_tagstruct_getu32(t, &u) == 0);
+    fail_unless(u == 4711);
+    fail_unless(pa_tagstruct_eof(t));
+
+    pa_tagstruct_free(t);
+    pa_proplist_free(q);
+    pa_proplist_free(p);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Tagstruct");
+    tc = tcase_create("tagstruct");
+    tcase_add_test(tc, tagstruct_test);
+    tcase_add_test(tc, proplist_keys_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
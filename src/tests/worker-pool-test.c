@@ -0,0 +1,281 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/resampler.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/thread-mq.h>
+#include <pulsecore/worker-pool.h>
+
+#define N_JOBS 1000
+#define N_RUNS 100
+
+static pa_thread_mq dummy_mq;
+static pa_atomic_t counters[N_JOBS];
+static pa_atomic_t wrong_mq;
+
+static void count_job(void *userdata, unsigned job) {
+    fail_unless(job < N_JOBS);
+
+    if (pa_thread_mq_get() != &dummy_mq)
+        pa_atomic_inc(&wrong_mq);
+
+    pa_atomic_inc(&counters[job]);
+}
+
+START_TEST (worker_pool_test) {
+    pa_worker_pool *p;
+    unsigned i, run;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    /* The calling thread takes part in the work too */
+    pa_thread_mq_install(&dummy_mq);
+
+    p = pa_worker_pool_new("test", 3, 0);
+    fail_unless(pa_worker_pool_get_n_threads(p) == 3);
+
+    for (i = 0; i < N_JOBS; i++)
+        pa_atomic_store(&counters[i], 0);
+
+    /* Every job of every run is done exactly once, no matter whether
+     * there are fewer or more jobs than threads */
+    for (run = 0; run < N_RUNS; run++) {
+        unsigned n = run % 5 == 0 ? run % 4 : N_JOBS;
+
+        pa_worker_pool_run(p, count_job, NULL, n);
+
+        for (i = 0; i < N_JOBS; i++)
+            if (i < n)
+                fail_unless(pa_atomic_dec(&counters[i]) == 1);
+            else
+                fail_unless(pa_atomic_load(&counters[i]) == 0);
+    }
+
+    fail_unless(pa_atomic_load(&wrong_mq) == 0);
+
+    pa_worker_pool_free(p);
+}
+END_TEST
+
+/* What a sink does for each of its inputs on every render cycle:
+ * resample the data it got from the client and apply the stream
+ * volume. The results are then mixed on the IO thread. */
+
+#define INPUT_FRAMES 1024
+#define N_CYCLES 20
+
+struct input {
+    pa_resampler *resampler;
+    pa_cvolume volume;
+    pa_memchunk result;
+};
+
+struct inputs {
+    struct input *inputs;
+    pa_memchunk source;
+    pa_sample_spec ss;
+};
+
+static void render_job(void *userdata, unsigned job) {
+    struct inputs *d = userdata;
+    struct input *in = d->inputs + job;
+
+    pa_resampler_run(in->resampler, &d->source, &in->result);
+    fail_unless(in->result.memblock != NULL);
+
+    pa_memchunk_make_writable(&in->result, 0);
+    pa_volume_memchunk(&in->result, &d->ss, &in->volume);
+}
+
+static struct input *inputs_new(pa_mempool *pool, unsigned n, const pa_sample_spec *a, const pa_sample_spec *b) {
+    struct input *inputs;
+    unsigned i;
+
+    inputs = pa_xnew0(struct input, n);
+
+    for (i = 0; i < n; i++) {
+        inputs[i].resampler = pa_resampler_new(pool, a, NULL, b, NULL, PA_RESAMPLER_AUTO, 0);
+        fail_unless(inputs[i].resampler != NULL);
+
+        pa_cvolume_set(&inputs[i].volume, b->channels, PA_VOLUME_NORM / (i % 3 + 2));
+    }
+
+    return inputs;
+}
+
+static void inputs_free(struct input *inputs, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+        pa_resampler_free(inputs[i].resampler);
+
+    pa_xfree(inputs);
+}
+
+/* Renders one cycle and returns the mixed result */
+static pa_memchunk render(pa_mempool *pool, pa_worker_pool *wp, struct inputs *d, unsigned n, pa_mix_info *info) {
+    pa_memchunk out;
+    size_t length = (size_t) -1;
+    unsigned i;
+
+    if (wp)
+        pa_worker_pool_run(wp, render_job, d, n);
+    else
+        for (i = 0; i < n; i++)
+            render_job(d, i);
+
+    for (i = 0; i < n; i++) {
+        info[i].chunk = d->inputs[i].result;
+        pa_cvolume_reset(&info[i].volume, d->ss.channels);
+        length = PA_MIN(length, info[i].chunk.length);
+    }
+
+    out.memblock = pa_memblock_new(pool, length);
+    out.index = 0;
+    out.length = pa_mix(info, n, pa_memblock_acquire(out.memblock), length, &d->ss, NULL, FALSE);
+    pa_memblock_release(out.memblock);
+
+    for (i = 0; i < n; i++)
+        pa_memblock_unref(d->inputs[i].result.memblock);
+
+    return out;
+}
+
+static void run_benchmark(pa_mempool *pool, unsigned n, unsigned n_threads) {
+    pa_sample_spec a = { .format = PA_SAMPLE_S16NE, .rate = 44100, .channels = 2 };
+    pa_sample_spec b = { .format = PA_SAMPLE_S16NE, .rate = 48000, .channels = 2 };
+    struct inputs serial, parallel;
+    pa_worker_pool *wp;
+    pa_mix_info *info;
+    pa_usec_t t_serial = 0, t_parallel = 0;
+    int16_t *d;
+    unsigned i, cycle;
+
+    info = pa_xnew0(pa_mix_info, n);
+
+    serial.ss = parallel.ss = b;
+    serial.inputs = inputs_new(pool, n, &a, &b);
+    parallel.inputs = inputs_new(pool, n, &a, &b);
+
+    serial.source.memblock = pa_memblock_new(pool, INPUT_FRAMES * pa_frame_size(&a));
+    serial.source.index = 0;
+    serial.source.length = pa_memblock_get_length(serial.source.memblock);
+
+    d = pa_memblock_acquire(serial.source.memblock);
+    for (i = 0; i < INPUT_FRAMES * a.channels; i++)
+        d[i] = (int16_t) (10000.0 * sin((double) i / 50.0));
+    pa_memblock_release(serial.source.memblock);
+
+    parallel.source = serial.source;
+
+    wp = pa_worker_pool_new("bench", n_threads, 0);
+
+    for (cycle = 0; cycle < N_CYCLES; cycle++) {
+        pa_memchunk s, p;
+        pa_usec_t start;
+        void *x, *y;
+
+        start = pa_rtclock_now();
+        s = render(pool, NULL, &serial, n, info);
+        t_serial += pa_rtclock_now() - start;
+
+        start = pa_rtclock_now();
+        p = render(pool, wp, &parallel, n, info);
+        t_parallel += pa_rtclock_now() - start;
+
+        /* The mix must not depend on which thread rendered what */
+        fail_unless(s.length == p.length);
+        x = pa_memblock_acquire(s.memblock);
+        y = pa_memblock_acquire(p.memblock);
+        fail_unless(memcmp(x, y, s.length) == 0);
+        pa_memblock_release(p.memblock);
+        pa_memblock_release(s.memblock);
+
+        pa_memblock_unref(s.memblock);
+        pa_memblock_unref(p.memblock);
+    }
+
+    pa_log_debug("%u inputs: serial %llu usec, %u workers %llu usec per cycle",
+                 n, (unsigned long long) (t_serial / N_CYCLES),
+                 n_threads, (unsigned long long) (t_parallel / N_CYCLES));
+
+    pa_worker_pool_free(wp);
+    pa_memblock_unref(serial.source.memblock);
+    inputs_free(serial.inputs, n);
+    inputs_free(parallel.inputs, n);
+    pa_xfree(info);
+}
+
+START_TEST (worker_pool_benchmark) {
+    static const unsigned n_inputs[] = { 1, 4, 16, 64, 200 };
+    pa_mempool *pool;
+    unsigned i, n_threads;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    /* Use all CPUs, the calling thread is one of them */
+    n_threads = PA_CLAMP(pa_ncpus(), 2U, 32U) - 1;
+
+    pool = pa_mempool_new(FALSE, 0);
+
+    for (i = 0; i < PA_ELEMENTSOF(n_inputs); i++)
+        run_benchmark(pool, n_inputs[i], n_threads);
+
+    pa_mempool_free(pool);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Worker pool");
+    tc = tcase_create("workerpool");
+    tcase_add_test(tc, worker_pool_test);
+    tcase_add_test(tc, worker_pool_benchmark);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -66,6 +66,7 @@ static uint32_t
     sink_idx = PA_INVALID_INDEX;
 
 static pa_bool_t short_list_format = FALSE;
+static pa_bool_t verbose = FALSE;
 static uint32_t module_index;
 static int32_t latency_offset;
 static pa_bool_t suspend;
@@ -164,6 +165,50 @@ static void stat_callback(pa_context *c, const pa_stat_info *i, void *userdata)
     pa_bytes_snprint(s, sizeof(s), i->scache_size);
     printf(_("Sample cache size: %s\n"), s);
 
+    if (pa_context_get_server_protocol_version(c) >= 32) {
+        char saved[PA_BYTES_SNPRINT_MAX];
+
+        pa_bytes_snprint(s, sizeof(s), i->resampler_cache_size);
+        pa_bytes_snprint(saved, sizeof(saved), i->resampler_cache_saved);
+        printf(_("Resampler filter tables: %s, %s saved by sharing them.\n"), s, saved);
+    }
+
+    if (pa_context_get_server_protocol_version(c) >= 33) {
+        printf(_("Subscription events: %llu sent, %llu saved by merging them.\n"),
+               (unsigned long long) i->subscription_events_delivered,
+               (unsigned long long) i->subscription_events_suppressed);
+        printf(_("Subscription events of this client: %llu sent, %llu saved by merging them.\n"),
+               (unsigned long long) i->client_subscription_events_delivered,
+               (unsigned long long) i->client_subscription_events_suppressed);
+    }
+
+    complete_action();
+}
+
+static void print_latency_stats(const char *title, uint32_t n, const pa_latency_stat_info *stats) {
+    uint32_t j;
+
+    printf("%s\n", title);
+
+    for (j = 0; j < n; j++)
+        printf(_("\t%s: %llu samples, median %llu usec, 99%% %llu usec, max %llu usec\n"),
+               stats[j].name,
+               (unsigned long long) stats[j].count,
+               (unsigned long long) stats[j].p50,
+               (unsigned long long) stats[j].p99,
+               (unsigned long long) stats[j].max);
+}
+
+static void latency_stats_callback(pa_context *c, const pa_latency_stats_info *i, void *userdata) {
+    if (!i) {
+        pa_log(_("Failed to get latency statistics: %s"), pa_strerror(pa_context_errno(c)));
+        quit(1);
+        return;
+    }
+
+    print_latency_stats(_("Command handling times:"), i->n_commands, i->commands);
+    print_latency_stats(_("IO thread message round trip times:"), i->n_threads, i->threads);
+
     complete_action();
 }
 
@@ -1115,6 +1160,18 @@ static void context_state_callback(pa_context *c, void *userdata) {
             switch (action) {
                 case STAT:
                     pa_operation_unref(pa_context_stat(c, stat_callback, NULL));
+                    if (verbose) {
+                        pa_operation *o;
+
+                        if (!(o = pa_context_get_latency_stats(c, latency_stats_callback, NULL))) {
+                            pa_log(_("Failed to get latency statistics: %s"), pa_strerror(pa_context_errno(c)));
+                            quit(1);
+                            break;
+                        }
+
+                        pa_operation_unref(o);
+                        actions++;
+                    }
                     if (short_list_format)
                         break;
                     actions++;
@@ -1407,11 +1464,13 @@ static void help(const char *argv0) {
              "  -h, --help                            Show this help\n"
              "      --version                         Show version\n\n"
              "  -s, --server=SERVER                   The name of the server to connect to\n"
-             "  -n, --client-name=NAME                How to call this client on the server\n"));
+             "  -n, --client-name=NAME                How to call this client on the server\n"
+             "      --verbose                         Include server latency statistics in stat\n"));
 }
 
 enum {
-    ARG_VERSION = 256
+    ARG_VERSION = 256,
+    ARG_VERBOSE
 };
 
 int main(int argc, char *argv[]) {
@@ -1423,6 +1482,7 @@ int main(int argc, char *argv[]) {
         {"server",      1, NULL, 's'},
         {"client-name", 1, NULL, 'n'},
         {"version",     0, NULL, ARG_VERSION},
+        {"verbose",     0, NULL, ARG_VERBOSE},
         {"help",        0, NULL, 'h'},
         {NULL,          0, NULL, 0}
     };
@@ -1453,6 +1513,10 @@ int main(int argc, char *argv[]) {
                 ret = 0;
                 goto quit;
 
+            case ARG_VERBOSE:
+                verbose = TRUE;
+                break;
+
             case 's':
                 pa_xfree(server);
                 server = pa_xstrdup(optarg);